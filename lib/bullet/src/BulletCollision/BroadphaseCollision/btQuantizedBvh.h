@@ -485,11 +485,24 @@ public:
 
 ////////////////////////////////////////////////////////////////////
 
-	SIMD_FORCE_INLINE bool isQuantized()
+	SIMD_FORCE_INLINE bool isQuantized() const
 	{
 		return m_useQuantization;
 	}
 
+	///STK: read access to the nodes of a tree which is not quantized, used
+	///to cast several rays at once against the tree
+	SIMD_FORCE_INLINE const NodeArray&	getContiguousNodeArray() const
+	{
+		return m_contiguousNodes;
+	}
+
+	///STK: number of nodes used in the node array
+	SIMD_FORCE_INLINE int getNumNodes() const
+	{
+		return m_curNodeIndex;
+	}
+
 private:
 	// Special "copy" constructor that allows for in-place deserialization
 	// Prevents btVector3's default constructor from being called, but doesn't inialize much else
@@ -68,7 +68,8 @@ protected:
 	
 	void	updateActivationState(btScalar timeStep);
 
-	void	updateActions(btScalar timeStep);
+	///STK: virtual, so that all karts can cast their suspension rays at once
+	virtual void	updateActions(btScalar timeStep);
 
 	void	startProfiling(btScalar timeStep);
 
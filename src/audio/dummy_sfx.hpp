@@ -67,6 +67,10 @@ public:
     virtual void       onSoundEnabledBack() OVERRIDE {}
     virtual void       setRolloff(float rolloff) OVERRIDE {}
     virtual const SFXBuffer* getBuffer() const OVERRIDE { return NULL; }
+    virtual float      getAudibility(const Vec3 &listener) OVERRIDE
+                                                              { return 0.0f; }
+    virtual bool       isVirtual() OVERRIDE { return false; }
+    virtual void       reallySetVirtual(bool is_virtual) OVERRIDE {}
 
 };   // DummySFX
 
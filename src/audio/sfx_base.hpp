@@ -84,6 +84,9 @@ public:
     virtual void       setRolloff(float rolloff)            = 0;
     virtual const SFXBuffer* getBuffer() const              = 0;
     virtual SFXStatus  getStatus()                          = 0;
+    virtual float      getAudibility(const Vec3 &listener)  = 0;
+    virtual bool       isVirtual()                          = 0;
+    virtual void       reallySetVirtual(bool is_virtual)    = 0;
 
 };   // SFXBase
 
@@ -56,6 +56,7 @@ SFXBuffer::SFXBuffer(const std::string& file,
     m_loaded      = false;
     m_max_dist    = max_dist;
     m_duration    = -1.0f;
+    m_priority    = 0;
     m_file        = file;
 
     m_rolloff     = rolloff;
@@ -76,6 +77,7 @@ SFXBuffer::SFXBuffer(const std::string& file,
     m_rolloff     = 0.1f;
     m_max_dist    = 300.0f;
     m_duration    = -1.0f;
+    m_priority    = 0;
     m_positional  = false;
     m_loaded      = false;
     m_file        = file;
@@ -85,6 +87,7 @@ SFXBuffer::SFXBuffer(const std::string& file,
     node->get("volume",      &m_gain       );
     node->get("max_dist",    &m_max_dist   );
     node->get("duration",    &m_duration   );
+    node->get("priority",    &m_priority   );
 }   // SFXBuffer(XMLNode)
 
 //----------------------------------------------------------------------------
@@ -72,6 +72,10 @@ private:
     /** Duration of the sfx. */
     float    m_duration;
 
+    /** Priority when selecting the sfx which are really played if there
+     *  are too many, higher values are preferred (before audibility). */
+    int      m_priority;
+
     bool loadVorbisBuffer(const std::string &name, ALuint buffer);
 
 public:
@@ -119,6 +123,12 @@ public:
     // ------------------------------------------------------------------------
     /** Returns how long this buffer will play. */
     float getDuration() const { return m_duration; }
+    // ------------------------------------------------------------------------
+    /** Returns the priority of this sfx, see SFXManager::updateVoices. */
+    int   getPriority() const { return m_priority; }
+    // ------------------------------------------------------------------------
+    /** Sets the priority of this sfx. */
+    void  setPriority(int priority) { m_priority = priority; }
 
 };   // class SFXBuffer
 
@@ -22,13 +22,14 @@
 #include "audio/sfx_buffer.hpp"
 #include "config/user_config.hpp"
 #include "io/file_manager.hpp"
-#include "modes/world.hpp"
 #include "race/race_manager.hpp"
 #include "utils/profiler.hpp"
 #include "utils/string_utils.hpp"
 #include "utils/vs.hpp"
 
 #include <pthread.h>
+#include <mutex>
+#include <thread>
 #include <stdexcept>
 #include <algorithm>
 #include <cerrno>
@@ -62,6 +63,16 @@
 
 SFXManager *SFXManager::m_sfx_manager;
 
+/** Number of commands which can be queued before the sfx thread executes
+ *  them. Must be a power of two. */
+static const unsigned SFX_COMMAND_RING_SIZE = 4096;
+
+#ifdef ENABLE_SOUND
+/** True in the sfx thread, which must not wait for space in the command
+ *  ring (since it is the one that frees it). */
+static thread_local bool g_is_sfx_thread = false;
+#endif
+
 // ----------------------------------------------------------------------------
 /** Static function to create the singleton sfx manager.
  */
@@ -83,8 +94,9 @@ void SFXManager::destroy()
 // ----------------------------------------------------------------------------
 /** Initialises the SFX manager and loads the sfx from a config file.
  */
-SFXManager::SFXManager()
+SFXManager::SFXManager() : m_sfx_commands(SFX_COMMAND_RING_SIZE)
 {
+    m_dropped_commands = 0;
 
     // The sound manager initialises OpenAL
     m_initialized = music_manager->initialized();
@@ -102,6 +114,7 @@ SFXManager::SFXManager()
     if (UserConfigParams::m_enable_sound)
     {
         pthread_cond_init(&m_cond_request, NULL);
+        pthread_mutex_init(&m_cond_mutex, NULL);
     
         pthread_attr_t  attr;
         pthread_attr_init(&attr);
@@ -124,9 +137,6 @@ SFXManager::SFXManager()
         pthread_attr_destroy(&attr);
     
         setMasterSFXVolume( UserConfigParams::m_sfx_volume );
-        m_sfx_commands.lock();
-        m_sfx_commands.getData().clear();
-        m_sfx_commands.unlock();
     }
 #endif
 }  // SoundManager
@@ -144,6 +154,7 @@ SFXManager::~SFXManager()
         delete m_thread_id.getData();
         m_thread_id.unlock();
         pthread_cond_destroy(&m_cond_request);
+        pthread_mutex_destroy(&m_cond_mutex);
     }
 #endif
 
@@ -199,8 +210,7 @@ void SFXManager::queue(SFXCommands command,  SFXBase *sfx)
     if (!UserConfigParams::m_enable_sound)
         return;
 
-    SFXCommand *sfx_command = new SFXCommand(command, sfx);
-    queueCommand(sfx_command);
+    queueCommand(SFXCommand(command, sfx));
 #endif
 }   // queue
 
@@ -218,8 +228,7 @@ void SFXManager::queue(SFXCommands command, SFXBase *sfx, float f)
     if (!UserConfigParams::m_enable_sound)
         return;
 
-    SFXCommand *sfx_command = new SFXCommand(command, sfx, f);
-    queueCommand(sfx_command);
+    queueCommand(SFXCommand(command, sfx, f));
 #endif
 }   // queue(float)
 
@@ -237,8 +246,7 @@ void SFXManager::queue(SFXCommands command, SFXBase *sfx, const Vec3 &p)
     if (!UserConfigParams::m_enable_sound)
         return;
 
-    SFXCommand *sfx_command = new SFXCommand(command, sfx, p);
-    queueCommand(sfx_command);
+    queueCommand(SFXCommand(command, sfx, p));
 #endif
 }   // queue (Vec3)
 
@@ -250,8 +258,8 @@ void SFXManager::queue(SFXCommands command, SFXBase *sfx, const Vec3 &p, SFXBuff
     if (!UserConfigParams::m_enable_sound)
         return;
 
-    SFXCommand *sfx_command = new SFXCommand(command, sfx, p);
-    sfx_command->m_buffer = buffer;
+    SFXCommand sfx_command(command, sfx, p);
+    sfx_command.m_buffer = buffer;
     queueCommand(sfx_command);
 #endif
 }   // queue (Vec3)
@@ -272,8 +280,7 @@ void SFXManager::queue(SFXCommands command, SFXBase *sfx, float f,
     if (!UserConfigParams::m_enable_sound)
         return;
 
-    SFXCommand *sfx_command = new SFXCommand(command, sfx, f, p);
-    queueCommand(sfx_command);
+    queueCommand(SFXCommand(command, sfx, f, p));
 #endif
 }   // queue(float, Vec3)
 
@@ -287,8 +294,7 @@ void SFXManager::queue(SFXCommands command, MusicInformation *mi)
     if (!UserConfigParams::m_enable_sound)
         return;
 
-    SFXCommand *sfx_command = new SFXCommand(command, mi);
-    queueCommand(sfx_command);
+    queueCommand(SFXCommand(command, mi));
 #endif
 }   // queue(MusicInformation)
 //----------------------------------------------------------------------------
@@ -303,48 +309,71 @@ void SFXManager::queue(SFXCommands command, MusicInformation *mi, float f)
     if (!UserConfigParams::m_enable_sound)
         return;
 
-    SFXCommand *sfx_command = new SFXCommand(command, mi, f);
-    queueCommand(sfx_command);
+    queueCommand(SFXCommand(command, mi, f));
 #endif
 }   // queue(MusicInformation)
 
 //----------------------------------------------------------------------------
-/** Enqueues a command to the sfx queue threadsafe. Then signal the
- *  sfx manager to wake up.
- *  \param command Pointer to the command to queue up.
+/** Enqueues a command to the sfx queue threadsafe. The command is copied into
+ *  the preallocated ring, so no memory is allocated. If the ring is full,
+ *  position, speed and loop updates are dropped (the next frame will send
+ *  new values anyway), and other commands wait till the sfx thread has
+ *  executed some commands.
+ *  \param command The command to queue up.
  */
-void SFXManager::queueCommand(SFXCommand *command)
+void SFXManager::queueCommand(const SFXCommand &command)
 {
 #ifdef ENABLE_SOUND
     if (!UserConfigParams::m_enable_sound)
         return;
-        
-    m_sfx_commands.lock();
-    if(World::getWorld() && 
-        m_sfx_commands.getData().size() > 20*race_manager->getNumberOfKarts()+20 &&
-        race_manager->getMinorMode() != RaceManager::MINOR_MODE_CUTSCENE)
+
+    if (m_sfx_commands.push(command))
+        return;
+
+    if (g_is_sfx_thread)
+    {
+        // The sfx thread can not wait for itself. An update will be queued
+        // again the next time the ring is empty.
+        if (command.m_command != SFX_UPDATE)
+            m_overflow_commands.push_back(command);
+        return;
+    }
+
+    if (command.m_command == SFX_POSITION || command.m_command == SFX_LOOP  ||
+        command.m_command == SFX_SPEED    || command.m_command == SFX_UPDATE ||
+        command.m_command == SFX_SPEED_POSITION                               )
     {
-        if(command->m_command==SFX_POSITION || command->m_command==SFX_LOOP ||
-           command->m_command==SFX_SPEED    || 
-           command->m_command==SFX_SPEED_POSITION                               )
+        unsigned dropped = m_dropped_commands++;
+        if (dropped < 5)
         {
-            delete command;
-            static int count_messages = 0;
-            if(count_messages < 5)
-            {
-                Log::warn("SFXManager", "Throttling sfx - queue size %d",
-                         m_sfx_commands.getData().size());
-                count_messages++;
-            }
-            m_sfx_commands.unlock();
+            Log::warn("SFXManager", "Throttling sfx - queue size %d",
+                      (int)m_sfx_commands.size());
+        }
+        return;
+    }
+
+    // Make sure the sfx thread is awake to empty the ring, and wait for it.
+    // If the thread is not running (anymore), the command is lost.
+    wakeUp();
+    while (!m_sfx_commands.push(command))
+    {
+        if (m_thread_id.getAtomic() == 0 || isReadyToDeleted())
             return;
-        }   // if throttling
+        std::this_thread::yield();
     }
-    m_sfx_commands.getData().push_back(command);
-    m_sfx_commands.unlock();
 #endif
 }   // queueCommand
 
+//----------------------------------------------------------------------------
+/** Wakes up the sfx thread to handle all queued up audio commands.
+ */
+void SFXManager::wakeUp()
+{
+    pthread_mutex_lock(&m_cond_mutex);
+    pthread_cond_signal(&m_cond_request);
+    pthread_mutex_unlock(&m_cond_mutex);
+}   // wakeUp
+
 //----------------------------------------------------------------------------
 /** Puts a NULL request into the queue, which will trigger the thread to
  *  exit.
@@ -356,7 +385,7 @@ void SFXManager::stopThread()
     {
         queue(SFX_EXIT);
         // Make sure the thread wakes up.
-        pthread_cond_signal(&m_cond_request);
+        wakeUp();
     }
     else
 #endif
@@ -378,103 +407,45 @@ void* SFXManager::mainLoop(void *obj)
         return NULL;
         
     VS::setThreadName("SFXManager");
+    g_is_sfx_thread = true;
     SFXManager *me = (SFXManager*)obj;
 
-    me->m_sfx_commands.lock();
-
-    // Wait till we have an empty sfx in the queue
-    while (me->m_sfx_commands.getData().empty() ||
-           me->m_sfx_commands.getData().front()->m_command!=SFX_EXIT)
+    std::vector<SFXCommand> overflow;
+    SFXCommand current;
+    while (true)
     {
-        PROFILER_PUSH_CPU_MARKER("Wait", 255, 0, 0);
-        bool empty = me->m_sfx_commands.getData().empty();
-
-        // Wait in cond_wait for a request to arrive. The 'while' is necessary
-        // since "spurious wakeups from the pthread_cond_wait ... may occur"
-        // (pthread_cond_wait man page)!
-        while (empty)
+        // First execute the commands this thread could not queue
+        if (!me->m_overflow_commands.empty())
         {
-            pthread_cond_wait(&me->m_cond_request, me->m_sfx_commands.getMutex());
-            empty = me->m_sfx_commands.getData().empty();
+            overflow.swap(me->m_overflow_commands);
+            for (const SFXCommand &command : overflow)
+                me->executeCommand(command);
+            overflow.clear();
         }
-        SFXCommand *current = me->m_sfx_commands.getData().front();
-        me->m_sfx_commands.getData().erase(me->m_sfx_commands.getData().begin());
 
-        if (current->m_command == SFX_EXIT)
+        PROFILER_PUSH_CPU_MARKER("Wait", 255, 0, 0);
+        if (!me->m_sfx_commands.pop(&current))
         {
-            delete current;
-            break;
+            // Wait in cond_wait for a request to arrive. The 'while' is
+            // necessary since "spurious wakeups from the pthread_cond_wait
+            // ... may occur" (pthread_cond_wait man page)!
+            pthread_mutex_lock(&me->m_cond_mutex);
+            while (!me->m_sfx_commands.pop(&current))
+                pthread_cond_wait(&me->m_cond_request, &me->m_cond_mutex);
+            pthread_mutex_unlock(&me->m_cond_mutex);
         }
-        me->m_sfx_commands.unlock();
         PROFILER_POP_CPU_MARKER();
-        PROFILER_PUSH_CPU_MARKER("Execute", 0, 255, 0);
-        switch (current->m_command)
-        {
-        case SFX_PLAY:     current->m_sfx->reallyPlayNow();       break;
-        case SFX_PLAY_POSITION:
-            current->m_sfx->reallyPlayNow(current->m_parameter, current->m_buffer);  break;
-        case SFX_STOP:     current->m_sfx->reallyStopNow();       break;
-        case SFX_PAUSE:    current->m_sfx->reallyPauseNow();      break;
-        case SFX_RESUME:   current->m_sfx->reallyResumeNow();     break;
-        case SFX_SPEED:    current->m_sfx->reallySetSpeed(
-                                  current->m_parameter.getX());   break;
-        case SFX_POSITION: current->m_sfx->reallySetPosition(
-                                         current->m_parameter);   break;
-        case SFX_SPEED_POSITION: current->m_sfx->reallySetSpeedPosition(
-                                         // Extract float from W component
-                                         current->m_parameter.getW(),
-                                         current->m_parameter);   break;
-        case SFX_VOLUME:   current->m_sfx->reallySetVolume(
-                                  current->m_parameter.getX());   break;
-        case SFX_MASTER_VOLUME:
-            current->m_sfx->reallySetMasterVolumeNow(
-                                  current->m_parameter.getX());   break;
-        case SFX_LOOP:     current->m_sfx->reallySetLoop(
-                             current->m_parameter.getX() != 0);   break;
-        case SFX_DELETE:     me->deleteSFX(current->m_sfx);       break;
-        case SFX_PAUSE_ALL:  me->reallyPauseAllNow();             break;
-        case SFX_RESUME_ALL: me->reallyResumeAllNow();            break;
-        case SFX_LISTENER:   me->reallyPositionListenerNow();     break;
-        case SFX_UPDATE:     me->reallyUpdateNow(current);        break;
-        case SFX_MUSIC_START:
-        {
-            current->m_music_information->setDefaultVolume();
-            current->m_music_information->startMusic();           break;
-        }
-        case SFX_MUSIC_STOP:
-            current->m_music_information->stopMusic();            break;
-        case SFX_MUSIC_PAUSE:
-            current->m_music_information->pauseMusic();           break;
-        case SFX_MUSIC_RESUME:
-            current->m_music_information->resumeMusic();
-            // This might be necessasary if the volume was changed
-            // in the in-game menu
-            current->m_music_information->setDefaultVolume();     break;
-        case SFX_MUSIC_SWITCH_FAST:
-            current->m_music_information->switchToFastMusic();    break;
-        case SFX_MUSIC_SET_TMP_VOLUME:
-        {
-            MusicInformation *mi = current->m_music_information;
-            mi->setTemporaryVolume(current->m_parameter.getX());  break;
-        }
-        case SFX_MUSIC_WAITING:
-               current->m_music_information->setMusicWaiting();   break;
-        case SFX_MUSIC_DEFAULT_VOLUME:
-        {
-            current->m_music_information->setDefaultVolume();
+
+        if (current.m_command == SFX_EXIT)
             break;
-        }
-        case SFX_CREATE_SOURCE:
-            current->m_sfx->init(); break;
-        default: assert("Not yet supported.");
-        }
-        delete current;
-        current = NULL;
+
+        PROFILER_PUSH_CPU_MARKER("Execute", 0, 255, 0);
+        me->executeCommand(current);
         PROFILER_POP_CPU_MARKER();
         PROFILER_PUSH_CPU_MARKER("yield", 0, 0, 255);
-        // We access the size without lock, doesn't matter if we
-        // should get an incorrect value because of concurrent read/writes
-        if (me->m_sfx_commands.getData().size() == 0 && me->sfxAllowed())
+        // The size is only approximate, doesn't matter if we should get
+        // an incorrect value because of concurrent writes
+        if (me->m_sfx_commands.size() == 0 && me->sfxAllowed())
         {
             // Wait some time to let other threads run, then queue an
             // update event to keep music playing.
@@ -483,26 +454,85 @@ void* SFXManager::mainLoop(void *obj)
             t = StkTime::getMonoTimeMs() - t;
             me->queue(SFX_UPDATE, (SFXBase*)NULL, float(t / 1000.0));
         }
-        me->m_sfx_commands.lock();
         PROFILER_POP_CPU_MARKER();
     }   // while
 
-    // Signal that the sfx manager can now be deleted.
-    // We signal this even before cleaning up memory, since there is no
-    // need to keep the user waiting for STK to exit.
+    // Signal that the sfx manager can now be deleted. Commands which are
+    // still in the ring don't own any memory, so they can just be ignored.
     me->setCanBeDeleted();
-
-    // Clean up memory to avoid leak detection
-    while(!me->m_sfx_commands.getData().empty())
-    {
-        delete me->m_sfx_commands.getData().front();
-        me->m_sfx_commands.getData().erase(me->m_sfx_commands.getData().begin());
-    }
-    me->m_sfx_commands.unlock();
 #endif
     return NULL;
 }   // mainLoop
 
+//----------------------------------------------------------------------------
+/** Executes one command, called from the sfx thread.
+ *  \param command The command to execute.
+ */
+void SFXManager::executeCommand(const SFXCommand &command)
+{
+    switch (command.m_command)
+    {
+    case SFX_PLAY:     command.m_sfx->reallyPlayNow();       break;
+    case SFX_PLAY_POSITION:
+        command.m_sfx->reallyPlayNow(command.m_parameter, command.m_buffer);
+        break;
+    case SFX_STOP:     command.m_sfx->reallyStopNow();       break;
+    case SFX_PAUSE:    command.m_sfx->reallyPauseNow();      break;
+    case SFX_RESUME:   command.m_sfx->reallyResumeNow();     break;
+    case SFX_SPEED:    command.m_sfx->reallySetSpeed(
+                              command.m_parameter.getX());   break;
+    case SFX_POSITION: command.m_sfx->reallySetPosition(
+                                     command.m_parameter);   break;
+    case SFX_SPEED_POSITION: command.m_sfx->reallySetSpeedPosition(
+                                     // Extract float from W component
+                                     command.m_parameter.getW(),
+                                     command.m_parameter);   break;
+    case SFX_VOLUME:   command.m_sfx->reallySetVolume(
+                              command.m_parameter.getX());   break;
+    case SFX_MASTER_VOLUME:
+        command.m_sfx->reallySetMasterVolumeNow(
+                              command.m_parameter.getX());   break;
+    case SFX_LOOP:     command.m_sfx->reallySetLoop(
+                         command.m_parameter.getX() != 0);   break;
+    case SFX_DELETE:     deleteSFX(command.m_sfx);           break;
+    case SFX_PAUSE_ALL:  reallyPauseAllNow();                break;
+    case SFX_RESUME_ALL: reallyResumeAllNow();               break;
+    case SFX_LISTENER:   reallyPositionListenerNow();        break;
+    case SFX_UPDATE:     reallyUpdateNow(command);           break;
+    case SFX_MUSIC_START:
+    {
+        command.m_music_information->setDefaultVolume();
+        command.m_music_information->startMusic();           break;
+    }
+    case SFX_MUSIC_STOP:
+        command.m_music_information->stopMusic();            break;
+    case SFX_MUSIC_PAUSE:
+        command.m_music_information->pauseMusic();           break;
+    case SFX_MUSIC_RESUME:
+        command.m_music_information->resumeMusic();
+        // This might be necessasary if the volume was changed
+        // in the in-game menu
+        command.m_music_information->setDefaultVolume();     break;
+    case SFX_MUSIC_SWITCH_FAST:
+        command.m_music_information->switchToFastMusic();    break;
+    case SFX_MUSIC_SET_TMP_VOLUME:
+    {
+        MusicInformation *mi = command.m_music_information;
+        mi->setTemporaryVolume(command.m_parameter.getX());  break;
+    }
+    case SFX_MUSIC_WAITING:
+           command.m_music_information->setMusicWaiting();   break;
+    case SFX_MUSIC_DEFAULT_VOLUME:
+    {
+        command.m_music_information->setDefaultVolume();
+        break;
+    }
+    case SFX_CREATE_SOURCE:
+        command.m_sfx->init(); break;
+    default: assert("Not yet supported.");
+    }
+}   // executeCommand
+
 //----------------------------------------------------------------------------
 /** Called when sound is globally switched on or off. It either pauses or
  *  resumes all sound effects. 
@@ -686,12 +716,14 @@ SFXBuffer* SFXManager::loadSingleSfx(const XMLNode* node,
 
     SFXBuffer tmpbuffer(full_path, node);
 
-    return addSingleSfx(sfx_name, full_path,
-                        tmpbuffer.isPositional(),
-                        tmpbuffer.getRolloff(),
-                        tmpbuffer.getMaxDist(),
-                        tmpbuffer.getGain(),
-                        load);
+    SFXBuffer *buffer = addSingleSfx(sfx_name, full_path,
+                                     tmpbuffer.isPositional(),
+                                     tmpbuffer.getRolloff(),
+                                     tmpbuffer.getMaxDist(),
+                                     tmpbuffer.getGain(),
+                                     load);
+    m_all_sfx_types[sfx_name]->setPriority(tmpbuffer.getPriority());
+    return buffer;
 
 }   // loadSingleSfx
 
@@ -820,7 +852,7 @@ void SFXManager::update()
 
     queue(SFX_UPDATE, (SFXBase*)NULL);
     // Wake up the sfx thread to handle all queued up audio commands.
-    pthread_cond_signal(&m_cond_request);
+    wakeUp();
 #endif
 }   // update
 
@@ -829,7 +861,7 @@ void SFXManager::update()
  *  This function is executed once per frame (triggered by the audio thread).
  *  \param current The sfx command - used to get timestep information.
 */
-void SFXManager::reallyUpdateNow(SFXCommand *current)
+void SFXManager::reallyUpdateNow(const SFXCommand &current)
 {
 #ifdef ENABLE_SOUND
     if (!UserConfigParams::m_enable_sound)
@@ -845,7 +877,7 @@ void SFXManager::reallyUpdateNow(SFXCommand *current)
     m_last_update_time = StkTime::getMonoTimeMs();
     float dt = float(m_last_update_time - previous_update_time) / 1000.0f;
 
-    assert(current->m_command==SFX_UPDATE);
+    assert(current.m_command==SFX_UPDATE);
     if (music_manager->getCurrentMusic())
         music_manager->getCurrentMusic()->update(dt);
     m_all_sfx.lock();
@@ -857,6 +889,8 @@ void SFXManager::reallyUpdateNow(SFXCommand *current)
     }   // for i in m_all_sfx
     m_all_sfx.unlock();
 
+    updateVoices();
+
     // We need to lock the quick sounds during update, since adding more
     // quick sounds by another thread could invalidate the iterator.
     m_quick_sounds.lock();
@@ -870,6 +904,229 @@ void SFXManager::reallyUpdateNow(SFXCommand *current)
 #endif
 }   // reallyUpdateNow
 
+//----------------------------------------------------------------------------
+/** Limits the number of sfx which are really played by OpenAL to
+ *  UserConfigParams::m_sfx_max_voices. The playing sfx are sorted by the
+ *  priority of their buffer, then by how loud they are at the listener. The
+ *  others are made virtual: they are paused in OpenAL, but keep their
+ *  status and play time, and continue at the right offset once they are
+ *  selected again. Executed once per frame from the sfx thread.
+ */
+void SFXManager::updateVoices()
+{
+#ifdef ENABLE_SOUND
+    if (!sfxAllowed()) return;
+
+    const Vec3 listener = getListenerPos();
+    m_all_sfx.lock();
+    m_voice_candidates.clear();
+    for (SFXBase *sfx : m_all_sfx.getData())
+    {
+        if (sfx->getStatus() != SFXBase::SFX_PLAYING)
+            continue;
+        VoiceCandidate candidate;
+        candidate.m_sfx        = sfx;
+        candidate.m_priority   = sfx->getBuffer()
+                               ? sfx->getBuffer()->getPriority() : 0;
+        candidate.m_audibility = sfx->getAudibility(listener);
+        // Prefer sfx which are already played, otherwise sfx with a similar
+        // audibility could be swapped every frame.
+        if (!sfx->isVirtual())
+            candidate.m_audibility *= 1.25f;
+        m_voice_candidates.push_back(candidate);
+    }   // for sfx in m_all_sfx
+
+    int max_voices = UserConfigParams::m_sfx_max_voices;
+    unsigned max = max_voices > 0 ? (unsigned)max_voices
+                                  : (unsigned)m_voice_candidates.size();
+    selectVoices(&m_voice_candidates, max);
+    for (unsigned i = 0; i < m_voice_candidates.size(); i++)
+        m_voice_candidates[i].m_sfx->reallySetVirtual(i >= max);
+    m_all_sfx.unlock();
+#endif
+}   // updateVoices
+
+//----------------------------------------------------------------------------
+/** Moves the max_voices most important candidates to the front of the
+ *  vector (in no particular order). Higher priorities come first, then
+ *  higher audibility.
+ *  \param candidates The sfx to select from.
+ *  \param max_voices Number of sfx which can be played.
+ */
+void SFXManager::selectVoices(std::vector<VoiceCandidate> *candidates,
+                              unsigned max_voices)
+{
+    if (candidates->size() <= max_voices)
+        return;
+    std::nth_element(candidates->begin(), candidates->begin() + max_voices,
+        candidates->end(),
+        [](const VoiceCandidate &a, const VoiceCandidate &b)
+        {
+            if (a.m_priority != b.m_priority)
+                return a.m_priority > b.m_priority;
+            return a.m_audibility > b.m_audibility;
+        });
+}   // selectVoices
+
+//----------------------------------------------------------------------------
+void SFXManager::unitTesting()
+{
+    std::vector<VoiceCandidate> candidates;
+    auto add = [&candidates](int priority, float audibility)
+        {
+            VoiceCandidate candidate;
+            candidate.m_sfx        = NULL;
+            candidate.m_priority   = priority;
+            candidate.m_audibility = audibility;
+            candidates.push_back(candidate);
+        };
+    auto selected = [&candidates](unsigned max_voices, int priority,
+                                  float audibility)
+        {
+            for (unsigned i = 0; i < max_voices; i++)
+            {
+                if (candidates[i].m_priority == priority &&
+                    candidates[i].m_audibility == audibility)
+                    return true;
+            }
+            return false;
+        };
+
+    // The loudest sfx are selected
+    add(0, 0.1f); add(0, 0.9f); add(0, 0.5f); add(0, 0.3f); add(0, 0.7f);
+    selectVoices(&candidates, 2);
+    if (!selected(2, 0, 0.9f) || !selected(2, 0, 0.7f))
+        Log::fatal("SFXManager", "The loudest sfx were not selected.");
+
+    // A higher priority wins even if the sfx is barely audible
+    add(1, 0.05f);
+    selectVoices(&candidates, 2);
+    if (!selected(2, 1, 0.05f) || !selected(2, 0, 0.9f))
+        Log::fatal("SFXManager", "The priority of a sfx was ignored.");
+
+    // Nothing is changed if all sfx can be played
+    candidates.clear();
+    add(0, 0.1f); add(2, 0.9f); add(1, 0.5f);
+    selectVoices(&candidates, 3);
+    if (candidates[0].m_audibility != 0.1f ||
+        candidates[1].m_audibility != 0.9f ||
+        candidates[2].m_audibility != 0.5f)
+        Log::fatal("SFXManager", "The sfx were reordered.");
+}   // unitTesting
+
+//----------------------------------------------------------------------------
+/** Compares the previous command queue (a heap allocated command appended to
+ *  a vector protected by a mutex, and removed from its front by the sfx
+ *  thread) with the ring, for one and several producer threads. The commands
+ *  are executed for dummy sfx, so only the queue itself is measured.
+ */
+void SFXManager::benchmarkCommands()
+{
+    SFXManager *me = get();
+    if (!me)
+    {
+        Log::warn("Benchmark", "No sfx manager.");
+        return;
+    }
+    const int num_commands = 100000;
+    std::vector<DummySFX*> all_sfx;
+    for (unsigned i = 0; i < 64; i++)
+        all_sfx.push_back(new DummySFX(NULL, true, 1.0f));
+    auto make_command = [&all_sfx](int i)
+        {
+            SFXBase *sfx = all_sfx[i % all_sfx.size()];
+            switch (i % 4)
+            {
+            case 0:  return SFXCommand(SFX_POSITION, sfx, Vec3(1, 2, 3));
+            case 1:  return SFXCommand(SFX_SPEED, sfx, 1.5f);
+            case 2:  return SFXCommand(SFX_SPEED_POSITION, sfx, 1.5f,
+                                       Vec3(1, 2, 3));
+            default: return SFXCommand(SFX_VOLUME, sfx, 0.5f);
+            }
+        };
+
+    for (int producers = 1; producers <= 4; producers *= 4)
+    {
+        const int per_producer = num_commands / producers;
+
+        std::mutex queue_mutex;
+        std::vector<SFXCommand*> queue;
+        uint64_t start = StkTime::getMonoTimeUs();
+        std::vector<std::thread> threads;
+        for (int p = 0; p < producers; p++)
+        {
+            threads.emplace_back([&, p]()
+                {
+                    for (int i = 0; i < per_producer; i++)
+                    {
+                        SFXCommand *command =
+                            new SFXCommand(make_command(i + p));
+                        std::lock_guard<std::mutex> lock(queue_mutex);
+                        queue.push_back(command);
+                    }
+                });
+        }
+        for (int executed = 0; executed < per_producer * producers;)
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            if (queue.empty())
+            {
+                lock.unlock();
+                std::this_thread::yield();
+                continue;
+            }
+            SFXCommand *command = queue.front();
+            queue.erase(queue.begin());
+            lock.unlock();
+            me->executeCommand(*command);
+            delete command;
+            executed++;
+        }
+        for (std::thread &t : threads)
+            t.join();
+        uint64_t vector_time = StkTime::getMonoTimeUs() - start;
+
+        MPSCRing<SFXCommand> ring(SFX_COMMAND_RING_SIZE);
+        threads.clear();
+        start = StkTime::getMonoTimeUs();
+        for (int p = 0; p < producers; p++)
+        {
+            threads.emplace_back([&, p]()
+                {
+                    for (int i = 0; i < per_producer; i++)
+                    {
+                        SFXCommand command = make_command(i + p);
+                        while (!ring.push(command))
+                            std::this_thread::yield();
+                    }
+                });
+        }
+        SFXCommand command;
+        for (int executed = 0; executed < per_producer * producers;)
+        {
+            if (!ring.pop(&command))
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            me->executeCommand(command);
+            executed++;
+        }
+        for (std::thread &t : threads)
+            t.join();
+        uint64_t ring_time = StkTime::getMonoTimeUs() - start;
+
+        Log::info("Benchmark", "%d producer(s), %d commands: mutex vector "
+            "%8.2f ms, ring %8.2f ms (%.1f million commands/s).", producers,
+            per_producer * producers, vector_time / 1000.0,
+            ring_time / 1000.0,
+            per_producer * producers / (double)ring_time);
+    }
+
+    for (DummySFX *sfx : all_sfx)
+        delete sfx;
+}   // benchmarkCommands
+
 //----------------------------------------------------------------------------
 /** Delete a sound effect object, and removes it from the internal list of
  *  all SFXs. This call deletes the object, and removes it from the list of
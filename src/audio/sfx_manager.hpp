@@ -20,11 +20,12 @@
 #define HEADER_SFX_MANAGER_HPP
 
 #include "utils/can_be_deleted.hpp"
-#include "utils/leak_check.hpp"
+#include "utils/mpsc_ring.hpp"
 #include "utils/no_copy.hpp"
 #include "utils/synchronised.hpp"
 #include "utils/vec3.hpp"
 
+#include <atomic>
 #include <map>
 #include <string>
 #include <vector>
@@ -113,17 +114,16 @@ public:
 private:
 
     /** Data structure for the queue, which stores a sfx and the command to 
-     *  execute for it. */
-    class SFXCommand : public NoCopy
+     *  execute for it. It is copied by value into the command ring, so it
+     *  should remain as small as possible. */
+    class SFXCommand
     {
-    private:
-        LEAK_CHECK()
     public:
         /** The sound effect for which the command should be executed. */
         SFXBase *m_sfx;
 
         /** The sound buffer to play (null = no change) */
-        SFXBuffer *m_buffer = NULL;
+        SFXBuffer *m_buffer;
 
         /** Stores music information for music commands. */
         MusicInformation *m_music_information;
@@ -134,16 +134,22 @@ private:
          *  floating point values are stored in the X component. */
         Vec3        m_parameter;
         // --------------------------------------------------------------------
+        /** Default constructor, used for the slots of the command ring. */
+        SFXCommand()
+        {
+            init(SFX_UPDATE);
+        }   // SFXCommand
+        // --------------------------------------------------------------------
         SFXCommand(SFXCommands command, SFXBase *base)
         {
-            m_command   = command;
+            init(command);
             m_sfx       = base;
         }   // SFXCommand()
         // --------------------------------------------------------------------
         /** Constructor for music information commands. */
         SFXCommand(SFXCommands command, MusicInformation *mi)
         {
-            m_command           = command;
+            init(command);
             m_music_information = mi;
         }   // SFXCommnd(MusicInformation*)
         // --------------------------------------------------------------------
@@ -151,21 +157,21 @@ private:
          *  point parameter (which is stored in the X value of m_parameter). */
         SFXCommand(SFXCommands command, MusicInformation *mi, float f)
         {
-            m_command = command;
+            init(command);
             m_parameter.setX(f);
             m_music_information = mi;
         }   // SFXCommnd(MusicInformation *, float)
         // --------------------------------------------------------------------
         SFXCommand(SFXCommands command, SFXBase *base, float parameter)
         {
-            m_command   = command;
+            init(command);
             m_sfx       = base;
             m_parameter.setX(parameter);
         }   // SFXCommand(float)
         // --------------------------------------------------------------------
         SFXCommand(SFXCommands command, SFXBase *base, const Vec3 &parameter)
         {
-            m_command   = command;
+            init(command);
             m_sfx       = base;
             m_parameter = parameter;
         }   // SFXCommand(Vec3)
@@ -176,11 +182,20 @@ private:
         SFXCommand(SFXCommands command, SFXBase *base, float f,
                    const Vec3 &parameter)
         {
-            m_command   = command;
+            init(command);
             m_sfx       = base;
             m_parameter = parameter;
             m_parameter.setW(f);
         }   // SFXCommand(Vec3)
+        // --------------------------------------------------------------------
+        void init(SFXCommands command)
+        {
+            m_command           = command;
+            m_sfx               = NULL;
+            m_buffer            = NULL;
+            m_music_information = NULL;
+            m_parameter         = Vec3(0, 0, 0, 0);
+        }   // init
     };   // SFXCommand
     // ========================================================================
 
@@ -202,8 +217,30 @@ private:
     /** The actual instances (sound sources) */
     Synchronised<std::vector<SFXBase*> > m_all_sfx;
 
-    /** The list of sound effects to be played in the next update. */
-    Synchronised< std::vector<SFXCommand*> > m_sfx_commands;
+    /** The commands to be executed by the sfx thread. The ring is
+     *  preallocated, so queueing a command does not allocate memory. */
+    MPSCRing<SFXCommand>      m_sfx_commands;
+
+    /** Commands queued by the sfx thread itself while the ring was full
+     *  (it can not wait for itself). Only accessed by the sfx thread. */
+    std::vector<SFXCommand>   m_overflow_commands;
+
+    /** Number of position, speed and loop updates which were dropped
+     *  because the ring was full. */
+    std::atomic<unsigned>     m_dropped_commands;
+
+    /** A sfx which is playing, used to decide which ones are really
+     *  played by OpenAL. */
+    struct VoiceCandidate
+    {
+        SFXBase *m_sfx;
+        int      m_priority;
+        float    m_audibility;
+    };
+
+    /** Reused by updateVoices to avoid allocations each frame. Only
+     *  accessed by the sfx thread. */
+    std::vector<VoiceCandidate> m_voice_candidates;
 
     /** To play non-positional sounds without having to create a
      *  new object for each. */
@@ -223,18 +260,28 @@ private:
     /** A conditional variable to wake up the main loop. */
     pthread_cond_t            m_cond_request;
 
+    /** The mutex used with m_cond_request. */
+    pthread_mutex_t           m_cond_mutex;
+
     void                      loadSfx();
                              SFXManager();
     virtual                 ~SFXManager();
 
     static void* mainLoop(void *obj);
     void deleteSFX(SFXBase *sfx);
-    void queueCommand(SFXCommand *command);
+    void queueCommand(const SFXCommand &command);
+    void wakeUp();
+    void executeCommand(const SFXCommand &command);
     void reallyPositionListenerNow();
+    void updateVoices();
+    static void selectVoices(std::vector<VoiceCandidate> *candidates,
+                             unsigned max_voices);
 
 public:
     static void create();
     static void destroy();
+    static void unitTesting();
+    static void benchmarkCommands();
     void queue(SFXCommands command, SFXBase *sfx=NULL);
     void queue(SFXCommands command, SFXBase *sfx, float f);
     void queue(SFXCommands command, SFXBase *sfx, const Vec3 &p);
@@ -276,7 +323,7 @@ public:
     void                     resumeAll();
     void                     reallyResumeAllNow();
     void                     update();
-    void                     reallyUpdateNow(SFXCommand *current);
+    void                     reallyUpdateNow(const SFXCommand &current);
     bool                     soundExist(const std::string &name);
     void                     setMasterSFXVolume(float gain);
     float                    getMasterSFXVolume() const { return m_master_gain; }
@@ -296,6 +343,10 @@ public:
      *  debug audio leaks */
     void dump();
 
+    // ------------------------------------------------------------------------
+    /** Returns the number of commands which were dropped because the
+     *  command queue was full. */
+    unsigned getDroppedCommands() const { return m_dropped_commands; }
     // ------------------------------------------------------------------------
     /** Returns the current position of the listener. */
     Vec3 getListenerPos() const { return m_listener_position.getData(); }
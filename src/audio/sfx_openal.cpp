@@ -33,6 +33,7 @@
 #  include <AL/al.h>
 #endif
 
+#include <algorithm>
 #include <assert.h>
 #include <cmath>
 #include <stdio.h>
@@ -52,6 +53,8 @@ SFXOpenAL::SFXOpenAL(SFXBuffer* buffer, bool positional, float volume,
     m_master_gain  = 1.0f;
     m_owns_buffer  = owns_buffer;
     m_play_time    = 0.0f;
+    m_pitch        = 1.0f;
+    m_is_virtual   = false;
 
     // Don't initialise anything else if the sfx manager was not correctly
     // initialised. First of all the initialisation will not work, and it
@@ -176,6 +179,8 @@ void SFXOpenAL::reallySetSpeed(float factor)
     {
         factor = 0.5f;
     }
+    m_pitch = factor;
+    if (m_is_virtual) return;
     alSourcef(m_sound_source,AL_PITCH,factor);
     SFXManager::checkError("setting speed");
 }   // reallySetSpeed
@@ -284,6 +289,7 @@ void SFXOpenAL::reallyStopNow()
     {
         m_status = SFX_STOPPED;
         m_loop = false;
+        m_is_virtual = false;
         alSourcei(m_sound_source, AL_LOOPING, AL_FALSE);
         alSourceStop(m_sound_source);
         SFXManager::checkError("stopping");
@@ -308,6 +314,8 @@ void SFXOpenAL::reallyPauseNow()
     // from pauseAll, and we have to make sure to only pause playing sfx.
     if (m_status != SFX_PLAYING || !SFXManager::get()->sfxAllowed()) return;
     m_status = SFX_PAUSED;
+    // A virtual sfx is paused already
+    if (m_is_virtual) return;
     alSourcePause(m_sound_source);
     SFXManager::checkError("pausing");
 }   // reallyPauseNow
@@ -336,8 +344,13 @@ void SFXOpenAL::reallyResumeNow()
 
     if(m_status==SFX_PAUSED)
     {
-        alSourcePlay(m_sound_source);
-        SFXManager::checkError("resuming");
+        // A virtual sfx is started again by the sfx manager once it is
+        // one of the most audible sfx
+        if (!m_is_virtual)
+        {
+            alSourcePlay(m_sound_source);
+            SFXManager::checkError("resuming");
+        }
         m_status = SFX_PLAYING;
     }
 }   // reallyResumeNow
@@ -389,6 +402,15 @@ void SFXOpenAL::reallyPlayNow(SFXBuffer* buffer)
             return;
     }
 
+    if (m_is_virtual)
+    {
+        // Rewind the paused source, and restore its pitch and position
+        m_is_virtual = false;
+        alSourceStop(m_sound_source);
+        alSourcef(m_sound_source, AL_PITCH, m_pitch);
+        if (m_positional)
+            reallySetPosition(m_position);
+    }
     alSourcePlay(m_sound_source);
     SFXManager::checkError("playing");
     // Esp. with terrain sounds it can (very likely) happen that the status
@@ -469,6 +491,9 @@ void SFXOpenAL::reallySetPosition(const Vec3 &position)
         return;
     }
 
+    m_position = position;
+    if (m_is_virtual) return;
+
     alSource3f(m_sound_source, AL_POSITION, position.getX(),
                position.getY(), -position.getZ());
 
@@ -542,6 +567,58 @@ void SFXOpenAL::setRolloff(float rolloff)
     alSourcef (m_sound_source, AL_ROLLOFF_FACTOR,  rolloff);
 }
 
+//-----------------------------------------------------------------------------
+/** Returns how loud this sfx is heard by the listener, using the default
+ *  distance model of OpenAL (inverse distance clamped, reference distance 1).
+ *  \param listener Position of the listener.
+ */
+float SFXOpenAL::getAudibility(const Vec3 &listener)
+{
+    float gain = (m_gain < 0.0f ? m_default_gain : m_gain) * m_master_gain;
+    if (!m_positional)
+        return gain;
+    float distance = listener.distance(m_position);
+    if (distance > m_sound_buffer->getMaxDist())
+        return 0.0f;
+    return gain / (1.0f + m_sound_buffer->getRolloff() *
+                          std::max(distance - 1.0f, 0.0f));
+}   // getAudibility
+
+//-----------------------------------------------------------------------------
+/** Pauses the OpenAL source of a playing sfx which is not audible enough, or
+ *  continues it (at the position it would be now) when it is audible again.
+ *  Executed from the sfx manager thread.
+ *  \param is_virtual True if the sfx should not be played by OpenAL.
+ */
+void SFXOpenAL::reallySetVirtual(bool is_virtual)
+{
+    // Paused or stopped sfx are handled when they are resumed or played
+    // again, and the source might not be created yet
+    if (m_is_virtual == is_virtual || m_status != SFX_PLAYING ||
+        m_sound_source == 0)
+        return;
+    m_is_virtual = is_virtual;
+    if (is_virtual)
+    {
+        alSourcePause(m_sound_source);
+        SFXManager::checkError("virtualising");
+        return;
+    }
+
+    alSourcef(m_sound_source, AL_PITCH, m_pitch);
+    if (m_positional)
+        reallySetPosition(m_position);
+    const float duration = m_sound_buffer->getDuration();
+    if (duration > 0.0f)
+    {
+        alSourcef(m_sound_source, AL_SEC_OFFSET,
+                  m_loop ? fmodf(m_play_time, duration)
+                         : std::min(m_play_time, duration));
+    }
+    alSourcePlay(m_sound_source);
+    SFXManager::checkError("continuing a virtual sfx");
+}   // reallySetVirtual
+
 //-----------------------------------------------------------------------------
 
 #endif //ifdef ENABLE_SOUND
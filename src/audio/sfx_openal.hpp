@@ -30,6 +30,7 @@
 #include "audio/sfx_base.hpp"
 #include "utils/leak_check.hpp"
 #include "utils/cpp2011.hpp"
+#include "utils/vec3.hpp"
 
 /**
   * \brief OpenAL implementation of the abstract SFXBase interface
@@ -76,6 +77,17 @@ private:
     /** How long the sfx has been playing. */
     float m_play_time;
 
+    /** The last position set, used to compute the audibility and to
+     *  restore a virtual sfx. */
+    Vec3 m_position;
+
+    /** The last pitch set, to restore a virtual sfx. */
+    float m_pitch;
+
+    /** True if the sfx is playing, but the OpenAL source is paused since
+     *  other sfx are more audible (see SFXManager::updateVoices). */
+    bool m_is_virtual;
+
 public:
               SFXOpenAL(SFXBuffer* buffer, bool positional, float volume,
                         bool owns_buffer = false);
@@ -108,6 +120,11 @@ public:
     virtual void      reallySetMasterVolumeNow(float volue) OVERRIDE;
     virtual void      onSoundEnabledBack() OVERRIDE;
     virtual void      setRolloff(float rolloff) OVERRIDE;
+    virtual float     getAudibility(const Vec3 &listener) OVERRIDE;
+    virtual void      reallySetVirtual(bool is_virtual) OVERRIDE;
+    // ------------------------------------------------------------------------
+    /** Returns if this sfx is playing, but not heard currently. */
+    virtual bool      isVirtual() OVERRIDE { return m_is_virtual; }
     // ------------------------------------------------------------------------
     /** Returns if this sfx is looped or not. */
     virtual bool      isLooped()  OVERRIDE { return m_loop; }
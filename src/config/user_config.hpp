@@ -400,6 +400,11 @@ namespace UserConfigParams
     PARAM_PREFIX FloatUserConfigParam       m_music_volume
             PARAM_DEFAULT(  FloatUserConfigParam(0.5f, "music_volume",
             &m_audio_group, "Music volume from 0.0 to 1.0") );
+    PARAM_PREFIX IntUserConfigParam         m_sfx_max_voices
+            PARAM_DEFAULT(  IntUserConfigParam(32, "sfx_max_voices",
+            &m_audio_group, "Maximum number of sound effects played at the "
+                            "same time, the least audible ones are paused "
+                            "(0 = no limit).") );
 
     // ---- Race setup
     PARAM_PREFIX GroupUserConfigParam        m_race_setup_group
@@ -683,6 +688,9 @@ namespace UserConfigParams
     /** If gamepad debugging is enabled. */
     PARAM_PREFIX bool m_unit_testing PARAM_DEFAULT(false);
 
+    /** Comma separated list of benchmarks to run (or "all"). */
+    PARAM_PREFIX std::string m_benchmark PARAM_DEFAULT("");
+
     /** If gamepad debugging is enabled. */
     PARAM_PREFIX bool m_gamepad_debug PARAM_DEFAULT( false );
 
@@ -25,7 +25,6 @@
 #include "font/face_ttf.hpp"
 #include "font/regular_face.hpp"
 #include "modes/profile_world.hpp"
-#include "states_screens/state_manager.hpp"
 #include "utils/string_utils.hpp"
 #include "utils/translation.hpp"
 
@@ -46,6 +45,10 @@ FontManager::FontManager()
     m_ft_library = NULL;
     m_digit_face = NULL;
     m_shaping_dpi = 128;
+    m_cached_gls_memory = 0;
+    m_max_cached_gls_memory = 4 * 1024 * 1024;
+    m_cached_gls_hits = 0;
+    m_cached_gls_misses = 0;
     if (ProfileWorld::isNoGraphics())
         return;
 
@@ -518,22 +521,72 @@ void FontManager::shape(const std::u32string& text,
 }   // shape
 
 // ----------------------------------------------------------------------------
-/* Return the cached glyph layouts for writing, it will clear all layouts if
- * not in-game and when the cached sized exceed a certain number. */
-std::vector<irr::gui::GlyphLayout>&
+/** Returns the glyph layouts of a text, which are shaped if they are not in
+ *  the cache. The layouts are shared with the cache and must not be changed.
+ *  If the cache uses too much memory, the least recently used layouts are
+ *  removed from it (they are kept alive by their users if still needed).
+ */
+std::shared_ptr<const std::vector<irr::gui::GlyphLayout> >
                    FontManager::getCachedLayouts(const irr::core::stringw& str)
 {
-    const size_t MAX_LAYOUTS = 600;
-    if (StateManager::get()->getGameState() != GUIEngine::GAME &&
-        m_cached_gls.size() > MAX_LAYOUTS)
+    static std::shared_ptr<const std::vector<irr::gui::GlyphLayout> >
+        empty_layouts = std::make_shared<std::vector<irr::gui::GlyphLayout> >();
+    if (str.empty())
+        return empty_layouts;
+
+    auto it = m_cached_gls.find(str);
+    if (it != m_cached_gls.end())
+    {
+        m_cached_gls_hits++;
+        m_cached_gls_lru.splice(m_cached_gls_lru.begin(), m_cached_gls_lru,
+            it->second.m_lru);
+        return it->second.m_layouts;
+    }
+
+    m_cached_gls_misses++;
+    std::shared_ptr<std::vector<irr::gui::GlyphLayout> > gls =
+        std::make_shared<std::vector<irr::gui::GlyphLayout> >();
+    shape(StringUtils::wideToUtf32(str), *gls);
+    gls->shrink_to_fit();
+
+    auto inserted = m_cached_gls.emplace(str, CachedLayouts());
+    CachedLayouts& cached = inserted.first->second;
+    cached.m_layouts = gls;
+    cached.m_memory = sizeof(CachedLayouts) + sizeof(*gls) +
+        (str.size() + 1) * sizeof(wchar_t) +
+        gls->capacity() * sizeof(irr::gui::GlyphLayout);
+    for (const irr::gui::GlyphLayout& gl : *gls)
+    {
+        cached.m_memory += gl.cluster.capacity() * sizeof(gl.cluster[0]) +
+            gl.draw_flags.capacity() * sizeof(gl.draw_flags[0]);
+    }
+    m_cached_gls_memory += cached.m_memory;
+    m_cached_gls_lru.push_front(&inserted.first->first);
+    cached.m_lru = m_cached_gls_lru.begin();
+
+    // Remove the least recently used layouts, but always keep the new one
+    while (m_cached_gls_memory > m_max_cached_gls_memory &&
+           m_cached_gls_lru.size() > 1)
     {
-        Log::debug("FontManager",
-            "Clearing cached glyph layouts because too many.");
-        clearCachedLayouts();
+        auto oldest = m_cached_gls.find(*m_cached_gls_lru.back());
+        m_cached_gls_memory -= oldest->second.m_memory;
+        m_cached_gls_lru.pop_back();
+        m_cached_gls.erase(oldest);
     }
-    return m_cached_gls[str];
+    return gls;
 }   // getCachedLayouts
 
+// ----------------------------------------------------------------------------
+/** Removes all glyph layouts from the cache, e.g. after the language was
+ *  changed.
+ */
+void FontManager::clearCachedLayouts()
+{
+    m_cached_gls.clear();
+    m_cached_gls_lru.clear();
+    m_cached_gls_memory = 0;
+}   // clearCachedLayouts
+
 // ----------------------------------------------------------------------------
 /** Convert text to glyph layouts for fast rendering with caching enabled
  *  If line_data is not null, each broken line u32string will be saved and
@@ -554,10 +607,9 @@ void FontManager::initGlyphLayouts(const core::stringw& text,
         return;
     }
 
-    auto& cached_gls = getCachedLayouts(text);
-    if (cached_gls.empty())
-        shape(StringUtils::wideToUtf32(text), cached_gls);
-    gls = cached_gls;
+    // The caller can change its layouts (e.g. when breaking lines), so they
+    // are copied from the cache
+    gls = *getCachedLayouts(text);
 }   // initGlyphLayouts
 
 // ----------------------------------------------------------------------------
@@ -661,7 +713,7 @@ void FontManager::loadFonts()
 // ----------------------------------------------------------------------------
 /** Unit testing that will try to load all translations in STK, and discover if
  *  there is any characters required by it are not supported in \ref
- *  m_normal_ttf.
+ *  m_normal_ttf. It also tests the glyph layouts cache.
  */
 void FontManager::unitTesting()
 {
@@ -708,5 +760,35 @@ void FontManager::unitTesting()
             }
         }
     }
+
+    // Shared layouts and least recently used order of the glyph layouts
+    // cache (shaping is disabled without graphics)
+    if (ProfileWorld::isNoGraphics())
+        return;
+    clearCachedLayouts();
+    const size_t max_memory = m_max_cached_gls_memory;
+    const unsigned hits = m_cached_gls_hits;
+    const unsigned misses = m_cached_gls_misses;
+    auto first = getCachedLayouts(L"SuperTuxKart 0");
+    if (first->empty() || getCachedLayouts(L"SuperTuxKart 0") != first ||
+        m_cached_gls_hits != hits + 1 || m_cached_gls_misses != misses + 1)
+        Log::fatal("FontManager", "Glyph layouts were not shared.");
+
+    // Only keep space for three texts (of the same size)
+    m_max_cached_gls_memory = m_cached_gls_memory * 3 + 1;
+    getCachedLayouts(L"SuperTuxKart 1");
+    getCachedLayouts(L"SuperTuxKart 2");
+    getCachedLayouts(L"SuperTuxKart 0");
+    getCachedLayouts(L"SuperTuxKart 3");
+    if (m_cached_gls.find(L"SuperTuxKart 0") == m_cached_gls.end() ||
+        m_cached_gls.find(L"SuperTuxKart 1") != m_cached_gls.end() ||
+        m_cached_gls_memory > m_max_cached_gls_memory ||
+        m_cached_gls.size() != m_cached_gls_lru.size())
+        Log::fatal("FontManager", "Wrong glyph layouts were removed.");
+    // Removed layouts are still valid for their users
+    if (first->empty())
+        Log::fatal("FontManager", "Shared glyph layouts were changed.");
+    m_max_cached_gls_memory = max_memory;
+    clearCachedLayouts();
 #endif
 }   // unitTesting
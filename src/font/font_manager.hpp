@@ -27,8 +27,10 @@
 #include "utils/log.hpp"
 #include "utils/no_copy.hpp"
 
-#include <string>
+#include <list>
 #include <map>
+#include <memory>
+#include <string>
 #include <typeindex>
 #include <unordered_map>
 #include <vector>
@@ -70,9 +72,46 @@ private:
     /** Map FT_Face to index for quicker layout. */
     std::map<FT_Face, uint16_t> m_ft_faces_to_index;
 
+    /** Hash function for the text of the glyph layouts cache. */
+    struct StringwHash
+    {
+        size_t operator()(const irr::core::stringw& str) const
+        {
+            // FNV-1a
+            size_t hash = 2166136261u;
+            for (unsigned i = 0; i < str.size(); i++)
+                hash = (hash ^ (size_t)str[i]) * 16777619u;
+            return hash;
+        }
+    };
+
+    /** A shaped text in the glyph layouts cache. */
+    struct CachedLayouts
+    {
+        /** The layouts, which are shared with the users of the cache. */
+        std::shared_ptr<const std::vector<irr::gui::GlyphLayout> > m_layouts;
+        /** Approximate memory used by this entry in bytes. */
+        size_t m_memory;
+        /** Position in m_cached_gls_lru. */
+        std::list<const irr::core::stringw*>::iterator m_lru;
+    };
+
     /** Text drawn to glyph layouts cache. */
-    std::map<irr::core::stringw,
-        std::vector<irr::gui::GlyphLayout> > m_cached_gls;
+    std::unordered_map<irr::core::stringw, CachedLayouts, StringwHash>
+        m_cached_gls;
+
+    /** The texts in m_cached_gls, the most recently used first. */
+    std::list<const irr::core::stringw*> m_cached_gls_lru;
+
+    /** Approximate memory used by the glyph layouts cache in bytes. */
+    size_t m_cached_gls_memory;
+
+    /** If m_cached_gls_memory exceeds this, the least recently used
+     *  layouts are removed from the cache. */
+    size_t m_max_cached_gls_memory;
+
+    /** Statistics of the glyph layouts cache, shown in artist debug mode. */
+    unsigned m_cached_gls_hits, m_cached_gls_misses;
 
     bool m_has_color_emoji;
 #endif
@@ -130,10 +169,21 @@ public:
                std::vector<irr::gui::GlyphLayout>& gls,
                std::vector<std::u32string>* line_data = NULL);
     // ------------------------------------------------------------------------
-    std::vector<irr::gui::GlyphLayout>& getCachedLayouts
-                  (const irr::core::stringw& str);
+    std::shared_ptr<const std::vector<irr::gui::GlyphLayout> >
+        getCachedLayouts(const irr::core::stringw& str);
+    // ------------------------------------------------------------------------
+    void clearCachedLayouts();
+    // ------------------------------------------------------------------------
+    /** Returns the number of texts in the glyph layouts cache. */
+    unsigned getCachedLayoutsCount() const
+                                      { return (unsigned)m_cached_gls.size(); }
+    // ------------------------------------------------------------------------
+    /** Returns the approximate memory of the glyph layouts cache in bytes. */
+    size_t getCachedLayoutsMemory() const       { return m_cached_gls_memory; }
+    // ------------------------------------------------------------------------
+    unsigned getCachedLayoutsHits() const         { return m_cached_gls_hits; }
     // ------------------------------------------------------------------------
-    void clearCachedLayouts()                         { m_cached_gls.clear(); }
+    unsigned getCachedLayoutsMisses() const     { return m_cached_gls_misses; }
     // ------------------------------------------------------------------------
     void initGlyphLayouts(const irr::core::stringw& text,
                           std::vector<irr::gui::GlyphLayout>& gls,
@@ -531,11 +531,10 @@ core::dimension2d<u32> FontWithFace::getDimension(const core::stringw& text,
             m_font_max_height, 1.0f/*inverse shaping*/, scale);
     }
 
-    auto& gls = font_manager->getCachedLayouts(text);
-    if (gls.empty() && !text.empty())
-        font_manager->shape(StringUtils::wideToUtf32(text), gls);
+    std::shared_ptr<const std::vector<gui::GlyphLayout> > gls =
+        font_manager->getCachedLayouts(text);
 
-    return gui::getGlyphLayoutsDimension(gls,
+    return gui::getGlyphLayoutsDimension(*gls,
         m_font_max_height * scale, m_inverse_shaping, scale);
 #endif
 }   // getDimension
@@ -1020,11 +1019,10 @@ void FontWithFace::drawText(const core::stringw& text,
         return;
     }
 
-    auto& gls = font_manager->getCachedLayouts(text);
-    if (gls.empty() && !text.empty())
-        font_manager->shape(StringUtils::wideToUtf32(text), gls);
+    std::shared_ptr<const std::vector<gui::GlyphLayout> > gls =
+        font_manager->getCachedLayouts(text);
 
-    render(gls, position, color, hcenter, vcenter, clip,
+    render(*gls, position, color, hcenter, vcenter, clip,
         font_settings, char_collector);
 #endif
 }   // drawText
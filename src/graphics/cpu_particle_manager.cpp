@@ -193,9 +193,18 @@ void CPUParticleManager::generateAll()
         {
             continue;
         }
+        // The particles of all nodes are written directly into the array
+        // which is uploaded, so reserve enough space for all of them first
+        std::vector<CPUParticle>& generated = m_particles_generated[p.first];
+        size_t max_count = generated.size();
         for (auto& q : p.second)
         {
-            q->generate(&m_particles_generated[p.first]);
+            max_count += q->getMaxCount();
+        }
+        generated.reserve(max_count);
+        for (auto& q : p.second)
+        {
+            q->generate(&generated);
         }
         if (isFlipsMaterial(p.first))
         {
@@ -46,11 +46,21 @@ struct CPUParticle
     video::SColor m_color_lifetime;
     short m_size[2];
     // ------------------------------------------------------------------------
+    /** Creates an uninitialised particle, which must be set with set(). */
+    CPUParticle() {}
+    // ------------------------------------------------------------------------
     CPUParticle(const core::vector3df& position,
                 const core::vector3df& color_from,
                 const core::vector3df& color_to, float lf_time, float size)
-         : m_position(position)
     {
+        set(position, color_from, color_to, lf_time, size);
+    }
+    // ------------------------------------------------------------------------
+    void set(const core::vector3df& position,
+             const core::vector3df& color_from,
+             const core::vector3df& color_to, float lf_time, float size)
+    {
+        m_position = position;
         core::vector3df ret = color_from + (color_to - color_from) * lf_time;
         m_color_lifetime.setRed(core::clamp((int)(ret.X * 255.0f), 0, 255));
         m_color_lifetime.setBlue(core::clamp((int)(ret.Y * 255.0f), 0, 255));
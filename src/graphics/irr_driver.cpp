@@ -1765,7 +1765,7 @@ void IrrDriver::displayFPS()
 
     const int fheight = font->getHeightPerLine();
     if (UserConfigParams::m_artist_debug_mode)
-        position = core::rect<s32>(51, 0, 30*fheight+51, 2*fheight + fheight / 3);
+        position = core::rect<s32>(51, 0, 30*fheight+51, 3*fheight + fheight / 3);
     else
         position = core::rect<s32>(75, 0, 18*fheight+75 , fheight + fheight / 5);
     GL32_draw2DRectangle(video::SColor(150, 96, 74, 196), position, NULL);
@@ -1829,6 +1829,12 @@ void IrrDriver::displayFPS()
                     min, fps, max, SP::sp_solid_poly_count,
                     SP::sp_shadow_poly_count, m_last_light_bucket_distance, irr_driver->getSceneComplexity(),
                     m_skinning_joint, ping);
+        fps_string += StringUtils::insertValues(L"\nGlyph layouts: %d "
+            "(%d KB), hits: %d, misses: %d",
+            font_manager->getCachedLayoutsCount(),
+            (int)(font_manager->getCachedLayoutsMemory() / 1024),
+            font_manager->getCachedLayoutsHits(),
+            font_manager->getCachedLayoutsMisses());
     }
     else
     {
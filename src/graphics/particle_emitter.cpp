@@ -328,15 +328,7 @@ void ParticleEmitter::setParticleType(const ParticleKind* type)
 //-----------------------------------------------------------------------------
 void ParticleEmitter::addHeightMapAffector(Track* t)
 {
-    const Vec3* aabb_min;
-    const Vec3* aabb_max;
-    t->getAABB(&aabb_min, &aabb_max);
-    float track_x = aabb_min->getX();
-    float track_z = aabb_min->getZ();
-    const float track_x_len = aabb_max->getX() - aabb_min->getX();
-    const float track_z_len = aabb_max->getZ() - aabb_min->getZ();
-    std::vector<std::vector<float> > array = t->buildHeightMap();
-    m_node->setHeightmap(array, track_x, track_z, track_x_len, track_z_len);
+    m_node->setHeightmap(t->getHeightMap());
 }
 
 //-----------------------------------------------------------------------------
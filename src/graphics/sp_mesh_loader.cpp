@@ -20,16 +20,25 @@
 #include "graphics/sp/sp_mesh.hpp"
 #include "graphics/sp/sp_mesh_buffer.hpp"
 #include "graphics/central_settings.hpp"
+#include "graphics/irr_driver.hpp"
 #include "graphics/material_manager.hpp"
 #include "graphics/stk_tex_manager.hpp"
+#include "io/file_manager.hpp"
+#include "karts/kart_properties.hpp"
+#include "karts/kart_properties_manager.hpp"
+#include "tracks/track.hpp"
+#include "tracks/track_manager.hpp"
 #include "utils/constants.hpp"
 #include "utils/mini_glm.hpp"
+#include "utils/string_utils.hpp"
+#include "utils/time.hpp"
 
 #include "../../lib/irrlicht/source/Irrlicht/CSkinnedMesh.h"
 const uint8_t VERSION_NOW = 1;
 
 #include <algorithm>
 #include <cmath>
+#include <set>
 #include <IVideoDriver.h>
 #include <IFileSystem.h>
 
@@ -59,13 +68,30 @@ scene::IAnimatedMesh* SPMeshLoader::createMesh(io::IReadFile* f)
     m_bind_frame = 0;
     m_joint_count = 0;
     m_frame_count = 0;
+    m_all_armatures.clear();
+    m_to_bind_pose_matrices.clear();
+    m_joints.clear();
     m_mesh = NULL;
     m_mesh = real_spm ? new SP::SPMesh() : m_scene_manager->createSkinnedMesh();
     io::IFileSystem* fs = m_scene_manager->getFileSystem();
     std::string base_path = fs->getFileDir(f->getFileName()).c_str();
+
+    // Read the whole file at once, the vertices are then decoded from memory
+    const long file_size = f->getSize();
+    std::vector<uint8_t> content;
+    content.resize(file_size > 0 ? file_size : 0);
+    f->seek(0);
+    if (file_size <= 0 || f->read(content.data(), file_size) != file_size)
+    {
+        Log::error("SPMeshLoader", "Cannot read %s.",
+            f->getFileName().c_str());
+        m_mesh->drop();
+        return NULL;
+    }
+    SPMData data(content.data(), content.size());
     std::string header;
     header.resize(2);
-    f->read(&header.front(), 2);
+    data.read(&header.front(), 2);
     if (header != "SP")
     {
         Log::error("SPMeshLoader", "Not a spm file.");
@@ -73,7 +99,7 @@ scene::IAnimatedMesh* SPMeshLoader::createMesh(io::IReadFile* f)
         return NULL;
     }
     uint8_t byte = 0;
-    f->read(&byte, 1);
+    data.read(&byte, 1);
     uint8_t version = byte >> 3;
     if (version != VERSION_NOW)
     {
@@ -90,16 +116,16 @@ scene::IAnimatedMesh* SPMeshLoader::createMesh(io::IReadFile* f)
         m_mesh->drop();
         return NULL;
     }
-    f->read(&byte, 1);
+    data.read(&byte, 1);
     bool read_normal = byte & 0x01;
     bool read_vcolor = byte >> 1 & 0x01;
     bool read_tangent = byte >> 2 & 0x01;
     const bool is_skinned = header == "SPMA";
     const SPVertexType vt = is_skinned ? SPVT_SKINNED : SPVT_NORMAL;
     float bbox[6];
-    f->read(bbox, 24);
+    data.read(bbox, 24);
     uint16_t size_num = 0;
-    f->read(&size_num, 2);
+    data.read(&size_num, 2);
     unsigned id = 0;
     std::unordered_map<unsigned, std::tuple<video::SMaterial, bool,
         bool> > mat_map;
@@ -109,17 +135,17 @@ scene::IAnimatedMesh* SPMeshLoader::createMesh(io::IReadFile* f)
     {
         uint8_t tex_size;
         std::string tex_name_1, tex_name_2;
-        f->read(&tex_size, 1);
+        data.read(&tex_size, 1);
         if (tex_size > 0)
         {
             tex_name_1.resize(tex_size);
-            f->read(&tex_name_1.front(), tex_size);
+            data.read(&tex_name_1.front(), tex_size);
         }
-        f->read(&tex_size, 1);
+        data.read(&tex_size, 1);
         if (tex_size > 0)
         {
             tex_name_2.resize(tex_size);
-            f->read(&tex_name_2.front(), tex_size);
+            data.read(&tex_name_2.front(), tex_size);
         }
         if (real_spm)
         {
@@ -180,28 +206,36 @@ scene::IAnimatedMesh* SPMeshLoader::createMesh(io::IReadFile* f)
         size_num--;
         id++;
     }
-    f->read(&size_num, 2);
+    data.read(&size_num, 2);
     while (size_num != 0)
     {
         uint16_t mat_size;
-        f->read(&mat_size, 2);
+        data.read(&mat_size, 2);
         while (mat_size != 0)
         {
             uint32_t vertices_count, indices_count;
             uint16_t mat_id;
-            f->read(&vertices_count, 4);
+            data.read(&vertices_count, 4);
             if (vertices_count > 65535)
             {
                 Log::error("SPMeshLoader", "32bit index not supported.");
                 m_mesh->drop();
                 return NULL;
             }
-            f->read(&indices_count, 4);
-            f->read(&mat_id, 2);
+            data.read(&indices_count, 4);
+            data.read(&mat_id, 2);
+            if (data.hasOverflow() || vertices_count == 0 ||
+                indices_count == 0)
+            {
+                Log::error("SPMeshLoader", "Invalid mesh buffer in %s.",
+                    f->getFileName().c_str());
+                m_mesh->drop();
+                return NULL;
+            }
             if (real_spm)
             {
                 assert(mat_id < sp_mat_map.size());
-                decompressSPM(f, vertices_count, indices_count, read_normal,
+                decompressSPM(&data, vertices_count, indices_count, read_normal,
                     read_vcolor, read_tangent, std::get<1>(sp_mat_map[mat_id]),
                     std::get<2>(sp_mat_map[mat_id]), vt,
                     std::get<0>(sp_mat_map[mat_id]));
@@ -209,7 +243,7 @@ scene::IAnimatedMesh* SPMeshLoader::createMesh(io::IReadFile* f)
             else
             {
                 assert(mat_id < mat_map.size());
-                decompress(f, vertices_count, indices_count, read_normal,
+                decompress(&data, vertices_count, indices_count, read_normal,
                     read_vcolor, read_tangent, std::get<1>(mat_map[mat_id]),
                     std::get<2>(mat_map[mat_id]), vt,
                     std::get<0>(mat_map[mat_id]));
@@ -220,13 +254,17 @@ scene::IAnimatedMesh* SPMeshLoader::createMesh(io::IReadFile* f)
         {
             // Reserved, never used
             assert(false);
-            f->read(bbox, 24);
+            data.read(bbox, 24);
         }
         size_num--;
     }
     if (header == "SPMA")
     {
-        createAnimationData(f);
+        // The armatures are read with the file interface from memory
+        io::IReadFile* animation = fs->createMemoryReadFile(
+            (void*)data.getPos(), (s32)data.getRemaining(), f->getFileName());
+        createAnimationData(animation);
+        animation->drop();
         convertIrrlicht();
     }
     else if (header == "SPMS")
@@ -234,7 +272,14 @@ scene::IAnimatedMesh* SPMeshLoader::createMesh(io::IReadFile* f)
         // Reserved, never used
         assert(false);
         uint16_t pre_computed_size = 0;
-        f->read(&pre_computed_size, 2);
+        data.read(&pre_computed_size, 2);
+    }
+    if (data.hasOverflow())
+    {
+        Log::error("SPMeshLoader", "Unexpected end of file %s.",
+            f->getFileName().c_str());
+        m_mesh->drop();
+        return NULL;
     }
     const bool has_armature = !m_all_armatures.empty();
     if (real_spm)
@@ -269,8 +314,7 @@ scene::IAnimatedMesh* SPMeshLoader::createMesh(io::IReadFile* f)
 }   // createMesh
 
 // ----------------------------------------------------------------------------
-void SPMeshLoader::decompressSPM(irr::io::IReadFile* spm,
-                                 unsigned vertices_count,
+void SPMeshLoader::decompressSPM(SPMData* spm, unsigned vertices_count,
                                  unsigned indices_count, bool read_normal,
                                  bool read_vcolor, bool read_tangent,
                                  bool uv_one, bool uv_two, SPVertexType vt,
@@ -283,9 +327,11 @@ void SPMeshLoader::decompressSPM(irr::io::IReadFile* spm,
     SPMeshBuffer* mb = new SPMeshBuffer();
     static_cast<SPMesh*>(m_mesh)->m_buffer.push_back(mb);
     const unsigned idx_size = vertices_count > 255 ? 2 : 1;
-    for (unsigned i = 0; i < vertices_count; i++)
+    // The vertices are decoded in place, and then moved into the mesh buffer
+    std::vector<video::S3DVertexSkinnedMesh> vertices;
+    vertices.resize(vertices_count);
+    for (video::S3DVertexSkinnedMesh& vertex : vertices)
     {
-        video::S3DVertexSkinnedMesh vertex = {};
         // 3 * float position
         spm->read(&vertex.m_position, 12);
         if (read_normal)
@@ -302,23 +348,13 @@ void SPMeshLoader::decompressSPM(irr::io::IReadFile* spm,
             // Color identifier
             uint8_t ci;
             spm->read(&ci, 1);
-            if (ci == 128)
-            {
-                // All white
-                vertex.m_color = video::SColor(255, 255, 255, 255);
-            }
-            else
+            if (ci != 128)
             {
-                uint8_t r, g, b;
-                spm->read(&r, 1);
-                spm->read(&g, 1);
-                spm->read(&b, 1);
-                vertex.m_color = video::SColor(255, r, g, b);
+                uint8_t rgb[3];
+                spm->read(rgb, 3);
+                vertex.m_color = video::SColor(255, rgb[0], rgb[1], rgb[2]);
             }
-        }
-        else
-        {
-            vertex.m_color = video::SColor(255, 255, 255, 255);
+            // else all white, which is the default color
         }
         if (uv_one)
         {
@@ -350,32 +386,19 @@ void SPMeshLoader::decompressSPM(irr::io::IReadFile* spm,
                 vertex.m_weight[0] = 15360;
             }
         }
-        mb->addSPMVertex(vertex);
     }
+    mb->setSPMVertices(vertices);
 
     std::vector<uint16_t> indices;
     indices.resize(indices_count);
-    if (idx_size == 2)
-    {
-        spm->read(indices.data(), indices_count * 2);
-    }
-    else
-    {
-        std::vector<uint8_t> tmp_idx;
-        tmp_idx.resize(indices_count);
-        spm->read(tmp_idx.data(), indices_count);
-        for (unsigned i = 0; i < indices_count; i++)
-        {
-            indices[i] = tmp_idx[i];
-        }
-    }
+    spm->readIndices(indices.data(), indices_count, idx_size);
     mb->setIndices(indices);
     mb->setSTKMaterial(m);
 
 }   // decompressSPM
 
 // ----------------------------------------------------------------------------
-void SPMeshLoader::decompress(irr::io::IReadFile* spm, unsigned vertices_count,
+void SPMeshLoader::decompress(SPMData* spm, unsigned vertices_count,
                               unsigned indices_count, bool read_normal,
                               bool read_vcolor, bool read_tangent, bool uv_one,
                               bool uv_two, SPVertexType vt,
@@ -387,12 +410,20 @@ void SPMeshLoader::decompress(irr::io::IReadFile* spm, unsigned vertices_count,
     if (uv_two)
     {
         mb->convertTo2TCoords();
+        mb->Vertices_2TCoords.reallocate(vertices_count);
+    }
+    else
+    {
+        mb->Vertices_Standard.reallocate(vertices_count);
     }
     using namespace MiniGLM;
     const unsigned idx_size = vertices_count > 255 ? 2 : 1;
-    char tmp[8] = {};
     std::vector<std::pair<std::array<short, 4>, std::array<float, 4> > >
         cur_joints;
+    if (vt == SPVT_SKINNED)
+    {
+        cur_joints.reserve(vertices_count);
+    }
     for (unsigned i = 0; i < vertices_count; i++)
     {
         video::S3DVertex2TCoords vertex;
@@ -417,11 +448,9 @@ void SPMeshLoader::decompress(irr::io::IReadFile* spm, unsigned vertices_count,
             }
             else
             {
-                uint8_t r, g, b;
-                spm->read(&r, 1);
-                spm->read(&g, 1);
-                spm->read(&b, 1);
-                vertex.Color = video::SColor(255, r, g, b);
+                uint8_t rgb[3];
+                spm->read(rgb, 3);
+                vertex.Color = video::SColor(255, rgb[0], rgb[1], rgb[2]);
             }
         }
         else
@@ -430,17 +459,16 @@ void SPMeshLoader::decompress(irr::io::IReadFile* spm, unsigned vertices_count,
         }
         if (uv_one)
         {
-            short hf[2];
-            spm->read(hf, 4);
+            short hf[4];
+            spm->read(hf, uv_two ? 8 : 4);
             vertex.TCoords.X = toFloat32(hf[0]);
             vertex.TCoords.Y = toFloat32(hf[1]);
             assert(!std::isnan(vertex.TCoords.X));
             assert(!std::isnan(vertex.TCoords.Y));
             if (uv_two)
             {
-                spm->read(hf, 4);
-                vertex.TCoords2.X = toFloat32(hf[0]);
-                vertex.TCoords2.Y = toFloat32(hf[1]);
+                vertex.TCoords2.X = toFloat32(hf[2]);
+                vertex.TCoords2.Y = toFloat32(hf[3]);
                 assert(!std::isnan(vertex.TCoords2.X));
                 assert(!std::isnan(vertex.TCoords2.Y));
             }
@@ -453,16 +481,14 @@ void SPMeshLoader::decompress(irr::io::IReadFile* spm, unsigned vertices_count,
         if (vt == SPVT_SKINNED)
         {
             std::array<short, 4> joint_idx;
+            short hf[4];
             spm->read(joint_idx.data(), 8);
-            spm->read(tmp, 8);
-            std::array<float, 4> joint_weight = {};
-            for (int j = 0; j < 8; j += 2)
+            spm->read(hf, 8);
+            std::array<float, 4> joint_weight;
+            for (unsigned j = 0; j < 4; j++)
             {
-                short hf;
-                memcpy(&hf, tmp + j, 2);
-                const unsigned idx = j >> 1;
-                joint_weight[idx] = toFloat32(hf);
-                assert(!std::isnan(joint_weight[idx]));
+                joint_weight[j] = toFloat32(hf[j]);
+                assert(!std::isnan(joint_weight[j]));
             }
             cur_joints.emplace_back(joint_idx, joint_weight);
         }
@@ -484,20 +510,7 @@ void SPMeshLoader::decompress(irr::io::IReadFile* spm, unsigned vertices_count,
         mb->Material = m;
     }
     mb->Indices.set_used(indices_count);
-    if (idx_size == 2)
-    {
-        spm->read(mb->Indices.pointer(), indices_count * 2);
-    }
-    else
-    {
-        std::vector<uint8_t> tmp_idx;
-        tmp_idx.resize(indices_count);
-        spm->read(tmp_idx.data(), indices_count);
-        for (unsigned i = 0; i < indices_count; i++)
-        {
-            mb->Indices[i] = tmp_idx[i];
-        }
-    }
+    spm->readIndices(mb->Indices.pointer(), indices_count, idx_size);
 
     if (!read_normal)
     {
@@ -676,3 +689,90 @@ void SPMeshLoader::convertIrrlicht()
     }
 
 }   // convertIrrlicht
+
+// ----------------------------------------------------------------------------
+/** Measures the time to load all spm files of the installed karts and tracks,
+ *  which is e.g. done for each race. Each file is loaded a few times, and the
+ *  fastest round is reported, so that the time to read the files from disk
+ *  is (mostly) excluded.
+ */
+void SPMeshLoader::benchmarkLoading()
+{
+    std::vector<std::string> kart_files, track_files;
+    std::set<std::string> result;
+    for (unsigned i = 0; i < kart_properties_manager->getNumberOfKarts(); i++)
+    {
+        file_manager->listFiles(result,
+            kart_properties_manager->getKartById(i)->getKartDir(),
+            /*make_full_path*/true);
+        for (const std::string& name : result)
+        {
+            if (StringUtils::getExtension(name) == "spm")
+                kart_files.push_back(name);
+        }
+    }
+    for (unsigned i = 0; i < track_manager->getNumberOfTracks(); i++)
+    {
+        file_manager->listFiles(result,
+            StringUtils::getPath(track_manager->getTrack(i)->getFilename()),
+            /*make_full_path*/true);
+        for (const std::string& name : result)
+        {
+            if (StringUtils::getExtension(name) == "spm")
+                track_files.push_back(name);
+        }
+    }
+    if (kart_files.empty() && track_files.empty())
+    {
+        Log::warn("Benchmark", "No spm files found in the karts and tracks.");
+        return;
+    }
+
+    scene::ISceneManager* sm = irr_driver->getSceneManager();
+    io::IFileSystem* fs = sm->getFileSystem();
+    SPMeshLoader loader(sm);
+    auto load_all = [&](const std::vector<std::string>& files,
+                        uint64_t* bytes, uint64_t* vertices)
+    {
+        *bytes = 0;
+        *vertices = 0;
+        uint64_t start = StkTime::getMonoTimeUs();
+        for (const std::string& name : files)
+        {
+            io::IReadFile* file = fs->createAndOpenFile(name.c_str());
+            if (file == NULL)
+                continue;
+            *bytes += file->getSize();
+            scene::IAnimatedMesh* mesh = loader.createMesh(file);
+            file->drop();
+            if (mesh == NULL)
+                continue;
+            for (unsigned i = 0; i < mesh->getMeshBufferCount(); i++)
+                *vertices += mesh->getMeshBuffer(i)->getVertexCount();
+            mesh->drop();
+        }
+        return StkTime::getMonoTimeUs() - start;
+    };
+
+    const int rounds = 3;
+    uint64_t best_karts = 0, best_tracks = 0;
+    uint64_t kart_bytes = 0, kart_vertices = 0;
+    uint64_t track_bytes = 0, track_vertices = 0;
+    for (int n = 0; n < rounds; n++)
+    {
+        uint64_t karts = load_all(kart_files, &kart_bytes, &kart_vertices);
+        uint64_t tracks = load_all(track_files, &track_bytes,
+                                   &track_vertices);
+        if (n == 0 || karts < best_karts)
+            best_karts = karts;
+        if (n == 0 || tracks < best_tracks)
+            best_tracks = tracks;
+    }
+    Log::info("Benchmark", "Karts: %d spm files, %.1f MB, %lu vertices "
+        "loaded in %.1f ms.", (int)kart_files.size(), kart_bytes / 1048576.0,
+        (unsigned long)kart_vertices, best_karts / 1000.0);
+    Log::info("Benchmark", "Tracks: %d spm files, %.1f MB, %lu vertices "
+        "loaded in %.1f ms.", (int)track_files.size(),
+        track_bytes / 1048576.0, (unsigned long)track_vertices,
+        best_tracks / 1000.0);
+}   // benchmarkLoading
@@ -24,7 +24,10 @@
 #include <ISceneManager.h>
 #include <ISkinnedMesh.h>
 #include <IReadFile.h>
+#include <algorithm>
 #include <array>
+#include <cstdint>
+#include <cstring>
 #include <vector>
 
 using namespace irr;
@@ -48,12 +51,67 @@ private:
         SPVT_SKINNED
     };
     // ------------------------------------------------------------------------
-    void decompress(irr::io::IReadFile* spm, unsigned vertices_count,
+    /** The content of a spm file, which is read in one block. The vertex
+     *  data is copied directly from memory, instead of a (virtual) read call
+     *  of the file for each field of each vertex. */
+    class SPMData
+    {
+    private:
+        const uint8_t* m_pos;
+        const uint8_t* m_end;
+        /** Set if it was tried to read after the end of the file. */
+        bool m_overflow;
+    public:
+        // --------------------------------------------------------------------
+        SPMData(const uint8_t* data, size_t size)
+            : m_pos(data), m_end(data + size), m_overflow(false) {}
+        // --------------------------------------------------------------------
+        /** Copies the next size bytes to dest, or zeros if the file ends. */
+        void read(void* dest, size_t size)
+        {
+            if ((size_t)(m_end - m_pos) < size)
+            {
+                memset(dest, 0, size);
+                m_pos = m_end;
+                m_overflow = true;
+                return;
+            }
+            memcpy(dest, m_pos, size);
+            m_pos += size;
+        }   // read
+        // --------------------------------------------------------------------
+        /** Reads count indices of idx_size (1 or 2) bytes each to dest. */
+        void readIndices(uint16_t* dest, unsigned count, unsigned idx_size)
+        {
+            if (idx_size == 2)
+            {
+                read(dest, count * 2);
+                return;
+            }
+            if (getRemaining() < count)
+            {
+                memset(dest, 0, count * 2);
+                m_pos = m_end;
+                m_overflow = true;
+                return;
+            }
+            std::copy(m_pos, m_pos + count, dest);
+            m_pos += count;
+        }   // readIndices
+        // --------------------------------------------------------------------
+        const uint8_t* getPos() const               { return m_pos; }
+        // --------------------------------------------------------------------
+        size_t getRemaining() const         { return m_end - m_pos; }
+        // --------------------------------------------------------------------
+        bool hasOverflow() const               { return m_overflow; }
+    };   // SPMData
+    // ------------------------------------------------------------------------
+    void decompress(SPMData* spm, unsigned vertices_count,
                     unsigned indices_count, bool read_normal, bool read_vcolor,
                     bool read_tangent, bool uv_one, bool uv_two,
                     SPVertexType vt, const video::SMaterial& m);
     // ------------------------------------------------------------------------
-    void decompressSPM(irr::io::IReadFile* spm, unsigned vertices_count,
+    void decompressSPM(SPMData* spm, unsigned vertices_count,
                        unsigned indices_count, bool read_normal,
                        bool read_vcolor, bool read_tangent, bool uv_one,
                        bool uv_two, SPVertexType vt,
@@ -77,6 +135,8 @@ public:
     virtual bool isALoadableFileExtension(const io::path& filename) const;
     // ------------------------------------------------------------------------
     virtual scene::IAnimatedMesh* createMesh(io::IReadFile* file);
+    // ------------------------------------------------------------------------
+    static void benchmarkLoading();
 
 };
 
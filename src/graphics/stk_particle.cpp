@@ -22,10 +22,63 @@
 #include "graphics/cpu_particle_manager.hpp"
 #include "graphics/irr_driver.hpp"
 #include "guiengine/engine.hpp"
+#include "tracks/height_map.hpp"
 
 #include <cmath>
 #include "../../lib/irrlicht/source/Irrlicht/os.h"
 
+#if __SSE2__ || _M_X64 || _M_IX86_FP >= 2
+ #include <emmintrin.h>
+ #define PARTICLE_SIMD_SSE2 (1)
+#elif __ARM_NEON__ || __ARM_NEON
+ #include <arm_neon.h>
+ #define PARTICLE_SIMD_NEON (1)
+#endif
+
+// ----------------------------------------------------------------------------
+// A minimal set of 4 wide float operations used to update the particles,
+// implemented with SSE2 or NEON.
+#if PARTICLE_SIMD_SSE2
+typedef __m128 Float4;
+static inline Float4 load4(const float* p)          { return _mm_loadu_ps(p); }
+static inline void store4(float* p, Float4 v)           { _mm_storeu_ps(p, v); }
+static inline Float4 set4(float f)                   { return _mm_set1_ps(f); }
+static inline Float4 add4(Float4 a, Float4 b)     { return _mm_add_ps(a, b); }
+static inline Float4 sub4(Float4 a, Float4 b)     { return _mm_sub_ps(a, b); }
+static inline Float4 mul4(Float4 a, Float4 b)     { return _mm_mul_ps(a, b); }
+/** Returns a with all lanes set to 0 in which b is 0. */
+static inline Float4 zeroWhereZero4(Float4 a, Float4 b)
+{
+    return _mm_and_ps(a, _mm_cmpneq_ps(b, _mm_setzero_ps()));
+}
+/** Returns a bit mask of the lanes in which a > b. */
+static inline int greaterMask4(Float4 a, Float4 b)
+{
+    return _mm_movemask_ps(_mm_cmpgt_ps(a, b));
+}
+#elif PARTICLE_SIMD_NEON
+typedef float32x4_t Float4;
+static inline Float4 load4(const float* p)            { return vld1q_f32(p); }
+static inline void store4(float* p, Float4 v)              { vst1q_f32(p, v); }
+static inline Float4 set4(float f)                   { return vdupq_n_f32(f); }
+static inline Float4 add4(Float4 a, Float4 b)       { return vaddq_f32(a, b); }
+static inline Float4 sub4(Float4 a, Float4 b)       { return vsubq_f32(a, b); }
+static inline Float4 mul4(Float4 a, Float4 b)       { return vmulq_f32(a, b); }
+/** Returns a with all lanes set to 0 in which b is 0. */
+static inline Float4 zeroWhereZero4(Float4 a, Float4 b)
+{
+    return vreinterpretq_f32_u32(vbicq_u32(vreinterpretq_u32_f32(a),
+                                           vceqq_f32(b, vdupq_n_f32(0.0f))));
+}
+/** Returns a bit mask of the lanes in which a > b. */
+static inline int greaterMask4(Float4 a, Float4 b)
+{
+    uint32x4_t m = vcgtq_f32(a, b);
+    return (vgetq_lane_u32(m, 0) & 1) | (vgetq_lane_u32(m, 1) & 2) |
+           (vgetq_lane_u32(m, 2) & 4) | (vgetq_lane_u32(m, 3) & 8);
+}
+#endif
+
 // ----------------------------------------------------------------------------
 std::vector<float> STKParticle::m_flips_data;
 GLuint STKParticle::m_flips_buffer = 0;
@@ -41,7 +94,6 @@ STKParticle::STKParticle(bool randomize_initial_y, ISceneNode* parent, s32 id,
                                       irr_driver->getSceneManager(), id,
                                       position, rotation, scale)
 {
-    m_hm = NULL;
     m_color_to = core::vector3df(1.0f);
     m_color_from = m_color_to;
     m_size_increase_factor = 0.0f;
@@ -81,26 +133,33 @@ static void generateLifetimeSizeDirection(scene::IParticleEmitter *emitter,
 }   // generateLifetimeSizeDirection
 
 // ----------------------------------------------------------------------------
-void STKParticle::generateParticlesFromPointEmitter
-    (scene::IParticlePointEmitter *emitter)
+void STKParticle::resizeParticles()
 {
-    m_particles_generating.clear();
-    m_initial_particles.clear();
     m_particles_generating.resize(m_max_count);
     m_initial_particles.resize(m_max_count);
+    m_inv_initial_lifetime.assign(m_max_count, 0.0f);
+    m_reset_particles.clear();
+    m_reset_particles.reserve(m_max_count);
+}   // resizeParticles
+
+// ----------------------------------------------------------------------------
+void STKParticle::generateParticlesFromPointEmitter
+    (scene::IParticlePointEmitter *emitter)
+{
+    resizeParticles();
     for (unsigned i = 0; i < m_max_count; i++)
     {
         // Initial lifetime is > 1
-        m_particles_generating[i].m_lifetime = 2.0f;
+        m_particles_generating.m_lifetime[i] = 2.0f;
 
+        core::vector3df direction;
         generateLifetimeSizeDirection(emitter,
-            m_initial_particles[i].m_lifetime,
-            m_particles_generating[i].m_size,
-            m_particles_generating[i].m_direction);
+            m_initial_particles.m_lifetime[i],
+            m_particles_generating.m_size[i], direction);
 
-        m_initial_particles[i].m_direction =
-            m_particles_generating[i].m_direction;
-        m_initial_particles[i].m_size = m_particles_generating[i].m_size;
+        m_particles_generating.setDirection(i, direction);
+        m_initial_particles.setDirection(i, direction);
+        m_initial_particles.m_size[i] = m_particles_generating.m_size[i];
     }
 }   // generateParticlesFromPointEmitter
 
@@ -108,41 +167,39 @@ void STKParticle::generateParticlesFromPointEmitter
 void STKParticle::generateParticlesFromBoxEmitter
     (scene::IParticleBoxEmitter *emitter)
 {
-    m_particles_generating.clear();
-    m_initial_particles.clear();
-    m_particles_generating.resize(m_max_count);
-    m_initial_particles.resize(m_max_count);
+    resizeParticles();
     const core::vector3df& extent = emitter->getBox().getExtent();
     for (unsigned i = 0; i < m_max_count; i++)
     {
-        m_particles_generating[i].m_position.X =
+        core::vector3df position;
+        position.X =
             emitter->getBox().MinEdge.X + os::Randomizer::frand() * extent.X;
-        m_particles_generating[i].m_position.Y =
+        position.Y =
             emitter->getBox().MinEdge.Y + os::Randomizer::frand() * extent.Y;
-        m_particles_generating[i].m_position.Z =
+        position.Z =
             emitter->getBox().MinEdge.Z + os::Randomizer::frand() * extent.Z;
+        m_particles_generating.setPosition(i, position);
 
         // Initial lifetime is random
-        m_particles_generating[i].m_lifetime = os::Randomizer::frand();
+        m_particles_generating.m_lifetime[i] = os::Randomizer::frand();
         if (!m_randomize_initial_y)
         {
-            m_particles_generating[i].m_lifetime += 1.0f;
+            m_particles_generating.m_lifetime[i] += 1.0f;
         }
-        m_initial_particles[i].m_position =
-            m_particles_generating[i].m_position;
+        m_initial_particles.setPosition(i, position);
 
+        core::vector3df direction;
         generateLifetimeSizeDirection(emitter,
-            m_initial_particles[i].m_lifetime,
-            m_particles_generating[i].m_size,
-            m_particles_generating[i].m_direction);
+            m_initial_particles.m_lifetime[i],
+            m_particles_generating.m_size[i], direction);
 
-        m_initial_particles[i].m_direction =
-            m_particles_generating[i].m_direction;
-        m_initial_particles[i].m_size = m_particles_generating[i].m_size;
+        m_particles_generating.setDirection(i, direction);
+        m_initial_particles.setDirection(i, direction);
+        m_initial_particles.m_size[i] = m_particles_generating.m_size[i];
 
         if (m_randomize_initial_y)
         {
-            m_initial_particles[i].m_position.Y =
+            m_initial_particles.m_y[i] =
                 os::Randomizer::frand() * 50.0f; // -100.0f;
         }
     }
@@ -152,10 +209,7 @@ void STKParticle::generateParticlesFromBoxEmitter
 void STKParticle::generateParticlesFromSphereEmitter
     (scene::IParticleSphereEmitter *emitter)
 {
-    m_particles_generating.clear();
-    m_initial_particles.clear();
-    m_particles_generating.resize(m_max_count);
-    m_initial_particles.resize(m_max_count);
+    resizeParticles();
     for (unsigned i = 0; i < m_max_count; i++)
     {
         // Random distance from center
@@ -167,21 +221,20 @@ void STKParticle::generateParticlesFromSphereEmitter
         pos.rotateYZBy(os::Randomizer::frand() * 360.f, emitter->getCenter());
         pos.rotateXZBy(os::Randomizer::frand() * 360.f, emitter->getCenter());
 
-        m_particles_generating[i].m_position = pos;
+        m_particles_generating.setPosition(i, pos);
 
         // Initial lifetime is > 1
-        m_particles_generating[i].m_lifetime = 2.0f;
-        m_initial_particles[i].m_position =
-            m_particles_generating[i].m_position;
+        m_particles_generating.m_lifetime[i] = 2.0f;
+        m_initial_particles.setPosition(i, pos);
 
+        core::vector3df direction;
         generateLifetimeSizeDirection(emitter,
-            m_initial_particles[i].m_lifetime,
-            m_particles_generating[i].m_size,
-            m_particles_generating[i].m_direction);
+            m_initial_particles.m_lifetime[i],
+            m_particles_generating.m_size[i], direction);
 
-        m_initial_particles[i].m_direction =
-            m_particles_generating[i].m_direction;
-        m_initial_particles[i].m_size = m_particles_generating[i].m_size;
+        m_particles_generating.setDirection(i, direction);
+        m_initial_particles.setDirection(i, direction);
+        m_initial_particles.m_size[i] = m_particles_generating.m_size[i];
     }
 }   // generateParticlesFromSphereEmitter
 
@@ -209,8 +262,7 @@ void STKParticle::setEmitter(scene::IParticleEmitter* emitter)
         return;
     }
 
-    delete m_hm;
-    m_hm = NULL;
+    m_height_map.reset();
     m_first_execution = true;
     m_pre_generating = true;
     m_flips = false;
@@ -232,6 +284,8 @@ void STKParticle::setEmitter(scene::IParticleEmitter* emitter)
     default:
         assert(false && "Wrong particle type");
     }
+    for (unsigned i = 0; i < m_max_count; i++)
+        m_inv_initial_lifetime[i] = 1.0f / m_initial_particles.m_lifetime[i];
 }   // setEmitter
 
 // ----------------------------------------------------------------------------
@@ -251,7 +305,7 @@ void STKParticle::generate(std::vector<CPUParticle>* out)
         for (int i = 0; i <
             (m_max_count > 5000 ? 5 : m_pre_generating ? 100 : 0); i++)
         {
-            if (m_hm != NULL)
+            if (m_height_map)
             {
                 stimulateHeightMap((float)i, active_count, NULL);
             }
@@ -264,7 +318,7 @@ void STKParticle::generate(std::vector<CPUParticle>* out)
     }
 
     float dt = GUIEngine::getLatestDt() * 1000.f;
-    if (m_hm != NULL)
+    if (m_height_map)
     {
         stimulateHeightMap(dt, active_count, out);
     }
@@ -291,78 +345,119 @@ inline float glslMix(float x, float y, float a)
     return x * (1.0f - a) + y * a;
 }   // glslMix
 
+// ----------------------------------------------------------------------------
+/** Moves all particles along their direction, and updates their lifetime
+ *  and size, 4 particles at a time if SIMD instructions are available. The
+ *  indices of the particles which need to be reset (because their lifetime
+ *  is over) are appended to m_reset_particles, the reset itself is done by
+ *  the caller.
+ *  \param dt Time step.
+ *  \param keep_zero_size If particles with size 0 keep their size.
+ *  \param reset_negative_lifetime If particles with a negative lifetime
+ *         (before the update) need to be reset, too.
+ */
+void STKParticle::advanceParticles(float dt, bool keep_zero_size,
+                                   bool reset_negative_lifetime)
+{
+    ParticleArrays& p = m_particles_generating;
+    const float* size_initial = m_initial_particles.m_size.data();
+    const float* inv_lifetime = m_inv_initial_lifetime.data();
+    unsigned i = 0;
+#if PARTICLE_SIMD_SSE2 || PARTICLE_SIMD_NEON
+    const Float4 dt4 = set4(dt);
+    const Float4 one4 = set4(1.0f);
+    const Float4 zero4 = set4(0.0f);
+    const Float4 increase4 = set4(m_size_increase_factor);
+    for (; i + 4 <= m_max_count; i += 4)
+    {
+        const Float4 lifetime = load4(&p.m_lifetime[i]);
+        const Float4 updated_lifetime =
+            add4(lifetime, mul4(dt4, load4(inv_lifetime + i)));
+        store4(&p.m_x[i], add4(load4(&p.m_x[i]),
+                               mul4(load4(&p.m_dir_x[i]), dt4)));
+        store4(&p.m_y[i], add4(load4(&p.m_y[i]),
+                               mul4(load4(&p.m_dir_y[i]), dt4)));
+        store4(&p.m_z[i], add4(load4(&p.m_z[i]),
+                               mul4(load4(&p.m_dir_z[i]), dt4)));
+
+        // glslMix(size_initial, size_initial * increase, updated_lifetime)
+        const Float4 si = load4(size_initial + i);
+        Float4 size = add4(mul4(si, sub4(one4, updated_lifetime)),
+                           mul4(mul4(si, increase4), updated_lifetime));
+        if (keep_zero_size)
+            size = zeroWhereZero4(size, load4(&p.m_size[i]));
+        store4(&p.m_size[i], size);
+        store4(&p.m_lifetime[i], updated_lifetime);
+
+        int reset = greaterMask4(updated_lifetime, one4);
+        if (reset_negative_lifetime)
+            reset |= greaterMask4(zero4, lifetime);
+        if (reset != 0)
+        {
+            for (unsigned j = 0; j < 4; j++)
+            {
+                if ((reset & (1 << j)) != 0)
+                    m_reset_particles.push_back(i + j);
+            }
+        }
+    }
+#endif
+    for (; i < m_max_count; i++)
+    {
+        const float lifetime = p.m_lifetime[i];
+        const float updated_lifetime = lifetime + dt * inv_lifetime[i];
+        p.m_x[i] += p.m_dir_x[i] * dt;
+        p.m_y[i] += p.m_dir_y[i] * dt;
+        p.m_z[i] += p.m_dir_z[i] * dt;
+        if (!keep_zero_size || p.m_size[i] != 0.0f)
+        {
+            p.m_size[i] = glslMix(size_initial[i],
+                size_initial[i] * m_size_increase_factor, updated_lifetime);
+        }
+        p.m_lifetime[i] = updated_lifetime;
+        if (updated_lifetime > 1.0f ||
+            (reset_negative_lifetime && lifetime < 0.0f))
+            m_reset_particles.push_back(i);
+    }
+}   // advanceParticles
+
 // ----------------------------------------------------------------------------
 void STKParticle::stimulateHeightMap(float dt, unsigned int active_count,
                                      std::vector<CPUParticle>* out)
 {
-    assert(m_hm != NULL);
+    assert(m_height_map);
     const core::matrix4 cur_matrix = AbsoluteTransformation;
+    ParticleArrays& p = m_particles_generating;
+
+    // The height lookups can't be vectorised, so the particles below the
+    // ground are collected before the positions are updated.
+    // Particles above cells without ground are never reset by this
+    m_reset_particles.clear();
     for (unsigned i = 0; i < m_max_count; i++)
     {
-        core::vector3df new_particle_position;
-        core::vector3df new_particle_direction;
-        float new_size = 0.0f;
-        float new_lifetime = 0.0f;
-
-        const core::vector3df particle_position =
-            m_particles_generating[i].m_position;
-        const float lifetime = m_particles_generating[i].m_lifetime;
-        const core::vector3df particle_direction =
-            m_particles_generating[i].m_direction;
+        if (p.m_y[i] < m_height_map->getHeight(p.m_x[i], p.m_z[i]))
+            m_reset_particles.push_back(i);
+    }
+    advanceParticles(dt, /*keep_zero_size*/false,
+                     /*reset_negative_lifetime*/true);
 
+    // A particle can be in the list twice, but resetting it is idempotent
+    for (unsigned i : m_reset_particles)
+    {
         const core::vector3df particle_position_initial =
-            m_initial_particles[i].m_position;
-        const float lifetime_initial = m_initial_particles[i].m_lifetime;
-        const core::vector3df particle_direction_initial =
-            m_initial_particles[i].m_direction;
-        const float size_initial = m_initial_particles[i].m_size;
-
-        bool reset = false;
-        const int px = core::clamp((int)(256.0f *
-            (particle_position.X - m_hm->m_x) / m_hm->m_x_len), 0, 255);
-        const int py = core::clamp((int)(256.0f *
-            (particle_position.Z - m_hm->m_z) / m_hm->m_z_len), 0, 255);
-        const float h = particle_position.Y - m_hm->m_array[px][py];
-        reset = h < 0.0f;
-
+            m_initial_particles.getPosition(i);
         core::vector3df initial_position, initial_new_position;
         cur_matrix.transformVect(initial_position, particle_position_initial);
         cur_matrix.transformVect(initial_new_position,
-            particle_position_initial + particle_direction_initial);
-
-        core::vector3df adjusted_initial_direction =
-            initial_new_position - initial_position;
-        float adjusted_lifetime = lifetime + (dt / lifetime_initial);
-        reset = reset || adjusted_lifetime > 1.0f;
-        reset = reset || lifetime < 0.0f;
-
-        new_particle_position = !reset ?
-            (particle_position + particle_direction * dt) : initial_position;
-        new_lifetime = !reset ? adjusted_lifetime : 0.0f;
-        new_particle_direction = !reset ?
-            particle_direction : adjusted_initial_direction;
-        new_size = !reset ?
-            glslMix(size_initial, size_initial * m_size_increase_factor,
-            adjusted_lifetime) : 0.0f;
-
-        m_particles_generating[i].m_position = new_particle_position;
-        m_particles_generating[i].m_lifetime = new_lifetime;
-        m_particles_generating[i].m_direction = new_particle_direction;
-        m_particles_generating[i].m_size = new_size;
-        if (out != NULL)
-        {
-            if (m_flips || new_size != 0.0f)
-            {
-                if (new_size != 0.0f)
-                {
-                    Buffer->BoundingBox.addInternalPoint
-                        (new_particle_position);
-                }
-                out->emplace_back(new_particle_position, m_color_from,
-                    m_color_to, new_lifetime, new_size);
-            }
-        }
+            particle_position_initial + m_initial_particles.getDirection(i));
+
+        p.setPosition(i, initial_position);
+        p.setDirection(i, initial_new_position - initial_position);
+        p.m_lifetime[i] = 0.0f;
+        p.m_size[i] = 0.0f;
     }
+    if (out != NULL)
+        writeParticles(out);
 }   // stimulateHeightMap
 
 // ----------------------------------------------------------------------------
@@ -370,106 +465,101 @@ void STKParticle::stimulateNormal(float dt, unsigned int active_count,
                                   std::vector<CPUParticle>* out)
 {
     const core::matrix4 cur_matrix = AbsoluteTransformation;
+    ParticleArrays& p = m_particles_generating;
+
+    m_reset_particles.clear();
+    advanceParticles(dt, /*keep_zero_size*/true,
+                     /*reset_negative_lifetime*/false);
+
     core::vector3df previous_frame_position, current_frame_position,
         previous_frame_direction, current_frame_direction;
-    for (unsigned i = 0; i < m_max_count; i++)
+    for (unsigned i : m_reset_particles)
     {
-        core::vector3df new_particle_position;
-        core::vector3df new_particle_direction;
-        float new_size = 0.0f;
-        float new_lifetime = 0.0f;
-
-        const core::vector3df particle_position =
-            m_particles_generating[i].m_position;
-        const float lifetime = m_particles_generating[i].m_lifetime;
-        const core::vector3df particle_direction =
-            m_particles_generating[i].m_direction;
-        const float size = m_particles_generating[i].m_size;
+        // advanceParticles has stored the updated lifetime
+        const float updated_lifetime = p.m_lifetime[i];
+        if (i >= active_count)
+        {
+            p.setPosition(i, core::vector3df());
+            p.setDirection(i, core::vector3df());
+            p.m_lifetime[i] = glslFract(updated_lifetime);
+            p.m_size[i] = 0.0f;
+            continue;
+        }
 
         const core::vector3df particle_position_initial =
-            m_initial_particles[i].m_position;
-        const float lifetime_initial = m_initial_particles[i].m_lifetime;
+            m_initial_particles.getPosition(i);
+        const float lifetime_initial = m_initial_particles.m_lifetime[i];
         const core::vector3df particle_direction_initial =
-            m_initial_particles[i].m_direction;
-        const float size_initial = m_initial_particles[i].m_size;
+            m_initial_particles.getDirection(i);
+        const float size_initial = m_initial_particles.m_size[i];
+
+        float dt_from_last_frame =
+            glslFract(updated_lifetime) * lifetime_initial;
+        float coeff = dt_from_last_frame / dt;
+
+        m_previous_frame_matrix.transformVect(previous_frame_position,
+            particle_position_initial);
+        cur_matrix.transformVect(current_frame_position,
+            particle_position_initial);
+
+        core::vector3df updated_position = previous_frame_position
+            .getInterpolated(current_frame_position, coeff);
+
+        m_previous_frame_matrix.rotateVect(previous_frame_direction,
+            particle_direction_initial);
+        cur_matrix.rotateVect(current_frame_direction,
+            particle_direction_initial);
+
+        core::vector3df updated_direction = previous_frame_direction
+            .getInterpolated(current_frame_direction, coeff);
+        // + (current_frame_position - previous_frame_position) / dt;
+
+        // To be accurate, emitter speed should be added.
+        // But the simple formula
+        // ( (current_frame_position - previous_frame_position) / dt )
+        // with a constant speed between 2 frames creates visual
+        // artifacts when the framerate is low, and a more accurate
+        // formula would need more complex computations.
+
+        p.setPosition(i, updated_position + dt_from_last_frame *
+            updated_direction);
+        p.setDirection(i, updated_direction);
+        p.m_lifetime[i] = glslFract(updated_lifetime);
+        p.m_size[i] = glslMix(size_initial,
+            size_initial * m_size_increase_factor,
+            glslFract(updated_lifetime));
+    }
+    if (out != NULL)
+        writeParticles(out);
+}   // stimulateNormal
 
-        float updated_lifetime = lifetime + (dt / lifetime_initial);
-        if (updated_lifetime > 1.0f)
-        {
-            if (i < active_count)
-            {
-                float dt_from_last_frame =
-                    glslFract(updated_lifetime) * lifetime_initial;
-                float coeff = dt_from_last_frame / dt;
-
-                m_previous_frame_matrix.transformVect(previous_frame_position,
-                    particle_position_initial);
-                cur_matrix.transformVect(current_frame_position,
-                    particle_position_initial);
-
-                core::vector3df updated_position = previous_frame_position
-                    .getInterpolated(current_frame_position, coeff);
-
-                m_previous_frame_matrix.rotateVect(previous_frame_direction,
-                    particle_direction_initial);
-                cur_matrix.rotateVect(current_frame_direction,
-                    particle_direction_initial);
-
-                core::vector3df updated_direction = previous_frame_direction
-                    .getInterpolated(current_frame_direction, coeff);
-                // + (current_frame_position - previous_frame_position) / dt;
-
-                // To be accurate, emitter speed should be added.
-                // But the simple formula
-                // ( (current_frame_position - previous_frame_position) / dt )
-                // with a constant speed between 2 frames creates visual
-                // artifacts when the framerate is low, and a more accurate
-                // formula would need more complex computations.
-
-                new_particle_position = updated_position + dt_from_last_frame *
-                    updated_direction;
-                new_particle_direction = updated_direction;
-
-                new_lifetime = glslFract(updated_lifetime);
-                new_size = glslMix(size_initial,
-                    size_initial * m_size_increase_factor,
-                    glslFract(updated_lifetime));
-            }
-            else
-            {
-                new_lifetime = glslFract(updated_lifetime);
-                new_size = 0.0f;
-            }
-        }
-        else
-        {
-            new_particle_position = particle_position +
-                particle_direction * dt;
-            new_particle_direction = particle_direction;
-            new_lifetime = updated_lifetime;
-            new_size = (size == 0.0f) ? 0.0f :
-                glslMix(size_initial, size_initial * m_size_increase_factor,
-                updated_lifetime);
-        }
-        m_particles_generating[i].m_position = new_particle_position;
-        m_particles_generating[i].m_lifetime = new_lifetime;
-        m_particles_generating[i].m_direction = new_particle_direction;
-        m_particles_generating[i].m_size = new_size;
-        if (out != NULL)
+// ----------------------------------------------------------------------------
+/** Appends the visible particles (or all particles if they use flips, since
+ *  the flips are taken from a buffer by index) to the particles which are
+ *  uploaded, and extends the bounding box.
+ */
+void STKParticle::writeParticles(std::vector<CPUParticle>* out)
+{
+    const ParticleArrays& p = m_particles_generating;
+    const size_t start = out->size();
+    out->resize(start + m_max_count);
+    CPUParticle* cur = out->data() + start;
+    for (unsigned i = 0; i < m_max_count; i++)
+    {
+        const float size = p.m_size[i];
+        if (size != 0.0f)
         {
-            if (m_flips || new_size != 0.0f)
-            {
-                if (new_size != 0.0f)
-                {
-                    Buffer->BoundingBox.addInternalPoint
-                        (new_particle_position);
-                }
-                out->emplace_back(new_particle_position, m_color_from,
-                    m_color_to, new_lifetime, new_size);
-            }
+            Buffer->BoundingBox.addInternalPoint(p.m_x[i], p.m_y[i],
+                                                 p.m_z[i]);
         }
+        else if (!m_flips)
+            continue;
+        cur->set(p.getPosition(i), m_color_from, m_color_to,
+                 p.m_lifetime[i], size);
+        cur++;
     }
-}   // stimulateNormal
+    out->resize(cur - out->data());
+}   // writeParticles
 
 // ----------------------------------------------------------------------------
 void STKParticle::updateFlips(unsigned maximum_particle_count)
@@ -506,9 +596,10 @@ void STKParticle::OnRegisterSceneNode()
     generate(NULL);
     Particles.clear();
     Buffer->BoundingBox.reset(AbsoluteTransformation.getTranslation());
-    for (unsigned i = 0; i < m_particles_generating.size(); i++)
+    for (unsigned i = 0; i < m_max_count; i++)
     {
-        if (m_particles_generating[i].m_size == 0.0f)
+        const float size = m_particles_generating.m_size[i];
+        if (size == 0.0f)
         {
             continue;
         }
@@ -517,12 +608,11 @@ void STKParticle::OnRegisterSceneNode()
         p.endTime = 0;
         p.color = 0;
         p.startColor = 0;
-        p.pos = m_particles_generating[i].m_position;
+        p.pos = m_particles_generating.getPosition(i);
         Buffer->BoundingBox.addInternalPoint(p.pos);
-        p.size = core::dimension2df(m_particles_generating[i].m_size,
-            m_particles_generating[i].m_size);
+        p.size = core::dimension2df(size, size);
         core::vector3df ret = m_color_from + (m_color_to - m_color_from) *
-            m_particles_generating[i].m_lifetime;
+            m_particles_generating.m_lifetime[i];
         p.color.setRed(core::clamp((int)(ret.X * 255.0f), 0, 255));
         p.color.setBlue(core::clamp((int)(ret.Y * 255.0f), 0, 255));
         p.color.setGreen(core::clamp((int)(ret.Z * 255.0f), 0, 255));
@@ -23,42 +23,63 @@
 #include "graphics/gl_headers.hpp"
 #include "../lib/irrlicht/source/Irrlicht/CParticleSystemSceneNode.h"
 #include <cassert>
+#include <memory>
 #include <vector>
 
 using namespace irr;
 
 struct CPUParticle;
+class HeightMap;
 
 class STKParticle : public scene::CParticleSystemSceneNode
 {
 private:
     // ------------------------------------------------------------------------
-    struct HeightMapData
+    /** The data of all particles, stored as one array per component, so that
+     *  the particles can be updated 4 at a time with SIMD instructions. */
+    struct ParticleArrays
     {
-        const std::vector<std::vector<float> > m_array;
-        const float m_x;
-        const float m_z;
-        const float m_x_len;
-        const float m_z_len;
+        std::vector<float> m_x, m_y, m_z;
+        std::vector<float> m_dir_x, m_dir_y, m_dir_z;
+        std::vector<float> m_lifetime, m_size;
         // --------------------------------------------------------------------
-        HeightMapData(std::vector<std::vector<float> >& array,
-                      float track_x, float track_z, float track_x_len,
-                      float track_z_len)
-            : m_array(std::move(array)), m_x(track_x), m_z(track_z),
-              m_x_len(track_x_len), m_z_len(track_z_len) {}
-    };
-    // ------------------------------------------------------------------------
-    struct ParticleData
-    {
-        core::vector3df m_position;
-        float m_lifetime;
-        core::vector3df m_direction;
-        float m_size;
+        void resize(unsigned n)
+        {
+            m_x.assign(n, 0.0f);
+            m_y.assign(n, 0.0f);
+            m_z.assign(n, 0.0f);
+            m_dir_x.assign(n, 0.0f);
+            m_dir_y.assign(n, 0.0f);
+            m_dir_z.assign(n, 0.0f);
+            m_lifetime.assign(n, 0.0f);
+            m_size.assign(n, 0.0f);
+        }
+        // --------------------------------------------------------------------
+        core::vector3df getPosition(unsigned i) const
+                               { return core::vector3df(m_x[i], m_y[i], m_z[i]); }
+        // --------------------------------------------------------------------
+        void setPosition(unsigned i, const core::vector3df& p)
+                                    { m_x[i] = p.X; m_y[i] = p.Y; m_z[i] = p.Z; }
+        // --------------------------------------------------------------------
+        core::vector3df getDirection(unsigned i) const
+                   { return core::vector3df(m_dir_x[i], m_dir_y[i], m_dir_z[i]); }
+        // --------------------------------------------------------------------
+        void setDirection(unsigned i, const core::vector3df& d)
+                        { m_dir_x[i] = d.X; m_dir_y[i] = d.Y; m_dir_z[i] = d.Z; }
     };
     // ------------------------------------------------------------------------
-    HeightMapData* m_hm;
+    /** The height map of the track, if the particles collide with it. */
+    std::shared_ptr<const HeightMap> m_height_map;
+
+    ParticleArrays m_particles_generating, m_initial_particles;
 
-    std::vector<ParticleData> m_particles_generating, m_initial_particles;
+    /** 1 / lifetime of each particle in m_initial_particles, so that the
+     *  update does not need a division. */
+    std::vector<float> m_inv_initial_lifetime;
+
+    /** Indices of particles that need to be reset in this frame (collected
+     *  by the SIMD update, and handled one at a time). */
+    std::vector<unsigned> m_reset_particles;
 
     core::vector3df m_color_from, m_color_to;
 
@@ -83,9 +104,16 @@ private:
     // ------------------------------------------------------------------------
     void generateParticlesFromSphereEmitter(scene::IParticleSphereEmitter*);
     // ------------------------------------------------------------------------
+    void resizeParticles();
+    // ------------------------------------------------------------------------
+    void advanceParticles(float dt, bool keep_zero_size,
+                          bool reset_negative_lifetime);
+    // ------------------------------------------------------------------------
     void stimulateHeightMap(float, unsigned int, std::vector<CPUParticle>*);
     // ------------------------------------------------------------------------
     void stimulateNormal(float, unsigned int, std::vector<CPUParticle>*);
+    // ------------------------------------------------------------------------
+    void writeParticles(std::vector<CPUParticle>* out);
 
 public:
     // ------------------------------------------------------------------------
@@ -95,11 +123,6 @@ public:
         const core::vector3df& rotation = core::vector3df(0, 0, 0),
         const core::vector3df& scale = core::vector3df(1.0f, 1.0f, 1.0f));
     // ------------------------------------------------------------------------
-    ~STKParticle()
-    {
-        delete m_hm;
-    }
-    // ------------------------------------------------------------------------
     void setColorFrom(float r, float g, float b)
     {
         m_color_from.X = r;
@@ -120,12 +143,8 @@ public:
     // ------------------------------------------------------------------------
     void setIncreaseFactor(float val)         { m_size_increase_factor = val; }
     // ------------------------------------------------------------------------
-    void setHeightmap(std::vector<std::vector<float> >& array, float track_x,
-                      float track_z, float track_x_len, float track_z_len)
-    {
-        m_hm = new HeightMapData(array, track_x, track_z, track_x_len,
-            track_z_len);
-    }
+    void setHeightmap(std::shared_ptr<const HeightMap> height_map)
+                                              { m_height_map = height_map; }
     // ------------------------------------------------------------------------
     void generate(std::vector<CPUParticle>* out);
     // ------------------------------------------------------------------------
@@ -249,6 +249,7 @@ FileManager::FileManager()
     checkAndCreateScreenshotDir();
     checkAndCreateReplayDir();
     checkAndCreateCachedTexturesDir();
+    checkAndCreateCachedDataDir();
     checkAndCreateGPDir();
 
     redirectOutput();
@@ -532,8 +533,14 @@ void FileManager::addRootDirs(const std::string &roots)
 }   // addRootDirs
 
 //-----------------------------------------------------------------------------
+/** Creates an XML reader for a file. The reader reads the whole file when it
+ *  is created, so the lock makes it safe to read XML files in a separate
+ *  thread (e.g. the drive graph while a track is loaded) while search paths
+ *  are added or removed.
+ */
 io::IXMLReader *FileManager::createXMLReader(const std::string &filename)
 {
+    std::lock_guard<std::mutex> lock(m_file_system_lock);
     return m_file_system->createXMLReader(filename.c_str());
 }   // getXMLReader
 //-----------------------------------------------------------------------------
@@ -809,6 +816,14 @@ std::string FileManager::getCachedTexturesDir() const
     return m_cached_textures_dir;
 }   // getCachedTexturesDir
 
+//-----------------------------------------------------------------------------
+/** Returns the directory in which data computed from the assets is cached.
+ */
+std::string FileManager::getCachedDataDir() const
+{
+    return m_cached_data_dir;
+}   // getCachedDataDir
+
 //-----------------------------------------------------------------------------
 /** Returns the directory in which user-defined grand prix should be stored.
  */
@@ -1151,6 +1166,30 @@ void FileManager::checkAndCreateCachedTexturesDir()
 
 }   // checkAndCreateCachedTexturesDir
 
+// ----------------------------------------------------------------------------
+/** Creates the directories for cached data. This will set m_cached_data_dir
+ *  with the appropriate path.
+ */
+void FileManager::checkAndCreateCachedDataDir()
+{
+#if defined(WIN32) || defined(__CYGWIN__)
+    m_cached_data_dir = m_user_config_dir + "cached-data/";
+#elif defined(__APPLE__)
+    m_cached_data_dir = getenv("HOME");
+    m_cached_data_dir += "/Library/Application Support/SuperTuxKart/CachedData/";
+#else
+    m_cached_data_dir = checkAndCreateLinuxDir("XDG_CACHE_HOME", "supertuxkart", ".cache/", ".");
+    m_cached_data_dir += "cached-data/";
+#endif
+
+    if (!checkAndCreateDirectory(m_cached_data_dir))
+    {
+        Log::error("FileManager", "Can not create cached data directory '%s', "
+            "falling back to '.'.", m_cached_data_dir.c_str());
+        m_cached_data_dir = ".";
+    }
+}   // checkAndCreateCachedDataDir
+
 // ----------------------------------------------------------------------------
 /** Creates the directories for user-defined grand prix. This will set m_gp_dir
  *  with the appropriate path.
@@ -38,7 +38,9 @@
 #include <IMesh.h>
 #include <IAnimatedMesh.h>
 
+#include <algorithm>
 #include <assert.h>
+#include <cmath>
 #include <stdexcept>
 #include <sstream>
 #include <string>
@@ -51,6 +53,14 @@ bool                         ItemManager::m_disable_item_collection = false;
 std::shared_ptr<ItemManager> ItemManager::m_item_manager;
 std::mt19937                 ItemManager::m_random_engine;
 
+/** Size of a cell of the grid used for item hit detection. */
+static const float ITEM_CELL_SIZE = 5.0f;
+
+/** Maximum distance between a kart and an item it can hit: Item::hitKart
+ *  halves the vertical distance before comparing the squared distance with
+ *  m_distance_2 (1.2), so the distance is less than 2 * sqrt(1.2). */
+static const float ITEM_MAX_HIT_DISTANCE = 2.2f;
+
 //-----------------------------------------------------------------------------
 /** Creates one instance of the item manager. */
 void ItemManager::create()
@@ -245,12 +255,28 @@ unsigned int ItemManager::insertItem(Item *item)
     return index;
 }   // insertItem
 
+//-----------------------------------------------------------------------------
+/** Returns the key of a cell of the item grid.
+ *  \param x Index of the cell in X direction.
+ *  \param z Index of the cell in Z direction.
+ */
+uint64_t ItemManager::getItemCell(int x, int z)
+{
+    return ((uint64_t)(uint32_t)x << 32) | (uint32_t)z;
+}   // getItemCell
+
 //-----------------------------------------------------------------------------
 /** Insert into the appropriate quad list, if there is a quad list
- *  (i.e. race mode has a quad graph).
+ *  (i.e. race mode has a quad graph), and into the grid cell of its
+ *  position.
  */
 void ItemManager::insertItemInQuad(Item *item)
 {
+    const Vec3& xyz = item->getXYZ();
+    m_items_in_cells[getItemCell((int)floorf(xyz.getX() / ITEM_CELL_SIZE),
+                                 (int)floorf(xyz.getZ() / ITEM_CELL_SIZE))]
+        .push_back(item);
+
     if(m_items_in_quads)
     {
         int graph_node = item->getGraphNode();
@@ -380,23 +406,45 @@ void ItemManager::collectedItem(ItemState *item, AbstractKart *kart)
  */
 void  ItemManager::checkItemHit(AbstractKart* kart)
 {
-    // We could use m_items_in_quads to to check for item hits: take the quad
-    // of the graph node of the kart, and only check items in that quad. But
-    // then we also need to check for any adjacent quads (since an item just
-    // on the order of one quad might get hit from an adjacent quad). Then
-    // it is possible that a quad is that short that we need to test adjacent
-    // of adjacent quads. And check for items outside of the track.
-    // Since at this stace item detection is by far not a bottle neck,
-    // the original, simple and stable algorithm is left in place.
-
     /** Disable item collection detection for debug purposes. */
     if(m_disable_item_collection) return;
 
     // Spare tire karts don't collect items
     if ( dynamic_cast<SpareTireAI*>(kart->getController()) ) return;
 
-    for(AllItemTypes::iterator i =m_all_items.begin();
-                               i!=m_all_items.end();  i++)
+    // Only items in grid cells within the maximum hit distance can be hit.
+    // They are tested in the order of m_all_items, so that the result is the
+    // same as testing all items.
+    const Vec3& xyz = kart->getXYZ();
+    const int x0 = (int)floorf((xyz.getX() - ITEM_MAX_HIT_DISTANCE) /
+                               ITEM_CELL_SIZE);
+    const int x1 = (int)floorf((xyz.getX() + ITEM_MAX_HIT_DISTANCE) /
+                               ITEM_CELL_SIZE);
+    const int z0 = (int)floorf((xyz.getZ() - ITEM_MAX_HIT_DISTANCE) /
+                               ITEM_CELL_SIZE);
+    const int z1 = (int)floorf((xyz.getZ() + ITEM_MAX_HIT_DISTANCE) /
+                               ITEM_CELL_SIZE);
+    m_close_items.clear();
+    for (int x = x0; x <= x1; x++)
+    {
+        for (int z = z0; z <= z1; z++)
+        {
+            auto cell = m_items_in_cells.find(getItemCell(x, z));
+            if (cell != m_items_in_cells.end())
+            {
+                m_close_items.insert(m_close_items.end(),
+                    cell->second.begin(), cell->second.end());
+            }
+        }
+    }
+    std::sort(m_close_items.begin(), m_close_items.end(),
+        [](const ItemState* a, const ItemState* b)
+        {
+            return a->getItemId() < b->getItemId();
+        });
+
+    for(AllItemTypes::iterator i =m_close_items.begin();
+                               i!=m_close_items.end();  i++)
     {
         // Ignore items that have been collected or are not available atm
         if ((!*i) || !(*i)->isAvailable() || (*i)->isUsedUp()) continue;
@@ -416,7 +464,7 @@ void  ItemManager::checkItemHit(AbstractKart* kart)
         {
             collectedItem(*i, kart);
         }   // if hit
-    }   // for m_all_items
+    }   // for m_close_items
 }   // checkItemHit
 
 //-----------------------------------------------------------------------------
@@ -527,11 +575,21 @@ void ItemManager::deleteItem(ItemState *item)
 }   // delete item
 
 //-----------------------------------------------------------------------------
-/** Removes an items from the items-in-quad list only
+/** Removes an items from the items-in-quad list and its grid cell only
  *  \param The item to delete.
  */
 void ItemManager::deleteItemInQuad(ItemState* item)
 {
+    const Vec3& xyz = item->getXYZ();
+    auto cell = m_items_in_cells.find(
+        getItemCell((int)floorf(xyz.getX() / ITEM_CELL_SIZE),
+                    (int)floorf(xyz.getZ() / ITEM_CELL_SIZE)));
+    assert(cell != m_items_in_cells.end());
+    AllItemTypes::iterator it_cell =
+        std::find(cell->second.begin(), cell->second.end(), item);
+    assert(it_cell != cell->second.end());
+    cell->second.erase(it_cell);
+
     if(m_items_in_quads)
     {
         int sector = item->getGraphNode();
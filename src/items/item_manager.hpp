@@ -33,6 +33,7 @@
 #include <memory>
 #include <random>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 class Kart;
@@ -110,6 +111,15 @@ private:
      *  field is undefined if no Graph exist, e.g. arena without navmesh. */
     std::vector< AllItemTypes > *m_items_in_quads;
 
+    /** Stores the items in a uniform grid on the XZ plane, so that
+     *  checkItemHit only needs to test the items close to a kart. The key
+     *  is the packed X and Z index of the cell, see getItemCell(). */
+    std::unordered_map<uint64_t, AllItemTypes> m_items_in_cells;
+
+    /** Temporary list of the items close to a kart in checkItemHit, kept
+     *  to avoid memory allocations each time. */
+    AllItemTypes m_close_items;
+
     /** Stores all item models. */
     static std::vector<scene::IMesh *> m_item_mesh;
 
@@ -127,6 +137,7 @@ protected:
     void setSwitchItems(const std::vector<int> &switch_items);
     void insertItemInQuad(Item *item);
     void deleteItemInQuad(ItemState *item);
+    static uint64_t getItemCell(int x, int z);
              ItemManager();
 public:
     virtual ~ItemManager();
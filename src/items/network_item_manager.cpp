@@ -248,6 +248,18 @@ BareNetworkString* NetworkItemManager::saveState(std::vector<std::string>* ru)
     return s;
 }   // saveState
 
+//-----------------------------------------------------------------------------
+/** On a client the predicted item state is empty: a state from the server
+ *  without item events changes nothing which is not already part of the
+ *  kart states (e.g. a collected item changes the powerup of a kart), so no
+ *  rewind is needed for it. Item events always cause a rewind, which also
+ *  sends their confirmation to the server.
+ */
+BareNetworkString* NetworkItemManager::savePredictedState()
+{
+    return new BareNetworkString();
+}   // savePredictedState
+
 //-----------------------------------------------------------------------------
 /** Progresses the time for all item by the given number of ticks. Used
  *  when computing a new state from a confirmed state.
@@ -488,7 +500,16 @@ void NetworkItemManager::restoreState(BareNetworkString *buffer, int count)
         // ... will be copied from item state to item
         if (is && item)
         {
-            *(ItemState*)item = *is;
+            // If the position changed the item must be moved to the
+            // correct cell for hit detection
+            if (item->getXYZ() != is->getXYZ())
+            {
+                deleteItemInQuad(item);
+                *(ItemState*)item = *is;
+                insertItemInQuad(static_cast<Item*>(item));
+            }
+            else
+                *(ItemState*)item = *is;
         }
         else if (is && !item)
         {
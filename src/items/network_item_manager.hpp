@@ -87,6 +87,7 @@ public:
     virtual BareNetworkString* saveState(std::vector<std::string>* ru)
         OVERRIDE;
     virtual void restoreState(BareNetworkString *buffer, int count) OVERRIDE;
+    virtual BareNetworkString* savePredictedState() OVERRIDE;
     // ------------------------------------------------------------------------
     virtual void rewindToEvent(BareNetworkString *bns) OVERRIDE {};
     // ------------------------------------------------------------------------
@@ -18,159 +18,277 @@
 
 #include "karts/cached_characteristic.hpp"
 
-#include "utils/interpolation_array.hpp"
+#include "karts/combined_characteristic.hpp"
+#include "karts/kart_properties_manager.hpp"
+#include "race/race_manager.hpp"
+#include "utils/log.hpp"
+#include "utils/time.hpp"
 
 CachedCharacteristic::CachedCharacteristic(const AbstractCharacteristic *origin) :
-    m_values(CHARACTERISTIC_COUNT),
     m_origin(origin)
 {
     updateSource();
 }
 
 // ----------------------------------------------------------------------------
-/** Deletes all allocated values. */
-CachedCharacteristic::~CachedCharacteristic()
+/** Returns a pointer to the member of the values which stores the given
+ *  characteristic.
+ */
+AbstractCharacteristic::Value CachedCharacteristic::getValue(Values *values,
+                                                     CharacteristicType type)
 {
-    // Delete all not-null values
-    for (int i = 0; i < CHARACTERISTIC_COUNT; i++)
+    switch (type)
     {
-        SaveValue &v = m_values[i];
-        if (v.content)
-        {
-            switch (getType(static_cast<CharacteristicType>(i)))
-            {
-            case TYPE_FLOAT:
-                delete static_cast<float*>(v.content);
-                break;
-            case TYPE_FLOAT_VECTOR:
-                delete static_cast<std::vector<float>*>(v.content);
-                break;
-            case TYPE_INTERPOLATION_ARRAY:
-                delete static_cast<InterpolationArray*>(v.content);
-                break;
-            case TYPE_BOOL:
-                delete static_cast<bool*>(v.content);
-                break;
-            }
-            v.content = nullptr;
-        }
-    }
-}   // ~CachedCharacteristic
+    case CHARACTERISTIC_COUNT:
+        Log::fatal("CachedCharacteristic::getValue", "Can't get value of COUNT");
+        break;
+    // Script-generated content generated by tools/create_kart_properties.py ccvalue
+    // Please don't change the following tag. It will be automatically detected
+    // by the script and replace the contained content.
+    // To update the code, use tools/update_characteristics.py
+    /* <characteristics-start ccvalue> */
+    case SUSPENSION_STIFFNESS:
+        return Value(&values->m_suspension_stiffness);
+    case SUSPENSION_REST:
+        return Value(&values->m_suspension_rest);
+    case SUSPENSION_TRAVEL:
+        return Value(&values->m_suspension_travel);
+    case SUSPENSION_EXP_SPRING_RESPONSE:
+        return Value(&values->m_suspension_exp_spring_response);
+    case SUSPENSION_MAX_FORCE:
+        return Value(&values->m_suspension_max_force);
+    case STABILITY_ROLL_INFLUENCE:
+        return Value(&values->m_stability_roll_influence);
+    case STABILITY_CHASSIS_LINEAR_DAMPING:
+        return Value(&values->m_stability_chassis_linear_damping);
+    case STABILITY_CHASSIS_ANGULAR_DAMPING:
+        return Value(&values->m_stability_chassis_angular_damping);
+    case STABILITY_DOWNWARD_IMPULSE_FACTOR:
+        return Value(&values->m_stability_downward_impulse_factor);
+    case STABILITY_TRACK_CONNECTION_ACCEL:
+        return Value(&values->m_stability_track_connection_accel);
+    case STABILITY_ANGULAR_FACTOR:
+        return Value(&values->m_stability_angular_factor);
+    case STABILITY_SMOOTH_FLYING_IMPULSE:
+        return Value(&values->m_stability_smooth_flying_impulse);
+    case TURN_RADIUS:
+        return Value(&values->m_turn_radius);
+    case TURN_TIME_RESET_STEER:
+        return Value(&values->m_turn_time_reset_steer);
+    case TURN_TIME_FULL_STEER:
+        return Value(&values->m_turn_time_full_steer);
+    case ENGINE_POWER:
+        return Value(&values->m_engine_power);
+    case ENGINE_MAX_SPEED:
+        return Value(&values->m_engine_max_speed);
+    case ENGINE_GENERIC_MAX_SPEED:
+        return Value(&values->m_engine_generic_max_speed);
+    case ENGINE_BRAKE_FACTOR:
+        return Value(&values->m_engine_brake_factor);
+    case ENGINE_BRAKE_TIME_INCREASE:
+        return Value(&values->m_engine_brake_time_increase);
+    case ENGINE_MAX_SPEED_REVERSE_RATIO:
+        return Value(&values->m_engine_max_speed_reverse_ratio);
+    case GEAR_SWITCH_RATIO:
+        return Value(&values->m_gear_switch_ratio);
+    case GEAR_POWER_INCREASE:
+        return Value(&values->m_gear_power_increase);
+    case MASS:
+        return Value(&values->m_mass);
+    case WHEELS_DAMPING_RELAXATION:
+        return Value(&values->m_wheels_damping_relaxation);
+    case WHEELS_DAMPING_COMPRESSION:
+        return Value(&values->m_wheels_damping_compression);
+    case CAMERA_DISTANCE:
+        return Value(&values->m_camera_distance);
+    case CAMERA_FORWARD_UP_ANGLE:
+        return Value(&values->m_camera_forward_up_angle);
+    case CAMERA_BACKWARD_UP_ANGLE:
+        return Value(&values->m_camera_backward_up_angle);
+    case JUMP_ANIMATION_TIME:
+        return Value(&values->m_jump_animation_time);
+    case LEAN_MAX:
+        return Value(&values->m_lean_max);
+    case LEAN_SPEED:
+        return Value(&values->m_lean_speed);
+    case ANVIL_DURATION:
+        return Value(&values->m_anvil_duration);
+    case ANVIL_WEIGHT:
+        return Value(&values->m_anvil_weight);
+    case ANVIL_SPEED_FACTOR:
+        return Value(&values->m_anvil_speed_factor);
+    case PARACHUTE_FRICTION:
+        return Value(&values->m_parachute_friction);
+    case PARACHUTE_DURATION:
+        return Value(&values->m_parachute_duration);
+    case PARACHUTE_DURATION_OTHER:
+        return Value(&values->m_parachute_duration_other);
+    case PARACHUTE_DURATION_RANK_MULT:
+        return Value(&values->m_parachute_duration_rank_mult);
+    case PARACHUTE_DURATION_SPEED_MULT:
+        return Value(&values->m_parachute_duration_speed_mult);
+    case PARACHUTE_LBOUND_FRACTION:
+        return Value(&values->m_parachute_lbound_fraction);
+    case PARACHUTE_UBOUND_FRACTION:
+        return Value(&values->m_parachute_ubound_fraction);
+    case PARACHUTE_MAX_SPEED:
+        return Value(&values->m_parachute_max_speed);
+    case FRICTION_KART_FRICTION:
+        return Value(&values->m_friction_kart_friction);
+    case BUBBLEGUM_DURATION:
+        return Value(&values->m_bubblegum_duration);
+    case BUBBLEGUM_SPEED_FRACTION:
+        return Value(&values->m_bubblegum_speed_fraction);
+    case BUBBLEGUM_TORQUE:
+        return Value(&values->m_bubblegum_torque);
+    case BUBBLEGUM_FADE_IN_TIME:
+        return Value(&values->m_bubblegum_fade_in_time);
+    case BUBBLEGUM_SHIELD_DURATION:
+        return Value(&values->m_bubblegum_shield_duration);
+    case ZIPPER_DURATION:
+        return Value(&values->m_zipper_duration);
+    case ZIPPER_FORCE:
+        return Value(&values->m_zipper_force);
+    case ZIPPER_SPEED_GAIN:
+        return Value(&values->m_zipper_speed_gain);
+    case ZIPPER_MAX_SPEED_INCREASE:
+        return Value(&values->m_zipper_max_speed_increase);
+    case ZIPPER_FADE_OUT_TIME:
+        return Value(&values->m_zipper_fade_out_time);
+    case SWATTER_DURATION:
+        return Value(&values->m_swatter_duration);
+    case SWATTER_DISTANCE:
+        return Value(&values->m_swatter_distance);
+    case SWATTER_SQUASH_DURATION:
+        return Value(&values->m_swatter_squash_duration);
+    case SWATTER_SQUASH_SLOWDOWN:
+        return Value(&values->m_swatter_squash_slowdown);
+    case PLUNGER_BAND_MAX_LENGTH:
+        return Value(&values->m_plunger_band_max_length);
+    case PLUNGER_BAND_FORCE:
+        return Value(&values->m_plunger_band_force);
+    case PLUNGER_BAND_DURATION:
+        return Value(&values->m_plunger_band_duration);
+    case PLUNGER_BAND_SPEED_INCREASE:
+        return Value(&values->m_plunger_band_speed_increase);
+    case PLUNGER_BAND_FADE_OUT_TIME:
+        return Value(&values->m_plunger_band_fade_out_time);
+    case PLUNGER_IN_FACE_TIME:
+        return Value(&values->m_plunger_in_face_time);
+    case STARTUP_TIME:
+        return Value(&values->m_startup_time);
+    case STARTUP_BOOST:
+        return Value(&values->m_startup_boost);
+    case RESCUE_DURATION:
+        return Value(&values->m_rescue_duration);
+    case RESCUE_VERT_OFFSET:
+        return Value(&values->m_rescue_vert_offset);
+    case RESCUE_HEIGHT:
+        return Value(&values->m_rescue_height);
+    case EXPLOSION_DURATION:
+        return Value(&values->m_explosion_duration);
+    case EXPLOSION_RADIUS:
+        return Value(&values->m_explosion_radius);
+    case EXPLOSION_INVULNERABILITY_TIME:
+        return Value(&values->m_explosion_invulnerability_time);
+    case NITRO_DURATION:
+        return Value(&values->m_nitro_duration);
+    case NITRO_ENGINE_FORCE:
+        return Value(&values->m_nitro_engine_force);
+    case NITRO_ENGINE_MULT:
+        return Value(&values->m_nitro_engine_mult);
+    case NITRO_CONSUMPTION:
+        return Value(&values->m_nitro_consumption);
+    case NITRO_SMALL_CONTAINER:
+        return Value(&values->m_nitro_small_container);
+    case NITRO_BIG_CONTAINER:
+        return Value(&values->m_nitro_big_container);
+    case NITRO_MAX_SPEED_INCREASE:
+        return Value(&values->m_nitro_max_speed_increase);
+    case NITRO_FADE_OUT_TIME:
+        return Value(&values->m_nitro_fade_out_time);
+    case NITRO_MAX:
+        return Value(&values->m_nitro_max);
+    case SLIPSTREAM_DURATION_FACTOR:
+        return Value(&values->m_slipstream_duration_factor);
+    case SLIPSTREAM_BASE_SPEED:
+        return Value(&values->m_slipstream_base_speed);
+    case SLIPSTREAM_LENGTH:
+        return Value(&values->m_slipstream_length);
+    case SLIPSTREAM_WIDTH:
+        return Value(&values->m_slipstream_width);
+    case SLIPSTREAM_INNER_FACTOR:
+        return Value(&values->m_slipstream_inner_factor);
+    case SLIPSTREAM_MIN_COLLECT_TIME:
+        return Value(&values->m_slipstream_min_collect_time);
+    case SLIPSTREAM_MAX_COLLECT_TIME:
+        return Value(&values->m_slipstream_max_collect_time);
+    case SLIPSTREAM_ADD_POWER:
+        return Value(&values->m_slipstream_add_power);
+    case SLIPSTREAM_MIN_SPEED:
+        return Value(&values->m_slipstream_min_speed);
+    case SLIPSTREAM_MAX_SPEED_INCREASE:
+        return Value(&values->m_slipstream_max_speed_increase);
+    case SLIPSTREAM_FADE_OUT_TIME:
+        return Value(&values->m_slipstream_fade_out_time);
+    case SKID_INCREASE:
+        return Value(&values->m_skid_increase);
+    case SKID_DECREASE:
+        return Value(&values->m_skid_decrease);
+    case SKID_MAX:
+        return Value(&values->m_skid_max);
+    case SKID_TIME_TILL_MAX:
+        return Value(&values->m_skid_time_till_max);
+    case SKID_VISUAL:
+        return Value(&values->m_skid_visual);
+    case SKID_VISUAL_TIME:
+        return Value(&values->m_skid_visual_time);
+    case SKID_REVERT_VISUAL_TIME:
+        return Value(&values->m_skid_revert_visual_time);
+    case SKID_MIN_SPEED:
+        return Value(&values->m_skid_min_speed);
+    case SKID_TIME_TILL_BONUS:
+        return Value(&values->m_skid_time_till_bonus);
+    case SKID_BONUS_SPEED:
+        return Value(&values->m_skid_bonus_speed);
+    case SKID_BONUS_TIME:
+        return Value(&values->m_skid_bonus_time);
+    case SKID_BONUS_FORCE:
+        return Value(&values->m_skid_bonus_force);
+    case SKID_PHYSICAL_JUMP_TIME:
+        return Value(&values->m_skid_physical_jump_time);
+    case SKID_GRAPHICAL_JUMP_TIME:
+        return Value(&values->m_skid_graphical_jump_time);
+    case SKID_POST_SKID_ROTATE_FACTOR:
+        return Value(&values->m_skid_post_skid_rotate_factor);
+    case SKID_REDUCE_TURN_MIN:
+        return Value(&values->m_skid_reduce_turn_min);
+    case SKID_REDUCE_TURN_MAX:
+        return Value(&values->m_skid_reduce_turn_max);
+    case SKID_ENABLED:
+        return Value(&values->m_skid_enabled);
+
+    /* <characteristics-end ccvalue> */
+    }   // switch (type)
+    Log::fatal("CachedCharacteristic::getValue", "Unknown type");
+    return Value(&values->m_mass);
+}   // getValue
 
 // ----------------------------------------------------------------------------
 /** Recompute the values of all characteristics based on the list of
- *  source-characteristics.
+ *  source-characteristics. All characteristics must be set, which is the
+ *  case as long as the base characteristic is part of the source.
  */
 void CachedCharacteristic::updateSource()
 {
     for (int i = 0; i < CHARACTERISTIC_COUNT; i++)
     {
-        SaveValue &v = m_values[i];
-        
+        CharacteristicType type = static_cast<CharacteristicType>(i);
         bool is_set = false;
-        switch (getType(static_cast<CharacteristicType>(i)))
-        {
-        case TYPE_FLOAT:
-        {
-            float value;
-            float *ptr = static_cast<float*>(v.content);
-            m_origin->process(static_cast<CharacteristicType>(i), &value, &is_set);
-            if (is_set)
-            {
-                if (!ptr)
-                {
-                    float *newPtr = new float();
-                    v.content = newPtr;
-                    ptr = newPtr;
-                }
-                *ptr = value;
-            }
-            else
-            {
-                if (ptr)
-                {
-                    delete ptr;
-                    v.content = nullptr;
-                }
-            }
-            break;
-        }
-        case TYPE_FLOAT_VECTOR:
-        {
-            std::vector<float> value;
-            std::vector<float> *ptr = static_cast<std::vector<float>*>(v.content);
-            m_origin->process(static_cast<CharacteristicType>(i), &value, &is_set);
-            if (is_set)
-            {
-                if (!ptr)
-                {
-                    std::vector<float> *newPtr = new std::vector<float>();
-                    v.content = newPtr;
-                    ptr = newPtr;
-                }
-                *ptr = value;
-            }
-            else
-            {
-                if (ptr)
-                {
-                    delete ptr;
-                    v.content = nullptr;
-                }
-            }
-            break;
-        }
-        case TYPE_INTERPOLATION_ARRAY:
-        {
-            InterpolationArray value;
-            InterpolationArray *ptr = static_cast<InterpolationArray*>(v.content);
-            m_origin->process(static_cast<CharacteristicType>(i), &value, &is_set);
-            if (is_set)
-            {
-                if (!ptr)
-                {
-                    InterpolationArray *newPtr = new InterpolationArray();
-                    v.content = newPtr;
-                    ptr = newPtr;
-                }
-                *ptr = value;
-            }
-            else
-            {
-                if (ptr)
-                {
-                    delete ptr;
-                    v.content = nullptr;
-                }
-            }
-            break;
-        }
-        case TYPE_BOOL:
-        {
-            bool value;
-            bool *ptr = static_cast<bool*>(v.content);
-            m_origin->process(static_cast<CharacteristicType>(i), &value, &is_set);
-            if (is_set)
-            {
-                if (!ptr)
-                {
-                    bool *newPtr = new bool();
-                    v.content = newPtr;
-                    ptr = newPtr;
-                }
-                *ptr = value;
-            }
-            else
-            {
-                if (ptr)
-                {
-                    delete ptr;
-                    v.content = nullptr;
-                }
-            }
-            break;
-        }
-        }   // switch (type)
+        m_origin->process(type, getValue(&m_values, type), &is_set);
+        if (!is_set)
+            Log::fatal("CachedCharacteristic", "Can't get characteristic %s",
+                       getName(type).c_str());
     }   // foreach characteristic
 }   // updateSource
 
@@ -179,25 +297,96 @@ void CachedCharacteristic::updateSource()
 void CachedCharacteristic::process(CharacteristicType type, Value value,
                                    bool *is_set) const
 {
-    void *v = m_values[type].content;
-    if (v)
+    // The values are only read, getValue is not const to be usable for
+    // updateSource, too.
+    Value v = getValue(const_cast<Values*>(&m_values), type);
+    switch (getType(type))
     {
-        switch (getType(type))
-        {
-        case TYPE_FLOAT:
-            *value.f = *static_cast<float*>(v);
-            break;
-        case TYPE_FLOAT_VECTOR:
-            *value.fv = *static_cast<std::vector<float>*>(v);
-            break;
-        case TYPE_INTERPOLATION_ARRAY:
-            *value.ia = *static_cast<InterpolationArray*>(v);
-            break;
-        case TYPE_BOOL:
-            *value.b = *static_cast<bool*>(v);
-            break;
-        }
-        *is_set = true;
+    case TYPE_FLOAT:
+        *value.f = *v.f;
+        break;
+    case TYPE_FLOAT_VECTOR:
+        *value.fv = *v.fv;
+        break;
+    case TYPE_INTERPOLATION_ARRAY:
+        *value.ia = *v.ia;
+        break;
+    case TYPE_BOOL:
+        *value.b = *v.b;
+        break;
     }
+    *is_set = true;
 }   // process
 
+// ----------------------------------------------------------------------------
+/** Queries characteristics like the kart does in each time step (physics,
+ *  skidding, nitro, ...). Used by benchmarkGetters() with the getters of
+ *  AbstractCharacteristic and the inline getters of CachedCharacteristic.
+ */
+template<typename C>
+static float queryCharacteristics(const C &c, float speed)
+{
+    float sum = c.getSuspensionStiffness() + c.getSuspensionRest()
+              + c.getSuspensionTravel() + c.getSuspensionMaxForce()
+              + c.getWheelsDampingRelaxation()
+              + c.getWheelsDampingCompression()
+              + c.getStabilityDownwardImpulseFactor()
+              + c.getEngineMaxSpeed() + c.getEnginePower()
+              + c.getEngineBrakeFactor() + c.getMass()
+              + c.getSkidIncrease() + c.getSkidDecrease() + c.getSkidMax()
+              + c.getNitroConsumption() + c.getNitroMaxSpeedIncrease()
+              + c.getTurnRadius().get(speed)
+              + c.getStabilityAngularFactor()[0];
+    return c.getSkidEnabled() ? sum : -sum;
+}   // queryCharacteristics
+
+// ----------------------------------------------------------------------------
+/** Compares the time to query the characteristics of a kart with the getters
+ *  of the combined characteristic (which evaluates the xml values), with the
+ *  getters of AbstractCharacteristic on the cached values (a virtual process
+ *  call for each value) and with the inline getters of this class.
+ */
+void CachedCharacteristic::benchmarkGetters()
+{
+    CombinedCharacteristic combined;
+    combined.addCharacteristic(kart_properties_manager->getBaseCharacteristic());
+    combined.addCharacteristic(kart_properties_manager
+        ->getDifficultyCharacteristic(race_manager->getDifficultyAsString(
+            race_manager->getDifficulty())));
+    combined.addCharacteristic(kart_properties_manager
+        ->getKartTypeCharacteristic("medium", "benchmark"));
+    CachedCharacteristic cached(&combined);
+
+    // Number of getters called by queryCharacteristics
+    const int getters = 19;
+    // Calls from 8 karts in 120 time steps per second for 10 minutes
+    const int queries = 8 * 120 * 600;
+    const AbstractCharacteristic &abstract = cached;
+    float sum[3] = { 0.0f, 0.0f, 0.0f };
+    uint64_t time[3];
+    int count[3] = { queries / 100, queries, queries };
+
+    uint64_t start = StkTime::getMonoTimeUs();
+    for (int i = 0; i < count[0]; i++)
+        sum[0] += queryCharacteristics(combined, float(i % 50));
+    time[0] = StkTime::getMonoTimeUs() - start;
+
+    start = StkTime::getMonoTimeUs();
+    for (int i = 0; i < count[1]; i++)
+        sum[1] += queryCharacteristics(abstract, float(i % 50));
+    time[1] = StkTime::getMonoTimeUs() - start;
+
+    start = StkTime::getMonoTimeUs();
+    for (int i = 0; i < count[2]; i++)
+        sum[2] += queryCharacteristics(cached, float(i % 50));
+    time[2] = StkTime::getMonoTimeUs() - start;
+
+    const char *names[3] = { "combined", "process", "inline" };
+    for (int i = 0; i < 3; i++)
+    {
+        Log::info("CachedCharacteristic",
+            "%-8s getters: %8.2f ns per call, %d queries in %d us (sum %f).",
+            names[i], time[i] * 1000.0f / (float(count[i]) * getters),
+            count[i], (int)time[i], sum[i]);
+    }
+}   // benchmarkGetters
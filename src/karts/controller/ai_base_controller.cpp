@@ -30,6 +30,7 @@
 #include "utils/constants.hpp"
 
 #include <assert.h>
+#include <string.h>
 
 bool AIBaseController::m_ai_debug = false;
 int  AIBaseController::m_test_ai  = 0;
@@ -60,6 +61,16 @@ void AIBaseController::update(int ticks)
     m_stuck = false;
 }
 
+//-----------------------------------------------------------------------------
+/** Returns true if both vectors have exactly the same bits. Data computed
+ *  in prepareUpdate() is only used if its input is identical in this sense,
+ *  since e.g. 0 and -0 compare equal, but can give different results.
+ */
+bool AIBaseController::isIdentical(const Vec3 &a, const Vec3 &b)
+{
+    return memcmp(&a.getX(), &b.getX(), 3*sizeof(btScalar)) == 0;
+}   // isIdentical
+
 //-----------------------------------------------------------------------------
 /** In debug mode when the user specified --ai-debug on the command line set
  *  the name of the controller as on-screen text, so that the different AI
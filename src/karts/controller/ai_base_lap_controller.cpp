@@ -104,6 +104,7 @@ AIBaseLapController::AIBaseLapController(AbstractKart *kart)
         m_all_look_aheads.clear();
         m_successor_index.clear();
     }   // if battle mode
+    m_prepared_node.m_valid = false;
     // Don't call our own setControllerName, since this will add a
     // billboard showing 'AIBaseLapController' to the kar.
     Controller::setControllerName("AIBaseLapController");
@@ -113,6 +114,7 @@ AIBaseLapController::AIBaseLapController(AbstractKart *kart)
 void AIBaseLapController::reset()
 {
     AIBaseController::reset();
+    m_prepared_node.m_valid = false;
 }   // reset
 
 
@@ -126,6 +128,7 @@ void  AIBaseLapController::newLap(int lap)
     if(lap>0)
     {
         computePath();
+        m_prepared_node.m_valid = false;
     }
 }   // newLap
 
@@ -203,26 +206,62 @@ void AIBaseLapController::update(int ticks)
     if(DriveGraph::get() && m_world)
     {
         // Update the current node:
-        int old_node = m_track_node;
-        if(m_track_node!=Graph::UNKNOWN_SECTOR)
-        {
-            DriveGraph::get()->findRoadSector(m_kart->getXYZ(), &m_track_node,
-                &m_all_look_aheads[m_track_node]);
-        }
-        // If we can't find a proper place on the track, to a broader search
-        // on off-track locations.
-        if(m_track_node==Graph::UNKNOWN_SECTOR)
-        {
-            m_track_node = DriveGraph::get()->findOutOfRoadSector(m_kart->getXYZ());
-        }
-        // IF the AI is off track (or on a branch of the track it did not
-        // select to be on), keep the old position.
-        if(m_track_node==Graph::UNKNOWN_SECTOR ||
-            m_next_node_index[m_track_node]==-1)
-            m_track_node = old_node;
+        if(m_prepared_node.m_valid &&
+           m_prepared_node.m_old_node == m_track_node &&
+           isIdentical(m_prepared_node.m_xyz, m_kart->getXYZ()))
+            m_track_node = m_prepared_node.m_new_node;
+        else
+            m_track_node = findTrackNode(m_kart->getXYZ(), m_track_node);
     }
+    m_prepared_node.m_valid = false;
 }   // update
 
+//-----------------------------------------------------------------------------
+/** Searches the current node in advance (see Controller::prepareUpdate).
+ *  \param ticks Number of physics time steps - should be 1.
+ */
+void AIBaseLapController::prepareUpdate(int ticks)
+{
+    m_prepared_node.m_valid = false;
+    if(!DriveGraph::get() || !m_world)
+        return;
+    btTransform trans;
+    Vec3 velocity_lc;
+    m_kart->getUpdatedTransform(&trans, &velocity_lc);
+    m_prepared_node.m_xyz      = trans.getOrigin();
+    m_prepared_node.m_old_node = m_track_node;
+    m_prepared_node.m_new_node = findTrackNode(m_prepared_node.m_xyz,
+                                               m_track_node);
+    m_prepared_node.m_valid    = true;
+}   // prepareUpdate
+
+//-----------------------------------------------------------------------------
+/** Returns the graph node the kart is on. This only reads data of this
+ *  controller and the drive graph, so it can be called in prepareUpdate().
+ *  \param xyz Position of the kart.
+ *  \param old_node The node the kart was on before.
+ */
+int AIBaseLapController::findTrackNode(const Vec3 &xyz, int old_node)
+{
+    int node = old_node;
+    if(node!=Graph::UNKNOWN_SECTOR)
+    {
+        DriveGraph::get()->findRoadSector(xyz, &node,
+            &m_all_look_aheads[node]);
+    }
+    // If we can't find a proper place on the track, to a broader search
+    // on off-track locations.
+    if(node==Graph::UNKNOWN_SECTOR)
+    {
+        node = DriveGraph::get()->findOutOfRoadSector(xyz);
+    }
+    // IF the AI is off track (or on a branch of the track it did not
+    // select to be on), keep the old position.
+    if(node==Graph::UNKNOWN_SECTOR || m_next_node_index[node]==-1)
+        node = old_node;
+    return node;
+}   // findTrackNode
+
 //-----------------------------------------------------------------------------
 /** Returns the next sector of the given sector index. This is used
  *  for branches in the quad graph to select which way the AI kart should
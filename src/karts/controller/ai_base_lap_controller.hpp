@@ -19,11 +19,11 @@
 #define HEADER_AI_BASE_LAP_CONTROLLER_HPP
 
 #include "karts/controller/ai_base_controller.hpp"
+#include "utils/vec3.hpp"
 
 class AIProperties;
 class LinearWorld;
 class Track;
-class Vec3;
 
 /** A base class for all AI karts. This class basically provides some
  *  common low level functions.
@@ -31,6 +31,20 @@ class Vec3;
  */
 class AIBaseLapController : public AIBaseController
 {
+private:
+    /** The search for the current node done in advance by prepareUpdate(),
+     *  together with the kart position and old node it was done for. */
+    struct PreparedTrackNode
+    {
+        Vec3 m_xyz;
+        int  m_old_node;
+        int  m_new_node;
+        bool m_valid;
+    };
+    PreparedTrackNode m_prepared_node;
+
+    int      findTrackNode(const Vec3 &xyz, int old_node);
+
 protected:
     /** The current node the kart is on. This can be different from the value
      *  in LinearWorld, since it takes the chosen path of the AI into account
@@ -54,6 +68,7 @@ protected:
     std::vector<std::vector<int> > m_all_look_aheads;
 
     virtual void update(int ticks);
+    virtual void prepareUpdate(int ticks);
     virtual unsigned int getNextSector(unsigned int index);
     virtual void  newLap(int lap);
     //virtual void setControllerName(const std::string &name);
@@ -62,6 +62,14 @@ public:
     virtual      ~Controller         () {};
     virtual void  reset              () = 0;
     virtual void  update             (int ticks) = 0;
+    // ------------------------------------------------------------------------
+    /** Called before the karts are updated, for all karts in parallel. A
+     *  controller can compute data here which only depends on the state its
+     *  kart will have in update(), and use it there if the kart is still in
+     *  exactly that state. It must not modify anything except its own data.
+     *  \param ticks Number of physics time steps - should be 1. */
+    virtual void  prepareUpdate      (int ticks) {}
+    // ------------------------------------------------------------------------
     virtual void  handleZipper       (bool play_sound) = 0;
     virtual void  collectedItem      (const ItemState &item,
                                       float previous_energy=0) = 0;
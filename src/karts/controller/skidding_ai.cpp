@@ -176,6 +176,7 @@ void SkiddingAI::reset()
     m_skid_probability_state     = SKID_PROBAB_NOT_YET;
     m_last_item_random           = NULL;
     m_burster                    = false;
+    m_prepared.m_valid           = false;
 
     AIBaseLapController::reset();
     m_track_node               = Graph::UNKNOWN_SECTOR;
@@ -214,6 +215,17 @@ unsigned int SkiddingAI::getNextSector(unsigned int index)
     return m_successor_index[index];
 }   // getNextSector
 
+//-----------------------------------------------------------------------------
+/** A new path might be selected on a new lap, so the data computed in
+ *  prepareUpdate() for the old path can not be used anymore.
+ *  \param lap The lap that was started.
+ */
+void SkiddingAI::newLap(int lap)
+{
+    AIBaseLapController::newLap(lap);
+    m_prepared.m_valid = false;
+}   // newLap
+
 //-----------------------------------------------------------------------------
 /** This is the main entry point for the AI.
  *  It is called once per frame for each AI and determines the behaviour of
@@ -460,13 +472,14 @@ void SkiddingAI::handleSteering(float dt)
         Vec3 aim_point;
         int last_node = Graph::UNKNOWN_SECTOR;
 
-        switch(m_point_selection_algorithm)
+        if(isPreparedFor(m_kart->getXYZ()))
         {
-        case PSA_NEW:    findNonCrashingPointNew(&aim_point, &last_node);
-                         break;
-        case PSA_DEFAULT:findNonCrashingPoint(&aim_point, &last_node);
-                         break;
+            aim_point = m_prepared.m_aim_point;
+            last_node = m_prepared.m_aim_node;
         }
+        else
+            findAimPoint(m_kart->getXYZ(), m_track_node, &aim_point,
+                         &last_node);
 #ifdef AI_DEBUG
         m_debug_sphere[m_point_selection_algorithm]->setPosition(aim_point.toIrrVector());
 #endif
@@ -2436,12 +2449,7 @@ int SkiddingAI::computeSkill(SkillType type)
 //-----------------------------------------------------------------------------
 void SkiddingAI::checkCrashes(const Vec3& pos )
 {
-    int steps = int( m_kart->getVelocityLC().getZ() / m_kart_length );
-    if( steps < 2 ) steps = 2;
-
-    // The AI drives significantly better with more steps, so for now
-    // add 5 additional steps.
-    steps+=5;
+    int steps = getCrashSteps(m_kart->getVelocityLC().getZ());
 
     //Right now there are 2 kind of 'crashes': with other karts and another
     //with the track. The sight line is used to find if the karts crash with
@@ -2477,7 +2485,6 @@ void SkiddingAI::checkCrashes(const Vec3& pos )
     // Time it takes to drive for m_kart_length units.
     float dt = m_kart_length / speed;
 
-    int current_node = m_track_node;
     if(steps<1 || steps>1000)
     {
         Log::warn(getControllerName().c_str(),
@@ -2485,32 +2492,84 @@ void SkiddingAI::checkCrashes(const Vec3& pos )
                   steps, m_kart_length, m_kart->getVelocityLC().getZ());
         steps=1000;
     }
-    for(int i = 1; steps > i; ++i)
+
+    // The crash with the drivelines only depends on this kart, so it was
+    // usually determined in prepareUpdate() already. Karts are only tested
+    // till the kart would leave the road.
+    int road_crash_step;
+    if(isPreparedFor(pos) &&
+       isIdentical(m_prepared.m_velocity, m_kart->getVelocity()) &&
+       m_prepared.m_crash_steps == steps)
+        road_crash_step = m_prepared.m_road_crash_step;
+    else
+        road_crash_step = findRoadCrashStep(pos, m_kart->getVelocity(),
+                                            steps, m_track_node);
+    if(road_crash_step > 0)
+    {
+        m_crashes.m_road = true;
+        steps = road_crash_step + 1;
+    }
+
+    for(int i = 1; steps > i && m_crashes.m_kart == -1; ++i)
     {
         Vec3 step_coord = pos + vel_normal* m_kart_length * float(i);
 
         /* Find if we crash with any kart, as long as we haven't found one
          * yet
          */
-        if( m_crashes.m_kart == -1 )
-        {
-            for( unsigned int j = 0; j < NUM_KARTS; ++j )
-            {
-                const AbstractKart* kart = m_world->getKart(j);
-                // Ignore eliminated karts
-                if(kart==m_kart||kart->isEliminated()||kart->isGhostKart()) continue;
-                const AbstractKart *other_kart = m_world->getKart(j);
-                // Ignore karts ahead that are faster than this kart.
-                if(m_kart->getVelocityLC().getZ() < other_kart->getVelocityLC().getZ())
-                    continue;
-                Vec3 other_kart_xyz = other_kart->getXYZ()
-                                    + other_kart->getVelocity()*(i*dt);
-                float kart_distance = (step_coord - other_kart_xyz).length();
-
-                if( kart_distance < m_kart_length)
-                    m_crashes.m_kart = j;
-            }
+        for( unsigned int j = 0; j < NUM_KARTS; ++j )
+        {
+            const AbstractKart* kart = m_world->getKart(j);
+            // Ignore eliminated karts
+            if(kart==m_kart||kart->isEliminated()||kart->isGhostKart()) continue;
+            const AbstractKart *other_kart = m_world->getKart(j);
+            // Ignore karts ahead that are faster than this kart.
+            if(m_kart->getVelocityLC().getZ() < other_kart->getVelocityLC().getZ())
+                continue;
+            Vec3 other_kart_xyz = other_kart->getXYZ()
+                                + other_kart->getVelocity()*(i*dt);
+            float kart_distance = (step_coord - other_kart_xyz).length();
+
+            if( kart_distance < m_kart_length)
+                m_crashes.m_kart = j;
         }
+    }
+}   // checkCrashes
+
+//-----------------------------------------------------------------------------
+/** Returns the number of steps (of one kart length each) for which
+ *  checkCrashes() tests for crashes.
+ *  \param forward_speed Speed of the kart in its forward direction.
+ */
+int SkiddingAI::getCrashSteps(float forward_speed) const
+{
+    int steps = int( forward_speed / m_kart_length );
+    if( steps < 2 ) steps = 2;
+
+    // The AI drives significantly better with more steps, so for now
+    // add 5 additional steps.
+    return steps + 5;
+}   // getCrashSteps
+
+//-----------------------------------------------------------------------------
+/** Tests if the kart would get off the drivelines when driving straight on
+ *  for the given number of steps. This only reads data of this controller
+ *  and the drive graph, so it can be called in prepareUpdate().
+ *  \param pos Position of the kart.
+ *  \param velocity Velocity of the kart, must not be zero.
+ *  \param steps Number of steps to test.
+ *  \param track_node The graph node the kart is on.
+ *  \return The first step at which the kart is off the drivelines, or 0
+ *          if it stays on them.
+ */
+int SkiddingAI::findRoadCrashStep(const Vec3 &pos, const Vec3 &velocity,
+                                  int steps, int track_node)
+{
+    Vec3 vel_normal = velocity.normalized();
+    int current_node = track_node;
+    for(int i = 1; steps > i; ++i)
+    {
+        Vec3 step_coord = pos + vel_normal* m_kart_length * float(i);
 
         /*Find if we crash with the drivelines*/
         if(current_node!=Graph::UNKNOWN_SECTOR &&
@@ -2519,12 +2578,80 @@ void SkiddingAI::checkCrashes(const Vec3& pos )
                         /* sectors to test*/ &m_all_look_aheads[current_node]);
 
         if( current_node == Graph::UNKNOWN_SECTOR)
-        {
-            m_crashes.m_road = true;
-            return;
-        }
+            return i;
     }
-}   // checkCrashes
+    return 0;
+}   // findRoadCrashStep
+
+//-----------------------------------------------------------------------------
+/** Does the parts of update() which only depend on the state of this kart
+ *  in advance (see Controller::prepareUpdate): the test for crashes with
+ *  the drivelines and the selection of the point to aim at.
+ *  \param ticks Number of physics time steps - should be 1.
+ */
+void SkiddingAI::prepareUpdate(int ticks)
+{
+    AIBaseLapController::prepareUpdate(ticks);
+    m_prepared.m_valid = false;
+    // The debug output of the point selection is not thread safe
+#if !defined(AI_DEBUG) && !defined(AI_DEBUG_KART_HEADING)
+    if(m_kart->getKartAnimation() || m_world->isStartPhase() ||
+       m_track_node == Graph::UNKNOWN_SECTOR)
+        return;
+
+    btTransform trans;
+    Vec3 velocity_lc;
+    m_kart->getUpdatedTransform(&trans, &velocity_lc);
+    m_prepared.m_xyz         = trans.getOrigin();
+    m_prepared.m_velocity    = m_kart->getVelocity();
+    m_prepared.m_track_node  = m_track_node;
+    m_prepared.m_crash_steps = getCrashSteps(velocity_lc.getZ());
+    if(m_prepared.m_crash_steps<1 || m_prepared.m_crash_steps>1000)
+        m_prepared.m_crash_steps = 1000;
+    m_prepared.m_road_crash_step = 0;
+    if(m_prepared.m_velocity.length() != 0)
+    {
+        m_prepared.m_road_crash_step =
+            findRoadCrashStep(m_prepared.m_xyz, m_prepared.m_velocity,
+                              m_prepared.m_crash_steps, m_track_node);
+    }
+    findAimPoint(m_prepared.m_xyz, m_track_node, &m_prepared.m_aim_point,
+                 &m_prepared.m_aim_node);
+    m_prepared.m_valid = true;
+#endif
+}   // prepareUpdate
+
+//-----------------------------------------------------------------------------
+/** Returns true if the data computed in prepareUpdate() can be used, i.e.
+ *  the kart is at the same position and on the same graph node.
+ *  \param xyz The current position of the kart.
+ */
+bool SkiddingAI::isPreparedFor(const Vec3 &xyz) const
+{
+    return m_prepared.m_valid && m_prepared.m_track_node == m_track_node &&
+           isIdentical(m_prepared.m_xyz, xyz);
+}   // isPreparedFor
+
+//-----------------------------------------------------------------------------
+/** Selects the point to aim at with the selected point selection algorithm.
+ *  \param xyz Position of the kart.
+ *  \param track_node The graph node the kart is on.
+ *  \param result On exit contains the point the AI should aim at.
+ *  \param last_node On exit contains the graph node the AI is aiming at.
+ */
+void SkiddingAI::findAimPoint(const Vec3 &xyz, int track_node, Vec3 *result,
+                              int *last_node)
+{
+    switch(m_point_selection_algorithm)
+    {
+    case PSA_NEW:    findNonCrashingPointNew(xyz, track_node, result,
+                                             last_node);
+                     break;
+    case PSA_DEFAULT:findNonCrashingPoint(xyz, track_node, result,
+                                          last_node);
+                     break;
+    }
+}   // findAimPoint
 
 //-----------------------------------------------------------------------------
 /** This is a new version of findNonCrashingPoint, which at this stage is
@@ -2557,14 +2684,17 @@ void SkiddingAI::checkCrashes(const Vec3& pos )
  *  a left turn, the kart will aim to the left point (and vice versa for
  *  right turn) - slightly offset by the width of the kart to avoid that
  *  the kart is getting off track.
+ *  \param xyz Position of the kart.
+ *  \param track_node The graph node the kart is on.
  *  \param aim_position The point to aim for, i.e. the point that can be
  *         driven to in a straight line.
  *  \param last_node The graph node index in which the aim_position is.
 */
-void SkiddingAI::findNonCrashingPointNew(Vec3 *result, int *last_node)
+void SkiddingAI::findNonCrashingPointNew(const Vec3 &xyz, int track_node,
+                                         Vec3 *result, int *last_node)
 {
-    *last_node = m_next_node_index[m_track_node];
-    const core::vector2df xz = m_kart->getXYZ().toIrrVector2d();
+    *last_node = m_next_node_index[track_node];
+    const core::vector2df xz = xyz.toIrrVector2d();
 
     const DriveNode* dn = DriveGraph::get()->getNode(*last_node);
 
@@ -2577,18 +2707,18 @@ void SkiddingAI::findNonCrashingPointNew(Vec3 *result, int *last_node)
 #if defined(AI_DEBUG) && defined(AI_DEBUG_NEW_FIND_NON_CRASHING)
     const Vec3 eps1(0,0.5f,0);
     m_curve[CURVE_LEFT]->clear();
-    m_curve[CURVE_LEFT]->addPoint(m_kart->getXYZ()+eps1);
+    m_curve[CURVE_LEFT]->addPoint(xyz+eps1);
     m_curve[CURVE_LEFT]->addPoint((*dn)[LEFT_END_POINT]+eps1);
-    m_curve[CURVE_LEFT]->addPoint(m_kart->getXYZ()+eps1);
+    m_curve[CURVE_LEFT]->addPoint(xyz+eps1);
     m_curve[CURVE_RIGHT]->clear();
-    m_curve[CURVE_RIGHT]->addPoint(m_kart->getXYZ()+eps1);
+    m_curve[CURVE_RIGHT]->addPoint(xyz+eps1);
     m_curve[CURVE_RIGHT]->addPoint((*dn)[RIGHT_END_POINT]+eps1);
-    m_curve[CURVE_RIGHT]->addPoint(m_kart->getXYZ()+eps1);
+    m_curve[CURVE_RIGHT]->addPoint(xyz+eps1);
 #endif
 #if defined(AI_DEBUG_KART_HEADING) || defined(AI_DEBUG_NEW_FIND_NON_CRASHING)
     const Vec3 eps(0,0.5f,0);
     m_curve[CURVE_KART]->clear();
-    m_curve[CURVE_KART]->addPoint(m_kart->getXYZ()+eps);
+    m_curve[CURVE_KART]->addPoint(xyz+eps);
     Vec3 forw(0, 0, 50);
     m_curve[CURVE_KART]->addPoint(m_kart->getTrans()(forw)+eps);
 #endif
@@ -2607,9 +2737,9 @@ void SkiddingAI::findNonCrashingPointNew(Vec3 *result, int *last_node)
                 break;
             left.end = p;
 #if defined(AI_DEBUG) && defined(AI_DEBUG_NEW_FIND_NON_CRASHING)
-            Vec3 ppp(p.X, m_kart->getXYZ().getY(), p.Y);
+            Vec3 ppp(p.X, xyz.getY(), p.Y);
             m_curve[CURVE_LEFT]->addPoint(ppp+eps);
-            m_curve[CURVE_LEFT]->addPoint(m_kart->getXYZ()+eps);
+            m_curve[CURVE_LEFT]->addPoint(xyz+eps);
 #endif
         }
         else
@@ -2626,9 +2756,9 @@ void SkiddingAI::findNonCrashingPointNew(Vec3 *result, int *last_node)
                 break;
 #if defined(AI_DEBUG) && defined(AI_DEBUG_NEW_FIND_NON_CRASHING)
 
-            Vec3 ppp(p.X, m_kart->getXYZ().getY(), p.Y);
+            Vec3 ppp(p.X, xyz.getY(), p.Y);
             m_curve[CURVE_RIGHT]->addPoint(ppp+eps);
-            m_curve[CURVE_RIGHT]->addPoint(m_kart->getXYZ()+eps);
+            m_curve[CURVE_RIGHT]->addPoint(xyz+eps);
 #endif
             right.end = p;
         }
@@ -2669,21 +2799,24 @@ void SkiddingAI::findNonCrashingPointNew(Vec3 *result, int *last_node)
  *  which takes some time - so it is actually mostly on track.
  *  Since this algoritm (so far) ends up with by far the best AI behaviour,
  *  it is for now the default).
+ *  \param xyz Position of the kart.
+ *  \param track_node The graph node the kart is on.
  *  \param aim_position On exit contains the point the AI should aim at.
  *  \param last_node On exit contais the graph node the AI is aiming at.
 */
- void SkiddingAI::findNonCrashingPoint(Vec3 *aim_position, int *last_node)
+ void SkiddingAI::findNonCrashingPoint(const Vec3 &xyz, int track_node,
+                                      Vec3 *aim_position, int *last_node)
 {
 #ifdef AI_DEBUG_KART_HEADING
     const Vec3 eps(0,0.5f,0);
     m_curve[CURVE_KART]->clear();
-    m_curve[CURVE_KART]->addPoint(m_kart->getXYZ()+eps);
+    m_curve[CURVE_KART]->addPoint(xyz+eps);
     Vec3 forw(0, 0, 50);
     m_curve[CURVE_KART]->addPoint(m_kart->getTrans()(forw)+eps);
 #endif
-    *last_node = m_next_node_index[m_track_node];
-    float angle = DriveGraph::get()->getAngleToNext(m_track_node,
-                                              m_successor_index[m_track_node]);
+    *last_node = m_next_node_index[track_node];
+    float angle = DriveGraph::get()->getAngleToNext(track_node,
+                                              m_successor_index[track_node]);
 
     Vec3 direction;
     Vec3 step_track_coord;
@@ -2711,7 +2844,7 @@ void SkiddingAI::findNonCrashingPointNew(Vec3 *result, int *last_node)
 
         //direction is a vector from our kart to the sectors we are testing
         direction = DriveGraph::get()->getNode(target_sector)->getCenter()
-                  - m_kart->getXYZ();
+                  - xyz;
 
         float len=direction.length();
         unsigned int steps = (unsigned int)( len / m_kart_length );
@@ -2731,7 +2864,7 @@ void SkiddingAI::findNonCrashingPointNew(Vec3 *result, int *last_node)
         //Test if we crash if we drive towards the target sector
         for(unsigned int i = 2; i < steps; ++i )
         {
-            step_coord = m_kart->getXYZ()+direction*m_kart_length * float(i);
+            step_coord = xyz+direction*m_kart_length * float(i);
 
             DriveGraph::get()->spatialToTrack(&step_track_coord, step_coord,
                                              *last_node );
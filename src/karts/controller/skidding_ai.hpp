@@ -234,6 +234,24 @@ private:
     enum {PSA_DEFAULT, PSA_NEW}
           m_point_selection_algorithm;
 
+    /** The parts of update() which only depend on the state of this kart,
+     *  computed in advance by prepareUpdate(), and the state they were
+     *  computed for. They are only used if the kart is in exactly this state
+     *  in update(), so the AI behaves the same as without prepareUpdate(). */
+    struct PreparedUpdate
+    {
+        Vec3 m_xyz;
+        Vec3 m_velocity;
+        int  m_track_node;
+        int  m_crash_steps;
+        /** Result of findRoadCrashStep(). */
+        int  m_road_crash_step;
+        /** Result of findAimPoint(). */
+        Vec3 m_aim_point;
+        int  m_aim_node;
+        bool m_valid;
+    } m_prepared;
+
 #ifdef AI_DEBUG
     /** For skidding debugging: shows the estimated turn shape. */
     ShowCurve **m_curve;
@@ -285,8 +303,16 @@ private:
                         std::vector<const ItemState *> *items_to_collect);
 
     void  checkCrashes(const Vec3& pos);
-    void  findNonCrashingPointNew(Vec3 *result, int *last_node);
-    void  findNonCrashingPoint(Vec3 *result, int *last_node);
+    int   getCrashSteps(float forward_speed) const;
+    int   findRoadCrashStep(const Vec3 &pos, const Vec3 &velocity, int steps,
+                            int track_node);
+    bool  isPreparedFor(const Vec3 &xyz) const;
+    void  findAimPoint(const Vec3 &xyz, int track_node, Vec3 *result,
+                       int *last_node);
+    void  findNonCrashingPointNew(const Vec3 &xyz, int track_node,
+                                  Vec3 *result, int *last_node);
+    void  findNonCrashingPoint(const Vec3 &xyz, int track_node,
+                               Vec3 *result, int *last_node);
 
     void  determineTrackDirection();
     virtual bool canSkid(float steer_fraction);
@@ -300,7 +326,9 @@ public:
                  SkiddingAI(AbstractKart *kart);
                 ~SkiddingAI();
     virtual void update      (int ticks);
+    virtual void prepareUpdate(int ticks);
     virtual void reset       ();
+    virtual void newLap      (int lap);
     virtual const irr::core::stringw& getNamePostfix() const;
 };
 
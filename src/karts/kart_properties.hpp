@@ -33,13 +33,13 @@ using namespace irr;
 
 #include "audio/sfx_manager.hpp"
 #include "io/xml_node.hpp"
+#include "karts/cached_characteristic.hpp"
 #include "race/race_manager.hpp"
 #include "utils/interpolation_array.hpp"
 #include "utils/vec3.hpp"
 
 class AbstractCharacteristic;
 class AIProperties;
-class CachedCharacteristic;
 class CombinedCharacteristic;
 class KartModel;
 class Material;
@@ -371,137 +371,252 @@ public:
     // To update the code, use tools/update_characteristics.py
     /* <characteristics-start kpdefs> */
 
-    float getSuspensionStiffness() const;
-    float getSuspensionRest() const;
-    float getSuspensionTravel() const;
-    bool getSuspensionExpSpringResponse() const;
-    float getSuspensionMaxForce() const;
-
-    float getStabilityRollInfluence() const;
-    float getStabilityChassisLinearDamping() const;
-    float getStabilityChassisAngularDamping() const;
-    float getStabilityDownwardImpulseFactor() const;
-    float getStabilityTrackConnectionAccel() const;
-    std::vector<float> getStabilityAngularFactor() const;
-    float getStabilitySmoothFlyingImpulse() const;
-
-    InterpolationArray getTurnRadius() const;
-    float getTurnTimeResetSteer() const;
-    InterpolationArray getTurnTimeFullSteer() const;
-
-    float getEnginePower() const;
-    float getEngineMaxSpeed() const;
-    float getEngineGenericMaxSpeed() const;
-    float getEngineBrakeFactor() const;
-    float getEngineBrakeTimeIncrease() const;
-    float getEngineMaxSpeedReverseRatio() const;
-
-    std::vector<float> getGearSwitchRatio() const;
-    std::vector<float> getGearPowerIncrease() const;
-
-    float getMass() const;
-
-    float getWheelsDampingRelaxation() const;
-    float getWheelsDampingCompression() const;
-
-    float getCameraDistance() const;
-    float getCameraForwardUpAngle() const;
-    float getCameraBackwardUpAngle() const;
-
-    float getJumpAnimationTime() const;
-
-    float getLeanMax() const;
-    float getLeanSpeed() const;
-
-    float getAnvilDuration() const;
-    float getAnvilWeight() const;
-    float getAnvilSpeedFactor() const;
-
-    float getParachuteFriction() const;
-    int   getParachuteDuration() const;
-    int   getParachuteDurationOther() const;
-    float getParachuteDurationRankMult() const;
-    float getParachuteDurationSpeedMult() const;
-    float getParachuteLboundFraction() const;
-    float getParachuteUboundFraction() const;
-    float getParachuteMaxSpeed() const;
-
-    float getFrictionKartFriction() const;
-
-    float getBubblegumDuration() const;
-    float getBubblegumSpeedFraction() const;
-    float getBubblegumTorque() const;
-    int   getBubblegumFadeInTicks() const;
-    float getBubblegumShieldDuration() const;
-
-    float getZipperDuration() const;
-    float getZipperForce() const;
-    float getZipperSpeedGain() const;
-    float getZipperMaxSpeedIncrease() const;
-    float getZipperFadeOutTime() const;
-
-    float getSwatterDuration() const;
-    float getSwatterDistance() const;
-    float getSwatterSquashDuration() const;
-    float getSwatterSquashSlowdown() const;
-
-    float getPlungerBandMaxLength() const;
-    float getPlungerBandForce() const;
-    float getPlungerBandDuration() const;
-    float getPlungerBandSpeedIncrease() const;
-    int   getPlungerBandFadeOutTicks() const;
-    float getPlungerInFaceTime() const;
-
-    std::vector<float> getStartupTime() const;
-    std::vector<float> getStartupBoost() const;
-
-    float getRescueDuration() const;
-    float getRescueVertOffset() const;
-    float getRescueHeight() const;
-
-    float getExplosionDuration() const;
-    float getExplosionRadius() const;
-    float getExplosionInvulnerabilityTime() const;
-
-    float getNitroDuration() const;
-    float getNitroEngineForce() const;
-    float getNitroEngineMult() const;
-    float getNitroConsumption() const;
-    float getNitroSmallContainer() const;
-    float getNitroBigContainer() const;
-    float getNitroMaxSpeedIncrease() const;
-    float getNitroFadeOutTime() const;
-    float getNitroMax() const;
-    float getSlipstreamDurationFactor() const;
-    float getSlipstreamBaseSpeed() const;
-    float getSlipstreamLength() const;
-    float getSlipstreamWidth() const;
-    float getSlipstreamInnerFactor() const;
-    float getSlipstreamMinCollectTime() const;
-    float getSlipstreamMaxCollectTime() const;
-    float getSlipstreamAddPower() const;
-    float getSlipstreamMinSpeed() const;
-    float getSlipstreamMaxSpeedIncrease() const;
-    int getSlipstreamFadeOutTicks() const;
-
-    float getSkidIncrease() const;
-    float getSkidDecrease() const;
-    float getSkidMax() const;
-    float getSkidTimeTillMax() const;
-    float getSkidVisual() const;
-    float getSkidVisualTime() const;
-    float getSkidRevertVisualTime() const;
-    float getSkidMinSpeed() const;
-    std::vector<float> getSkidTimeTillBonus() const;
-    std::vector<float> getSkidBonusSpeed() const;
-    std::vector<float> getSkidBonusTime() const;
-    std::vector<float> getSkidBonusForce() const;
-    float getSkidPhysicalJumpTime() const;
-    float getSkidGraphicalJumpTime() const;
-    float getSkidPostSkidRotateFactor() const;
-    float getSkidReduceTurnMin() const;
-    float getSkidReduceTurnMax() const;
-    bool getSkidEnabled() const;
+    float getSuspensionStiffness() const
+        { return m_cached_characteristic->getSuspensionStiffness(); }
+    float getSuspensionRest() const
+        { return m_cached_characteristic->getSuspensionRest(); }
+    float getSuspensionTravel() const
+        { return m_cached_characteristic->getSuspensionTravel(); }
+    bool getSuspensionExpSpringResponse() const
+        { return m_cached_characteristic->getSuspensionExpSpringResponse(); }
+    float getSuspensionMaxForce() const
+        { return m_cached_characteristic->getSuspensionMaxForce(); }
+
+    float getStabilityRollInfluence() const
+        { return m_cached_characteristic->getStabilityRollInfluence(); }
+    float getStabilityChassisLinearDamping() const
+        { return m_cached_characteristic->getStabilityChassisLinearDamping(); }
+    float getStabilityChassisAngularDamping() const
+        { return m_cached_characteristic->getStabilityChassisAngularDamping(); }
+    float getStabilityDownwardImpulseFactor() const
+        { return m_cached_characteristic->getStabilityDownwardImpulseFactor(); }
+    float getStabilityTrackConnectionAccel() const
+        { return m_cached_characteristic->getStabilityTrackConnectionAccel(); }
+    const std::vector<float>& getStabilityAngularFactor() const
+        { return m_cached_characteristic->getStabilityAngularFactor(); }
+    float getStabilitySmoothFlyingImpulse() const
+        { return m_cached_characteristic->getStabilitySmoothFlyingImpulse(); }
+
+    const InterpolationArray& getTurnRadius() const
+        { return m_cached_characteristic->getTurnRadius(); }
+    float getTurnTimeResetSteer() const
+        { return m_cached_characteristic->getTurnTimeResetSteer(); }
+    const InterpolationArray& getTurnTimeFullSteer() const
+        { return m_cached_characteristic->getTurnTimeFullSteer(); }
+
+    float getEnginePower() const
+        { return m_cached_characteristic->getEnginePower(); }
+    float getEngineMaxSpeed() const
+        { return m_cached_characteristic->getEngineMaxSpeed(); }
+    float getEngineGenericMaxSpeed() const
+        { return m_cached_characteristic->getEngineGenericMaxSpeed(); }
+    float getEngineBrakeFactor() const
+        { return m_cached_characteristic->getEngineBrakeFactor(); }
+    float getEngineBrakeTimeIncrease() const
+        { return m_cached_characteristic->getEngineBrakeTimeIncrease(); }
+    float getEngineMaxSpeedReverseRatio() const
+        { return m_cached_characteristic->getEngineMaxSpeedReverseRatio(); }
+
+    const std::vector<float>& getGearSwitchRatio() const
+        { return m_cached_characteristic->getGearSwitchRatio(); }
+    const std::vector<float>& getGearPowerIncrease() const
+        { return m_cached_characteristic->getGearPowerIncrease(); }
+
+    float getMass() const
+        { return m_cached_characteristic->getMass(); }
+
+    float getWheelsDampingRelaxation() const
+        { return m_cached_characteristic->getWheelsDampingRelaxation(); }
+    float getWheelsDampingCompression() const
+        { return m_cached_characteristic->getWheelsDampingCompression(); }
+
+    float getCameraDistance() const
+        { return m_cached_characteristic->getCameraDistance(); }
+    float getCameraForwardUpAngle() const
+        { return m_cached_characteristic->getCameraForwardUpAngle(); }
+    float getCameraBackwardUpAngle() const
+        { return m_cached_characteristic->getCameraBackwardUpAngle(); }
+
+    float getJumpAnimationTime() const
+        { return m_cached_characteristic->getJumpAnimationTime(); }
+
+    float getLeanMax() const
+        { return m_cached_characteristic->getLeanMax(); }
+    float getLeanSpeed() const
+        { return m_cached_characteristic->getLeanSpeed(); }
+
+    float getAnvilDuration() const
+        { return m_cached_characteristic->getAnvilDuration(); }
+    float getAnvilWeight() const
+        { return m_cached_characteristic->getAnvilWeight(); }
+    float getAnvilSpeedFactor() const
+        { return m_cached_characteristic->getAnvilSpeedFactor(); }
+
+    float getParachuteFriction() const
+        { return m_cached_characteristic->getParachuteFriction(); }
+    int getParachuteDuration() const
+        { return m_cached_characteristic->getParachuteDuration(); }
+    int getParachuteDurationOther() const
+        { return m_cached_characteristic->getParachuteDurationOther(); }
+    float getParachuteDurationRankMult() const
+        { return m_cached_characteristic->getParachuteDurationRankMult(); }
+    float getParachuteDurationSpeedMult() const
+        { return m_cached_characteristic->getParachuteDurationSpeedMult(); }
+    float getParachuteLboundFraction() const
+        { return m_cached_characteristic->getParachuteLboundFraction(); }
+    float getParachuteUboundFraction() const
+        { return m_cached_characteristic->getParachuteUboundFraction(); }
+    float getParachuteMaxSpeed() const
+        { return m_cached_characteristic->getParachuteMaxSpeed(); }
+
+    float getFrictionKartFriction() const
+        { return m_cached_characteristic->getFrictionKartFriction(); }
+
+    float getBubblegumDuration() const
+        { return m_cached_characteristic->getBubblegumDuration(); }
+    float getBubblegumSpeedFraction() const
+        { return m_cached_characteristic->getBubblegumSpeedFraction(); }
+    float getBubblegumTorque() const
+        { return m_cached_characteristic->getBubblegumTorque(); }
+    int getBubblegumFadeInTicks() const
+        { return stk_config->time2Ticks(m_cached_characteristic
+                                        ->getBubblegumFadeInTime()); }
+    float getBubblegumShieldDuration() const
+        { return m_cached_characteristic->getBubblegumShieldDuration(); }
+
+    float getZipperDuration() const
+        { return m_cached_characteristic->getZipperDuration(); }
+    float getZipperForce() const
+        { return m_cached_characteristic->getZipperForce(); }
+    float getZipperSpeedGain() const
+        { return m_cached_characteristic->getZipperSpeedGain(); }
+    float getZipperMaxSpeedIncrease() const
+        { return m_cached_characteristic->getZipperMaxSpeedIncrease(); }
+    float getZipperFadeOutTime() const
+        { return m_cached_characteristic->getZipperFadeOutTime(); }
+
+    float getSwatterDuration() const
+        { return m_cached_characteristic->getSwatterDuration(); }
+    float getSwatterDistance() const
+        { return m_cached_characteristic->getSwatterDistance(); }
+    float getSwatterSquashDuration() const
+        { return m_cached_characteristic->getSwatterSquashDuration(); }
+    float getSwatterSquashSlowdown() const
+        { return m_cached_characteristic->getSwatterSquashSlowdown(); }
+
+    float getPlungerBandMaxLength() const
+        { return m_cached_characteristic->getPlungerBandMaxLength(); }
+    float getPlungerBandForce() const
+        { return m_cached_characteristic->getPlungerBandForce(); }
+    float getPlungerBandDuration() const
+        { return m_cached_characteristic->getPlungerBandDuration(); }
+    float getPlungerBandSpeedIncrease() const
+        { return m_cached_characteristic->getPlungerBandSpeedIncrease(); }
+    int getPlungerBandFadeOutTicks() const
+        { return stk_config->time2Ticks(m_cached_characteristic
+                                        ->getPlungerBandFadeOutTime()); }
+    float getPlungerInFaceTime() const
+        { return m_cached_characteristic->getPlungerInFaceTime(); }
+
+    const std::vector<float>& getStartupTime() const
+        { return m_cached_characteristic->getStartupTime(); }
+    const std::vector<float>& getStartupBoost() const
+        { return m_cached_characteristic->getStartupBoost(); }
+
+    float getRescueDuration() const
+        { return m_cached_characteristic->getRescueDuration(); }
+    float getRescueVertOffset() const
+        { return m_cached_characteristic->getRescueVertOffset(); }
+    float getRescueHeight() const
+        { return m_cached_characteristic->getRescueHeight(); }
+
+    float getExplosionDuration() const
+        { return m_cached_characteristic->getExplosionDuration(); }
+    float getExplosionRadius() const
+        { return m_cached_characteristic->getExplosionRadius(); }
+    float getExplosionInvulnerabilityTime() const
+        { return m_cached_characteristic->getExplosionInvulnerabilityTime(); }
+
+    float getNitroDuration() const
+        { return m_cached_characteristic->getNitroDuration(); }
+    float getNitroEngineForce() const
+        { return m_cached_characteristic->getNitroEngineForce(); }
+    float getNitroEngineMult() const
+        { return m_cached_characteristic->getNitroEngineMult(); }
+    float getNitroConsumption() const
+        { return m_cached_characteristic->getNitroConsumption(); }
+    float getNitroSmallContainer() const
+        { return m_cached_characteristic->getNitroSmallContainer(); }
+    float getNitroBigContainer() const
+        { return m_cached_characteristic->getNitroBigContainer(); }
+    float getNitroMaxSpeedIncrease() const
+        { return m_cached_characteristic->getNitroMaxSpeedIncrease(); }
+    float getNitroFadeOutTime() const
+        { return m_cached_characteristic->getNitroFadeOutTime(); }
+    float getNitroMax() const
+        { return m_cached_characteristic->getNitroMax(); }
+
+    float getSlipstreamDurationFactor() const
+        { return m_cached_characteristic->getSlipstreamDurationFactor(); }
+    float getSlipstreamBaseSpeed() const
+        { return m_cached_characteristic->getSlipstreamBaseSpeed(); }
+    float getSlipstreamLength() const
+        { return m_cached_characteristic->getSlipstreamLength(); }
+    float getSlipstreamWidth() const
+        { return m_cached_characteristic->getSlipstreamWidth(); }
+    float getSlipstreamInnerFactor() const
+        { return m_cached_characteristic->getSlipstreamInnerFactor(); }
+    float getSlipstreamMinCollectTime() const
+        { return m_cached_characteristic->getSlipstreamMinCollectTime(); }
+    float getSlipstreamMaxCollectTime() const
+        { return m_cached_characteristic->getSlipstreamMaxCollectTime(); }
+    float getSlipstreamAddPower() const
+        { return m_cached_characteristic->getSlipstreamAddPower(); }
+    float getSlipstreamMinSpeed() const
+        { return m_cached_characteristic->getSlipstreamMinSpeed(); }
+    float getSlipstreamMaxSpeedIncrease() const
+        { return m_cached_characteristic->getSlipstreamMaxSpeedIncrease(); }
+    int getSlipstreamFadeOutTicks() const
+        { return stk_config->time2Ticks(m_cached_characteristic
+                                        ->getSlipstreamFadeOutTime()); }
+
+    float getSkidIncrease() const
+        { return m_cached_characteristic->getSkidIncrease(); }
+    float getSkidDecrease() const
+        { return m_cached_characteristic->getSkidDecrease(); }
+    float getSkidMax() const
+        { return m_cached_characteristic->getSkidMax(); }
+    float getSkidTimeTillMax() const
+        { return m_cached_characteristic->getSkidTimeTillMax(); }
+    float getSkidVisual() const
+        { return m_cached_characteristic->getSkidVisual(); }
+    float getSkidVisualTime() const
+        { return m_cached_characteristic->getSkidVisualTime(); }
+    float getSkidRevertVisualTime() const
+        { return m_cached_characteristic->getSkidRevertVisualTime(); }
+    float getSkidMinSpeed() const
+        { return m_cached_characteristic->getSkidMinSpeed(); }
+    const std::vector<float>& getSkidTimeTillBonus() const
+        { return m_cached_characteristic->getSkidTimeTillBonus(); }
+    const std::vector<float>& getSkidBonusSpeed() const
+        { return m_cached_characteristic->getSkidBonusSpeed(); }
+    const std::vector<float>& getSkidBonusTime() const
+        { return m_cached_characteristic->getSkidBonusTime(); }
+    const std::vector<float>& getSkidBonusForce() const
+        { return m_cached_characteristic->getSkidBonusForce(); }
+    float getSkidPhysicalJumpTime() const
+        { return m_cached_characteristic->getSkidPhysicalJumpTime(); }
+    float getSkidGraphicalJumpTime() const
+        { return m_cached_characteristic->getSkidGraphicalJumpTime(); }
+    float getSkidPostSkidRotateFactor() const
+        { return m_cached_characteristic->getSkidPostSkidRotateFactor(); }
+    float getSkidReduceTurnMin() const
+        { return m_cached_characteristic->getSkidReduceTurnMin(); }
+    float getSkidReduceTurnMax() const
+        { return m_cached_characteristic->getSkidReduceTurnMax(); }
+    bool getSkidEnabled() const
+        { return m_cached_characteristic->getSkidEnabled(); }
+
     // ------------------------------------------------------------------------
     /** Returns minimum time during which nitro is consumed when pressing nitro
     *  key, to prevent using nitro in very short bursts
@@ -41,6 +41,8 @@
 #include "utils/vec3.hpp"
 
 #include <ISceneNode.h>
+#include <algorithm>
+#include <cmath>
 #include <string.h>
 
 KartRewinder::KartRewinder(const std::string& ident,
@@ -58,6 +60,8 @@ KartRewinder::KartRewinder(const std::string& ident,
 {
     m_steering_smoothing_dt = -1.0f;
     m_prev_steering = m_steering_smoothing_time = 0.0f;
+    m_saved_body_offset = m_saved_body_end = -1;
+    m_state_layout_ok = true;
 }   // KartRewinder
 
 // ----------------------------------------------------------------------------
@@ -217,13 +221,16 @@ BareNetworkString* KartRewinder::saveState(std::vector<std::string>* ru)
     // -------------------------------------------
     if (has_animation)
     {
+        m_saved_body_offset = m_saved_body_end = -1;
         buffer->addUInt8(m_kart_animation->getAnimationType());
         m_kart_animation->saveState(buffer);
     }
     else
     {
+        m_saved_body_offset = (int)buffer->getTotalSize();
         CompressNetworkBody::compress(
             m_body.get(), m_motion_state.get(), buffer);
+        m_saved_body_end = (int)buffer->getTotalSize();
 
         if (m_vehicle->getTimedRotationTicks() > 0)
         {
@@ -433,6 +440,216 @@ void KartRewinder::restoreState(BareNetworkString *buffer, int count)
 
 }   // restoreState
 
+// ----------------------------------------------------------------------------
+namespace
+{
+    /** Differences between a received and a predicted kart state which are
+     *  small enough to not need any rewind (in m, radians and m/s). */
+    const float MATCH_XYZ = 0.01f, MATCH_ROTATION = 0.005f,
+                MATCH_VELOCITY = 0.05f, MATCH_SKIDDING = 0.01f;
+    /** Larger differences up to these values are corrected in the current
+     *  state of the kart without replaying. */
+    const float CORRECT_XYZ = 0.25f, CORRECT_ROTATION = 0.05f,
+                CORRECT_VELOCITY = 0.5f;
+
+    /** Size of the compressed body in a kart state, see
+     *  CompressNetworkBody::compress. */
+    const int BODY_SIZE = 3 * 4 + 4 + 6 * 2;
+    /** Size of the two skidding floats at the end of a kart state. */
+    const int SKIDDING_FLOATS_SIZE = 2 * 4;
+
+    struct KartBodyState
+    {
+        Vec3 m_xyz;
+        btQuaternion m_rotation;
+        Vec3 m_linear_velocity;
+        Vec3 m_angular_velocity;
+        float m_skid_factor;
+        float m_visual_rotation;
+    };   // KartBodyState
+
+    // ------------------------------------------------------------------------
+    /** Returns the offset of the compressed body in a kart state saved by
+     *  KartRewinder::saveState, or -1 if the kart has an animation instead.
+     */
+    int getBodyOffset(const BareNetworkString& state)
+    {
+        // Controls and controller use 5 bytes each, followed by two bytes
+        // with flags for the optional data
+        const int flags_offset = 10;
+        if ((int)state.getTotalSize() < flags_offset + 2)
+            return -1;
+        const uint8_t flags = (uint8_t)state.getData()[flags_offset];
+        if ((flags >> 5) & 1)
+            return -1;
+        int offset = flags_offset + 2;
+        if ((flags >> 1) & 1)   // bubblegum ticks
+            offset += 2;
+        if ((flags >> 2) & 1)   // plunger ticks
+            offset += 2;
+        if ((flags >> 3) & 1)   // invulnerable ticks
+            offset += 2;
+        if ((flags >> 4) & 1)   // energy
+            offset += 4;
+        if (offset + BODY_SIZE + SKIDDING_FLOATS_SIZE >
+            (int)state.getTotalSize())
+            return -1;
+        return offset;
+    }   // getBodyOffset
+
+    // ------------------------------------------------------------------------
+    KartBodyState decodeBody(const BareNetworkString& state, int offset)
+    {
+        KartBodyState b;
+        BareNetworkString body(state.getData() + offset, BODY_SIZE);
+        b.m_xyz.setX(body.getFloat());
+        b.m_xyz.setY(body.getFloat());
+        b.m_xyz.setZ(body.getFloat());
+        b.m_rotation = MiniGLM::decompressbtQuaternion(body.getUInt32());
+        float v[6];
+        for (unsigned i = 0; i < 6; i++)
+            v[i] = MiniGLM::toFloat32(body.getUInt16());
+        b.m_linear_velocity = Vec3(v[0], v[1], v[2]);
+        b.m_angular_velocity = Vec3(v[3], v[4], v[5]);
+        BareNetworkString skidding(state.getData() + state.getTotalSize() -
+            SKIDDING_FLOATS_SIZE, SKIDDING_FLOATS_SIZE);
+        b.m_skid_factor = skidding.getFloat();
+        b.m_visual_rotation = skidding.getFloat();
+        return b;
+    }   // decodeBody
+}   // namespace
+
+// ----------------------------------------------------------------------------
+/** On a client returns the state of this kart as the server would save it
+ *  at this time.
+ */
+BareNetworkString* KartRewinder::savePredictedState()
+{
+    // Saving the state rounds the physics values like on the server
+    std::vector<std::string> ru;
+    BareNetworkString* state = saveState(&ru);
+    if (state && m_state_layout_ok && !checkStateLayout(*state))
+    {
+        Log::error("KartRewinder", "Unexpected layout of the state of kart "
+                   "%s, predicted states are compared byte by byte.",
+                   getIdent().c_str());
+        m_state_layout_ok = false;
+    }
+    return state;
+}   // savePredictedState
+
+// ----------------------------------------------------------------------------
+/** Checks that getBodyOffset() and decodeBody(), which are used to compare
+ *  predicted states, find the data of this kart in a state which was just
+ *  written by saveState(): the offsets of the compressed body must be the
+ *  ones recorded while writing, and the decoded values must be the (rounded)
+ *  values of the kart.
+ *  \param state The state just written by saveState().
+ */
+bool KartRewinder::checkStateLayout(const BareNetworkString& state)
+{
+    const int body = getBodyOffset(state);
+    if (body != m_saved_body_offset)
+        return false;
+    if (body < 0)
+        return true;
+    if (m_saved_body_end - body != BODY_SIZE)
+        return false;
+    // Compressing the body sets the body to the rounded values, and the
+    // skidding values are saved unchanged. Only the rotation is converted
+    // to a matrix and back, so it is not exactly the same.
+    KartBodyState b = decodeBody(state, body);
+    const btTransform& t = m_body->getWorldTransform();
+    return b.m_xyz == t.getOrigin() &&
+        fabsf(b.m_rotation.dot(t.getRotation())) > 0.9999f &&
+        b.m_linear_velocity == m_body->getLinearVelocity() &&
+        b.m_angular_velocity == m_body->getAngularVelocity() &&
+        b.m_skid_factor == m_skidding->getSkidFactor();
+}   // checkStateLayout
+
+// ----------------------------------------------------------------------------
+/** Compares a received kart state with the predicted one. All data must be
+ *  identical, except for the transform, velocities and skidding values,
+ *  which only need to be close. Larger errors in the transform and
+ *  velocities can be corrected by correctPredictedState().
+ */
+Rewinder::PredictionResult
+    KartRewinder::comparePredictedState(const BareNetworkString& predicted,
+                                        const BareNetworkString& received)
+{
+    const int size = (int)predicted.getTotalSize();
+    const int body = m_state_layout_ok ? getBodyOffset(predicted) : -1;
+    if (body < 0 || size != (int)received.getTotalSize())
+        return Rewinder::comparePredictedState(predicted, received);
+
+    // Identical data before the body means that the received state has
+    // the same layout
+    const int rest = body + BODY_SIZE;
+    const int skidding = size - SKIDDING_FLOATS_SIZE;
+    if (memcmp(predicted.getData(), received.getData(), body) != 0 ||
+        memcmp(predicted.getData() + rest, received.getData() + rest,
+               skidding - rest) != 0)
+        return PR_WRONG;
+
+    KartBodyState p = decodeBody(predicted, body);
+    KartBodyState r = decodeBody(received, body);
+    if (fabsf(p.m_skid_factor - r.m_skid_factor) > MATCH_SKIDDING ||
+        fabsf(p.m_visual_rotation - r.m_visual_rotation) > MATCH_SKIDDING)
+        return PR_WRONG;
+
+    const float xyz = (p.m_xyz - r.m_xyz).length();
+    const float dot = fabsf(p.m_rotation.dot(r.m_rotation));
+    const float rotation = 2.0f * acosf(std::min(dot, 1.0f));
+    const float velocity = std::max(
+        (p.m_linear_velocity - r.m_linear_velocity).length(),
+        (p.m_angular_velocity - r.m_angular_velocity).length());
+    if (xyz <= MATCH_XYZ && rotation <= MATCH_ROTATION &&
+        velocity <= MATCH_VELOCITY)
+        return PR_MATCH;
+    if (xyz <= CORRECT_XYZ && rotation <= CORRECT_ROTATION &&
+        velocity <= CORRECT_VELOCITY)
+        return PR_CORRECTABLE;
+    return PR_WRONG;
+}   // comparePredictedState
+
+// ----------------------------------------------------------------------------
+/** Adds the difference between the received and the predicted transform and
+ *  velocities to the current ones. The change is visually smoothed like
+ *  after a rewind.
+ */
+void KartRewinder::correctPredictedState(const BareNetworkString& predicted,
+                                         const BareNetworkString& received)
+{
+    const int body = getBodyOffset(predicted);
+    if (body < 0 || m_kart_animation || !m_state_layout_ok)
+        return;
+    KartBodyState p = decodeBody(predicted, body);
+    KartBodyState r = decodeBody(received, body);
+
+    Moveable::prepareSmoothing();
+    btTransform t = m_body->getWorldTransform();
+    t.setOrigin(t.getOrigin() + r.m_xyz - p.m_xyz);
+    btQuaternion rotation = r.m_rotation * p.m_rotation.inverse() *
+        t.getRotation();
+    t.setRotation(rotation.normalized());
+    Vec3 lv = m_body->getLinearVelocity() + r.m_linear_velocity -
+        p.m_linear_velocity;
+    Vec3 av = m_body->getAngularVelocity() + r.m_angular_velocity -
+        p.m_angular_velocity;
+
+    m_body->setWorldTransform(t);
+    m_motion_state->setWorldTransform(t);
+    m_body->setInterpolationWorldTransform(t);
+    m_body->setLinearVelocity(lv);
+    m_body->setAngularVelocity(av);
+    m_body->setInterpolationLinearVelocity(lv);
+    m_body->setInterpolationAngularVelocity(av);
+    m_body->updateInertiaTensor();
+    m_transform = t;
+    m_vehicle->updateAllWheelTransformsWS();
+    Moveable::checkSmoothing();
+}   // correctPredictedState
+
 // ----------------------------------------------------------------------------
 /** Called once a frame. It will add a new kart control event to the rewind
  *  manager if any control values have changed.
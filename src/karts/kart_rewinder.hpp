@@ -32,6 +32,22 @@ private:
     float m_prev_steering, m_steering_smoothing_dt, m_steering_smoothing_time;
 
     bool m_has_server_state;
+
+    /** Offset of the compressed body in the last state written by
+     *  saveState(), -1 if the kart had an animation. */
+    int m_saved_body_offset;
+
+    /** Offset of the data after the compressed body in the last state
+     *  written by saveState(). */
+    int m_saved_body_end;
+
+    /** False if a predicted state did not have the layout which
+     *  comparePredictedState() expects (i.e. one of the functions writing
+     *  the state was changed), in which case only identical predicted and
+     *  received states are accepted. */
+    bool m_state_layout_ok;
+
+    bool checkStateLayout(const BareNetworkString& state);
 public:
     KartRewinder(const std::string& ident, unsigned int world_kart_id,
                  int position, const btTransform& init_transform,
@@ -44,6 +60,14 @@ public:
         OVERRIDE;
     void reset() OVERRIDE;
     virtual void restoreState(BareNetworkString *p, int count) OVERRIDE;
+    virtual BareNetworkString* savePredictedState() OVERRIDE;
+    virtual PredictionResult comparePredictedState(
+                                        const BareNetworkString& predicted,
+                                        const BareNetworkString& received)
+        OVERRIDE;
+    virtual void correctPredictedState(const BareNetworkString& predicted,
+                                       const BareNetworkString& received)
+        OVERRIDE;
     virtual void rewindToEvent(BareNetworkString *p) OVERRIDE {}
     virtual void update(int ticks) OVERRIDE;
     // -------------------------------------------------------------------------
@@ -149,12 +149,27 @@ void Moveable::stopFlying()
  */
 void Moveable::update(int ticks)
 {
-    if(m_body->getInvMass()!=0)
-        m_motion_state->getWorldTransform(m_transform);
-    m_velocityLC = getVelocity()*m_transform.getBasis();
+    getUpdatedTransform(&m_transform, &m_velocityLC);
     updatePosition();
 }   // update
 
+//-----------------------------------------------------------------------------
+/** Computes the transform and the velocity in local coordinates which the
+ *  next call to update() will set, i.e. the result of the last physics step.
+ *  This only reads data, so it can be called from other threads while the
+ *  object is not modified.
+ *  \param trans On return the new transform.
+ *  \param velocity_lc On return the new velocity in local coordinates.
+ */
+void Moveable::getUpdatedTransform(btTransform *trans, Vec3 *velocity_lc) const
+{
+    if(m_body->getInvMass()!=0)
+        m_motion_state->getWorldTransform(*trans);
+    else
+        *trans = m_transform;
+    *velocity_lc = getVelocity()*trans->getBasis();
+}   // getUpdatedTransform
+
 //-----------------------------------------------------------------------------
 /** Updates the current position and rotation. This function is also called
  *  by ghost karts for getHeading() to work.
@@ -119,6 +119,8 @@ public:
     // ------------------------------------------------------------------------
     virtual void  reset();
     virtual void  update(int ticks) ;
+    void          getUpdatedTransform(btTransform *trans,
+                                      Vec3 *velocity_lc) const;
     btRigidBody  *getBody() const {return m_body.get(); }
     void          createBody(float mass, btTransform& trans,
                              btCollisionShape *shape,
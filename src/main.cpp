@@ -158,9 +158,11 @@
 #  endif
 #else
 #  include <signal.h>
+#  include <sys/wait.h>
 #  include <unistd.h>
 #endif
 #include <stdexcept>
+#include <cerrno>
 #include <cstdio>
 #include <string>
 #include <cstring>
@@ -193,6 +195,7 @@
 #include "graphics/referee.hpp"
 #include "graphics/sp/sp_base.hpp"
 #include "graphics/sp/sp_shader.hpp"
+#include "graphics/sp_mesh_loader.hpp"
 #include "guiengine/engine.hpp"
 #include "guiengine/event_handler.hpp"
 #include "guiengine/dialog_queue.hpp"
@@ -206,6 +209,7 @@
 #include "items/network_item_manager.hpp"
 #include "items/powerup_manager.hpp"
 #include "items/projectile_manager.hpp"
+#include "karts/cached_characteristic.hpp"
 #include "karts/combined_characteristic.hpp"
 #include "karts/controller/ai_base_lap_controller.hpp"
 #include "karts/kart_model.hpp"
@@ -213,27 +217,33 @@
 #include "karts/kart_properties_manager.hpp"
 #include "modes/cutscene_world.hpp"
 #include "modes/demo_world.hpp"
+#include "modes/linear_world.hpp"
 #include "modes/profile_world.hpp"
 #include "network/protocols/connect_to_server.hpp"
 #include "network/protocols/client_lobby.hpp"
 #include "network/protocols/server_lobby.hpp"
 #include "network/network_config.hpp"
+#include "network/network_pool.hpp"
+#include "network/packet_buffers.hpp"
 #include "network/network_string.hpp"
 #include "network/rewind_manager.hpp"
 #include "network/rewind_queue.hpp"
 #include "network/server.hpp"
 #include "network/server_config.hpp"
 #include "network/servers_manager.hpp"
+#include "network/state_delta.hpp"
 #include "network/stk_host.hpp"
 #include "network/stk_peer.hpp"
 #include "online/profile_manager.hpp"
 #include "online/request_manager.hpp"
+#include "physics/btKartRaycast.hpp"
 #include "race/grand_prix_manager.hpp"
 #include "race/highscore_manager.hpp"
 #include "race/history.hpp"
 #include "race/race_manager.hpp"
 #include "replay/replay_play.hpp"
 #include "replay/replay_recorder.hpp"
+#include "scriptengine/script_engine.hpp"
 #include "states_screens/main_menu_screen.hpp"
 #include "states_screens/online/networking_lobby.hpp"
 #include "states_screens/online/register_screen.hpp"
@@ -242,6 +252,7 @@
 #include "states_screens/dialogs/init_android_dialog.hpp"
 #include "states_screens/dialogs/message_dialog.hpp"
 #include "tracks/arena_graph.hpp"
+#include "tracks/height_map.hpp"
 #include "tracks/track.hpp"
 #include "tracks/track_manager.hpp"
 #include "utils/command_line.hpp"
@@ -253,10 +264,12 @@
 #include "utils/profiler.hpp"
 #include "utils/string_utils.hpp"
 #include "utils/translation.hpp"
+#include "utils/worker_pool.hpp"
 
 static void cleanSuperTuxKart();
 static void cleanUserConfig();
 void runUnitTests();
+void runBenchmarks();
 
 // ============================================================================
 //                        gamepad visualisation screen
@@ -581,10 +594,20 @@ void cmdLineHelp()
     "       --trackdir=DIR     A directory from which additional tracks are "
                               "loaded.\n"
     "       --seed=n           Seed for random number generation to provide reproducible behavior.\n"
+    "       --worker-threads=n Number of threads used to prepare the kart updates,\n"
+    "                          0 to do everything in the main thread.\n"
     "       --profile-laps=n   Enable automatic driven profile mode for n "
                               "laps.\n"
     "       --profile-time=n   Enable automatic driven profile mode for n "
                               "seconds.\n"
+    "       --profile-ticks=n  Simulate n physics ticks with AI karts only and "
+                              "write a JSON\n"
+    "                          report with ticks per second, peak memory and "
+                              "the time of\n"
+    "                          each profiler marker. Use with --no-graphics "
+                              "and --seed for\n"
+    "                          reproducible results.\n"
+    "       --profile-json=f   File name for the --profile-ticks report.\n"
     "       --unlock-all       Permanently unlock all karts and tracks for testing.\n"
     "       --no-unlock-all    Disable unlock-all (i.e. base unlocking on player achievement).\n"
     "       --no-graphics      Do not display the actual race.\n"
@@ -602,6 +625,8 @@ void cmdLineHelp()
     // "    --disable-item-collection Disable item collection. Useful for\n"
     // "                          debugging client/server item management.\n"
     // "    --network-item-debugging Print item handling debug information.\n"
+    // "    --no-incremental-rewind Always rewind when a state is received,\n"
+    // "                          even if it matches the client prediction.\n"
     "       --server-config=file Specify the server_config.xml for server hosting, it will create\n"
     "                            one if not found.\n"
     "       --network-console  Enable network console.\n"
@@ -620,6 +645,8 @@ void cmdLineHelp()
     "       --init-user        Save the above login and password (if set) in config.\n"
     "       --disable-polling  Don't poll for logged in user.\n"
     "       --port=n           Port number to use.\n"
+    "       --lobbies=n        Number of lobbies hosted by this server, each in its\n"
+    "                          own process sharing the loaded assets (not on Windows).\n"
     "       --auto-connect     Automatically connect to fist server and start race\n"
     "       --max-players=n    Maximum number of clients (server only).\n"
     "       --min-players=n    Minimum number of clients for owner less server(server only).\n"
@@ -646,6 +673,11 @@ void cmdLineHelp()
     "       --log=N            Set the verbosity to a value between\n"
     "                          0 (Debug) and 5 (Only Fatal messages)\n"
     "       --logbuffer=N      Buffers up to N lines log lines before writing.\n"
+    "       --log-async        Write log messages in a separate thread.\n"
+    "       --log-rotate-size=N Rotate the log file once it is bigger than N MB\n"
+    "                          (only with --log-async).\n"
+    "       --log-rotate-hours=N Rotate the log file every N hours\n"
+    "                          (only with --log-async).\n"
     "       --root=DIR         Path to add to the list of STK root directories.\n"
     "                          You can specify more than one by separating them\n"
     "                          with colons (:).\n"
@@ -727,6 +759,16 @@ int handleCmdLineOutputModifier()
         Log::setLogLevel(n);
     if (CommandLine::has("--logbuffer", &n))
         Log::setBufferSize(n);
+    // --log-async is only handled after forking the server lobbies, since
+    // the writer thread would not exist in the lobby processes
+    int rotate_size = 0, rotate_hours = 0;
+    CommandLine::has("--log-rotate-size", &rotate_size);
+    CommandLine::has("--log-rotate-hours", &rotate_hours);
+    if (rotate_size > 0 || rotate_hours > 0)
+    {
+        Log::setRotation((size_t)std::max(rotate_size, 0) * 1024 * 1024,
+                         std::max(rotate_hours, 0) * 3600);
+    }
 
     if(CommandLine::has("--log=nocolor"))
     {
@@ -938,9 +980,18 @@ int handleCmdLinePreliminary()
         Log::info("main", "STK using random seed (%d)", n);
     }
 
+    if (CommandLine::has("--worker-threads", &n))
+        WorkerPool::setNumThreads(std::max(n, 0));
+
     return 0;
 }   // handleCmdLinePreliminary
 
+// ============================================================================
+/** Index of the lobby hosted by this process (see forkServerLobbies()), 0 if
+ *  the server hosts only one lobby. Each lobby uses the server port plus
+ *  this index. */
+static int g_lobby_index = 0;
+
 // ============================================================================
 /** Handles command line options.
  *  \param argc Number of command line options
@@ -955,6 +1006,8 @@ int handleCmdLine(bool has_server_config, bool has_parent_process)
 
     if (CommandLine::has("--unit-testing"))
         UserConfigParams::m_unit_testing = true;
+    if (CommandLine::has("--benchmark", &s))
+        UserConfigParams::m_benchmark = s;
     if (CommandLine::has("--gamepad-debug"))
         UserConfigParams::m_gamepad_debug=true;
     if (CommandLine::has("--keyboard-debug"))
@@ -1207,6 +1260,9 @@ int handleCmdLine(bool has_server_config, bool has_parent_process)
 
     if (CommandLine::has("--network-item-debugging"))
         NetworkItemManager::m_network_item_debugging = true;
+
+    if (CommandLine::has("--no-incremental-rewind"))
+        RewindManager::setIncrementalRewind(false);
     
     std::string server_password;
     if (CommandLine::has("--server-password", &s))
@@ -1292,7 +1348,9 @@ int handleCmdLine(bool has_server_config, bool has_parent_process)
         // We don't know if this instance is going to be a client
         // or server, so just set both ports, only one will be used anyway
         NetworkConfig::get()->setClientPort(n);
-        ServerConfig::m_server_port = n;
+        // This is only parsed after the lobby processes are created, so
+        // the port of this lobby must be set here (0 means automatic)
+        ServerConfig::m_server_port = n == 0 ? 0 : n + g_lobby_index;
     }
     if (CommandLine::has("--public-server"))
     {
@@ -1578,6 +1636,21 @@ int handleCmdLine(bool has_server_config, bool has_parent_process)
         race_manager->setNumLaps(999999); // profile end depends on time
     }   // --profile-time
 
+    if(CommandLine::has("--profile-ticks",  &n))
+    {
+        if (n <= 0)
+        {
+            Log::error("main", "Invalid number of profile-ticks: %i.", n);
+            return 0;
+        }
+        std::string json_file;
+        CommandLine::has("--profile-json", &json_file);
+        Log::verbose("main", "Profiling %d ticks.", n);
+        UserConfigParams::m_no_start_screen = true;
+        ProfileWorld::setProfileModeTicks(n, json_file);
+        race_manager->setNumLaps(999999); // profile end depends on ticks
+    }   // --profile-ticks
+
     if(CommandLine::has("--history"))
     {
         history->setReplayHistory(true);
@@ -1680,6 +1753,110 @@ void clearGlobalVariables()
 #endif
 }   // clearGlobalVariables
 
+//=============================================================================
+/** Returns true if this server hosts more than one lobby, in which case
+ *  forkServerLobbies() creates one process for each lobby.
+ */
+static bool hostsMultipleLobbies()
+{
+#ifdef WIN32
+    return false;
+#else
+    return NetworkConfig::get()->isServer() && ServerConfig::m_lobby_count > 1;
+#endif
+}   // hostsMultipleLobbies
+
+//=============================================================================
+#ifndef WIN32
+/** Process ids of the lobby processes, used by the parent process to forward
+ *  termination signals. */
+static std::vector<pid_t> g_lobby_pids;
+
+/** Creates one child process for each lobby of a server. This is done after
+ *  the karts, item models and the list of tracks are loaded, so all lobbies
+ *  share them (copy on write) instead of loading them once per lobby. The
+ *  track of a race is only loaded when the race starts, so each lobby loads
+ *  its own track meshes, collision shapes and graphs. Each lobby has its own
+ *  world, physics and network state, and uses the server port plus its
+ *  index (unless the port is chosen automatically) and its index appended to
+ *  the server name. This function only returns in the lobby processes, the
+ *  parent process waits for all lobbies to finish and then exits.
+ *  \return The index of the lobby of this process.
+ */
+static int forkServerLobbies()
+{
+    const int count = ServerConfig::m_lobby_count;
+    const int port = ServerConfig::m_server_port;
+    const std::string name = ServerConfig::m_server_name;
+    for (int i = 0; i < count; i++)
+    {
+        pid_t pid = fork();
+        if (pid < 0)
+        {
+            Log::error("main", "Cannot create process for lobby %d.", i);
+            continue;
+        }
+        if (pid > 0)
+        {
+            g_lobby_pids.push_back(pid);
+            continue;
+        }
+        // Lobby process
+        g_lobby_pids.clear();
+        g_lobby_index = i;
+        if (port != 0)
+            ServerConfig::m_server_port = port + i;
+        if (i > 0)
+        {
+            ServerConfig::m_server_name = name + " " +
+                StringUtils::toString(i + 1);
+            // Only the first lobby reads the network console from stdin
+            ServerConfig::m_enable_console = false;
+        }
+        Log::setPrefix(std::string("Lobby ") + StringUtils::toString(i + 1));
+        // Each lobby writes its own log file, the file of the parent process
+        // would be renamed by each lobby when it is rotated
+        Log::closeOutputFiles();
+        FileManager::setStdoutName(StringUtils::removeExtension(
+            FileManager::getStdoutName()) + "-lobby" +
+            StringUtils::toString(i + 1) + ".log");
+        file_manager->redirectOutput();
+        // The request thread was not started before forking, since only
+        // the calling thread exists in a forked process.
+        Online::RequestManager::get()->startNetworkThread();
+        return i;
+    }
+
+    auto stop_lobbies = [](int signum)
+        {
+            for (pid_t pid : g_lobby_pids)
+                kill(pid, SIGTERM);
+        };
+    signal(SIGTERM, stop_lobbies);
+    signal(SIGINT, stop_lobbies);
+    Log::info("main", "Hosting %d lobbies.", (int)g_lobby_pids.size());
+    unsigned running = (unsigned)g_lobby_pids.size();
+    while (running > 0)
+    {
+        int status = 0;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        auto it = std::find(g_lobby_pids.begin(), g_lobby_pids.end(), pid);
+        if (it == g_lobby_pids.end())
+            continue;
+        running--;
+        Log::info("main", "Lobby %d exited with status %d.",
+            (int)(it - g_lobby_pids.begin()) + 1, status);
+    }
+    exit(0);
+}   // forkServerLobbies
+#endif
+
 //=============================================================================
 void initRest()
 {
@@ -1735,7 +1912,9 @@ void initRest()
     // The rest will be read later (since the rest needs the unlock- and
     // achievement managers to be created, which can only be created later).
     PlayerManager::create();
-    Online::RequestManager::get()->startNetworkThread();
+    // A server with several lobbies starts the thread in each lobby process
+    if (!hostsMultipleLobbies())
+        Online::RequestManager::get()->startNetworkThread();
 #ifndef SERVER_ONLY
     if (!ProfileWorld::isNoGraphics())
         NewsManager::get();   // this will create the news manager
@@ -1984,6 +2163,10 @@ int main(int argc, char *argv[])
             ServerConfig::m_validating_player = false;
         }
 
+        int lobbies;
+        if (CommandLine::has("--lobbies", &lobbies))
+            ServerConfig::m_lobby_count = lobbies;
+
         if (!ProfileWorld::isNoGraphics())
             profiler.init();
         initRest();
@@ -2058,10 +2241,24 @@ int main(int argc, char *argv[])
         GUIEngine::addLoadingIcon( irr_driver->getTexture(FileManager::GUI_ICON,
                                                           "banana.png")    );
 
+        int lobby_index = 0;
+#ifndef WIN32
+        if (hostsMultipleLobbies())
+            lobby_index = forkServerLobbies();
+#endif
+        if (CommandLine::has("--log-async"))
+            Log::setAsync(true);
+
         //handleCmdLine() needs InitTuxkart() so it can't be called first
         if (!handleCmdLine(!server_config.empty(), has_parent_process))
             exit(0);
 
+        // The other lobbies changed the server name and port, which must not
+        // be written to the server config
+        auto sl = LobbyProtocol::get<ServerLobby>();
+        if (lobby_index > 0 && sl)
+            sl->setSaveServerConfig(false);
+
 #ifndef SERVER_ONLY
         if (!ProfileWorld::isNoGraphics())
         {
@@ -2095,6 +2292,12 @@ int main(int argc, char *argv[])
             exit(0);
         }
 
+        if (!UserConfigParams::m_benchmark.empty())
+        {
+            runBenchmarks();
+            exit(0);
+        }
+
 #ifndef SERVER_ONLY
         if (!ProfileWorld::isNoGraphics())
         {
@@ -2438,6 +2641,7 @@ static void cleanSuperTuxKart()
 #endif
 
     ServersManager::deallocate();
+    WorkerPool::destroy();
     cleanUserConfig();
 
     StateManager::deallocate();
@@ -2474,8 +2678,16 @@ void runUnitTests()
     GraphicsRestrictions::unitTesting();
     Log::info("UnitTest", "NetworkString");
     NetworkString::unitTesting();
+    Log::info("UnitTest", "StateDelta");
+    StateDelta::unitTesting();
+    Log::info("UnitTest", "NetworkPool");
+    NetworkPool::unitTesting();
+    Log::info("UnitTest", "PacketBuffers");
+    PacketBuffers::unitTesting();
     Log::info("UnitTest", "TransportAddress");
     TransportAddress::unitTesting();
+    Log::info("UnitTest", "WorkerPool");
+    WorkerPool::unitTesting();
     Log::info("UnitTest", "StringUtils::versionToInt");
     StringUtils::unitTesting();
 
@@ -2519,13 +2731,83 @@ void runUnitTests()
     Log::info("UnitTest", "Arena Graph");
     ArenaGraph::unitTesting();
 
+    Log::info("UnitTest", "Height map");
+    HeightMap::unitTesting();
+
     Log::info("UnitTest", "Fonts for translation");
     font_manager->unitTesting();
 
     Log::info("UnitTest", "RewindQueue");
     RewindQueue::unitTesting();
 
+    Log::info("UnitTest", "SFXManager");
+    SFXManager::unitTesting();
+
     Log::info("UnitTest", "=====================");
     Log::info("UnitTest", "Testing successful   ");
     Log::info("UnitTest", "=====================");
 }   // runUnitTests
+
+//=============================================================================
+/** Runs the benchmarks selected with --benchmark=a,b,... (or all of them with
+ *  --benchmark=all). The results are printed to the log.
+ */
+void runBenchmarks()
+{
+    std::vector<std::string> names =
+        StringUtils::split(UserConfigParams::m_benchmark, ',');
+    auto selected = [&names](const std::string& name)
+    {
+        return std::find(names.begin(), names.end(), "all") != names.end() ||
+            std::find(names.begin(), names.end(), name) != names.end();
+    };
+
+    Log::info("Benchmark", "Starting benchmarks");
+    Log::info("Benchmark", "=====================");
+    if (selected("broadcast"))
+    {
+        Log::info("Benchmark", "STKHost broadcast");
+        STKHost::benchmarkBroadcast();
+    }
+    if (selected("sector"))
+    {
+        Log::info("Benchmark", "Graph sector search");
+        Graph::benchmarkSectorSearch();
+    }
+    if (selected("rewind"))
+    {
+        Log::info("Benchmark", "RewindQueue rewind");
+        RewindQueue::benchmarkRewind();
+    }
+    if (selected("position"))
+    {
+        Log::info("Benchmark", "LinearWorld race position");
+        LinearWorld::benchmarkRacePosition();
+    }
+    if (selected("characteristics"))
+    {
+        Log::info("Benchmark", "Kart characteristic getters");
+        CachedCharacteristic::benchmarkGetters();
+    }
+    if (selected("raycast"))
+    {
+        Log::info("Benchmark", "Kart suspension raycasts");
+        btKartRaycaster::benchmarkRaycasts();
+    }
+    if (selected("script"))
+    {
+        Log::info("Benchmark", "Script function calls");
+        Scripting::ScriptEngine::benchmarkCalls();
+    }
+    if (selected("spm"))
+    {
+        Log::info("Benchmark", "SPM mesh loading");
+        SPMeshLoader::benchmarkLoading();
+    }
+    if (selected("sfx"))
+    {
+        Log::info("Benchmark", "SFX command queue");
+        SFXManager::benchmarkCommands();
+    }
+    Log::info("Benchmark", "=====================");
+}   // runBenchmarks
@@ -46,10 +46,13 @@
 #include "tracks/track.hpp"
 #include "utils/constants.hpp"
 #include "utils/string_utils.hpp"
+#include "utils/time.hpp"
 #include "utils/translation.hpp"
+#include "utils/worker_pool.hpp"
 
 #include <climits>
 #include <iostream>
+#include <random>
 
 //-----------------------------------------------------------------------------
 /** Constructs the linear world. Note that here no functions can be called
@@ -242,8 +245,9 @@ void LinearWorld::update(int ticks)
 //-----------------------------------------------------------------------------
 void LinearWorld::updateTrackSectors()
 {
-    const unsigned int kart_amount = getNumKarts();
-    for(unsigned int n=0; n<kart_amount; n++)
+    // Each kart only changes its own track sector and kart info, so all
+    // karts can be done in parallel.
+    WorkerPool::get()->parallelFor(getNumKarts(), [this](unsigned int n)
     {
         KartInfo& kart_info = m_kart_info[n];
         AbstractKart* kart = m_karts[n].get();
@@ -252,7 +256,7 @@ void LinearWorld::updateTrackSectors()
         // rescued or eliminated
         if(kart->getKartAnimation() &&
            !dynamic_cast<CannonAnimation*>(kart->getKartAnimation()))
-            continue;
+            return;
         // If the kart is off road, and 'flying' over a reset plane
         // don't adjust the distance of the kart, to avoid a jump
         // in the position of the kart (e.g. while falling the kart
@@ -262,12 +266,12 @@ void LinearWorld::updateTrackSectors()
             (!kart->getMaterial() ||
               kart->getMaterial()->isDriveReset()))  &&
              !kart->isGhostKart())
-            continue;
+            return;
         getTrackSector(n)->update(kart->getFrontXYZ());
         kart_info.m_overall_distance = kart_info.m_finished_laps
                                      * Track::getCurrentTrack()->getTrackLength()
                         + getDistanceDownTrackForKart(kart->getWorldKartId(), true);
-    }   // for n
+    });   // for n
 }   // updateTrackSectors
 
 //-----------------------------------------------------------------------------
@@ -819,9 +823,81 @@ btTransform LinearWorld::getRescueTransform(unsigned int index) const
 }   // getRescueTransform
 
 //-----------------------------------------------------------------------------
-/** Find the position (rank) of every kart. ATM it uses a stable O(n^2)
- *  algorithm by counting for each kart how many other karts are ahead of
- *  it.
+/** Computes the race position of all karts which are still racing, i.e.
+ *  which are neither eliminated nor finished. All karts which have finished
+ *  the race (and are not eliminated) are ahead of them. The other karts are
+ *  sorted by overall distance, and by their start position if the distance
+ *  is the same.
+ *  \param info The race position data of all karts.
+ *  \param order The order of the kart ids from the last call, which is
+ *         sorted again. If it has the wrong size it is reinitialised.
+ *  \param positions On return the position of each racing kart, the entries
+ *         for other karts are not changed.
+ */
+void LinearWorld::computeRacePositions(const std::vector<RacePositionInfo> &info,
+                                       std::vector<int> *order,
+                                       std::vector<int> *positions)
+{
+    const unsigned int kart_amount = (unsigned int)info.size();
+    if (order->size() != kart_amount)
+    {
+        order->resize(kart_amount);
+        for (unsigned int i = 0; i < kart_amount; i++)
+            (*order)[i] = i;
+    }
+    positions->resize(kart_amount);
+
+    // True if kart a is ahead of kart b. Karts which are not racing are
+    // sorted by kart id behind all racing karts.
+    auto is_ahead = [&info](int a, int b)
+    {
+        const RacePositionInfo &ia = info[a];
+        const RacePositionInfo &ib = info[b];
+        const bool racing_a = !ia.m_eliminated && !ia.m_finished;
+        const bool racing_b = !ib.m_eliminated && !ib.m_finished;
+        if (racing_a != racing_b)
+            return racing_a;
+        if (!racing_a)
+            return a < b;
+        return ia.m_overall_distance > ib.m_overall_distance ||
+               (ia.m_overall_distance == ib.m_overall_distance &&
+                ia.m_initial_position < ib.m_initial_position);
+    };
+
+    // Insertion sort: the order of the last time step is usually still
+    // sorted, or only a few karts have swapped their places
+    std::vector<int> &o = *order;
+    for (unsigned int i = 1; i < kart_amount; i++)
+    {
+        const int id = o[i];
+        unsigned int j = i;
+        while (j > 0 && is_ahead(id, o[j - 1]))
+        {
+            o[j] = o[j - 1];
+            j--;
+        }
+        o[j] = id;
+    }
+
+    int finished = 0;
+    for (unsigned int i = 0; i < kart_amount; i++)
+    {
+        if (!info[i].m_eliminated && info[i].m_finished)
+            finished++;
+    }
+    for (unsigned int i = 0; i < kart_amount; i++)
+    {
+        const RacePositionInfo &ri = info[o[i]];
+        if (ri.m_eliminated || ri.m_finished)
+            break;
+        (*positions)[o[i]] = finished + i + 1;
+    }
+}   // computeRacePositions
+
+//-----------------------------------------------------------------------------
+/** Find the position (rank) of every kart. The karts are sorted by
+ *  computeRacePositions(), which gives the same result as counting for each
+ *  kart how many other karts are ahead of it.
  */
 void LinearWorld::updateRacePosition()
 {
@@ -833,9 +909,18 @@ void LinearWorld::updateRacePosition()
     bool rank_changed = false;
 #endif
 
-    // NOTE: if you do any changes to this loop, the next loop (see
-    // DEBUG_KART_RANK below) needs to have the same changes applied
-    // so that debug output is still correct!!!!!!!!!!!
+    m_race_position_info.resize(kart_amount);
+    for (unsigned int i=0; i<kart_amount; i++)
+    {
+        RacePositionInfo &info = m_race_position_info[i];
+        info.m_overall_distance = m_kart_info[i].m_overall_distance;
+        info.m_initial_position = m_karts[i]->getInitialPosition();
+        info.m_finished         = m_karts[i]->hasFinishedRace();
+        info.m_eliminated       = m_karts[i]->isEliminated();
+    }
+    computeRacePositions(m_race_position_info, &m_race_order,
+                         &m_race_positions);
+
     for (unsigned int i=0; i<kart_amount; i++)
     {
         AbstractKart* kart = m_karts[i].get();
@@ -853,33 +938,7 @@ void LinearWorld::updateRacePosition()
         }
         KartInfo& kart_info = m_kart_info[i];
 
-        int p = 1 ;
-
-        const unsigned int my_id = kart->getWorldKartId();
-        const float my_distance  = m_kart_info[my_id].m_overall_distance;
-
-        // Count karts ahead of the current kart, i.e. kart that are
-        // already finished or have covered a larger overall distance.
-        for (unsigned int j = 0 ; j < kart_amount ; j++)
-        {
-            // don't compare a kart with itself and ignore eliminated karts
-            if(j == my_id || m_karts[j]->isEliminated())
-                continue;
-
-            // If the other kart has:
-            // - finished the race (but this kart hasn't)
-            // - or is ahead
-            // - or has the same distance (very unlikely) but started earlier
-            // it is ahead --> increase position
-            if((!kart->hasFinishedRace() && m_karts[j]->hasFinishedRace()) ||
-                m_kart_info[j].m_overall_distance > my_distance            ||
-               (m_kart_info[j].m_overall_distance == my_distance &&
-                m_karts[j]->getInitialPosition()<kart->getInitialPosition() ) )
-            {
-                p++;
-            }
-
-        } //next kart
+        const int p = m_race_positions[i];
 
 #ifndef DEBUG
         setKartPosition(i, p);
@@ -937,60 +996,16 @@ void LinearWorld::updateRacePosition()
         Log::debug("[LinearWorld]", "Counting laps at %u seconds.", getTime());
         for (unsigned int i=0; i<kart_amount; i++)
         {
-            AbstractKart* kart = m_karts[i].get();
-            Log::debug("[LinearWorld]", "counting karts ahead of %s (laps %u,"
-                        " progress %u, finished %d, eliminated %d, initial position %u.",
-                        kart->getIdent().c_str(),
-                        m_kart_info[i].m_race_lap,
-                        m_kart_info[i].m_overall_distance,
+            AbstractKart* kart = m_karts[m_race_order[i]].get();
+            Log::debug("[LinearWorld]", "%u: %s (laps %u, progress %f, "
+                        "finished %d, eliminated %d, initial position %u).",
+                        kart->getPosition(), kart->getIdent().c_str(),
+                        m_kart_info[m_race_order[i]].m_finished_laps,
+                        m_kart_info[m_race_order[i]].m_overall_distance,
                         kart->hasFinishedRace(),
                         kart->isEliminated(),
                         kart->getInitialPosition());
-            // Karts that are either eliminated or have finished the
-            // race already have their (final) position assigned. If
-            // these karts would get their rank updated, it could happen
-            // that a kart that finished first will be overtaken after
-            // crossing the finishing line and become second!
-            if(kart->isEliminated() || kart->hasFinishedRace()) continue;
-            KartInfo& kart_info = m_kart_info[i];
-            int p = 1 ;
-            const int my_id         = kart->getWorldKartId();
-            const float my_distance = m_kart_info[my_id].m_overall_distance;
-
-            for (unsigned int j = 0 ; j < kart_amount ; j++)
-            {
-                if(j == my_id) continue;
-                if(m_karts[j]->isEliminated())
-                {
-                    Log::debug("[LinearWorld]", " %u: %s because it is eliminated.",
-                                p, m_karts[j]->getIdent().c_str());
-                    continue;
-                }
-                if(!kart->hasFinishedRace() && m_karts[j]->hasFinishedRace())
-                {
-                    p++;
-                    Log::debug("[LinearWorld]", " %u: %s because it has finished the race.",
-                                p, m_karts[j]->getIdent().c_str());
-                    continue;
-                }
-                if(m_kart_info[j].m_overall_distance > my_distance)
-                {
-                    p++;
-                    Log::debug("[LinearWorld]", " %u: %s because it is ahead %u.",
-                                p, m_karts[j]->getIdent().c_str(),
-                                m_kart_info[j].m_overall_distance);
-                    continue;
-                }
-                if(m_kart_info[j].m_overall_distance == my_distance &&
-                   m_karts[j]->getInitialPosition()<kart->getInitialPosition())
-                {
-                    p++;
-                    Log::debug("[LinearWorld]"," %u: %s has same distance, but started ahead %d",
-                                p, m_karts[j]->getIdent().c_str(),
-                                m_karts[j]->getInitialPosition());
-                }
-            }   // next kart j
-        }   // for i<kart_amount
+        }
         Log::debug("LinearWorld]", "-------------------------------------------");
     }   // if rank_changed
 #endif
@@ -1245,3 +1260,96 @@ void LinearWorld::handleServerCheckStructureCount(unsigned count)
     else
         m_check_structure_compatible = true;
 }   // handleServerCheckStructureCount
+
+//-----------------------------------------------------------------------------
+/** Compares computeRacePositions() with counting for each kart the number
+ *  of karts ahead of it (the old algorithm), for 8 to 128 simulated karts
+ *  which overtake each other, finish or get eliminated.
+ */
+void LinearWorld::benchmarkRacePosition()
+{
+    const int ticks = 6000;
+    for (unsigned int kart_amount = 8; kart_amount <= 128; kart_amount *= 2)
+    {
+        // Simulates the race with the same random numbers each time, and
+        // returns the positions of all karts after each time step.
+        auto simulate = [kart_amount](bool sort, std::vector<int>* result)
+        {
+            std::mt19937 random(1234);
+            std::uniform_real_distribution<float> speed_change(-0.5f, 0.5f);
+            std::uniform_int_distribution<int> event(0, 20000);
+            std::vector<RacePositionInfo> info(kart_amount);
+            std::vector<float> speed(kart_amount);
+            for (unsigned int i = 0; i < kart_amount; i++)
+            {
+                info[i].m_initial_position = i + 1;
+                info[i].m_overall_distance = -2.0f * i;
+                info[i].m_finished         = false;
+                info[i].m_eliminated       = false;
+                speed[i] = 20.0f;
+            }
+            std::vector<int> order, positions(kart_amount, 0);
+            result->clear();
+            uint64_t time = 0;
+            for (int t = 0; t < ticks; t++)
+            {
+                for (unsigned int i = 0; i < kart_amount; i++)
+                {
+                    RacePositionInfo& ri = info[i];
+                    if (ri.m_finished || ri.m_eliminated)
+                        continue;
+                    speed[i] += speed_change(random);
+                    ri.m_overall_distance += speed[i] / 120.0f;
+                    int e = event(random);
+                    if (e == 0)
+                        ri.m_eliminated = true;
+                    else if (e == 1)
+                        ri.m_finished = true;
+                }
+                uint64_t start = StkTime::getMonoTimeUs();
+                if (sort)
+                    computeRacePositions(info, &order, &positions);
+                else
+                {
+                    for (unsigned int i = 0; i < kart_amount; i++)
+                    {
+                        const RacePositionInfo& ri = info[i];
+                        if (ri.m_finished || ri.m_eliminated)
+                            continue;
+                        int p = 1;
+                        for (unsigned int j = 0; j < kart_amount; j++)
+                        {
+                            const RacePositionInfo& rj = info[j];
+                            if (j == i || rj.m_eliminated)
+                                continue;
+                            if (rj.m_finished ||
+                                rj.m_overall_distance > ri.m_overall_distance ||
+                                (rj.m_overall_distance == ri.m_overall_distance &&
+                                 rj.m_initial_position < ri.m_initial_position))
+                                p++;
+                        }
+                        positions[i] = p;
+                    }
+                }
+                time += StkTime::getMonoTimeUs() - start;
+                result->insert(result->end(), positions.begin(),
+                               positions.end());
+            }
+            return time;
+        };
+
+        std::vector<int> counted, sorted;
+        uint64_t count_time = simulate(/*sort*/false, &counted);
+        uint64_t sort_time  = simulate(/*sort*/true,  &sorted);
+        int mismatches = 0;
+        for (unsigned int i = 0; i < counted.size(); i++)
+        {
+            if (counted[i] != sorted[i])
+                mismatches++;
+        }
+        Log::info("Benchmark", "%d karts: counting %.3f us/update, sorting "
+                  "%.3f us/update, %d mismatches", kart_amount,
+                  count_time / float(ticks), sort_time / float(ticks),
+                  mismatches);
+    }
+}   // benchmarkRacePosition
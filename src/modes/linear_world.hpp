@@ -77,6 +77,33 @@ private:
      */
     void  updateLiveDifference();
 
+    // ------------------------------------------------------------------------
+    /** The data which determines the race position of a kart. */
+    struct RacePositionInfo
+    {
+        float m_overall_distance;
+        int   m_initial_position;
+        bool  m_finished;
+        bool  m_eliminated;
+    };
+
+    /** The race position data of all karts, kept to avoid allocations. */
+    std::vector<RacePositionInfo> m_race_position_info;
+
+    /** Kart ids sorted by race position in the last call to
+     *  updateRacePosition(), karts which are not racing anymore are at the
+     *  end. Since only few karts overtake each other in one time step,
+     *  sorting this again is usually linear. */
+    std::vector<int> m_race_order;
+
+    /** Race position of each kart computed by computeRacePositions(). */
+    std::vector<int> m_race_positions;
+
+    static void computeRacePositions(
+                              const std::vector<RacePositionInfo> &info,
+                              std::vector<int> *order,
+                              std::vector<int> *positions);
+
     // ------------------------------------------------------------------------
     /** Some additional info that needs to be kept for each kart
      * in this kind of race.
@@ -149,6 +176,7 @@ public:
                                             bool account_for_checklines) const;
     void          updateTrackSectors();
     void          updateRacePosition();
+    static void   benchmarkRacePosition();
     float         getDistanceToCenterForKart(const int kart_id) const;
     float         getEstimatedFinishTime(const int kart_id) const;
     int           getLapForKart(const int kart_id) const;
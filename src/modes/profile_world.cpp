@@ -19,21 +19,35 @@
 #include "modes/profile_world.hpp"
 
 #include "main_loop.hpp"
+#include "config/user_config.hpp"
 #include "graphics/camera.hpp"
 #include "graphics/irr_driver.hpp"
+#include "io/file_manager.hpp"
 #include "karts/kart_with_stats.hpp"
 #include "karts/controller/controller.hpp"
 #include "tracks/track.hpp"
+#include "utils/file_utils.hpp"
+#include "utils/profiler.hpp"
+#include "utils/string_utils.hpp"
+#include "utils/time.hpp"
 
 #include <ISceneManager.h>
 
+#include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <map>
 #include <sstream>
 
+#ifndef WIN32
+#  include <sys/resource.h>
+#endif
+
 ProfileWorld::ProfileType ProfileWorld::m_profile_mode=PROFILE_NONE;
 int   ProfileWorld::m_num_laps    = 0;
 float ProfileWorld::m_time        = 0.0f;
+int   ProfileWorld::m_num_ticks   = 0;
+std::string ProfileWorld::m_json_file;
 bool  ProfileWorld::m_no_graphics = false;
 
 //-----------------------------------------------------------------------------
@@ -57,6 +71,17 @@ ProfileWorld::ProfileWorld()
     m_num_transparent  = 0;
     m_num_trans_effect = 0;
     m_num_calls        = 0;
+    m_tick_count       = 0;
+    m_simulation_start = 0;
+
+    // The profiler is normally only initialised with graphics, but its
+    // markers are needed for the report of the ticks based profiling.
+    if (m_profile_mode == PROFILE_TICKS)
+    {
+        if (m_no_graphics)
+            profiler.init();
+        UserConfigParams::m_profiler_enabled = true;
+    }
 }   // ProfileWorld
 
 //-----------------------------------------------------------------------------
@@ -93,6 +118,24 @@ void ProfileWorld::setProfileModeLaps(int laps)
     m_num_laps     = laps;
 }   // setProfileModeLaps
 
+//-----------------------------------------------------------------------------
+/** Enables profiling for a fixed number of physics ticks. Together with a
+ *  fixed random seed and no graphics this gives a reproducible benchmark of
+ *  the simulation. At the end a JSON report with the time spent in each
+ *  profiler marker is written.
+ *  \param ticks The number of physics ticks to simulate.
+ *  \param json_file Name of the file for the report, if empty the file
+ *         'profile.json' in the user config directory is used.
+ */
+void ProfileWorld::setProfileModeTicks(int ticks,
+                                       const std::string &json_file)
+{
+    m_profile_mode = PROFILE_TICKS;
+    m_num_laps     = 99999;
+    m_num_ticks    = ticks;
+    m_json_file    = json_file;
+}   // setProfileModeTicks
+
 //-----------------------------------------------------------------------------
 /** Creates a kart, having a certain position, starting location, and local
  *  and global player id (if applicable).
@@ -137,6 +180,9 @@ bool ProfileWorld::isRaceOver()
     if(m_profile_mode==PROFILE_TIME)
         return getTime()>m_time;
 
+    if(m_profile_mode==PROFILE_TICKS)
+        return m_tick_count>=m_num_ticks;
+
     if(m_profile_mode == PROFILE_LAPS )
     {
         // Now it must be laps based profiling:
@@ -153,9 +199,13 @@ bool ProfileWorld::isRaceOver()
  */
 void ProfileWorld::update(int ticks)
 {
+    if (m_tick_count == 0)
+        m_simulation_start = StkTime::getMonoTimeUs();
+
     StandardRace::update(ticks);
 
     m_frame_count++;
+    m_tick_count += ticks;
     video::IVideoDriver *driver = irr_driver->getVideoDriver();
     io::IAttributes   *attr = irr_driver->getSceneManager()->getParameters();
     m_num_triangles    += (int)(driver->getPrimitiveCountDrawn( 0 )
@@ -168,6 +218,73 @@ void ProfileWorld::update(int ticks)
 
 }   // update
 
+//-----------------------------------------------------------------------------
+/** Writes the result of a ticks based profiling run as JSON: the number of
+ *  simulated ticks per second, the peak memory usage, and the total and
+ *  per tick time of each profiler marker.
+ */
+void ProfileWorld::writeJSONReport() const
+{
+    const double seconds =
+        (StkTime::getMonoTimeUs() - m_simulation_start) / 1000000.0;
+
+    // Peak resident memory in KB, -1 if not available
+    long peak_memory = -1;
+#ifndef WIN32
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+    {
+#  ifdef __APPLE__
+        peak_memory = (long)(usage.ru_maxrss / 1024);
+#  else
+        peak_memory = (long)usage.ru_maxrss;
+#  endif
+    }
+#endif
+
+    std::map<std::string, double> totals;
+    profiler.getTotals(&totals);
+
+    std::string file_name = m_json_file.empty()
+                          ? file_manager->getUserConfigFile("profile.json")
+                          : m_json_file;
+    std::ofstream f(FileUtils::getPortableWritingPath(file_name));
+    if (!f.is_open())
+    {
+        Log::error("profile", "Can't open '%s' for writing.",
+                   file_name.c_str());
+        return;
+    }
+    f << "{\n"
+      << "  \"track\": \"" << Track::getCurrentTrack()->getIdent() << "\",\n"
+      << "  \"karts\": " << getNumKarts() << ",\n"
+      << "  \"ticks\": " << m_tick_count << ",\n"
+      << "  \"seconds\": " << seconds << ",\n"
+      << "  \"ticks_per_second\": "
+      << (seconds > 0 ? m_tick_count / seconds : 0) << ",\n"
+      << "  \"peak_memory_kb\": " << peak_memory << ",\n"
+      << "  \"markers\": {";
+    for (std::map<std::string, double>::const_iterator i = totals.begin();
+         i != totals.end(); ++i)
+    {
+        // Marker names are string literals in the code, but make sure
+        // that they can't break the JSON syntax
+        std::string name = i->first;
+        name = StringUtils::replace(name, "\\", "\\\\");
+        name = StringUtils::replace(name, "\"", "\\\"");
+        f << (i == totals.begin() ? "\n" : ",\n")
+          << "    \"" << name << "\": { \"total_ms\": " << i->second
+          << ", \"per_tick_us\": "
+          << (m_tick_count > 0 ? i->second * 1000.0 / m_tick_count : 0)
+          << " }";
+    }
+    f << "\n  }\n}\n";
+    f.close();
+    Log::info("profile", "%d ticks in %f seconds (%f ticks per second), "
+              "report written to '%s'.", m_tick_count, seconds,
+              seconds > 0 ? m_tick_count / seconds : 0, file_name.c_str());
+}   // writeJSONReport
+
 //-----------------------------------------------------------------------------
 /** This function is called when the race is finished, but end-of-race
  *  animations have still to be played. In the case of profiling,
@@ -175,11 +292,14 @@ void ProfileWorld::update(int ticks)
  */
 void ProfileWorld::enterRaceOverState()
 {
+    if (m_profile_mode == PROFILE_TICKS)
+        writeJSONReport();
+
     // If in timing mode, the number of laps is way too high (which avoids
     // aborting too early). So in this case determine the maximum number
     // of laps and set this +1 as the number of laps to get more meaningful
     // time estimations.
-    if(m_profile_mode==PROFILE_TIME)
+    if(m_profile_mode==PROFILE_TIME || m_profile_mode==PROFILE_TICKS)
     {
         int max_laps = -2;
         for(unsigned int i=0; i<race_manager->getNumberOfKarts(); i++)
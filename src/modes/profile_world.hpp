@@ -20,6 +20,9 @@
 #define HEADER_PROFILE_WORLD_HPP
 
 #include "modes/standard_race.hpp"
+#include "utils/types.hpp"
+
+#include <string>
 
 class Kart;
 
@@ -31,7 +34,8 @@ class ProfileWorld : public StandardRace
 {
 private:
     /** Profiling modes. */
-    enum        ProfileType {PROFILE_NONE, PROFILE_TIME, PROFILE_LAPS};
+    enum        ProfileType {PROFILE_NONE, PROFILE_TIME, PROFILE_LAPS,
+                             PROFILE_TICKS};
 
     /** If profiling is done, and if so, which mode. */
     static ProfileType m_profile_mode;
@@ -43,6 +47,20 @@ private:
     /** In time based profiling only: time to run. */
     static float m_time;
 
+    /** In ticks based profiling only: number of physics ticks to run. */
+    static int   m_num_ticks;
+
+    /** In ticks based profiling only: name of the file the JSON report
+     *  is written to. */
+    static std::string m_json_file;
+
+    /** Number of physics ticks done so far. */
+    int          m_tick_count;
+
+    /** Real time (in us) when the first tick was simulated, so that
+     *  loading the track is not included in the ticks per second. */
+    uint64_t     m_simulation_start;
+
     /** Return value of real time at start of race. */
     unsigned int m_start_time;
 
@@ -72,6 +90,8 @@ protected:
      *  used by DemoWorld. */
     static int   m_num_laps;
 
+    void writeJSONReport() const;
+
     virtual std::shared_ptr<AbstractKart> createKart
         (const std::string &kart_ident, int index, int local_player_id,
         int global_player_id, RaceManager::KartType type,
@@ -88,6 +108,8 @@ public:
 
     static   void setProfileModeTime(float time);
     static   void setProfileModeLaps(int laps);
+    static   void setProfileModeTicks(int ticks,
+                                      const std::string &json_file);
     // ------------------------------------------------------------------------
     /** Returns true if profile mode was selected. */
     static   bool isProfileMode() {return m_profile_mode!=PROFILE_NONE; }
@@ -80,6 +80,7 @@
 #include "utils/profiler.hpp"
 #include "utils/translation.hpp"
 #include "utils/string_utils.hpp"
+#include "utils/worker_pool.hpp"
 
 #include <algorithm>
 #include <assert.h>
@@ -1097,12 +1098,28 @@ void World::update(int ticks)
     Track::getCurrentTrack()->getTrackObjectManager()->update(stk_config->ticks2Time(ticks));
     PROFILER_POP_CPU_MARKER();
 
+    // The kart updates are done in two phases: first the controllers of all
+    // karts compute what only depends on the state of their own kart, in
+    // parallel. Then the karts are updated one after the other in the
+    // usual order, which uses the prepared data only if the kart is still
+    // in exactly the same state. So the result is the same as updating
+    // everything sequentially, which networking and replays depend on.
+    PROFILER_PUSH_CPU_MARKER("World::update (prepare karts)", 0x40, 0x7F, 0x40);
+    const int kart_amount = (int)m_karts.size();
+    WorkerPool::get()->parallelFor(kart_amount, [this, ticks](unsigned int i)
+        {
+            SpareTireAI* sta =
+                dynamic_cast<SpareTireAI*>(m_karts[i]->getController());
+            if (!m_karts[i]->isEliminated() || (sta && sta->isMoving()))
+                m_karts[i]->getController()->prepareUpdate(ticks);
+        });
+    PROFILER_POP_CPU_MARKER();
+
     PROFILER_PUSH_CPU_MARKER("World::update (Kart::upate)", 0x40, 0x7F, 0x00);
 
     // Update all the karts. This in turn will also update the controller,
     // which causes all AI steering commands set. So in the following 
     // physics update the new steering is taken into account.
-    const int kart_amount = (int)m_karts.size();
     for (int i = 0 ; i < kart_amount; ++i)
     {
         SpareTireAI* sta =
@@ -25,6 +25,7 @@
 #include "tracks/track.hpp"
 #include "tracks/track_sector.hpp"
 #include "utils/log.hpp"
+#include "utils/worker_pool.hpp"
 
 #include <iostream>
 
@@ -252,11 +253,12 @@ void WorldWithRank::updateSectorForKarts()
 
     const unsigned int n = getNumKarts();
     assert(n == m_kart_track_sector.size());
-    for (unsigned int i = 0; i < n; i++)
+    // Each kart only changes its own track sector
+    WorkerPool::get()->parallelFor(n, [this](unsigned int i)
     {
         SpareTireAI* sta =
             dynamic_cast<SpareTireAI*>(m_karts[i]->getController());
         if (!m_karts[i]->isEliminated() || (sta && sta->isMoving()))
             getTrackSector(i)->update(m_karts[i]->getXYZ());
-    }
+    });
 }   // updateSectorForKarts
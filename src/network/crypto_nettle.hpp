@@ -38,6 +38,7 @@
 
 class BareNetworkString;
 class NetworkString;
+class PacketBuffers;
 
 class Crypto
 {
@@ -142,7 +143,8 @@ public:
     // ------------------------------------------------------------------------
     bool decryptConnectionRequest(BareNetworkString& ns);
     // ------------------------------------------------------------------------
-    ENetPacket* encryptSend(BareNetworkString& ns, bool reliable);
+    ENetPacket* encryptSend(BareNetworkString& ns, bool reliable,
+                            PacketBuffers* buffers = NULL);
     // ------------------------------------------------------------------------
     NetworkString* decryptRecieve(ENetPacket* p);
 
@@ -21,6 +21,7 @@
 #include "network/crypto_openssl.hpp"
 #include "network/network_config.hpp"
 #include "network/network_string.hpp"
+#include "network/packet_buffers.hpp"
 
 #include <openssl/aes.h>
 #include <openssl/buffer.h>
@@ -129,13 +130,21 @@ bool Crypto::decryptConnectionRequest(BareNetworkString& ns)
 }   // decryptConnectionRequest
 
 // ----------------------------------------------------------------------------
-ENetPacket* Crypto::encryptSend(BareNetworkString& ns, bool reliable)
+/** Encrypts a message into a new packet.
+ *  \param ns The message to encrypt.
+ *  \param reliable If the packet is sent reliable.
+ *  \param buffers If not NULL, the memory of the packet is taken from (and
+ *         given back to) these buffers instead of being allocated.
+ */
+ENetPacket* Crypto::encryptSend(BareNetworkString& ns, bool reliable,
+                                PacketBuffers* buffers)
 {
     // 4 bytes counter and 4 bytes tag
-    ENetPacket* p = enet_packet_create(NULL, ns.m_buffer.size() + 8,
-        (reliable ? ENET_PACKET_FLAG_RELIABLE :
-        (ENET_PACKET_FLAG_UNSEQUENCED | ENET_PACKET_FLAG_UNRELIABLE_FRAGMENT))
-        );
+    const uint32_t flags = reliable ? ENET_PACKET_FLAG_RELIABLE :
+        (ENET_PACKET_FLAG_UNSEQUENCED | ENET_PACKET_FLAG_UNRELIABLE_FRAGMENT);
+    ENetPacket* p = buffers ?
+        buffers->createPacket(ns.m_buffer.size() + 8, flags) :
+        enet_packet_create(NULL, ns.m_buffer.size() + 8, flags);
     if (p == NULL)
         return NULL;
 
@@ -24,6 +24,7 @@
 #ifndef EVENT_HPP
 #define EVENT_HPP
 
+#include "network/network_pool.hpp"
 #include "network/network_string.hpp"
 #include "utils/leak_check.hpp"
 #include "utils/types.hpp"
@@ -93,6 +94,15 @@ public:
          Event(ENetEvent* event, std::shared_ptr<STKPeer> peer);
         ~Event();
 
+    // ------------------------------------------------------------------------
+    /** An event is created for each received packet, so its memory is taken
+     *  from the network pool. */
+    static void* operator new(size_t size)
+                                       { return NetworkPool::allocate(size); }
+    // ------------------------------------------------------------------------
+    static void operator delete(void* p, size_t size)
+                                         { NetworkPool::deallocate(p, size); }
+
     // ------------------------------------------------------------------------
     /** Returns the type of this event. */
     EVENT_TYPE getType() const { return m_type; }
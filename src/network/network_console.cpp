@@ -18,6 +18,7 @@
 
 #include "network/network_config.hpp"
 #include "network/network_player_profile.hpp"
+#include "network/network_pool.hpp"
 #include "network/server_config.hpp"
 #include "network/stk_host.hpp"
 #include "network/stk_peer.hpp"
@@ -43,6 +44,10 @@ void showHelp()
     std::cout << "listpeers, List all peers with host ID and IP." << std::endl;
     std::cout << "listban, List IP ban list of server." << std::endl;
     std::cout << "speedstats, Show upload and download speed." << std::endl;
+    std::cout << "contentionstats, Show peer table and enet command queue "
+        "usage." << std::endl;
+    std::cout << "poolstats, Show network string and event memory pool "
+        "usage." << std::endl;
 }   // showHelp
 
 // ----------------------------------------------------------------------------
@@ -122,6 +127,14 @@ void mainLoop(STKHost* host)
                 "   Download speed (KBps): " <<
                 (float)host->getDownloadSpeed() / 1024.0f  << std::endl;
         }
+        else if (str == "contentionstats")
+        {
+            std::cout << host->getContentionStats() << std::endl;
+        }
+        else if (str == "poolstats")
+        {
+            std::cout << NetworkPool::getStats() << std::endl;
+        }
         else
         {
             std::cout << "Unknown command: " << str << std::endl;
@@ -0,0 +1,337 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2020 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "network/network_pool.hpp"
+
+#include "utils/log.hpp"
+#include "utils/string_utils.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <thread>
+
+namespace NetworkPool
+{
+// ----------------------------------------------------------------------------
+/** Number of shards, threads with the same hash share one. */
+const unsigned SHARD_COUNT = 8;
+
+/** Buffers with a larger capacity (e.g. from a file transfer) are freed, so
+ *  the pool does not keep a lot of memory for rarely used sizes. */
+const size_t MAX_BUFFER_CAPACITY = 16384;
+
+/** Maximum number of buffers and of blocks kept in each shard. */
+const size_t MAX_FREE_PER_SHARD = 512;
+
+// ----------------------------------------------------------------------------
+struct Shard
+{
+    std::mutex m_mutex;
+    std::vector<std::vector<uint8_t> > m_buffers;
+    std::vector<void*> m_blocks;
+
+    /** Buffers and blocks handed out from the pool. */
+    uint64_t m_buffers_reused, m_blocks_reused;
+    /** Heap allocations: new buffers, buffers which had to be enlarged and
+     *  new blocks. */
+    uint64_t m_buffers_new, m_buffers_grown, m_blocks_new;
+    /** Memory given back to the heap because the shard was full (or the
+     *  buffer too large). */
+    uint64_t m_buffers_freed, m_blocks_freed;
+    /** Number of times memory was taken from another shard. */
+    uint64_t m_steals;
+
+    Shard()
+    {
+        m_buffers_reused = m_blocks_reused = 0;
+        m_buffers_new = m_buffers_grown = m_blocks_new = 0;
+        m_buffers_freed = m_blocks_freed = 0;
+        m_steals = 0;
+    }
+};   // struct Shard
+
+// ----------------------------------------------------------------------------
+/** Returns all shards. They are never deleted, since network strings can be
+ *  destroyed during static destruction at exit. */
+Shard* getShards()
+{
+    static Shard* shards = new Shard[SHARD_COUNT];
+    return shards;
+}   // getShards
+
+// ----------------------------------------------------------------------------
+/** Returns the shard used by the calling thread. */
+Shard& getThreadShard()
+{
+    size_t h = std::hash<std::thread::id>()(std::this_thread::get_id());
+    return getShards()[(h ^ (h >> 16)) % SHARD_COUNT];
+}   // getThreadShard
+
+// ----------------------------------------------------------------------------
+/** Moves half of the buffers or blocks of another shard into the (locked)
+ *  shard of this thread. Shards which are in use by another thread at the
+ *  moment are skipped.
+ *  \param blocks True to take blocks, false to take buffers.
+ */
+void steal(Shard& own, bool blocks)
+{
+    Shard* shards = getShards();
+    for (unsigned i = 0; i < SHARD_COUNT; i++)
+    {
+        Shard& other = shards[i];
+        if (&other == &own)
+            continue;
+        std::unique_lock<std::mutex> lock(other.m_mutex, std::try_to_lock);
+        if (!lock.owns_lock())
+            continue;
+        if (blocks && !other.m_blocks.empty())
+        {
+            size_t n = (other.m_blocks.size() + 1) / 2;
+            own.m_blocks.insert(own.m_blocks.end(), other.m_blocks.end() - n,
+                other.m_blocks.end());
+            other.m_blocks.resize(other.m_blocks.size() - n);
+            own.m_steals++;
+            return;
+        }
+        if (!blocks && !other.m_buffers.empty())
+        {
+            size_t n = (other.m_buffers.size() + 1) / 2;
+            for (size_t j = other.m_buffers.size() - n;
+                 j < other.m_buffers.size(); j++)
+            {
+                own.m_buffers.emplace_back();
+                own.m_buffers.back().swap(other.m_buffers[j]);
+            }
+            other.m_buffers.resize(other.m_buffers.size() - n);
+            own.m_steals++;
+            return;
+        }
+    }
+}   // steal
+
+// ----------------------------------------------------------------------------
+/** Returns an empty buffer with at least the given capacity, which should be
+ *  given back with putBuffer() once it is not needed anymore.
+ */
+std::vector<uint8_t> getBuffer(size_t capacity)
+{
+    std::vector<uint8_t> buffer;
+    Shard& shard = getThreadShard();
+    std::unique_lock<std::mutex> lock(shard.m_mutex);
+    if (shard.m_buffers.empty())
+        steal(shard, /*blocks*/false);
+    if (shard.m_buffers.empty())
+    {
+        shard.m_buffers_new++;
+        lock.unlock();
+        buffer.reserve(capacity);
+        return buffer;
+    }
+    buffer.swap(shard.m_buffers.back());
+    shard.m_buffers.pop_back();
+    shard.m_buffers_reused++;
+    if (buffer.capacity() < capacity)
+        shard.m_buffers_grown++;
+    lock.unlock();
+    buffer.reserve(capacity);
+    return buffer;
+}   // getBuffer
+
+// ----------------------------------------------------------------------------
+/** Gives the memory of a buffer back to the pool, the buffer is empty
+ *  afterwards.
+ */
+void putBuffer(std::vector<uint8_t>* buffer)
+{
+    if (buffer->capacity() == 0)
+        return;
+    Shard& shard = getThreadShard();
+    std::unique_lock<std::mutex> lock(shard.m_mutex);
+    if (buffer->capacity() > MAX_BUFFER_CAPACITY ||
+        shard.m_buffers.size() >= MAX_FREE_PER_SHARD)
+    {
+        shard.m_buffers_freed++;
+        lock.unlock();
+        std::vector<uint8_t>().swap(*buffer);
+        return;
+    }
+    buffer->clear();
+    shard.m_buffers.emplace_back();
+    shard.m_buffers.back().swap(*buffer);
+}   // putBuffer
+
+// ----------------------------------------------------------------------------
+/** Allocates memory for an object, used by the class specific operator new
+ *  of network strings and events.
+ */
+void* allocate(size_t size)
+{
+    if (size > BLOCK_SIZE)
+        return ::operator new(size);
+    Shard& shard = getThreadShard();
+    std::unique_lock<std::mutex> lock(shard.m_mutex);
+    if (shard.m_blocks.empty())
+        steal(shard, /*blocks*/true);
+    if (shard.m_blocks.empty())
+    {
+        shard.m_blocks_new++;
+        lock.unlock();
+        return ::operator new(BLOCK_SIZE);
+    }
+    void* p = shard.m_blocks.back();
+    shard.m_blocks.pop_back();
+    shard.m_blocks_reused++;
+    return p;
+}   // allocate
+
+// ----------------------------------------------------------------------------
+/** Frees memory from allocate(), size must be the same as used there. */
+void deallocate(void* p, size_t size)
+{
+    if (p == NULL)
+        return;
+    if (size > BLOCK_SIZE)
+    {
+        ::operator delete(p);
+        return;
+    }
+    Shard& shard = getThreadShard();
+    std::unique_lock<std::mutex> lock(shard.m_mutex);
+    if (shard.m_blocks.size() >= MAX_FREE_PER_SHARD)
+    {
+        shard.m_blocks_freed++;
+        lock.unlock();
+        ::operator delete(p);
+        return;
+    }
+    shard.m_blocks.push_back(p);
+}   // deallocate
+
+// ----------------------------------------------------------------------------
+/** Returns the counters of all shards as a printable string. The number of
+ *  new and grown buffers and new blocks stays the same while the pool covers
+ *  all network strings and events.
+ */
+std::string getStats()
+{
+    Shard total;
+    size_t free_buffers = 0, free_blocks = 0;
+    Shard* shards = getShards();
+    for (unsigned i = 0; i < SHARD_COUNT; i++)
+    {
+        Shard& s = shards[i];
+        std::lock_guard<std::mutex> lock(s.m_mutex);
+        total.m_buffers_reused += s.m_buffers_reused;
+        total.m_blocks_reused += s.m_blocks_reused;
+        total.m_buffers_new += s.m_buffers_new;
+        total.m_buffers_grown += s.m_buffers_grown;
+        total.m_blocks_new += s.m_blocks_new;
+        total.m_buffers_freed += s.m_buffers_freed;
+        total.m_blocks_freed += s.m_blocks_freed;
+        total.m_steals += s.m_steals;
+        free_buffers += s.m_buffers.size();
+        free_blocks += s.m_blocks.size();
+    }
+    return StringUtils::insertValues("Buffers: %d reused, %d new, %d grown, "
+        "%d freed, %d pooled. Objects: %d reused, %d new, %d freed, "
+        "%d pooled. %d steals between threads.",
+        total.m_buffers_reused, total.m_buffers_new, total.m_buffers_grown,
+        total.m_buffers_freed, free_buffers, total.m_blocks_reused,
+        total.m_blocks_new, total.m_blocks_freed, free_blocks,
+        total.m_steals);
+}   // getStats
+
+// ----------------------------------------------------------------------------
+/** Unit testing function.
+ */
+void unitTesting()
+{
+    // A buffer given back is handed out again with its memory
+    std::vector<uint8_t> buffer = getBuffer(100);
+    assert(buffer.capacity() >= 100);
+    buffer.push_back(1);
+    const uint8_t* data = buffer.data();
+    putBuffer(&buffer);
+    assert(buffer.capacity() == 0);
+    buffer = getBuffer(50);
+    if (!buffer.empty() || buffer.data() != data)
+        Log::fatal("NetworkPool", "A pooled buffer was not reused.");
+    putBuffer(&buffer);
+
+    // Too large buffers are not kept
+    buffer.reserve(MAX_BUFFER_CAPACITY + 1);
+    putBuffer(&buffer);
+    assert(buffer.capacity() == 0);
+
+    void* p = allocate(BLOCK_SIZE);
+    deallocate(p, BLOCK_SIZE);
+    void* q = allocate(BLOCK_SIZE / 2);
+    assert(p == q);
+    deallocate(q, BLOCK_SIZE / 2);
+    p = allocate(BLOCK_SIZE + 1);
+    deallocate(p, BLOCK_SIZE + 1);
+
+    // Memory freed by one thread is used by another one without new heap
+    // allocations
+    std::vector<std::vector<uint8_t> > buffers(64);
+    std::vector<void*> blocks(64);
+    for (unsigned i = 0; i < 64; i++)
+    {
+        buffers[i] = getBuffer(1000);
+        blocks[i] = allocate(BLOCK_SIZE);
+    }
+    std::thread t([&buffers, &blocks]()
+        {
+            for (unsigned i = 0; i < 64; i++)
+            {
+                putBuffer(&buffers[i]);
+                deallocate(blocks[i], BLOCK_SIZE);
+            }
+        });
+    t.join();
+    Shard* shards = getShards();
+    auto count_new = [shards]()
+        {
+            uint64_t n = 0;
+            for (unsigned i = 0; i < SHARD_COUNT; i++)
+            {
+                n += shards[i].m_buffers_new + shards[i].m_buffers_grown +
+                    shards[i].m_blocks_new;
+            }
+            return n;
+        };
+    uint64_t new_before = count_new();
+    for (unsigned i = 0; i < 64; i++)
+    {
+        buffers[i] = getBuffer(1);
+        blocks[i] = allocate(BLOCK_SIZE);
+    }
+    if (count_new() != new_before)
+        Log::fatal("NetworkPool", "Memory freed by another thread was not "
+                   "reused.");
+    for (unsigned i = 0; i < 64; i++)
+    {
+        putBuffer(&buffers[i]);
+        deallocate(blocks[i], BLOCK_SIZE);
+    }
+}   // unitTesting
+
+}   // namespace NetworkPool
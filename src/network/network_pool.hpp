@@ -0,0 +1,60 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2020 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_NETWORK_POOL_HPP
+#define HEADER_NETWORK_POOL_HPP
+
+#include "utils/types.hpp"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/** \ingroup network
+ *  Recycles the memory of network strings and events, so that once the pool
+ *  is warmed up sending and receiving packets and saving states does not
+ *  allocate from the heap anymore.
+ *  Two kinds of memory are kept: the byte buffers of (Bare)NetworkString,
+ *  which keep their capacity when given back, and small fixed size blocks
+ *  for the NetworkString and Event objects themselves.
+ *  The pool is split into a few shards, each with its own mutex. A thread
+ *  always uses the shard selected by its thread id, so threads rarely wait
+ *  for each other. Memory is often freed by a different thread than the one
+ *  which allocated it (e.g. events are created by the listening thread and
+ *  deleted by the protocol manager), so a thread with an empty shard takes
+ *  half of the memory of another shard.
+ */
+namespace NetworkPool
+{
+    /** Size of the blocks used for objects, larger objects use the heap. */
+    const size_t BLOCK_SIZE = 128;
+
+    std::vector<uint8_t> getBuffer(size_t capacity);
+    // ------------------------------------------------------------------------
+    void putBuffer(std::vector<uint8_t>* buffer);
+    // ------------------------------------------------------------------------
+    void* allocate(size_t size);
+    // ------------------------------------------------------------------------
+    void deallocate(void* p, size_t size);
+    // ------------------------------------------------------------------------
+    std::string getStats();
+    // ------------------------------------------------------------------------
+    void unitTesting();
+}   // namespace NetworkPool
+
+#endif
@@ -23,6 +23,7 @@
 #ifndef NETWORK_STRING_HPP
 #define NETWORK_STRING_HPP
 
+#include "network/network_pool.hpp"
 #include "network/protocol.hpp"
 #include "utils/leak_check.hpp"
 #include "utils/types.hpp"
@@ -122,13 +123,14 @@ public:
 
     /** Constructor, sets the protocol type of this message. */
     BareNetworkString(int capacity=16)
+        : m_buffer(NetworkPool::getBuffer(capacity))
     {
-        m_buffer.reserve(capacity);
         m_current_offset = 0;
     }   // BareNetworkString
 
     // ------------------------------------------------------------------------
     BareNetworkString(const std::string &s)
+        : m_buffer(NetworkPool::getBuffer(s.size() + 1))
     {
         m_current_offset = 0;
         encodeString(s);
@@ -136,11 +138,39 @@ public:
     // ------------------------------------------------------------------------
     /** Initialises the string with a sequence of characters. */
     BareNetworkString(const char *data, int len)
+        : m_buffer(NetworkPool::getBuffer(len))
     {
         m_current_offset = 0;
-        m_buffer.resize(len);
-        memcpy(m_buffer.data(), data, len);
+        m_buffer.assign((const uint8_t*)data, (const uint8_t*)data + len);
     }   // BareNetworkString
+    // ------------------------------------------------------------------------
+    BareNetworkString(const BareNetworkString& other)
+        : m_buffer(NetworkPool::getBuffer(other.m_buffer.size()))
+    {
+        m_buffer = other.m_buffer;
+        m_current_offset = other.m_current_offset;
+    }   // BareNetworkString
+    // ------------------------------------------------------------------------
+    BareNetworkString(BareNetworkString&& other)
+        : m_buffer(std::move(other.m_buffer))
+    {
+        m_current_offset = other.m_current_offset;
+    }   // BareNetworkString
+    // ------------------------------------------------------------------------
+    BareNetworkString& operator=(const BareNetworkString& other) = default;
+    // ------------------------------------------------------------------------
+    BareNetworkString& operator=(BareNetworkString&& other) = default;
+    // ------------------------------------------------------------------------
+    /** Gives the buffer back to the pool for the next network string. */
+    ~BareNetworkString()             { NetworkPool::putBuffer(&m_buffer); }
+    // ------------------------------------------------------------------------
+    /** Network strings are created and deleted for each packet and state,
+     *  so their memory is taken from the network pool. */
+    static void* operator new(size_t size)
+                                       { return NetworkPool::allocate(size); }
+    // ------------------------------------------------------------------------
+    static void operator delete(void* p, size_t size)
+                                         { NetworkPool::deallocate(p, size); }
 
     // ------------------------------------------------------------------------
     /** Allows one to read a buffer from the beginning again. */
@@ -0,0 +1,129 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2020 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+
+#include "network/packet_buffers.hpp"
+#include "utils/log.hpp"
+
+#include <cassert>
+
+// ----------------------------------------------------------------------------
+PacketBuffers::~PacketBuffers()
+{
+    for (Buffer* b : m_free)
+        delete b;
+}   // ~PacketBuffers
+
+// ----------------------------------------------------------------------------
+/** Creates a packet whose data is a (reused if possible) buffer of this
+ *  pool. Can be called from any thread.
+ *  \param size Size of the packet data.
+ *  \param flags Enet packet flags.
+ *  \return The packet, or NULL if enet could not allocate it.
+ */
+ENetPacket* PacketBuffers::createPacket(size_t size, uint32_t flags)
+{
+    Buffer* b = NULL;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_free.empty())
+        {
+            b = m_free.back();
+            m_free.pop_back();
+        }
+    }
+    if (b == NULL)
+    {
+        b = new Buffer();
+        b->m_owner = shared_from_this();
+    }
+    // Only allocates if the buffer has never been this large
+    b->m_data.resize(size);
+
+    ENetPacket* packet = enet_packet_create(b->m_data.data(), size,
+        flags | ENET_PACKET_FLAG_NO_ALLOCATE);
+    if (packet == NULL)
+    {
+        delete b;
+        return NULL;
+    }
+    packet->userData = b;
+    packet->freeCallback = freePacket;
+    return packet;
+}   // createPacket
+
+// ----------------------------------------------------------------------------
+/** Called by enet_packet_destroy (usually in the listening thread), gives
+ *  the buffer of the packet back to its pool.
+ */
+void PacketBuffers::freePacket(ENetPacket* packet)
+{
+    Buffer* b = (Buffer*)packet->userData;
+    packet->userData = NULL;
+    packet->data = NULL;
+    std::shared_ptr<PacketBuffers> owner = b->m_owner.lock();
+    if (owner && b->m_data.capacity() <= MAX_BUFFER_CAPACITY)
+    {
+        std::lock_guard<std::mutex> lock(owner->m_mutex);
+        if (owner->m_free.size() < MAX_FREE)
+        {
+            owner->m_free.push_back(b);
+            return;
+        }
+    }
+    delete b;
+}   // freePacket
+
+// ----------------------------------------------------------------------------
+void PacketBuffers::unitTesting()
+{
+    std::shared_ptr<PacketBuffers> buffers =
+        std::make_shared<PacketBuffers>();
+
+    // A destroyed packet gives its buffer back, the next packet reuses it
+    ENetPacket* p = buffers->createPacket(100, ENET_PACKET_FLAG_RELIABLE);
+    if (p == NULL || p->dataLength != 100 ||
+        (p->flags & ENET_PACKET_FLAG_RELIABLE) == 0)
+        Log::fatal("PacketBuffers", "Wrong packet created.");
+    uint8_t* data = p->data;
+    enet_packet_destroy(p);
+    if (buffers->getFreeCount() != 1)
+        Log::fatal("PacketBuffers", "Buffer not given back.");
+    p = buffers->createPacket(50, 0);
+    if (p->data != data || p->dataLength != 50 ||
+        buffers->getFreeCount() != 0)
+        Log::fatal("PacketBuffers", "Buffer not reused.");
+
+    // More packets than free buffers kept
+    std::vector<ENetPacket*> packets;
+    for (size_t i = 0; i < MAX_FREE + 4; i++)
+        packets.push_back(buffers->createPacket(10, 0));
+    for (ENetPacket* q : packets)
+        enet_packet_destroy(q);
+    if (buffers->getFreeCount() != MAX_FREE)
+        Log::fatal("PacketBuffers", "Wrong number of free buffers.");
+
+    // Too large buffers are not kept
+    enet_packet_destroy(buffers->createPacket(MAX_BUFFER_CAPACITY + 1, 0));
+    if (buffers->getFreeCount() != MAX_FREE - 1)
+        Log::fatal("PacketBuffers", "Too large buffer kept.");
+
+    // A packet can outlive its pool (e.g. when a peer is removed)
+    buffers.reset();
+    enet_packet_destroy(p);
+}   // unitTesting
@@ -0,0 +1,83 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2020 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+
+#ifndef HEADER_PACKET_BUFFERS_HPP
+#define HEADER_PACKET_BUFFERS_HPP
+
+#include "utils/no_copy.hpp"
+#include "utils/types.hpp"
+
+#include <enet/enet.h>
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/** \ingroup network
+ *  The preallocated memory of the (encrypted) packets sent to one peer.
+ *  Packets are created with ENET_PACKET_FLAG_NO_ALLOCATE on a buffer of this
+ *  pool, and enet gives the buffer back through the free callback of the
+ *  packet once it has been sent (or acknowledged), so that a peer which
+ *  receives a state every frame reuses the same few buffers.
+ *  The packets can be destroyed by the listening thread after the peer (and
+ *  so this object) is gone, therefore each buffer only keeps a weak pointer
+ *  to its pool and is freed if the pool does not exist anymore. Objects must
+ *  be created with std::make_shared.
+ */
+class PacketBuffers : public std::enable_shared_from_this<PacketBuffers>,
+                      public NoCopy
+{
+private:
+    struct Buffer
+    {
+        std::weak_ptr<PacketBuffers> m_owner;
+        std::vector<uint8_t> m_data;
+    };
+
+    /** Maximum number of unused buffers kept, a peer rarely has more packets
+     *  waiting in enet. */
+    static const size_t MAX_FREE = 16;
+
+    /** Buffers with a larger capacity are freed when given back. */
+    static const size_t MAX_BUFFER_CAPACITY = 16384;
+
+    std::mutex m_mutex;
+
+    std::vector<Buffer*> m_free;
+
+    static void freePacket(ENetPacket* packet);
+
+public:
+    // ------------------------------------------------------------------------
+    ~PacketBuffers();
+    // ------------------------------------------------------------------------
+    ENetPacket* createPacket(size_t size, uint32_t flags);
+    // ------------------------------------------------------------------------
+    /** Returns the number of buffers which are not used by a packet. */
+    size_t getFreeCount()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_free.size();
+    }   // getFreeCount
+    // ------------------------------------------------------------------------
+    static void unitTesting();
+};   // class PacketBuffers
+
+#endif
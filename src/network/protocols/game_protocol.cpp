@@ -30,12 +30,17 @@
 #include "network/protocol_manager.hpp"
 #include "network/rewind_info.hpp"
 #include "network/rewind_manager.hpp"
+#include "network/server_config.hpp"
+#include "network/state_delta.hpp"
 #include "network/stk_host.hpp"
 #include "network/stk_peer.hpp"
 #include "utils/log.hpp"
 #include "utils/time.hpp"
 #include "main_loop.hpp"
 
+#include <algorithm>
+#include <memory>
+
 // ============================================================================
 std::weak_ptr<GameProtocol> GameProtocol::m_game_protocol;
 // ============================================================================
@@ -125,6 +130,8 @@ bool GameProtocol::notifyEventAsynchronous(Event* event)
     {
     case GP_CONTROLLER_ACTION: handleControllerAction(event); break;
     case GP_STATE:             handleState(event);            break;
+    case GP_STATE_DELTA:       handleStateDelta(event);       break;
+    case GP_STATE_ACK:         handleStateAck(event);         break;
     case GP_ITEM_CONFIRMATION: handleItemEventConfirmation(event); break;
     case GP_ADJUST_TIME:
     case GP_ITEM_UPDATE:
@@ -323,14 +330,90 @@ void GameProtocol::finalizeState(std::vector<std::string>& cur_rewinder)
 
 // ----------------------------------------------------------------------------
 /** Called when the last state information has been added and the message
- *  can be sent to the clients.
+ *  can be sent to the clients. If state delta compression is enabled, each
+ *  client which supports it will receive the difference to the latest state
+ *  it acknowledged instead, unless that state is too old (e.g. because of
+ *  packet loss), in which case the full state is sent.
  */
 void GameProtocol::sendState()
 {
     assert(NetworkConfig::get()->isServer());
-    sendMessageToPeers(m_data_to_send, /*reliable*/false);
+    if (!ServerConfig::m_state_delta_compression)
+    {
+        sendMessageToPeers(m_data_to_send, /*reliable*/false);
+        return;
+    }
+
+    // Skip protocol type, gp event type and ticks
+    const int ticks = World::getWorld()->getTicksSinceStart();
+    const std::vector<uint8_t>& buffer = m_data_to_send->getBuffer();
+    std::vector<uint8_t> state(buffer.begin() + 1 + 1 + 4, buffer.end());
+
+    // Peers acknowledging the same baseline share the same delta
+    std::map<int, std::unique_ptr<NetworkString> > deltas;
+    auto peers = STKHost::get()->getPeers();
+    std::vector<std::tuple<ENetPeer*, ENetPacket*, uint32_t,
+        ENetCommandType> > cmds;
+    cmds.reserve(peers.size());
+    for (auto& peer : peers)
+    {
+        if (!peer->isValidated() || peer->isWaitingForGame())
+            continue;
+        NetworkString* ns = m_data_to_send;
+        if (peer->getClientCapabilities().find("state_delta") !=
+            peer->getClientCapabilities().end())
+        {
+            int acked = -1;
+            std::unique_lock<std::mutex> ul(m_state_acks_mutex);
+            auto it = m_state_acks.find(peer->getHostId());
+            if (it != m_state_acks.end())
+                acked = it->second;
+            ul.unlock();
+
+            auto& delta = deltas[acked];
+            if (!delta)
+            {
+                for (auto& rs : m_recent_states)
+                {
+                    if (rs.first != acked)
+                        continue;
+                    delta.reset(getNetworkString());
+                    delta->addUInt8(GP_STATE_DELTA).addUInt32(ticks)
+                        .addUInt32(acked);
+                    StateDelta::encode(rs.second, state, delta.get());
+                    break;
+                }
+            }
+            if (delta &&
+                delta->getTotalSize() < m_data_to_send->getTotalSize())
+                ns = delta.get();
+        }
+        ENetPacket* packet = peer->createPacket(ns, /*reliable*/false);
+        if (packet)
+        {
+            cmds.emplace_back(peer->getENetPeer(), packet,
+                EVENT_CHANNEL_NORMAL, ECT_SEND_PACKET);
+        }
+    }
+    STKHost::get()->addEnetCommands(cmds);
+    addRecentState(ticks, state);
 }   // sendState
 
+// ----------------------------------------------------------------------------
+/** Stores a full state to be used as baseline for future delta compressed
+ *  states. About one second of states is kept, older baselines are removed.
+ *  \param ticks Time of the state.
+ *  \param state The state content (rewinder names and rewinder states).
+ */
+void GameProtocol::addRecentState(int ticks, const std::vector<uint8_t>& state)
+{
+    m_recent_states.emplace_back(ticks, state);
+    const size_t max_states =
+        std::max(NetworkConfig::get()->getStateFrequency(), 1) + 1;
+    while (m_recent_states.size() > max_states)
+        m_recent_states.pop_front();
+}   // addRecentState
+
 // ----------------------------------------------------------------------------
 /** Called when a new full state is received form the server.
  */
@@ -340,7 +423,82 @@ void GameProtocol::handleState(Event *event)
         return;
     NetworkString &data = event->data();
     int ticks          = data.getUInt32();
+    if (NetworkConfig::get()->getServerCapabilities().find("state_delta") !=
+        NetworkConfig::get()->getServerCapabilities().end())
+    {
+        std::vector<uint8_t> state(data.getBuffer().begin() +
+            data.getCurrentOffset(), data.getBuffer().end());
+        addRecentState(ticks, state);
+        NetworkString* ack = getNetworkString(5);
+        ack->addUInt8(GP_STATE_ACK).addUInt32(ticks);
+        sendToServer(ack, /*reliable*/false);
+        delete ack;
+    }
+    addNetworkState(ticks, data);
+}   // handleState
+
+// ----------------------------------------------------------------------------
+/** Called when a delta compressed state is received from the server. The
+ *  full state is reconstructed from the baseline state it refers to, which
+ *  this client acknowledged before. If the baseline is not available anymore
+ *  the state is ignored, the server will send a full state later.
+ */
+void GameProtocol::handleStateDelta(Event *event)
+{
+    if (!NetworkConfig::get()->isClient() || !checkDataSize(event, 8))
+        return;
+    NetworkString &data = event->data();
+    int ticks          = data.getUInt32();
+    int baseline_ticks = data.getUInt32();
+    auto it = std::find_if(m_recent_states.begin(), m_recent_states.end(),
+        [baseline_ticks](const std::pair<int, std::vector<uint8_t> >& rs)
+        {
+            return rs.first == baseline_ticks;
+        });
+    if (it == m_recent_states.end())
+    {
+        Log::debug("GameProtocol", "Missing baseline state %d for state %d.",
+            baseline_ticks, ticks);
+        return;
+    }
 
+    BareNetworkString state;
+    if (!StateDelta::decode(it->second, &data, &state.getBuffer()))
+    {
+        Log::warn("GameProtocol", "Received invalid delta state %d.", ticks);
+        return;
+    }
+    addRecentState(ticks, state.getBuffer());
+    NetworkString* ack = getNetworkString(5);
+    ack->addUInt8(GP_STATE_ACK).addUInt32(ticks);
+    sendToServer(ack, /*reliable*/false);
+    delete ack;
+    addNetworkState(ticks, state);
+}   // handleStateDelta
+
+// ----------------------------------------------------------------------------
+/** Handles a state acknowledgement from a client, the acknowledged state
+ *  will then be used as baseline for the following delta compressed states
+ *  sent to this client.
+ */
+void GameProtocol::handleStateAck(Event *event)
+{
+    if (!NetworkConfig::get()->isServer() || !checkDataSize(event, 4))
+        return;
+    int ticks = event->data().getUInt32();
+    std::lock_guard<std::mutex> lock(m_state_acks_mutex);
+    auto ret = m_state_acks.emplace(event->getPeer()->getHostId(), ticks);
+    if (!ret.second && ret.first->second < ticks)
+        ret.first->second = ticks;
+}   // handleStateAck
+
+// ----------------------------------------------------------------------------
+/** Adds a full state received from the server to the rewind manager.
+ *  \param ticks Time of the state.
+ *  \param data The state, read from the list of rewinders using.
+ */
+void GameProtocol::addNetworkState(int ticks, BareNetworkString& data)
+{
     // Check for updated rewinder using
     unsigned rewinder_size = data.getUInt8();
     std::vector<std::string> rewinder_using;
@@ -355,7 +513,7 @@ void GameProtocol::handleState(Event *event)
     RewindInfoState* ris = new RewindInfoState(ticks, data.getCurrentOffset(),
         rewinder_using, data.getBuffer());
     RewindManager::get()->addNetworkRewindInfo(ris);
-}   // handleState
+}   // addNetworkState
 
 // ----------------------------------------------------------------------------
 /** Called from the RewindManager when rolling back.
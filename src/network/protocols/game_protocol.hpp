@@ -27,6 +27,8 @@
 #include "utils/singleton.hpp"
 
 #include <cstdlib>
+#include <deque>
+#include <map>
 #include <mutex>
 #include <vector>
 #include <tuple>
@@ -48,7 +50,9 @@ private:
            GP_STATE,
            GP_ITEM_UPDATE,
            GP_ITEM_CONFIRMATION,
-           GP_ADJUST_TIME
+           GP_ADJUST_TIME,
+           GP_STATE_DELTA,
+           GP_STATE_ACK
     };
 
     /** A network string that collects all information from the server to be sent
@@ -73,8 +77,24 @@ private:
     // List of all kart actions to send to the server
     std::vector<Action> m_all_actions;
 
+    /** The most recent full states (without the ticks) sent by the server
+     *  or received by a client, which are used as baseline for delta
+     *  compressed states. */
+    std::deque<std::pair<int, std::vector<uint8_t> > > m_recent_states;
+
+    /** Server only: ticks of the latest state acknowledged by each peer,
+     *  indexed by host id. */
+    std::map<uint32_t, int> m_state_acks;
+
+    /** Protect \ref m_state_acks, which is written by the protocol thread. */
+    std::mutex m_state_acks_mutex;
+
     void handleControllerAction(Event *event);
     void handleState(Event *event);
+    void handleStateDelta(Event *event);
+    void handleStateAck(Event *event);
+    void addRecentState(int ticks, const std::vector<uint8_t>& state);
+    void addNetworkState(int ticks, BareNetworkString& data);
     void handleAdjustTime(Event *event);
     void handleItemEventConfirmation(Event *event);
     static std::weak_ptr<GameProtocol> m_game_protocol;
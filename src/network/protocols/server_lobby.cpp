@@ -2974,9 +2974,13 @@ void ServerLobby::handleUnencryptedConnection(std::shared_ptr<STKPeer> peer,
     message_ack->addUInt8(LE_CONNECTION_ACCEPTED).addUInt32(peer->getHostId())
         .addUInt32(ServerConfig::m_server_version);
 
-    message_ack->addUInt16(
-        (uint16_t)stk_config->m_network_capabilities.size());
-    for (const std::string& cap : stk_config->m_network_capabilities)
+    // Clients only acknowledge states (which are used as delta baselines)
+    // if this server sends delta compressed states
+    std::set<std::string> capabilities = stk_config->m_network_capabilities;
+    if (!ServerConfig::m_state_delta_compression)
+        capabilities.erase("state_delta");
+    message_ack->addUInt16((uint16_t)capabilities.size());
+    for (const std::string& cap : capabilities)
         message_ack->encodeString(cap);
 
     message_ack->addFloat(auto_start_timer)
@@ -20,6 +20,7 @@
 #define HEADER_REWIND_INFO_HPP
 
 #include "network/event_rewinder.hpp"
+#include "network/network_pool.hpp"
 #include "network/network_string.hpp"
 #include "utils/cpp2011.hpp"
 #include "utils/leak_check.hpp"
@@ -68,6 +69,12 @@ public:
     virtual void replay() = 0;
     // ------------------------------------------------------------------------
     virtual ~RewindInfo() { }
+    /** Rewind infos are created for each state and event, so their memory
+     *  is taken from the network pool. */
+    static void* operator new(size_t size)
+                                       { return NetworkPool::allocate(size); }
+    static void operator delete(void* p, size_t size)
+                                         { NetworkPool::deallocate(p, size); }
     // ------------------------------------------------------------------------
     /** Returns the time at which this RewindInfo was saved. */
     int getTicks() const { return m_ticks; }
@@ -114,6 +121,14 @@ public:
     /** Returns a pointer to the state buffer. */
     BareNetworkString *getBuffer() const { return m_buffer; }
     // ------------------------------------------------------------------------
+    /** Returns the unique identities of the rewinders in this state, in the
+     *  order in which their data is stored. */
+    const std::vector<std::string>& getRewinderUsing() const
+                                                   { return m_rewinder_using; }
+    // ------------------------------------------------------------------------
+    /** Returns the offset of the data of the first rewinder in the buffer. */
+    int getStartOffset() const                       { return m_start_offset; }
+    // ------------------------------------------------------------------------
     virtual bool isState() const { return true; }
     // ------------------------------------------------------------------------
     /** Called when going back in time to undo any rewind information.
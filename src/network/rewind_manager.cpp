@@ -33,11 +33,13 @@
 #include "tracks/track_object_manager.hpp"
 #include "utils/log.hpp"
 #include "utils/profiler.hpp"
+#include "utils/string_utils.hpp"
 
 #include <algorithm>
 
 RewindManager* RewindManager::m_rewind_manager = NULL;
 bool           RewindManager::m_enable_rewind_manager = false;
+bool           RewindManager::m_incremental_rewind = true;
 
 /** Creates the singleton. */
 RewindManager *RewindManager::create()
@@ -61,6 +63,7 @@ void RewindManager::destroy()
  */
 RewindManager::RewindManager()
 {
+    m_states_received = 0;
     reset();
 }   // RewindManager
 
@@ -80,6 +83,9 @@ RewindManager::~RewindManager()
  */
 void RewindManager::reset()
 {
+    if (m_states_received > 0)
+        Log::info("RewindManager", "%s", getRewindStats().c_str());
+    m_states_received = m_rewinds_skipped = m_rewinds_corrected = 0;
     m_is_rewinding = false;
     m_not_rewound_ticks.store(0);
     m_overall_state_size = 0;
@@ -90,6 +96,7 @@ void RewindManager::reset()
 
     clearExpiredRewinder();
     m_rewind_queue.reset();
+    m_predicted_state.clear();
 }   // reset
 
 // ----------------------------------------------------------------------------    
@@ -160,8 +167,8 @@ void RewindManager::saveState()
 
     for (auto& p : m_all_rewinder)
     {
-        // TODO: check if it's worth passing in a sufficiently large buffer from
-        // GameProtocol - this would save the copy operation.
+        // The buffer and its memory come from the network pool, so saving
+        // a state does not allocate once the pool is warmed up.
         BareNetworkString* buffer = NULL;
         if (auto r = p.second.lock())
             buffer = r->saveState(&rewinder_using);
@@ -185,11 +192,20 @@ void RewindManager::update(int ticks_not_used)
 {
     // FIXME: rename ticks_not_used
     if (!m_enable_rewind_manager ||
-        m_all_rewinder.size() == 0 ||
-        m_is_rewinding)  return;
+        m_all_rewinder.size() == 0)  return;
 
     int ticks = World::getWorld()->getTicksSinceStart();
 
+    if (m_is_rewinding)
+    {
+        // The replay of a rewind changes the predictions of all following
+        // states, so they must be saved again
+        if (NetworkConfig::get()->isClient() && m_incremental_rewind &&
+            shouldSaveState(ticks))
+            savePredictedState(ticks);
+        return;
+    }
+
     m_not_rewound_ticks.store(ticks, std::memory_order_relaxed);
 
     if (!shouldSaveState(ticks))
@@ -205,6 +221,8 @@ void RewindManager::update(int ticks_not_used)
             if (auto r = p.second.lock())
                 ret.push_back(r->getLocalStateRestoreFunction());
         }
+        if (m_incremental_rewind)
+            savePredictedState(ticks);
     }
     else
     {
@@ -216,6 +234,131 @@ void RewindManager::update(int ticks_not_used)
     PROFILER_POP_CPU_MARKER();
 }   // update
 
+// ----------------------------------------------------------------------------
+/** Saves the state each rewinder predicts for the given ticks on a client,
+ *  which is compared with the state received from the server later.
+ *  \param ticks Ticks at which the server saves a state.
+ */
+void RewindManager::savePredictedState(int ticks)
+{
+    auto& predicted = m_predicted_state[ticks];
+    predicted.clear();
+    for (auto& p : m_all_rewinder)
+    {
+        if (auto r = p.second.lock())
+        {
+            predicted[p.first] =
+                std::unique_ptr<BareNetworkString>(r->savePredictedState());
+        }
+    }
+}   // savePredictedState
+
+// ----------------------------------------------------------------------------
+/** Called on a client when a state in the past was received, before
+ *  rewinding to it. If the state of each rewinder matches the state the
+ *  client predicted for the same ticks, the rewind is not needed. If some
+ *  rewinders only have a small error, it is corrected directly in their
+ *  current state, which is much cheaper than replaying all ticks since the
+ *  state.
+ *  \param rewind_ticks Time of the received state.
+ *  \param world_ticks Current world time.
+ *  \return True if the rewind is not needed anymore.
+ */
+bool RewindManager::checkPredictedState(int rewind_ticks, int world_ticks)
+{
+    // Network events received after the state have not been simulated yet
+    if (m_rewind_queue.getLatestUnplayedEventTicks() >= rewind_ticks)
+        return false;
+    auto predicted = m_predicted_state.find(rewind_ticks);
+    if (predicted == m_predicted_state.end())
+        return false;
+    RewindInfoState* state = m_rewind_queue.getConfirmedState(rewind_ticks);
+    if (!state)
+        return false;
+
+    struct Correction
+    {
+        std::shared_ptr<Rewinder> m_rewinder;
+        const BareNetworkString* m_predicted;
+        BareNetworkString m_received;
+    };
+    std::vector<Correction> corrections;
+    BareNetworkString* buffer = state->getBuffer();
+    unsigned found = 0;
+    try
+    {
+        buffer->reset();
+        buffer->skip(state->getStartOffset());
+        for (const std::string& name : state->getRewinderUsing())
+        {
+            const uint16_t data_size = buffer->getUInt16();
+            if (data_size > buffer->size())
+                return false;
+            std::shared_ptr<Rewinder> r = getRewinder(name);
+            auto it = predicted->second.find(name);
+            if (!r || it == predicted->second.end() || !it->second)
+                return false;
+            BareNetworkString received(buffer->getCurrentData(), data_size);
+            buffer->skip(data_size);
+            Rewinder::PredictionResult result =
+                r->comparePredictedState(*it->second, received);
+            if (result == Rewinder::PR_WRONG)
+                return false;
+            if (result == Rewinder::PR_CORRECTABLE)
+            {
+                Correction c = { r, it->second.get(), std::move(received) };
+                corrections.push_back(std::move(c));
+            }
+            found++;
+        }
+    }
+    catch (std::exception&)
+    {
+        return false;
+    }
+
+    // A rewinder which the server did not save (e.g. a kart eliminated
+    // on the server only) needs the rewind, too
+    for (auto& p : predicted->second)
+    {
+        if (p.second)
+            found--;
+    }
+    if (found != 0)
+        return false;
+
+    for (Correction& c : corrections)
+        c.m_rewinder->correctPredictedState(*c.m_predicted, c.m_received);
+
+    m_rewind_queue.skipRewind(world_ticks);
+    for (auto it = m_local_state.begin(); it != m_local_state.end();)
+    {
+        if (it->first <= rewind_ticks)
+            it = m_local_state.erase(it);
+        else
+            break;
+    }
+    m_predicted_state.erase(m_predicted_state.begin(), ++predicted);
+    if (corrections.empty())
+        m_rewinds_skipped++;
+    else
+        m_rewinds_corrected++;
+    return true;
+}   // checkPredictedState
+
+// ----------------------------------------------------------------------------
+/** Returns how many received states did not need a full rewind. */
+std::string RewindManager::getRewindStats() const
+{
+    const unsigned full = m_states_received - m_rewinds_skipped -
+        m_rewinds_corrected;
+    return StringUtils::insertValues("%d states received: %d rewinds "
+        "skipped, %d corrected without replay, %d full rewinds, %d "
+        "percent avoided.", m_states_received, m_rewinds_skipped,
+        m_rewinds_corrected, full, m_states_received == 0 ? 0 :
+        (m_states_received - full) * 100 / m_states_received);
+}   // getRewindStats
+
 // ----------------------------------------------------------------------------
 /** Replays all events from the last event played till the specified time.
  *  \param world_ticks Up to (and inclusive) which time events will be replayed.
@@ -237,6 +380,14 @@ void RewindManager::playEventsTill(int world_ticks, bool fast_forward)
     // be getTime()+dt - world time has not been updated yet).
     m_rewind_queue.mergeNetworkData(world_ticks, &needs_rewind, &rewind_ticks);
 
+    if (needs_rewind && NetworkConfig::get()->isClient())
+    {
+        m_states_received++;
+        if (m_incremental_rewind && !fast_forward &&
+            checkPredictedState(rewind_ticks, world_ticks))
+            needs_rewind = false;
+    }
+
     if (needs_rewind)
     {
         Log::setPrefix("Rewind");
@@ -348,6 +499,9 @@ void RewindManager::rewindTo(int rewind_ticks, int now_ticks,
             exact_rewind_ticks);
     }
 
+    // The predictions after the rewind ticks are saved again during replay
+    m_predicted_state.clear();
+
     // A loop in case that we should split states into several smaller ones:
     while (current && current->getTicks() == exact_rewind_ticks && 
            current->isState()                                        )
@@ -94,6 +94,13 @@ private:
 
     std::map<int, std::vector<std::function<void()> > > m_local_state;
 
+    /** The states of each rewinder predicted by a client at the ticks a
+     *  server saves a state, see checkPredictedState. A NULL state means
+     *  that the rewinder can not check its prediction. */
+    std::map<int, std::map<std::string,
+                           std::unique_ptr<BareNetworkString> > >
+                                                          m_predicted_state;
+
     /** A list of all objects that can be rewound. */
     std::map<std::string, std::weak_ptr<Rewinder> > m_all_rewinder;
 
@@ -116,6 +123,14 @@ private:
 
     std::vector<RewindInfoEventFunction*> m_pending_rief;
 
+    /** If set, a client skips rewinds if the received state matches its
+     *  prediction. */
+    static bool m_incremental_rewind;
+
+    /** Number of received states handled by a client, and how many of them
+     *  did not need a rewind, or could be corrected without replaying. */
+    unsigned m_states_received, m_rewinds_skipped, m_rewinds_corrected;
+
     RewindManager();
    ~RewindManager();
     // ------------------------------------------------------------------------
@@ -133,6 +148,10 @@ private:
     }
     // ------------------------------------------------------------------------
     void mergeRewindInfoEventFunction();
+    // ------------------------------------------------------------------------
+    void savePredictedState(int ticks);
+    // ------------------------------------------------------------------------
+    bool checkPredictedState(int rewind_ticks, int world_ticks);
 
 public:
     // First static functions to manage rewinding.
@@ -146,6 +165,9 @@ public:
     /** Returns if rewinding is enabled or not. */
     static bool isEnabled() { return m_enable_rewind_manager; }
     // ------------------------------------------------------------------------
+    /** En- or disables skipping rewinds of correctly predicted states. */
+    static void setIncrementalRewind(bool m)   { m_incremental_rewind = m; }
+    // ------------------------------------------------------------------------
     /** Returns the singleton. This function will not automatically create
      *  the singleton. */
     static RewindManager *get()
@@ -210,6 +232,8 @@ public:
     }
     // ------------------------------------------------------------------------
     void resetSmoothNetworkBody();
+    // ------------------------------------------------------------------------
+    std::string getRewindStats() const;
 };   // RewindManager
 
 
@@ -27,7 +27,10 @@
 #include "network/rewind_info.hpp"
 #include "network/rewind_manager.hpp"
 
+#include "utils/time.hpp"
+
 #include <algorithm>
+#include <list>
 
 /** The RewindQueue stores one TimeStepInfo for each time step done.
  *  The TimeStepInfo stores all states and events to be used at the
@@ -74,15 +77,49 @@ void RewindQueue::reset()
     m_network_events.getData().clear();
     m_network_events.unlock();
 
-    AllRewindInfo::const_iterator i;
+    for (RewindInfo* ri : m_pending_network_events)
+        delete ri;
+    m_pending_network_events.clear();
+
+    AllRewindInfo::iterator i;
     for (i = m_all_rewind_info.begin(); i != m_all_rewind_info.end(); ++i)
         delete *i;
 
     m_all_rewind_info.clear();
     m_current = m_all_rewind_info.end();
     m_latest_confirmed_state_time = -1;
+    m_latest_unplayed_event_ticks = -1;
 }   // reset
 
+// ----------------------------------------------------------------------------
+/** Inserts a RewindInfo before the given position, moving all following
+ *  slots by one. The slots are doubled when full.
+ *  \param pos Position before which to insert.
+ *  \param ri The RewindInfo to insert.
+ *  \return Iterator pointing to the inserted element.
+ */
+RewindQueue::AllRewindInfo::iterator
+    RewindQueue::AllRewindInfo::insert(iterator pos, RewindInfo* ri)
+{
+    if (m_size == m_slots.size())
+    {
+        std::vector<Slot> slots(m_slots.size() * 2);
+        for (unsigned i = 0; i < m_size; i++)
+            slots[i] = slot(i);
+        m_slots.swap(slots);
+        m_first = 0;
+    }
+    for (unsigned i = m_size; i > pos.m_index; i--)
+        slot(i) = slot(i - 1);
+    Slot& s = slot(pos.m_index);
+    s.m_ticks = ri->getTicks();
+    s.m_is_event = ri->isEvent();
+    s.m_is_confirmed = ri->isConfirmed();
+    s.m_info = ri;
+    m_size++;
+    return iterator(this, pos.m_index);
+}   // AllRewindInfo::insert
+
 // ----------------------------------------------------------------------------
 /** Inserts a RewindInfo object in the list of all events at the correct time.
  *  If there are several RewindInfo at the exact same time, state RewindInfo
@@ -94,23 +131,31 @@ void RewindQueue::reset()
  */
 void RewindQueue::insertRewindInfo(RewindInfo *ri)
 {
-    AllRewindInfo::iterator i = m_all_rewind_info.end();
-
-    while (i != m_all_rewind_info.begin())
+    // Binary search for the first element that ri must be inserted before
+    const int ticks = ri->getTicks();
+    const bool is_event = ri->isEvent();
+    unsigned low = 0;
+    unsigned high = m_all_rewind_info.size();
+    while (low < high)
     {
-        AllRewindInfo::iterator i_prev = i;
-        i_prev--;
-        // Now test if 'ri' needs to be inserted after the
-        // previous element, i.e. before the current element:
-        if ((*i_prev)->getTicks() < ri->getTicks()) break;
-        if ((*i_prev)->getTicks() == ri->getTicks() &&
-            ri->isEvent()                              ) break;
-        i = i_prev;
+        unsigned mid = (low + high) / 2;
+        int mid_ticks = AllRewindInfo::iterator(&m_all_rewind_info, mid)
+            .getTicks();
+        if (mid_ticks < ticks || (mid_ticks == ticks && is_event))
+            low = mid + 1;
+        else
+            high = mid;
     }
-    if(m_current == m_all_rewind_info.end())
-        m_current = m_all_rewind_info.insert(i, ri);
-    else
-        m_all_rewind_info.insert(i, ri);  
+
+    const bool current_at_end = m_current == m_all_rewind_info.end();
+    AllRewindInfo::iterator i = m_all_rewind_info.insert(
+        AllRewindInfo::iterator(&m_all_rewind_info, low), ri);
+    // Keep m_current on the same element (the index of which was increased
+    // if it is after the new element)
+    if (current_at_end)
+        m_current = i;
+    else if (i.getIndex() <= m_current.getIndex())
+        m_current++;
 }   // insertRewindInfo
 
 // ----------------------------------------------------------------------------
@@ -203,11 +248,20 @@ void RewindQueue::mergeNetworkData(int world_ticks, bool *needs_rewind,
 {
     *needs_rewind = false;
     m_network_events.lock();
-    if(m_network_events.getData().empty())
+    // Events received earlier for a future tick are still pending, so they
+    // must be checked even if nothing new was received.
+    if(m_network_events.getData().empty() &&
+       m_pending_network_events.empty())
     {
         m_network_events.unlock();
         return;
     }
+    // Only hold the lock for moving the new events, the network thread can
+    // add more while they are merged
+    m_pending_network_events.insert(m_pending_network_events.end(),
+        m_network_events.getData().begin(), m_network_events.getData().end());
+    m_network_events.getData().clear();
+    m_network_events.unlock();
 
     // Merge all newly received network events into the main event list.
     // Only a client ever rewinds. So the rewind time should be the latest
@@ -217,27 +271,28 @@ void RewindQueue::mergeNetworkData(int world_ticks, bool *needs_rewind,
     // FIXME: making m_network_events sorted would prevent the need to 
     // go through the whole list of events
     int latest_confirmed_state = -1;
-    AllNetworkRewindInfo::iterator i = m_network_events.getData().begin();
-    while (i != m_network_events.getData().end())
+    // Events which are kept for later are moved to the front
+    unsigned kept = 0;
+    for (unsigned n = 0; n < m_pending_network_events.size(); n++)
     {
+        RewindInfo* ri = m_pending_network_events[n];
         // Ignore any events that will happen in the future. The current
         // time step is world_ticks.
-        if ((*i)->getTicks() > world_ticks)
+        if (ri->getTicks() > world_ticks)
         {
-            i++;
+            m_pending_network_events[kept++] = ri;
             continue;
         }
         // Any state of event that is received before the latest confirmed
         // state can be deleted.
-        if ((*i)->getTicks() < m_latest_confirmed_state_time)
+        if (ri->getTicks() < m_latest_confirmed_state_time)
         {
             Log::info("RewindQueue",
                       "Deleting %s at %d because it's before confirmed state %d",
-                      (*i)->isEvent() ? "event" : "state",
-                      (*i)->getTicks(),
+                      ri->isEvent() ? "event" : "state",
+                      ri->getTicks(),
                       m_latest_confirmed_state_time);
-            delete *i;
-            i = m_network_events.getData().erase(i);
+            delete ri;
             continue;
         }
 
@@ -245,21 +300,29 @@ void RewindQueue::mergeNetworkData(int world_ticks, bool *needs_rewind,
         // duplicated states, which in the best case would then have
         // a negative effect for every player, when in fact only one
         // player might have a network hickup).
-        if (NetworkConfig::get()->isServer() && (*i)->getTicks() < world_ticks)
+        if (NetworkConfig::get()->isServer() && ri->getTicks() < world_ticks)
         {
             if (Network::m_connection_debug)
             {
                 Log::warn("RewindQueue",
                     "Server received at %d message from %d",
-                    world_ticks, (*i)->getTicks());
+                    world_ticks, ri->getTicks());
             }
             // Server received an event in the past. Adjust this event
             // to be executed 'now' - at least we get a bit closer to the
             // client state.
-            (*i)->setTicks(world_ticks);
+            ri->setTicks(world_ticks);
         }
 
-        insertRewindInfo(*i);
+        insertRewindInfo(ri);
+
+        // An event in the past of a client is only replayed by the next
+        // rewind, so a rewind can not be skipped (see
+        // RewindManager::checkPredictedState) if it is after the state.
+        if (NetworkConfig::get()->isClient() && ri->isEvent() &&
+            ri->getTicks() < world_ticks &&
+            ri->getTicks() > m_latest_unplayed_event_ticks)
+            m_latest_unplayed_event_ticks = ri->getTicks();
 
         // Check if a rewind is necessary, i.e. a message is received in the
         // past of client (server never rewinds). Even if
@@ -268,7 +331,7 @@ void RewindQueue::mergeNetworkData(int world_ticks, bool *needs_rewind,
         // happen during debugging) we need to rewind to getTicks (in order
         // to get the latest state).
         if (NetworkConfig::get()->isClient() &&
-            (*i)->getTicks() <= world_ticks && (*i)->isState())
+            ri->getTicks() <= world_ticks && ri->isState())
         {
             // We need rewind if we receive an event in the past. This will
             // then trigger a rewind later. Note that we only rewind to the
@@ -279,20 +342,17 @@ void RewindQueue::mergeNetworkData(int world_ticks, bool *needs_rewind,
             // the earlier event, and the event will be replayed anyway. This
             // makes it easy to handle lost event messages.
             *needs_rewind = true;
-            if ((*i)->getTicks() > *rewind_ticks)
-                *rewind_ticks = (*i)->getTicks();
+            if (ri->getTicks() > *rewind_ticks)
+                *rewind_ticks = ri->getTicks();
         }   // if client and ticks < world_ticks
 
-        if ((*i)->isState() && (*i)->getTicks() > latest_confirmed_state &&
-            (*i)->isConfirmed())
+        if (ri->isState() && ri->getTicks() > latest_confirmed_state &&
+            ri->isConfirmed())
         {
-            latest_confirmed_state = (*i)->getTicks();
+            latest_confirmed_state = ri->getTicks();
         }
-
-        i = m_network_events.getData().erase(i);
-    }   // for i in m_network_events
-
-    m_network_events.unlock();
+    }   // for ri in m_pending_network_events
+    m_pending_network_events.resize(kept);
 
     if (latest_confirmed_state > m_latest_confirmed_state_time)
     {
@@ -327,19 +387,16 @@ void RewindQueue::mergeNetworkData(int world_ticks, bool *needs_rewind,
  */
 void RewindQueue::cleanupOldRewindInfo(int ticks)
 {
-    auto i = m_all_rewind_info.begin();
-
     while (!m_all_rewind_info.empty() &&
-        (*i)->getTicks() < ticks)
+        m_all_rewind_info.begin().getTicks() < ticks)
     {
-        if (m_current == i) next();
-        delete *i;
-        i = m_all_rewind_info.erase(i);
+        // If m_current is the removed element, it will point to the next
+        // element (which then has index 0)
+        if (m_current.getIndex() > 0)
+            m_current--;
+        delete m_all_rewind_info.front();
+        m_all_rewind_info.popFront();
     }
-
-    if (m_all_rewind_info.empty())
-        m_current = m_all_rewind_info.end();
-
 }   // cleanupOldRewindInfo
 
 // ----------------------------------------------------------------------------
@@ -369,27 +426,85 @@ int RewindQueue::undoUntil(int undo_ticks)
     // makes sure that m_current is not end()
     //assert(m_current != m_all_rewind_info.end());
     assert(!m_all_rewind_info.empty());
-    m_current = m_all_rewind_info.end();
-    m_current--;
-    while((*m_current)->getTicks() > undo_ticks ||
-        (*m_current)->isEvent() || !(*m_current)->isConfirmed())
+    unsigned i = m_all_rewind_info.size() - 1;
+    while (true)
     {
+        const AllRewindInfo::Slot& s = m_all_rewind_info.slot(i);
+        if (s.m_ticks <= undo_ticks && !s.m_is_event && s.m_is_confirmed)
+            break;
         // Undo all events and states from the current time
-        (*m_current)->undo();
-        if(m_current == m_all_rewind_info.begin())
+        s.m_info->undo();
+        if (i == 0)
         {
             // This shouldn't happen, but add some debug info just in case
             Log::error("undoUntil",
                        "At %d rewinding to %d current = %d = begin",
                        World::getWorld()->getTicksSinceStart(), undo_ticks, 
-                       (*m_current)->getTicks());
+                       s.m_ticks);
+            break;
         }
-        m_current--;
+        i--;
     }
-
-    return (*m_current)->getTicks();
+    m_current = AllRewindInfo::iterator(&m_all_rewind_info, i);
+    // All events after the state will be replayed now
+    m_latest_unplayed_event_ticks = -1;
+    return m_current.getTicks();
 }   // undoUntil
 
+// ----------------------------------------------------------------------------
+/** Returns the confirmed state at the given ticks, or NULL if there is none
+ *  or if it is split into several states.
+ *  \param ticks Time in ticks of the state.
+ */
+RewindInfoState* RewindQueue::getConfirmedState(int ticks) const
+{
+    // States are sorted before events with the same ticks
+    unsigned low = 0;
+    unsigned high = m_all_rewind_info.size();
+    while (low < high)
+    {
+        unsigned mid = (low + high) / 2;
+        if (m_all_rewind_info.slot(mid).m_ticks < ticks)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    if (low >= m_all_rewind_info.size())
+        return NULL;
+    const AllRewindInfo::Slot& s = m_all_rewind_info.slot(low);
+    if (s.m_ticks != ticks || s.m_is_event || !s.m_is_confirmed)
+        return NULL;
+    if (low + 1 < m_all_rewind_info.size())
+    {
+        const AllRewindInfo::Slot& next = m_all_rewind_info.slot(low + 1);
+        if (next.m_ticks == ticks && !next.m_is_event)
+            return NULL;
+    }
+    return dynamic_cast<RewindInfoState*>(s.m_info);
+}   // getConfirmedState
+
+// ----------------------------------------------------------------------------
+/** Called instead of a rewind when the received state matched the state
+ *  predicted by the client. Sets the current element to the first one at
+ *  the world time, which is where a rewind would have stopped.
+ *  \param world_ticks Current world time.
+ */
+void RewindQueue::skipRewind(int world_ticks)
+{
+    unsigned low = 0;
+    unsigned high = m_all_rewind_info.size();
+    while (low < high)
+    {
+        unsigned mid = (low + high) / 2;
+        if (m_all_rewind_info.slot(mid).m_ticks < world_ticks)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    m_current = AllRewindInfo::iterator(&m_all_rewind_info, low);
+    m_latest_unplayed_event_ticks = -1;
+}   // skipRewind
+
 // ----------------------------------------------------------------------------
 /** Replays all events (not states) that happened at the specified time.
  *  \param ticks Time in ticks.
@@ -397,12 +512,16 @@ int RewindQueue::undoUntil(int undo_ticks)
 void RewindQueue::replayAllEvents(int ticks)
 {
     // Replay all events that happened at the current time step
-    while ( hasMoreRewindInfo() && (*m_current)->getTicks() == ticks )
+    unsigned i = m_current.getIndex();
+    const unsigned size = m_all_rewind_info.size();
+    while (i < size && m_all_rewind_info.slot(i).m_ticks == ticks)
     {
-        if ((*m_current)->isEvent())
-            (*m_current)->replay();
-        m_current++;
+        const AllRewindInfo::Slot& s = m_all_rewind_info.slot(i);
+        if (s.m_is_event)
+            s.m_info->replay();
+        i++;
     }   // while current->getTIcks == ticks
+    m_current = AllRewindInfo::iterator(&m_all_rewind_info, i);
 
 }   // replayAllEvents
 
@@ -520,5 +639,120 @@ void RewindQueue::unitTesting()
     b2.mergeNetworkData(4, &needs_rewind, &rewind_ticks);
     assert((*b2.m_current)->getTicks() == 3);
 
+    // Skipping a rewind must find the state and leave m_current at the
+    // events of the current world time
+    RewindQueue b3;
+    b3.addLocalState(NULL, true, 2);
+    b3.addLocalEvent(NULL, NULL, true, 2);
+    b3.addLocalEvent(NULL, NULL, true, 3);
+    b3.addLocalEvent(NULL, NULL, true, 5);
+    if (b3.getConfirmedState(2) != b3.m_all_rewind_info.front() ||
+        b3.getConfirmedState(3) != NULL)
+        Log::fatal("RewindQueue", "Confirmed state not found correctly");
+    b3.skipRewind(3);
+    if (b3.getCurrent()->getTicks() != 3 || !b3.getCurrent()->isEvent())
+        Log::fatal("RewindQueue", "skipRewind(3) did not stop at tick 3");
+    b3.skipRewind(4);
+    if (b3.getCurrent()->getTicks() != 5)
+        Log::fatal("RewindQueue", "skipRewind(4) did not stop at tick 5");
+    b3.skipRewind(6);
+    if (b3.hasMoreRewindInfo())
+        Log::fatal("RewindQueue", "skipRewind(6) did not skip all events");
+
+    // 4) An event for a future tick is kept, and must be merged once its
+    //    tick is reached, even if nothing else was received since then.
+    RewindQueue b4;
+    b4.addNetworkEvent(dummy_rewinder.get(), NULL, 5);
+    b4.mergeNetworkData(3, &needs_rewind, &rewind_ticks);
+    if (!b4.m_all_rewind_info.empty())
+        Log::fatal("RewindQueue", "Future event merged too early");
+    b4.mergeNetworkData(5, &needs_rewind, &rewind_ticks);
+    if (b4.m_all_rewind_info.size() != 1 ||
+        b4.m_all_rewind_info.front()->getTicks() != 5)
+        Log::fatal("RewindQueue", "Pending future event was not merged");
 
 }   // unitTesting
+
+// ----------------------------------------------------------------------------
+/** Measures the rewind queue part of RewindManager::rewindTo for rewinds
+ *  over 60 to 120 ticks: undo all events back to the confirmed state,
+ *  restore it and replay the events of each tick. There are events of
+ *  8 karts at each tick. For comparison the same is done with the
+ *  previously used std::list of RewindInfo pointers, the nodes of which are
+ *  allocated in between the event buffers like it happened in game.
+ */
+void RewindQueue::benchmarkRewind()
+{
+    const int karts = 8;
+    const int iterations = 2000;
+    auto dummy_rewinder = std::make_shared<DummyRewinder>();
+
+    for (int rewind_ticks = 60; rewind_ticks <= 120; rewind_ticks += 30)
+    {
+        RewindQueue q;
+        std::list<RewindInfo*> list;
+        q.addLocalState(new BareNetworkString(), /*confirmed*/true, 0);
+        list.push_back(q.m_all_rewind_info.front());
+        for (int t = 0; t < rewind_ticks; t++)
+        {
+            for (int k = 0; k < karts; k++)
+            {
+                BareNetworkString* buffer = new BareNetworkString();
+                buffer->addUInt8(k).addUInt16(t);
+                q.addLocalEvent(dummy_rewinder.get(), buffer,
+                    /*confirmed*/true, t);
+                list.push_back(*(--q.m_all_rewind_info.end()));
+            }
+        }
+
+        uint64_t start = StkTime::getMonoTimeUs();
+        for (int n = 0; n < iterations; n++)
+        {
+            q.undoUntil(0);
+            RewindInfo* current = q.getCurrent();
+            while (current && current->getTicks() == 0 && current->isState())
+            {
+                current->restore();
+                q.next();
+                current = q.getCurrent();
+            }
+            for (int t = 0; t < rewind_ticks; t++)
+                q.replayAllEvents(t);
+        }
+        uint64_t ring = StkTime::getMonoTimeUs() - start;
+
+        start = StkTime::getMonoTimeUs();
+        for (int n = 0; n < iterations; n++)
+        {
+            auto current = list.end();
+            current--;
+            while ((*current)->getTicks() > 0 || (*current)->isEvent() ||
+                !(*current)->isConfirmed())
+            {
+                (*current)->undo();
+                current--;
+            }
+            while (current != list.end() && (*current)->getTicks() == 0 &&
+                (*current)->isState())
+            {
+                (*current)->restore();
+                current++;
+            }
+            for (int t = 0; t < rewind_ticks; t++)
+            {
+                while (current != list.end() && (*current)->getTicks() == t)
+                {
+                    if ((*current)->isEvent())
+                        (*current)->replay();
+                    current++;
+                }
+            }
+        }
+        uint64_t linked = StkTime::getMonoTimeUs() - start;
+
+        Log::info("Benchmark", "Rewind over %3d ticks (%d infos): ring "
+            "%7.2f us, list %7.2f us per rewind.", rewind_ticks,
+            q.m_all_rewind_info.size(), ring / (double)iterations,
+            linked / (double)iterations);
+    }
+}   // benchmarkRewind
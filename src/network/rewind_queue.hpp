@@ -22,12 +22,12 @@
 #include "utils/synchronised.hpp"
 
 #include <assert.h>
-#include <list>
 #include <vector>
 
 class BareNetworkString;
 class EventRewinder;
 class RewindInfo;
+class RewindInfoState;
 class TimeStepInfo;
 
 /** \ingroup network
@@ -37,7 +37,95 @@ class RewindQueue
 {
 private:
 
-    typedef std::list<RewindInfo*> AllRewindInfo;
+    /** All rewind infos sorted by ticks, stored in a ring buffer of
+     *  contiguous slots. Each slot keeps the ticks and type of its rewind
+     *  info, so finding a time or a confirmed state does not need to touch
+     *  the rewind info objects.
+     *  Elements are removed from the front only (old infos), and new ones
+     *  are almost always inserted close to the end, so inserting moves only
+     *  a few slots. Iterators are positions in this order and stay valid
+     *  while no element is inserted before them or removed. */
+    class AllRewindInfo
+    {
+    public:
+        struct Slot
+        {
+            int m_ticks;
+            bool m_is_event;
+            bool m_is_confirmed;
+            RewindInfo* m_info;
+        };
+    private:
+        /** The slots, the size is always a power of 2. */
+        std::vector<Slot> m_slots;
+
+        /** Index in m_slots of the first element. */
+        unsigned m_first;
+
+        /** Number of elements. */
+        unsigned m_size;
+
+        // --------------------------------------------------------------------
+        Slot& slot(unsigned i)
+                { return m_slots[(m_first + i) & (m_slots.size() - 1)]; }
+        // --------------------------------------------------------------------
+        const Slot& slot(unsigned i) const
+                { return m_slots[(m_first + i) & (m_slots.size() - 1)]; }
+        // --------------------------------------------------------------------
+        friend class RewindQueue;
+
+    public:
+        class iterator
+        {
+        private:
+            friend class AllRewindInfo;
+            const AllRewindInfo* m_all;
+            unsigned m_index;
+        public:
+            iterator() : m_all(NULL), m_index(0) {}
+            iterator(const AllRewindInfo* all, unsigned index)
+                : m_all(all), m_index(index) {}
+            RewindInfo* operator*() const
+                                   { return m_all->slot(m_index).m_info; }
+            int getTicks() const  { return m_all->slot(m_index).m_ticks; }
+            unsigned getIndex() const                   { return m_index; }
+            iterator& operator++()               { m_index++; return *this; }
+            iterator operator++(int)
+                               { iterator old = *this; m_index++; return old; }
+            iterator& operator--()               { m_index--; return *this; }
+            iterator operator--(int)
+                               { iterator old = *this; m_index--; return old; }
+            bool operator==(const iterator& o) const
+                        { return m_all == o.m_all && m_index == o.m_index; }
+            bool operator!=(const iterator& o) const
+                                                  { return !(*this == o); }
+        };   // iterator
+
+        AllRewindInfo() : m_slots(64), m_first(0), m_size(0) {}
+        // --------------------------------------------------------------------
+        iterator begin() const                 { return iterator(this, 0); }
+        // --------------------------------------------------------------------
+        iterator end() const              { return iterator(this, m_size); }
+        // --------------------------------------------------------------------
+        unsigned size() const                             { return m_size; }
+        // --------------------------------------------------------------------
+        bool empty() const                           { return m_size == 0; }
+        // --------------------------------------------------------------------
+        RewindInfo* front() const                 { return slot(0).m_info; }
+        // --------------------------------------------------------------------
+        /** Removes all elements (without deleting them). */
+        void clear()                               { m_first = m_size = 0; }
+        // --------------------------------------------------------------------
+        iterator insert(iterator pos, RewindInfo* ri);
+        // --------------------------------------------------------------------
+        /** Removes the first element (without deleting it). */
+        void popFront()
+        {
+            assert(m_size > 0);
+            m_first = (m_first + 1) & (unsigned)(m_slots.size() - 1);
+            m_size--;
+        }   // popFront
+    };   // class AllRewindInfo
 
     AllRewindInfo m_all_rewind_info;
 
@@ -49,17 +137,26 @@ private:
     typedef std::vector<RewindInfo*> AllNetworkRewindInfo;
     Synchronised<AllNetworkRewindInfo> m_network_events;
 
+    /** Network events taken from m_network_events which are still in the
+     *  future, only used by the main thread. */
+    AllNetworkRewindInfo m_pending_network_events;
+
     /** Iterator to the curren time step info to be handled. */
     AllRewindInfo::iterator m_current;
 
     /** Time at which the latest confirmed state is at. */
     int m_latest_confirmed_state_time;
 
+    /** Latest ticks of a network event which was received in the past of
+     *  a client and was not replayed yet, or -1. */
+    int m_latest_unplayed_event_ticks;
+
 
     void cleanupOldRewindInfo(int ticks);
 
 public:
         static void unitTesting();
+        static void benchmarkRewind();
 
          RewindQueue();
         ~RewindQueue();
@@ -83,6 +180,8 @@ public:
     bool hasMoreRewindInfo() const;
     int  undoUntil(int undo_ticks);
     void insertRewindInfo(RewindInfo *ri);
+    RewindInfoState* getConfirmedState(int ticks) const;
+    void skipRewind(int world_ticks);
 
     // ------------------------------------------------------------------------
     /** Returns the time of the latest confirmed state. */
@@ -91,6 +190,13 @@ public:
         return m_latest_confirmed_state_time;
     }
     // ------------------------------------------------------------------------
+    /** Returns the latest ticks of a network event received in the past
+     *  which was not replayed yet, or -1 if there is none. */
+    int getLatestUnplayedEventTicks() const
+    {
+        return m_latest_unplayed_event_ticks;
+    }
+    // ------------------------------------------------------------------------
     /** Sets the current element to be the next one and returns the next
      *  RewindInfo element. */
     void next()
@@ -18,8 +18,11 @@
 
 #include "network/rewinder.hpp"
 
+#include "network/network_string.hpp"
 #include "network/rewind_manager.hpp"
 
+#include <cstring>
+
 // ----------------------------------------------------------------------------
 /** Add this object to the list of all rewindable
  *  objects in the rewind manager.
@@ -28,3 +31,20 @@ bool Rewinder::rewinderAdd()
 {
     return RewindManager::get()->addRewinder(shared_from_this());
 }   // rewinderAdd
+
+// ----------------------------------------------------------------------------
+/** Compares a state received from the server with the state predicted for
+ *  the same ticks by savePredictedState(). By default the states must be
+ *  identical.
+ *  \param predicted The state saved by savePredictedState().
+ *  \param received The data of this rewinder in the received state.
+ */
+Rewinder::PredictionResult
+    Rewinder::comparePredictedState(const BareNetworkString& predicted,
+                                    const BareNetworkString& received)
+{
+    if (predicted.getTotalSize() != received.getTotalSize())
+        return PR_WRONG;
+    return memcmp(predicted.getData(), received.getData(),
+        predicted.getTotalSize()) == 0 ? PR_MATCH : PR_WRONG;
+}   // comparePredictedState
@@ -57,6 +57,15 @@ private:
     std::string m_unique_identity;
 
 public:
+    /** Result of comparing a state received from the server with the state
+     *  a client predicted for the same ticks. */
+    enum PredictionResult
+    {
+        PR_MATCH,       //!< Within tolerance, no rewind is needed.
+        PR_CORRECTABLE, //!< Small error, can be corrected without replay.
+        PR_WRONG        //!< A full rewind is needed.
+    };
+
     Rewinder(const std::string& ui = "")             { m_unique_identity = ui; }
 
     virtual ~Rewinder() {}
@@ -99,6 +108,24 @@ public:
      */
     virtual void undoState(BareNetworkString *buffer) = 0;
 
+    // -------------------------------------------------------------------------
+    /** Called on a client at the ticks at which the server saves a state.
+     *  Returns the state this rewinder would save on the server, which is
+     *  compared with the state received later to avoid unnecessary rewinds.
+     *  NULL means that the prediction of this rewinder can not be checked,
+     *  so any state received for it causes a rewind.
+     */
+    virtual BareNetworkString* savePredictedState()           { return NULL; }
+    // -------------------------------------------------------------------------
+    virtual PredictionResult comparePredictedState(
+                                        const BareNetworkString& predicted,
+                                        const BareNetworkString& received);
+    // -------------------------------------------------------------------------
+    /** Applies the difference between a received and the predicted state
+     *  (for which comparePredictedState returned PR_CORRECTABLE) to the
+     *  current state, without replaying the ticks in between. */
+    virtual void correctPredictedState(const BareNetworkString& predicted,
+                                       const BareNetworkString& received) {}
     // -------------------------------------------------------------------------
     /** Nothing to do here. */
     virtual void reset() {}
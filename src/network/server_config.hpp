@@ -125,6 +125,16 @@ namespace ServerConfig
         "Enable wan server, which requires you to have an stk-addons account "
         "with a saved session. Check init-user command for details."));
 
+    SERVER_CFG_PREFIX IntServerConfigParam m_lobby_count
+        SERVER_CFG_DEFAULT(IntServerConfigParam(1, "lobby-count",
+        "Number of independent lobbies hosted by this server. Each lobby runs "
+        "in its own process created after the karts and the list of tracks "
+        "are loaded, so only this data is shared between the lobbies. The "
+        "track of a race (meshes, collision shapes and graphs) is loaded by "
+        "each lobby itself. Lobby n uses server-port (or --port) + n - 1 (if "
+        "it is not 0) and the server name with n appended (for n > 1). Not "
+        "supported on Windows."));
+
     SERVER_CFG_PREFIX BoolServerConfigParam m_enable_console
         SERVER_CFG_DEFAULT(BoolServerConfigParam(false, "enable-console",
         "Enable network console, which can do for example kickban."));
@@ -319,6 +329,14 @@ namespace ServerConfig
         "more rewind, which clients with slow device may have problem playing "
         "this server, use the default value is recommended."));
 
+    SERVER_CFG_PREFIX BoolServerConfigParam m_state_delta_compression
+        SERVER_CFG_DEFAULT(BoolServerConfigParam(false,
+        "state-delta-compression",
+        "If true, the server will send each state as the difference to the "
+        "latest state acknowledged by a client (if the client supports it), "
+        "which greatly reduces upload bandwidth. A full state is sent if no "
+        "recent state was acknowledged, for example after packet loss."));
+
     SERVER_CFG_PREFIX BoolServerConfigParam m_sql_management
         SERVER_CFG_DEFAULT(BoolServerConfigParam(false,
         "sql-management",
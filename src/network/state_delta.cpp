@@ -0,0 +1,215 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2020 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "network/state_delta.hpp"
+
+#include "network/network_string.hpp"
+#include "utils/log.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace StateDelta
+{
+// ----------------------------------------------------------------------------
+/** Unchanged gaps shorter than this are sent as part of the surrounding run,
+ *  since starting a new run costs 4 bytes of header. */
+const size_t MIN_GAP = 4;
+
+// ----------------------------------------------------------------------------
+/** Writes the delta between baseline and state into out.
+ *  \param baseline The older state which the receiver already has.
+ *  \param state The new state to be encoded.
+ *  \param out The network string to which the delta is appended.
+ */
+void encode(const std::vector<uint8_t>& baseline,
+            const std::vector<uint8_t>& state, BareNetworkString* out)
+{
+    const size_t size = state.size();
+    auto differs = [&baseline, &state](size_t i)
+        {
+            return i >= baseline.size() || baseline[i] != state[i];
+        };
+
+    out->addUInt32((uint32_t)size);
+    size_t last_end = 0;
+    size_t start = 0;
+    while (true)
+    {
+        while (start < size && !differs(start))
+            start++;
+        if (start == size)
+            break;
+
+        // Extend the run over all changed bytes, including short unchanged
+        // gaps between them
+        size_t end = start + 1;
+        while (end < size)
+        {
+            if (differs(end))
+            {
+                end++;
+                continue;
+            }
+            size_t next = end;
+            while (next < size && next - end < MIN_GAP && !differs(next))
+                next++;
+            if (next < size && next - end < MIN_GAP)
+                end = next;
+            else
+                break;
+        }
+
+        size_t skip = start - last_end;
+        while (skip > 0xffff)
+        {
+            out->addUInt16(0xffff).addUInt16(0);
+            skip -= 0xffff;
+        }
+        size_t pos = start;
+        while (pos < end)
+        {
+            uint16_t len = (uint16_t)std::min<size_t>(end - pos, 0xffff);
+            out->addUInt16((uint16_t)skip).addUInt16(len);
+            out->getBuffer().insert(out->getBuffer().end(),
+                state.begin() + pos, state.begin() + pos + len);
+            pos += len;
+            skip = 0;
+        }
+        last_end = end;
+        start = end;
+    }
+}   // encode
+
+// ----------------------------------------------------------------------------
+/** Reconstructs a state from a baseline and a delta created by encode().
+ *  \param baseline The baseline state the delta was computed against.
+ *  \param delta The delta, read from its current offset till the end.
+ *  \param out The reconstructed state.
+ *  \return False if the delta is malformed or does not fit the baseline.
+ */
+bool decode(const std::vector<uint8_t>& baseline, BareNetworkString* delta,
+            std::vector<uint8_t>* out)
+{
+    try
+    {
+        const size_t size = delta->getUInt32();
+        // Bytes after the baseline can only come from the delta, so reject
+        // bigger sizes before allocating memory for them
+        if (size > baseline.size() + delta->size())
+            return false;
+        out->resize(size);
+        size_t pos = 0;
+        while (delta->size() > 0)
+        {
+            size_t skip = delta->getUInt16();
+            size_t len = delta->getUInt16();
+            if (pos + skip + len > size || pos + skip > baseline.size() ||
+                len > delta->size())
+                return false;
+            std::copy(baseline.begin() + pos, baseline.begin() + pos + skip,
+                out->begin() + pos);
+            pos += skip;
+            memcpy(out->data() + pos, delta->getCurrentData(), len);
+            delta->skip((int)len);
+            pos += len;
+        }
+        if (size > baseline.size() && pos < size)
+            return false;
+        std::copy(baseline.begin() + pos, baseline.begin() + size,
+            out->begin() + pos);
+    }
+    catch (std::out_of_range&)
+    {
+        return false;
+    }
+    return true;
+}   // decode
+
+// ----------------------------------------------------------------------------
+/** Unit testing function.
+ */
+void unitTesting()
+{
+    auto round_trip = [](const std::vector<uint8_t>& baseline,
+                         const std::vector<uint8_t>& state)
+        {
+            BareNetworkString bns;
+            encode(baseline, state, &bns);
+            std::vector<uint8_t> result;
+            if (!decode(baseline, &bns, &result) || result != state)
+                Log::fatal("StateDelta", "Round trip failed.");
+            return bns.getTotalSize();
+        };
+
+    std::vector<uint8_t> baseline(300);
+    for (unsigned i = 0; i < baseline.size(); i++)
+        baseline[i] = (uint8_t)i;
+
+    // Identical states only send the size
+    auto check_size = [](unsigned size, unsigned expected)
+        {
+            if (size != expected)
+            {
+                Log::fatal("StateDelta", "Delta has %u bytes instead of %u.",
+                           size, expected);
+            }
+        };
+    check_size(round_trip(baseline, baseline), 4);
+
+    // Single changed byte, and changes with small gaps merged into one run
+    std::vector<uint8_t> state = baseline;
+    state[10] = 0;
+    check_size(round_trip(baseline, state), 4 + 4 + 1);
+    state[12] = 0;
+    check_size(round_trip(baseline, state), 4 + 4 + 3);
+    state[100] = 0;
+    check_size(round_trip(baseline, state), 4 + 4 + 3 + 4 + 1);
+
+    // Shorter and longer states than the baseline
+    state.resize(200);
+    round_trip(baseline, state);
+    state.resize(400, 7);
+    round_trip(baseline, state);
+    round_trip(std::vector<uint8_t>(), state);
+    round_trip(state, std::vector<uint8_t>());
+
+    // Runs longer than 16 bits
+    std::vector<uint8_t> big_baseline(0x20000, 1);
+    std::vector<uint8_t> big_state = big_baseline;
+    big_state[0x1ffff] = 2;
+    round_trip(big_baseline, big_state);
+    std::fill(big_state.begin() + 10, big_state.end(), 3);
+    round_trip(big_baseline, big_state);
+
+    // A delta against the wrong (too short) baseline must be rejected
+    BareNetworkString bns;
+    encode(big_baseline, big_state, &bns);
+    std::vector<uint8_t> result;
+    if (decode(baseline, &bns, &result))
+        Log::fatal("StateDelta", "Delta against a wrong baseline accepted.");
+
+    // A size which can not be reached with the delta must be rejected
+    BareNetworkString huge;
+    huge.addUInt32(0xffffffff);
+    if (decode(baseline, &huge, &result))
+        Log::fatal("StateDelta", "Delta with an invalid size accepted.");
+}   // unitTesting
+
+}   // namespace StateDelta
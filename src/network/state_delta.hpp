@@ -0,0 +1,51 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2020 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_STATE_DELTA_HPP
+#define HEADER_STATE_DELTA_HPP
+
+#include "utils/types.hpp"
+
+#include <vector>
+
+class BareNetworkString;
+
+/** \ingroup network
+ *  Functions to encode a game state as a difference against an older state
+ *  (the baseline) which the receiver is known to have. Each rewinder writes
+ *  its fields at fixed positions as long as the set of rewinders does not
+ *  change, so only the bytes of fields which changed between two states
+ *  need to be sent. The delta is a list of runs:
+ *   - UInt16 number of unchanged bytes to copy from the baseline,
+ *   - UInt16 number of changed bytes,
+ *   - the changed bytes.
+ *  It is prefixed by the UInt32 size of the resulting state, so that states
+ *  of different size (e.g. after a rewinder was added) can be handled, too.
+ */
+namespace StateDelta
+{
+    void encode(const std::vector<uint8_t>& baseline,
+                const std::vector<uint8_t>& state, BareNetworkString* out);
+    // ------------------------------------------------------------------------
+    bool decode(const std::vector<uint8_t>& baseline,
+                BareNetworkString* delta, std::vector<uint8_t>* out);
+    // ------------------------------------------------------------------------
+    void unitTesting();
+}   // namespace StateDelta
+
+#endif
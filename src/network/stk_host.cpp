@@ -21,6 +21,7 @@
 #include "config/stk_config.hpp"
 #include "config/user_config.hpp"
 #include "io/file_manager.hpp"
+#include "network/crypto.hpp"
 #include "network/event.hpp"
 #include "network/game_setup.hpp"
 #include "network/ios_ipv6.hpp"
@@ -29,6 +30,7 @@
 #include "network/network_player_profile.hpp"
 #include "network/network_string.hpp"
 #include "network/network_timer_synchronizer.hpp"
+#include "network/packet_buffers.hpp"
 #include "network/protocols/connect_to_peer.hpp"
 #include "network/protocols/server_lobby.hpp"
 #include "network/protocol_manager.hpp"
@@ -249,9 +251,14 @@ constexpr bool isPingPacket(unsigned char* data, size_t length)
 }   // isPingPacket
 
 // ============================================================================
+/** Number of commands the listening thread queue can hold before adding
+ *  threads have to wait (or use the overflow list). */
+const size_t ENET_CMD_QUEUE_SIZE = 4096;
+
+// ----------------------------------------------------------------------------
 /** The constructor for a server or client.
  */
-STKHost::STKHost(bool server)
+STKHost::STKHost(bool server) : m_enet_cmd(ENET_CMD_QUEUE_SIZE)
 {
     init();
     m_host_id = std::numeric_limits<uint32_t>::max();
@@ -305,6 +312,15 @@ void STKHost::init()
     m_network          = NULL;
     m_exit_timeout.store(std::numeric_limits<uint64_t>::max());
     m_client_ping.store(0);
+    m_peers = std::make_shared<const PeerMap>();
+    m_enet_cmd_overflow_size.store(0);
+    m_peers_updates.store(0);
+    m_peers_update_contended.store(0);
+    m_enet_cmd_pushes.store(0);
+    m_enet_cmd_cas_retries.store(0);
+    m_enet_cmd_full_waits.store(0);
+    m_enet_cmd_overflows.store(0);
+    m_enet_cmd_max_size.store(0);
 
     // Start with initialising ENet
     // ============================
@@ -342,7 +358,10 @@ STKHost::~STKHost()
     stopListening();
 
     // Drop all unsent packets
-    for (auto& p : m_enet_cmd)
+    EnetCommand cmd;
+    while (m_enet_cmd.pop(&cmd))
+        m_enet_cmd_overflow.push_back(cmd);
+    for (auto& p : m_enet_cmd_overflow)
     {
         if (std::get<3>(p) == ECT_SEND_PACKET)
         {
@@ -353,6 +372,8 @@ STKHost::~STKHost()
     delete m_network;
     enet_deinitialize();
     delete m_separate_process;
+    Log::info("STKHost", "Network pool: %s",
+        NetworkPool::getStats().c_str());
 }   // ~STKHost
 
 //-----------------------------------------------------------------------------
@@ -629,16 +650,168 @@ void STKHost::setPrivatePort()
 */
 void STKHost::disconnectAllPeers(bool timeout_waiting)
 {
-    std::lock_guard<std::mutex> lock(m_peers_mutex);
-    if (!m_peers.empty() && timeout_waiting)
+    updatePeers([this, timeout_waiting](PeerMap& peers)
+        {
+            if (!peers.empty() && timeout_waiting)
+            {
+                for (auto peer : peers)
+                    peer.second->disconnect();
+                // Wait for at most 2 seconds for disconnect event to be
+                // generated
+                m_exit_timeout.store(StkTime::getMonoTimeMs() + 2000);
+            }
+            peers.clear();
+        });
+}   // disconnectAllPeers
+
+//-----------------------------------------------------------------------------
+/** Changes the peer table. A copy of the current table is modified and then
+ *  published, so threads which are reading the old table are not disturbed.
+ *  Only writers are serialized with \ref m_peers_mutex.
+ *  \param modify Function which changes the copied table.
+ */
+void STKHost::updatePeers(std::function<void(PeerMap&)> modify)
+{
+    std::unique_lock<std::mutex> lock(m_peers_mutex, std::try_to_lock);
+    if (!lock.owns_lock())
     {
-        for (auto peer : m_peers)
-            peer.second->disconnect();
-        // Wait for at most 2 seconds for disconnect event to be generated
-        m_exit_timeout.store(StkTime::getMonoTimeMs() + 2000);
+        m_peers_update_contended.fetch_add(1, std::memory_order_relaxed);
+        lock.lock();
     }
-    m_peers.clear();
-}   // disconnectAllPeers
+    std::shared_ptr<PeerMap> peers =
+        std::make_shared<PeerMap>(*std::atomic_load(&m_peers));
+    modify(*peers);
+    std::atomic_store(&m_peers, std::shared_ptr<const PeerMap>(peers));
+    m_peers_updates.fetch_add(1, std::memory_order_relaxed);
+}   // updatePeers
+
+//-----------------------------------------------------------------------------
+/** Queues an enet command to be executed by the listening thread, which is
+ *  the only thread allowed to call enet. This does not lock unless the queue
+ *  is full.
+ */
+void STKHost::addEnetCommand(ENetPeer* peer, ENetPacket* packet, uint32_t i,
+                             ENetCommandType ect)
+{
+    const EnetCommand cmd(peer, packet, i, ect);
+    m_enet_cmd_pushes.fetch_add(1, std::memory_order_relaxed);
+    // The listening thread itself (or anyone without a listening thread)
+    // cannot wait for the queue to be emptied
+    const bool can_wait = m_listening_thread.joinable() &&
+        std::this_thread::get_id() != m_listening_thread.get_id();
+    bool waited = false;
+    while (m_enet_cmd_overflow_size.load(std::memory_order_acquire) == 0)
+    {
+        unsigned retries = 0;
+        bool added = m_enet_cmd.push(cmd, &retries);
+        if (retries > 0)
+        {
+            m_enet_cmd_cas_retries.fetch_add(retries,
+                std::memory_order_relaxed);
+        }
+        if (added)
+        {
+            uint32_t size = (uint32_t)m_enet_cmd.size();
+            uint32_t max_size =
+                m_enet_cmd_max_size.load(std::memory_order_relaxed);
+            while (size > max_size &&
+                !m_enet_cmd_max_size.compare_exchange_weak(max_size, size,
+                std::memory_order_relaxed))
+            {
+            }
+            return;
+        }
+        if (!can_wait || m_shutdown.load())
+            break;
+        if (!waited)
+        {
+            m_enet_cmd_full_waits.fetch_add(1, std::memory_order_relaxed);
+            waited = true;
+        }
+        std::this_thread::yield();
+    }
+    std::lock_guard<std::mutex> lock(m_enet_cmd_overflow_mutex);
+    m_enet_cmd_overflow.push_back(cmd);
+    m_enet_cmd_overflow_size.fetch_add(1, std::memory_order_release);
+    m_enet_cmd_overflows.fetch_add(1, std::memory_order_relaxed);
+}   // addEnetCommand
+
+//-----------------------------------------------------------------------------
+/** Executes all queued enet commands, called from the listening thread. The
+ *  overflow list is executed after the queue, since commands are only added
+ *  to it once the queue was full.
+ */
+void STKHost::processEnetCommands(ENetHost* host)
+{
+    // Limit to what is in the queue now, so busy producers cannot keep the
+    // listening thread here
+    EnetCommand cmd;
+    for (size_t n = m_enet_cmd.size(); n > 0 && m_enet_cmd.pop(&cmd); n--)
+        executeEnetCommand(host, cmd);
+
+    if (m_enet_cmd_overflow_size.load(std::memory_order_acquire) == 0)
+        return;
+    std::list<EnetCommand> copied_list;
+    std::unique_lock<std::mutex> lock(m_enet_cmd_overflow_mutex);
+    // Anything which made it into the queue before the overflow list was
+    // used must be executed first
+    while (m_enet_cmd.pop(&cmd))
+        executeEnetCommand(host, cmd);
+    std::swap(copied_list, m_enet_cmd_overflow);
+    m_enet_cmd_overflow_size.store(0, std::memory_order_release);
+    lock.unlock();
+    for (auto& p : copied_list)
+        executeEnetCommand(host, p);
+}   // processEnetCommands
+
+//-----------------------------------------------------------------------------
+void STKHost::executeEnetCommand(ENetHost* host, const EnetCommand& cmd)
+{
+    switch (std::get<3>(cmd))
+    {
+    case ECT_SEND_PACKET:
+    {
+        // If enet_peer_send failed, destroy the packet to
+        // prevent leaking, this can only be done if the packet
+        // is copied instead of shared sending to all peers
+        ENetPacket* packet = std::get<1>(cmd);
+        if (enet_peer_send(
+            std::get<0>(cmd), (uint8_t)std::get<2>(cmd), packet) < 0)
+        {
+            enet_packet_destroy(packet);
+        }
+        break;
+    }
+    case ECT_DISCONNECT:
+        enet_peer_disconnect(std::get<0>(cmd), std::get<2>(cmd));
+        break;
+    case ECT_RESET:
+    {
+        // Flush enet before reset (so previous command is send)
+        enet_host_flush(host);
+        ENetPeer* peer = std::get<0>(cmd);
+        enet_peer_reset(peer);
+        // Remove the stk peer of it
+        updatePeers([peer](PeerMap& peers) { peers.erase(peer); });
+        break;
+    }
+    }
+}   // executeEnetCommand
+
+//-----------------------------------------------------------------------------
+/** Returns the peer table and enet command queue counters as a printable
+ *  string, used by the network console.
+ */
+std::string STKHost::getContentionStats() const
+{
+    return StringUtils::insertValues("Peer table: %d updates, %d waited for "
+        "another writer. Enet commands: %d added, %d CAS retries, %d waited "
+        "for a full queue, %d used the overflow list, queue peak %d of %d.",
+        m_peers_updates.load(), m_peers_update_contended.load(),
+        m_enet_cmd_pushes.load(), m_enet_cmd_cas_retries.load(),
+        m_enet_cmd_full_waits.load(), m_enet_cmd_overflows.load(),
+        m_enet_cmd_max_size.load(), (unsigned)m_enet_cmd.capacity());
+}   // getContentionStats
 
 //-----------------------------------------------------------------------------
 /** Sets an error message for the gui.
@@ -771,7 +944,9 @@ void STKHost::mainLoop()
 
         if (is_server)
         {
-            std::unique_lock<std::mutex> peer_lock(m_peers_mutex);
+            // Only the listening thread removes peers here, so this snapshot
+            // is the current table until the erasing below
+            auto peers = getPeersSnapshot();
             const float timeout = ServerConfig::m_validation_timeout;
             bool need_ping = false;
             if (sl && (!sl->isRacing() || sl->allowJoinedPlayersWaiting()) &&
@@ -788,7 +963,7 @@ void STKHost::mainLoop()
             if (need_ping)
             {
                 m_peer_pings.getData().clear();
-                for (auto& p : m_peers)
+                for (auto& p : *peers)
                 {
                     m_peer_pings.getData()[p.second->getHostId()] =
                         p.second->getPing();
@@ -815,8 +990,7 @@ void STKHost::mainLoop()
                                 player_name.c_str(), ap, max_ping);
                             p.second->setWarnedForHighPing(true);
                             p.second->setDisconnected(true);
-                            std::lock_guard<std::mutex> lock(m_enet_cmd_mutex);
-                            m_enet_cmd.emplace_back(p.second->getENetPeer(),
+                            addEnetCommand(p.second->getENetPeer(),
                                 (ENetPacket*)NULL, PDI_KICK_HIGH_PING,
                                 ECT_DISCONNECT);
                         }
@@ -861,7 +1035,8 @@ void STKHost::mainLoop()
                     g_ping_packet.end());
             }
 
-            for (auto it = m_peers.begin(); it != m_peers.end();)
+            std::vector<ENetPeer*> timed_out_peers;
+            for (auto it = peers->begin(); it != peers->end(); it++)
             {
                 if (!ping_packet.getBuffer().empty() &&
                     (!sl->allowJoinedPlayersWaiting() ||
@@ -893,52 +1068,21 @@ void STKHost::mainLoop()
                         timeout);
                     enet_host_flush(host);
                     enet_peer_reset(it->first);
-                    it = m_peers.erase(it);
-                }
-                else
-                {
-                    it++;
+                    timed_out_peers.push_back(it->first);
                 }
             }
-            peer_lock.unlock();
-        }
-
-        std::list<std::tuple<ENetPeer*, ENetPacket*, uint32_t,
-            ENetCommandType> > copied_list;
-        std::unique_lock<std::mutex> lock(m_enet_cmd_mutex);
-        std::swap(copied_list, m_enet_cmd);
-        lock.unlock();
-        for (auto& p : copied_list)
-        {
-            switch (std::get<3>(p))
-            {
-            case ECT_SEND_PACKET:
+            if (!timed_out_peers.empty())
             {
-                // If enet_peer_send failed, destroy the packet to
-                // prevent leaking, this can only be done if the packet
-                // is copied instead of shared sending to all peers
-                ENetPacket* packet = std::get<1>(p);
-                if (enet_peer_send(
-                    std::get<0>(p), (uint8_t)std::get<2>(p), packet) < 0)
-                {
-                    enet_packet_destroy(packet);
-                }
-                break;
-            }
-            case ECT_DISCONNECT:
-                enet_peer_disconnect(std::get<0>(p), std::get<2>(p));
-                break;
-            case ECT_RESET:
-                // Flush enet before reset (so previous command is send)
-                enet_host_flush(host);
-                enet_peer_reset(std::get<0>(p));
-                // Remove the stk peer of it
-                std::lock_guard<std::mutex> lock(m_peers_mutex);
-                m_peers.erase(std::get<0>(p));
-                break;
+                updatePeers([&timed_out_peers](PeerMap& new_peers)
+                    {
+                        for (ENetPeer* peer : timed_out_peers)
+                            new_peers.erase(peer);
+                    });
             }
         }
 
+        processEnetCommands(host);
+
         bool need_ping_update = false;
         while (enet_host_service(host, &event, 10) != 0)
         {
@@ -970,9 +1114,11 @@ void STKHost::mainLoop()
                 // ++m_next_unique_host_id for unique host id for database
                 auto stk_peer = std::make_shared<STKPeer>
                     (event.peer, this, ++m_next_unique_host_id);
-                std::unique_lock<std::mutex> lock(m_peers_mutex);
-                m_peers[event.peer] = stk_peer;
-                lock.unlock();
+                ENetPeer* enet_peer = event.peer;
+                updatePeers([enet_peer, stk_peer](PeerMap& peers)
+                    {
+                        peers[enet_peer] = stk_peer;
+                    });
                 stk_event = new Event(&event, stk_peer);
                 TransportAddress addr(event.peer->address);
                 Log::info("STKHost", "%s has just connected. There are "
@@ -994,20 +1140,27 @@ void STKHost::mainLoop()
                 }
                 // Use the previous stk peer so protocol can see the network
                 // profile and handle it for disconnection
-                if (m_peers.find(event.peer) != m_peers.end())
+                auto peers = getPeersSnapshot();
+                auto it = peers->find(event.peer);
+                if (it != peers->end())
                 {
-                    stk_event = new Event(&event, m_peers.at(event.peer));
-                    std::lock_guard<std::mutex> lock(m_peers_mutex);
-                    m_peers.erase(event.peer);
+                    stk_event = new Event(&event, it->second);
+                    ENetPeer* enet_peer = event.peer;
+                    updatePeers([enet_peer](PeerMap& new_peers)
+                        {
+                            new_peers.erase(enet_peer);
+                        });
                 }
                 TransportAddress addr(event.peer->address);
                 Log::info("STKHost", "%s has just disconnected. There are "
                     "now %u peers.", addr.toString().c_str(), getPeerCount());
             }   // ENET_EVENT_TYPE_DISCONNECT
 
-            if (!stk_event && m_peers.find(event.peer) != m_peers.end())
+            auto peers = getPeersSnapshot();
+            auto peer_it = peers->find(event.peer);
+            if (!stk_event && peer_it != peers->end())
             {
-                auto& peer = m_peers.at(event.peer);
+                auto& peer = peer_it->second;
                 if (isPingPacket(event.packet->data, event.packet->dataLength))
                 {
                     if (!is_server)
@@ -1197,8 +1350,8 @@ void STKHost::handleDirectSocketRequest(Network* direct_socket,
  */
 bool STKHost::peerExists(const TransportAddress& peer)
 {
-    std::lock_guard<std::mutex> lock(m_peers_mutex);
-    for (auto p : m_peers)
+    auto peers = getPeersSnapshot();
+    for (auto& p : *peers)
     {
         auto stk_peer = p.second;
         if (stk_peer->getAddress() == peer ||
@@ -1217,9 +1370,10 @@ bool STKHost::peerExists(const TransportAddress& peer)
 std::shared_ptr<STKPeer> STKHost::getServerPeerForClient() const
 {
     assert(NetworkConfig::get()->isClient());
-    if (m_peers.size() != 1)
+    auto peers = getPeersSnapshot();
+    if (peers->size() != 1)
         return nullptr;
-    return m_peers.begin()->second;
+    return peers->begin()->second;
 }   // getServerPeerForClient
 
 // ----------------------------------------------------------------------------
@@ -1247,12 +1401,7 @@ bool STKHost::isConnectedTo(const TransportAddress& peer)
  */
 void STKHost::sendPacketToAllPeersInServer(NetworkString *data, bool reliable)
 {
-    std::lock_guard<std::mutex> lock(m_peers_mutex);
-    for (auto p : m_peers)
-    {
-        if (p.second->isValidated())
-            p.second->sendPacket(data, reliable);
-    }
+    sendPacketToAllPeersWith([](STKPeer*) { return true; }, data, reliable);
 }   // sendPacketToAllPeersInServer
 
 //-----------------------------------------------------------------------------
@@ -1262,12 +1411,10 @@ void STKHost::sendPacketToAllPeersInServer(NetworkString *data, bool reliable)
  */
 void STKHost::sendPacketToAllPeers(NetworkString *data, bool reliable)
 {
-    std::lock_guard<std::mutex> lock(m_peers_mutex);
-    for (auto p : m_peers)
-    {
-        if (p.second->isValidated() && !p.second->isWaitingForGame())
-            p.second->sendPacket(data, reliable);
-    }
+    sendPacketToAllPeersWith([](STKPeer* p)
+        {
+            return !p->isWaitingForGame();
+        }, data, reliable);
 }   // sendPacketToAllPeers
 
 //-----------------------------------------------------------------------------
@@ -1279,20 +1426,16 @@ void STKHost::sendPacketToAllPeers(NetworkString *data, bool reliable)
 void STKHost::sendPacketExcept(STKPeer* peer, NetworkString *data,
                                bool reliable)
 {
-    std::lock_guard<std::mutex> lock(m_peers_mutex);
-    for (auto p : m_peers)
-    {
-        STKPeer* stk_peer = p.second.get();
-        if (!stk_peer->isSamePeer(peer) && p.second->isValidated() &&
-            !p.second->isWaitingForGame())
+    sendPacketToAllPeersWith([peer](STKPeer* p)
         {
-            stk_peer->sendPacket(data, reliable);
-        }
-    }
+            return !p->isSamePeer(peer) && !p->isWaitingForGame();
+        }, data, reliable);
 }   // sendPacketExcept
 
 //-----------------------------------------------------------------------------
-/** Sends data to peers with custom rule
+/** Sends data to peers with custom rule. The (per peer encrypted) packets
+ *  are created from a snapshot of the peer table, so no lock is held while
+ *  encrypting, and then handed to the listening thread.
  *  \param predicate boolean function for peer to predicate whether to send
  *  \param data Data to sent.
  *  \param reliable If the data should be sent reliable or now.
@@ -1300,26 +1443,197 @@ void STKHost::sendPacketExcept(STKPeer* peer, NetworkString *data,
 void STKHost::sendPacketToAllPeersWith(std::function<bool(STKPeer*)> predicate,
                                        NetworkString* data, bool reliable)
 {
-    std::lock_guard<std::mutex> lock(m_peers_mutex);
-    for (auto p : m_peers)
+    auto peers = getPeersSnapshot();
+    std::vector<EnetCommand> cmds;
+    cmds.reserve(peers->size());
+    for (auto& p : *peers)
     {
         STKPeer* stk_peer = p.second.get();
-        if (!stk_peer->isValidated())
+        if (!stk_peer->isValidated() || !predicate(stk_peer))
             continue;
-        if (predicate(stk_peer))
-            stk_peer->sendPacket(data, reliable);
+        ENetPacket* packet = stk_peer->createPacket(data, reliable);
+        if (packet)
+        {
+            cmds.emplace_back(stk_peer->getENetPeer(), packet,
+                EVENT_CHANNEL_NORMAL, ECT_SEND_PACKET);
+        }
     }
+    addEnetCommands(cmds);
 }   // sendPacketToAllPeersWith
 
+//-----------------------------------------------------------------------------
+/** Compares the ways of sending a broadcast for 1 to 32 peers, using a state
+ *  sized message: the old path, which allocated each encrypted packet and
+ *  locked a mutex protected list for each peer, allocated packets handed to
+ *  the lock free queue used by addEnetCommands, and packets encrypted into
+ *  the preallocated PacketBuffers of each peer (the current path). Each peer
+ *  has its own key, so the AES-GCM encryption itself is done for each peer
+ *  in all cases. Afterwards the list and the queue are compared with 4
+ *  threads adding commands at the same time as the consuming thread removes
+ *  them.
+ */
+void STKHost::benchmarkBroadcast()
+{
+    const int iterations = 2000;
+    NetworkString state(PROTOCOL_CONTROLLER_EVENTS, 1024);
+    for (unsigned i = 0; i < 1024; i++)
+        state.addUInt8((uint8_t)i);
+
+    std::mt19937 rng(0);
+    std::vector<std::unique_ptr<Crypto> > all_crypto;
+    std::vector<std::shared_ptr<PacketBuffers> > all_buffers;
+    for (unsigned i = 0; i < 32; i++)
+    {
+        std::vector<uint8_t> key(16), iv(12);
+        for (uint8_t& k : key)
+            k = (uint8_t)rng();
+        for (uint8_t& v : iv)
+            v = (uint8_t)rng();
+        all_crypto.emplace_back(new Crypto(key, iv));
+        all_buffers.push_back(std::make_shared<PacketBuffers>());
+    }
+
+    // The listening thread part: take all commands and free the packets
+    std::mutex cmd_mutex;
+    std::list<EnetCommand> cmd_list;
+    auto process_commands = [&cmd_mutex, &cmd_list]()
+        {
+            std::list<EnetCommand> copied_list;
+            std::unique_lock<std::mutex> lock(cmd_mutex);
+            std::swap(copied_list, cmd_list);
+            lock.unlock();
+            for (auto& cmd : copied_list)
+                enet_packet_destroy(std::get<1>(cmd));
+        };
+    MPSCRing<EnetCommand> cmd_ring(ENET_CMD_QUEUE_SIZE);
+    auto process_ring = [&cmd_ring]()
+        {
+            EnetCommand cmd;
+            while (cmd_ring.pop(&cmd))
+                enet_packet_destroy(std::get<1>(cmd));
+        };
+
+    for (unsigned peers = 1; peers <= 32; peers *= 2)
+    {
+        uint64_t start = StkTime::getMonoTimeUs();
+        for (int i = 0; i < iterations; i++)
+        {
+            for (unsigned j = 0; j < peers; j++)
+            {
+                ENetPacket* packet =
+                    all_crypto[j]->encryptSend(state, /*reliable*/false);
+                std::lock_guard<std::mutex> lock(cmd_mutex);
+                cmd_list.emplace_back((ENetPeer*)NULL, packet,
+                    EVENT_CHANNEL_NORMAL, ECT_SEND_PACKET);
+            }
+            process_commands();
+        }
+        uint64_t per_peer = StkTime::getMonoTimeUs() - start;
+
+        start = StkTime::getMonoTimeUs();
+        for (int i = 0; i < iterations; i++)
+        {
+            for (unsigned j = 0; j < peers; j++)
+            {
+                cmd_ring.push(EnetCommand((ENetPeer*)NULL,
+                    all_crypto[j]->encryptSend(state, /*reliable*/false),
+                    EVENT_CHANNEL_NORMAL, ECT_SEND_PACKET));
+            }
+            process_ring();
+        }
+        uint64_t ring = StkTime::getMonoTimeUs() - start;
+
+        start = StkTime::getMonoTimeUs();
+        for (int i = 0; i < iterations; i++)
+        {
+            for (unsigned j = 0; j < peers; j++)
+            {
+                cmd_ring.push(EnetCommand((ENetPeer*)NULL,
+                    all_crypto[j]->encryptSend(state, /*reliable*/false,
+                    all_buffers[j].get()),
+                    EVENT_CHANNEL_NORMAL, ECT_SEND_PACKET));
+            }
+            process_ring();
+        }
+        uint64_t buffers = StkTime::getMonoTimeUs() - start;
+
+        Log::info("Benchmark", "Broadcast to %2d peers: per peer %8.2f us, "
+            "queue %8.2f us, queue and buffers %8.2f us per state.", peers,
+            per_peer / (double)iterations, ring / (double)iterations,
+            buffers / (double)iterations);
+    }
+
+    // Contended case, without encryption: 4 producers and one consumer
+    const unsigned producers = 4;
+    const unsigned commands = 200000;
+    std::atomic<unsigned> done(0);
+    ENetPacket* packet = enet_packet_create(NULL, 0, 0);
+    auto run = [&](std::function<void()> produce,
+                   std::function<void()> consume)
+        {
+            done.store(0);
+            uint64_t start = StkTime::getMonoTimeUs();
+            std::vector<std::thread> threads;
+            for (unsigned i = 0; i < producers; i++)
+                threads.emplace_back(produce);
+            while (done.load() < producers)
+                consume();
+            for (std::thread& t : threads)
+                t.join();
+            consume();
+            return StkTime::getMonoTimeUs() - start;
+        };
+    uint64_t list_time = run([&]()
+        {
+            for (unsigned i = 0; i < commands; i++)
+            {
+                std::lock_guard<std::mutex> lock(cmd_mutex);
+                cmd_list.emplace_back((ENetPeer*)NULL, packet, 0,
+                    ECT_DISCONNECT);
+            }
+            done.fetch_add(1);
+        },
+        [&]()
+        {
+            std::list<EnetCommand> copied_list;
+            std::unique_lock<std::mutex> lock(cmd_mutex);
+            std::swap(copied_list, cmd_list);
+        });
+    std::atomic<uint64_t> cas_retries(0);
+    uint64_t ring_time = run([&]()
+        {
+            unsigned retries = 0;
+            for (unsigned i = 0; i < commands; i++)
+            {
+                while (!cmd_ring.push(EnetCommand((ENetPeer*)NULL, packet, 0,
+                    ECT_DISCONNECT), &retries))
+                    std::this_thread::yield();
+            }
+            cas_retries.fetch_add(retries);
+            done.fetch_add(1);
+        },
+        [&]()
+        {
+            EnetCommand cmd;
+            while (cmd_ring.pop(&cmd))
+            {
+            }
+        });
+    enet_packet_destroy(packet);
+    Log::info("Benchmark", "%d threads adding %d commands each: mutex list "
+        "%8.2f ms, queue %8.2f ms (%d CAS retries).", producers, commands,
+        list_time / 1000.0, ring_time / 1000.0, (unsigned)cas_retries.load());
+}   // benchmarkBroadcast
+
 //-----------------------------------------------------------------------------
 /** Sends a message from a client to the server. */
 void STKHost::sendToServer(NetworkString *data, bool reliable)
 {
-    std::lock_guard<std::mutex> lock(m_peers_mutex);
-    if (m_peers.empty())
+    auto peers = getPeersSnapshot();
+    if (peers->empty())
         return;
     assert(NetworkConfig::get()->isClient());
-    m_peers.begin()->second->sendPacket(data, reliable);
+    peers->begin()->second->sendPacket(data, reliable);
 }   // sendToServer
 
 //-----------------------------------------------------------------------------
@@ -1327,15 +1641,14 @@ std::vector<std::shared_ptr<NetworkPlayerProfile> >
     STKHost::getAllPlayerProfiles() const
 {
     std::vector<std::shared_ptr<NetworkPlayerProfile> > p;
-    std::unique_lock<std::mutex> lock(m_peers_mutex);
-    for (auto& peer : m_peers)
+    auto peers = getPeersSnapshot();
+    for (auto& peer : *peers)
     {
         if (peer.second->isDisconnected() || !peer.second->isValidated())
             continue;
         auto peer_profile = peer.second->getPlayerProfiles();
         p.insert(p.end(), peer_profile.begin(), peer_profile.end());
     }
-    lock.unlock();
     return p;
 }   // getAllPlayerProfiles
 
@@ -1343,8 +1656,8 @@ std::vector<std::shared_ptr<NetworkPlayerProfile> >
 std::set<uint32_t> STKHost::getAllPlayerOnlineIds() const
 {
     std::set<uint32_t> online_ids;
-    std::unique_lock<std::mutex> lock(m_peers_mutex);
-    for (auto& peer : m_peers)
+    auto peers = getPeersSnapshot();
+    for (auto& peer : *peers)
     {
         if (peer.second->isDisconnected() || !peer.second->isValidated())
             continue;
@@ -1354,20 +1667,19 @@ std::set<uint32_t> STKHost::getAllPlayerOnlineIds() const
                 peer.second->getPlayerProfiles()[0]->getOnlineId());
         }
     }
-    lock.unlock();
     return online_ids;
 }   // getAllPlayerOnlineIds
 
 //-----------------------------------------------------------------------------
 std::shared_ptr<STKPeer> STKHost::findPeerByHostId(uint32_t id) const
 {
-    std::lock_guard<std::mutex> lock(m_peers_mutex);
-    auto ret = std::find_if(m_peers.begin(), m_peers.end(),
+    auto peers = getPeersSnapshot();
+    auto ret = std::find_if(peers->begin(), peers->end(),
         [id](const std::pair<ENetPeer*, std::shared_ptr<STKPeer> >& p)
         {
             return p.second->getHostId() == id;
         });
-    return ret != m_peers.end() ? ret->second : nullptr;
+    return ret != peers->end() ? ret->second : nullptr;
 }   // findPeerByHostId
 
 //-----------------------------------------------------------------------------
@@ -1384,7 +1696,11 @@ void STKHost::initClientNetwork(ENetEvent& event, Network* new_network)
     auto stk_peer = std::make_shared<STKPeer>(event.peer, this,
         m_next_unique_host_id++);
     stk_peer->setValidated();
-    m_peers[event.peer] = stk_peer;
+    ENetPeer* enet_peer = event.peer;
+    updatePeers([enet_peer, stk_peer](PeerMap& peers)
+        {
+            peers[enet_peer] = stk_peer;
+        });
     setPrivatePort();
     auto pm = ProtocolManager::lock();
     if (pm && !pm->isExiting())
@@ -1415,8 +1731,8 @@ std::vector<std::shared_ptr<NetworkPlayerProfile> >
     STKHost::getPlayersForNewGame() const
 {
     std::vector<std::shared_ptr<NetworkPlayerProfile> > players;
-    std::lock_guard<std::mutex> lock(m_peers_mutex);
-    for (auto& p : m_peers)
+    auto peers = getPeersSnapshot();
+    for (auto& p : *peers)
     {
         auto& stk_peer = p.second;
         if (stk_peer->isWaitingForGame())
@@ -1439,8 +1755,8 @@ void STKHost::updatePlayers(unsigned* ingame, unsigned* waiting,
     uint32_t ingame_players = 0;
     uint32_t waiting_players = 0;
     uint32_t total_players = 0;
-    std::lock_guard<std::mutex> lock(m_peers_mutex);
-    for (auto& p : m_peers)
+    auto peers = getPeersSnapshot();
+    for (auto& p : *peers)
     {
         auto& stk_peer = p.second;
         if (!stk_peer->isValidated())
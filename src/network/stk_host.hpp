@@ -25,6 +25,7 @@
 #include "network/network.hpp"
 #include "network/network_string.hpp"
 #include "network/transport_address.hpp"
+#include "utils/mpsc_ring.hpp"
 #include "utils/synchronised.hpp"
 #include "utils/time.hpp"
 
@@ -87,20 +88,47 @@ private:
     /** Network console thread */
     std::thread m_network_console;
 
-    /** Make sure the removing or adding a peer is thread-safe. */
+public:
+    typedef std::map<ENetPeer*, std::shared_ptr<STKPeer> > PeerMap;
+
+    typedef std::tuple</*peer receive*/ENetPeer*,
+        /*packet to send*/ENetPacket*, /*integer data*/uint32_t,
+        ENetCommandType> EnetCommand;
+
+private:
+    /** Serializes the writers of \ref m_peers, readers never take it. */
     mutable std::mutex m_peers_mutex;
 
     /** Let (atm enet_peer_send and enet_peer_disconnect) run in the listening
-     *  thread. */
-    std::list<std::tuple</*peer receive*/ENetPeer*,
-        /*packet to send*/ENetPacket*, /*integer data*/uint32_t,
-        ENetCommandType> > m_enet_cmd;
+     *  thread. Any thread can add commands without taking a lock, only the
+     *  listening thread removes them. */
+    MPSCRing<EnetCommand> m_enet_cmd;
 
-    /** Protect \ref m_enet_cmd from multiple threads usage. */
-    std::mutex m_enet_cmd_mutex;
+    /** Commands which did not fit into \ref m_enet_cmd because it was full
+     *  and the adding thread could not wait for the listening thread (or was
+     *  the listening thread itself). As long as it is not empty all new
+     *  commands are added here, so the order of commands is kept. */
+    std::list<EnetCommand> m_enet_cmd_overflow;
 
-    /** The list of peers connected to this instance. */
-    std::map<ENetPeer*, std::shared_ptr<STKPeer> > m_peers;
+    /** Protect \ref m_enet_cmd_overflow from multiple threads usage. */
+    std::mutex m_enet_cmd_overflow_mutex;
+
+    /** Size of \ref m_enet_cmd_overflow, to test for it without locking. */
+    std::atomic<uint32_t> m_enet_cmd_overflow_size;
+
+    /** The list of peers connected to this instance. It is never modified in
+     *  place: writers copy it, change the copy and publish it atomically, so
+     *  readers can iterate over a consistent snapshot without locking. */
+    std::shared_ptr<const PeerMap> m_peers;
+
+    /** Counters to see how often the peer table and command queue are used
+     *  and contended, see getContentionStats(). */
+    std::atomic<uint64_t> m_peers_updates, m_peers_update_contended,
+        m_enet_cmd_pushes, m_enet_cmd_cas_retries, m_enet_cmd_full_waits,
+        m_enet_cmd_overflows;
+
+    /** Highest number of commands seen in \ref m_enet_cmd at once. */
+    std::atomic<uint32_t> m_enet_cmd_max_size;
 
     /** Next unique host id. It is increased whenever a new peer is added (see
      *  getPeer()), but not decreased whena host (=peer) disconnects. This
@@ -167,6 +195,12 @@ private:
                                    std::map<std::string, uint64_t>& ctp);
     // ------------------------------------------------------------------------
     void mainLoop();
+    // ------------------------------------------------------------------------
+    void updatePeers(std::function<void(PeerMap&)> modify);
+    // ------------------------------------------------------------------------
+    void processEnetCommands(ENetHost* host);
+    // ------------------------------------------------------------------------
+    void executeEnetCommand(ENetHost* host, const EnetCommand& cmd);
 
 public:
     /** If a network console should be started. */
@@ -231,6 +265,8 @@ public:
     void sendPacketToAllPeersWith(std::function<bool(STKPeer*)> predicate,
                                   NetworkString* data, bool reliable = true);
     // ------------------------------------------------------------------------
+    static void benchmarkBroadcast();
+    // ------------------------------------------------------------------------
     /** Returns true if this client instance is allowed to control the server.
      *  It will auto transfer ownership if previous server owner disconnected.
      */
@@ -267,12 +303,25 @@ public:
     void setErrorMessage(const irr::core::stringw &message);
     // ------------------------------------------------------------------------
     void addEnetCommand(ENetPeer* peer, ENetPacket* packet, uint32_t i,
-                        ENetCommandType ect)
+                        ENetCommandType ect);
+    // ------------------------------------------------------------------------
+    /** Moves a batch of commands (e.g. the packets of one broadcast) to the
+     *  listening thread. */
+    void addEnetCommands(std::vector<EnetCommand>& cmds)
     {
-        std::lock_guard<std::mutex> lock(m_enet_cmd_mutex);
-        m_enet_cmd.emplace_back(peer, packet, i, ect);
+        for (EnetCommand& cmd : cmds)
+        {
+            addEnetCommand(std::get<0>(cmd), std::get<1>(cmd),
+                std::get<2>(cmd), std::get<3>(cmd));
+        }
+        cmds.clear();
     }
     // ------------------------------------------------------------------------
+    /** Returns the current peers, the map is never changed afterwards and
+     *  can be used without locking. */
+    std::shared_ptr<const PeerMap> getPeersSnapshot() const
+                                           { return std::atomic_load(&m_peers); }
+    // ------------------------------------------------------------------------
     /** Returns the last error (or "" if no error has happened). */
     const irr::core::stringw& getErrorMessage() const
                                                     { return m_error_message; }
@@ -299,9 +348,10 @@ public:
     /** Returns a copied list of peers. */
     std::vector<std::shared_ptr<STKPeer> > getPeers() const
     {
-        std::lock_guard<std::mutex> lock(m_peers_mutex);
+        auto snapshot = getPeersSnapshot();
         std::vector<std::shared_ptr<STKPeer> > peers;
-        for (auto p : m_peers)
+        peers.reserve(snapshot->size());
+        for (auto& p : *snapshot)
         {
             peers.push_back(p.second);
         }
@@ -319,10 +369,7 @@ public:
     // ------------------------------------------------------------------------
     /** Returns the number of currently connected peers. */
     unsigned int getPeerCount() const
-    {
-        std::lock_guard<std::mutex> lock(m_peers_mutex);
-        return (unsigned)m_peers.size();
-    }
+                             { return (unsigned)getPeersSnapshot()->size(); }
     // ------------------------------------------------------------------------
     /** Sets the global host id of this host (client use). */
     void setMyHostId(uint32_t my_host_id)           { m_host_id = my_host_id; }
@@ -376,6 +423,8 @@ public:
     // ------------------------------------------------------------------------
     std::vector<std::shared_ptr<NetworkPlayerProfile> >
         getPlayersForNewGame() const;
+    // ------------------------------------------------------------------------
+    std::string getContentionStats() const;
 };   // class STKHost
 
 #endif // STK_HOST_HPP
@@ -23,6 +23,7 @@
 #include "network/event.hpp"
 #include "network/network_config.hpp"
 #include "network/network_string.hpp"
+#include "network/packet_buffers.hpp"
 #include "network/stk_host.hpp"
 #include "network/transport_address.hpp"
 #include "utils/log.hpp"
@@ -45,6 +46,7 @@ STKPeer::STKPeer(ENetPeer *enet_peer, STKHost* host, uint32_t host_id)
     m_disconnected.store(false);
     m_warned_for_high_ping.store(false);
     m_last_activity.store((int64_t)StkTime::getMonoTimeMs());
+    m_packet_buffers = std::make_shared<PacketBuffers>();
 }   // STKPeer
 
 //-----------------------------------------------------------------------------
@@ -96,26 +98,30 @@ void STKPeer::reset()
 }   // reset
 
 //-----------------------------------------------------------------------------
-/** Sends a packet to this host.
+/** Creates the (possibly encrypted) enet packet to be sent to this host,
+ *  without queuing it.
  *  \param data The data to send.
  *  \param reliable If the data is sent reliable or not.
  *  \param encrypted If the data is sent encrypted or not.
+ *  \return The packet, or NULL if this peer is not connected anymore.
  */
-void STKPeer::sendPacket(NetworkString *data, bool reliable, bool encrypted)
+ENetPacket* STKPeer::createPacket(NetworkString *data, bool reliable,
+                                  bool encrypted)
 {
     if (m_disconnected.load())
-        return;
+        return NULL;
     TransportAddress a(m_enet_peer->address);
     // Enet will reuse a disconnected peer so we check here to avoid sending
     // to wrong peer
     if (m_enet_peer->state != ENET_PEER_STATE_CONNECTED ||
         a != m_peer_address)
-        return;
+        return NULL;
 
     ENetPacket* packet = NULL;
     if (m_crypto && encrypted)
     {
-        packet = m_crypto->encryptSend(*data, reliable);
+        packet = m_crypto->encryptSend(*data, reliable,
+            m_packet_buffers.get());
     }
     else
     {
@@ -126,14 +132,26 @@ void STKPeer::sendPacket(NetworkString *data, bool reliable, bool encrypted)
             ENET_PACKET_FLAG_UNRELIABLE_FRAGMENT)));
     }
 
+    if (packet && Network::m_connection_debug)
+    {
+        Log::verbose("STKPeer", "sending packet of size %d to %s at %lf",
+            packet->dataLength, a.toString().c_str(),
+            StkTime::getRealTime());
+    }
+    return packet;
+}   // createPacket
+
+//-----------------------------------------------------------------------------
+/** Sends a packet to this host.
+ *  \param data The data to send.
+ *  \param reliable If the data is sent reliable or not.
+ *  \param encrypted If the data is sent encrypted or not.
+ */
+void STKPeer::sendPacket(NetworkString *data, bool reliable, bool encrypted)
+{
+    ENetPacket* packet = createPacket(data, reliable, encrypted);
     if (packet)
     {
-        if (Network::m_connection_debug)
-        {
-            Log::verbose("STKPeer", "sending packet of size %d to %s at %lf",
-                packet->dataLength, a.toString().c_str(),
-                StkTime::getRealTime());
-        }
         m_host->addEnetCommand(m_enet_peer, packet,
                 encrypted ? EVENT_CHANNEL_NORMAL : EVENT_CHANNEL_UNENCRYPTED,
                 ECT_SEND_PACKET);
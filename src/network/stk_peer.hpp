@@ -41,6 +41,7 @@
 class Crypto;
 class NetworkPlayerProfile;
 class NetworkString;
+class PacketBuffers;
 class STKHost;
 class TransportAddress;
 
@@ -92,6 +93,9 @@ protected:
 
     std::unique_ptr<Crypto> m_crypto;
 
+    /** Reused memory of the encrypted packets sent to this peer. */
+    std::shared_ptr<PacketBuffers> m_packet_buffers;
+
     std::deque<uint32_t> m_previous_pings;
 
     std::atomic<uint32_t> m_average_ping;
@@ -109,6 +113,9 @@ public:
     // ------------------------------------------------------------------------
     ~STKPeer();
     // ------------------------------------------------------------------------
+    ENetPacket* createPacket(NetworkString *data, bool reliable = true,
+                             bool encrypted = true);
+    // ------------------------------------------------------------------------
     void sendPacket(NetworkString *data, bool reliable = true,
                     bool encrypted = true);
     // ------------------------------------------------------------------------
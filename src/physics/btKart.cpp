@@ -286,7 +286,18 @@ btScalar btKart::rayCast(unsigned int index, float fraction)
 
     btAssert(m_vehicleRaycaster);
 
-    void* object = m_vehicleRaycaster->castRay(source,target,rayResults);
+    // Use the raycast against the track from prepareTrackHits() if there is
+    // one (the raycaster checks that it was done for the same ray).
+    void* object;
+    if (fraction == 1.0f && (int)index < m_track_hits.size())
+    {
+        btKartRaycaster::TrackHit &hit = m_track_hits[index];
+        object = static_cast<btKartRaycaster*>(m_vehicleRaycaster)
+                       ->castRay(source, target, rayResults, &hit);
+        hit.m_valid = false;
+    }
+    else
+        object = m_vehicleRaycaster->castRay(source,target,rayResults);
 
     wheel.m_raycastInfo.m_groundObject = 0;
 
@@ -420,6 +431,36 @@ const btTransform& btKart::getChassisWorldTransform() const
     return getRigidBody()->getCenterOfMassTransform();
 }   // getChassisWorldTransform
 
+// ----------------------------------------------------------------------------
+/** Casts the suspension rays of all wheels against the track only, and keeps
+ *  the results for the next rayCast() of each wheel. The rays are the same
+ *  as in rayCast(), and they are cast together, so that the bvh of the track
+ *  is only traversed once for all wheels. This only reads the track and the
+ *  chassis transform, so it can be called for all karts in parallel before
+ *  the vehicles are updated.
+ *  \param track The collision object of the track.
+ */
+void btKart::prepareTrackHits(btCollisionObject *track)
+{
+    m_track_hits.resize(m_wheelInfo.size());
+    const btTransform &chassis_trans = getChassisWorldTransform();
+    for (int i = 0; i < m_wheelInfo.size(); i++)
+    {
+        const btWheelInfo &wheel = m_wheelInfo[i];
+        btKartRaycaster::TrackHit &hit = m_track_hits[i];
+        // Same computation as updateWheelTransformsWS() and rayCast()
+        hit.m_from = chassis_trans(wheel.m_chassisConnectionPointCS*1.0f);
+        btVector3 direction = chassis_trans.getBasis()
+                            * wheel.m_wheelDirectionCS;
+        btScalar max_susp_len = wheel.getSuspensionRestLength()
+                              + wheel.m_maxSuspensionTravel;
+        btScalar raylen = max_susp_len + 0.5f;
+        hit.m_to = hit.m_from + direction * raylen;
+    }
+    btKartRaycaster::castTrackRays(track, m_track_hits.size(),
+                                   &m_track_hits[0]);
+}   // prepareTrackHits
+
 // ----------------------------------------------------------------------------
 void btKart::updateAllWheelPositions()
 {
@@ -121,6 +121,11 @@ private:
 
     btAlignedObjectArray<btWheelInfo> m_wheelInfo;
 
+    /** The results of the raycasts of all wheels against the track, computed
+     *  in prepareTrackHits() before the vehicles are updated. Each result is
+     *  used only once. */
+    btAlignedObjectArray<btKartRaycaster::TrackHit> m_track_hits;
+
     void     defaultInit();
     btScalar rayCast(btWheelInfo& wheel, const btVector3& ray);
     void     updateWheelTransformsWS(btWheelInfo& wheel,
@@ -144,6 +149,7 @@ public:
     void               debugDraw(btIDebugDraw* debugDrawer);
     const btTransform& getChassisWorldTransform() const;
     btScalar           rayCast(unsigned int index, float fraction=1.0f);
+    void               prepareTrackHits(btCollisionObject *track);
     virtual void       updateVehicle(btScalar step);
     void               resetSuspension();
     btScalar           getSteeringValue(int wheel) const;
@@ -13,63 +13,190 @@
 #include "btKartRaycast.hpp"
 
 #include "BulletCollision/CollisionDispatch/btCollisionWorld.h"
+#include "BulletCollision/CollisionShapes/btBvhTriangleMeshShape.h"
+#include "BulletCollision/NarrowPhaseCollision/btRaycastCallback.h"
 #include "BulletDynamics/Dynamics/btDynamicsWorld.h"
+#include "btBulletDynamicsCommon.h"
 
 #include "modes/world.hpp"
 #include "physics/triangle_mesh.hpp"
 #include "tracks/track.hpp"
+#include "utils/log.hpp"
+#include "utils/time.hpp"
 
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <new>
+#include <random>
+
+// ============================================================================
+/** A ray result callback which stores the closest hit and the index of the
+ *  triangle hit. It can ignore one object, which is used to cast a ray
+ *  against everything except the track.
+ */
+class ClosestWithNormal : public btCollisionWorld::ClosestRayResultCallback
+{
+private:
+    int m_triangle_index;
+    const btCollisionObject *m_ignore_object;
+public:
+    /** Constructor, initialises the triangle index. */
+    ClosestWithNormal(const btVector3 &from, const btVector3 &to,
+                      const btCollisionObject *ignore_object = NULL)
+                    : btCollisionWorld::ClosestRayResultCallback(from,to)
+    {
+        m_triangle_index = -1;
+        m_ignore_object  = ignore_object;
+    }   // ClosestWithNormal
+    // ------------------------------------------------------------------------
+    /** Stores the index of the triangle hit. */
+    virtual    btScalar addSingleResult(btCollisionWorld::LocalRayResult& rayResult,
+                                        bool normalInWorldSpace)
+    {
+        // We don't always get a triangle index, sometimes (e.g. ray hits
+        // other kart) we get shapePart=-1, or no localShapeInfo at all
+        if(rayResult.m_localShapeInfo &&
+            rayResult.m_localShapeInfo->m_shapePart>-1)
+            m_triangle_index = rayResult.m_localShapeInfo->m_triangleIndex;
+        return
+            btCollisionWorld::ClosestRayResultCallback::addSingleResult(rayResult,
+            normalInWorldSpace);
+    }
+    // ------------------------------------------------------------------------
+    virtual bool needsCollision(btBroadphaseProxy* proxy) const
+    {
+        if (proxy->m_clientObject == m_ignore_object)
+            return false;
+        return btCollisionWorld::ClosestRayResultCallback::needsCollision(proxy);
+    }   // needsCollision
+    // ------------------------------------------------------------------------
+    /** Returns the index of the triangle which was hit, or -1 if
+     *  no triangle was hit. */
+    int getTriangleIndex() const { return m_triangle_index; }
+
+};   // ClosestWithNormal
+
+// ============================================================================
+/** Reports the triangles hit by a ray in the local space of a triangle mesh
+ *  to a ClosestWithNormal callback. Identical to the callback used by
+ *  btCollisionWorld::rayTestSingle() for bvh triangle meshes.
+ */
+class TrackRaycastCallback : public btTriangleRaycastCallback
+{
+private:
+    ClosestWithNormal *m_result;
+    btCollisionObject *m_object;
+    const btTransform &m_object_transform;
+public:
+    TrackRaycastCallback(const btVector3 &from, const btVector3 &to,
+                         ClosestWithNormal *result, btCollisionObject *object,
+                         const btTransform &object_transform)
+        : btTriangleRaycastCallback(from, to, result->m_flags),
+          m_result(result), m_object(object),
+          m_object_transform(object_transform)
+    {
+        m_hitFraction = result->m_closestHitFraction;
+    }   // TrackRaycastCallback
+    // ------------------------------------------------------------------------
+    virtual btScalar reportHit(const btVector3 &hit_normal_local,
+                               btScalar hit_fraction, int part_id,
+                               int triangle_index)
+    {
+        btCollisionWorld::LocalShapeInfo shape_info;
+        shape_info.m_shapePart     = part_id;
+        shape_info.m_triangleIndex = triangle_index;
+        btVector3 hit_normal_world = m_object_transform.getBasis()
+                                   * hit_normal_local;
+        btCollisionWorld::LocalRayResult ray_result(m_object, &shape_info,
+                                                    hit_normal_world,
+                                                    hit_fraction);
+        return m_result->addSingleResult(ray_result,
+                                         /*normalInWorldSpace*/true);
+    }   // reportHit
+};   // TrackRaycastCallback
+
+// ============================================================================
+/** Returns true if both vectors are bit-identical. */
+static bool isIdentical(const btVector3 &a, const btVector3 &b)
+{
+    return memcmp(a.m_floats, b.m_floats, 3 * sizeof(btScalar)) == 0;
+}   // isIdentical
+
+// ----------------------------------------------------------------------------
+/** Casts a ray against all objects of the world.
+ */
 void* btKartRaycaster::castRay(const btVector3& from, const btVector3& to,
                                btVehicleRaycasterResult& result)
 {
-    // ========================================================================
-    class ClosestWithNormal : public btCollisionWorld::ClosestRayResultCallback
-    {
-    private:
-        int m_triangle_index;
-    public:
-        /** Constructor, initialises the triangle index. */
-        ClosestWithNormal(const btVector3 &from,
-                          const btVector3 &to)
-                          : btCollisionWorld::ClosestRayResultCallback(from,to)
-        {
-            m_triangle_index = -1;
-        }   // CloestWithNormal
-        // --------------------------------------------------------------------
-        /** Stores the index of the triangle hit. */
-        virtual    btScalar addSingleResult(btCollisionWorld::LocalRayResult& rayResult,
-                                         bool normalInWorldSpace)
-        {
-            // We don't always get a triangle index, sometimes (e.g. ray hits
-            // other kart) we get shapePart=-1, or no localShapeInfo at all
-            if(rayResult.m_localShapeInfo &&
-                rayResult.m_localShapeInfo->m_shapePart>-1)
-                m_triangle_index = rayResult.m_localShapeInfo->m_triangleIndex;
-            return
-                btCollisionWorld::ClosestRayResultCallback::addSingleResult(rayResult,
-                normalInWorldSpace);
-        }
-        // --------------------------------------------------------------------
-        /** Returns the index of the triangle which was hit, or -1 if
-         *  no triangle was hit. */
-        int getTriangleIndex() const { return m_triangle_index; }
+    ClosestWithNormal rayCallback(from,to);
 
-    };   // CloestWithNormal
-    // ========================================================================
+    m_dynamicsWorld->rayTest(from, to, rayCallback);
 
-    ClosestWithNormal rayCallback(from,to);
+    return getResult(rayCallback, rayCallback.getTriangleIndex(), result);
+}   // castRay
+
+// ----------------------------------------------------------------------------
+/** Casts a ray using the result of the raycast against the track which was
+ *  computed before with castTrackRays(). Only the other objects (e.g. other
+ *  karts and physical objects) are tested, and the closer hit is used. The
+ *  result is identical to the one of castRay() without track hit. If the
+ *  track hit was computed for a different ray, or the track and another
+ *  object are hit at exactly the same distance (in which case the order
+ *  of the objects in the broadphase decides which hit is reported), the
+ *  normal raycast is done.
+ *  \param track_hit The result of the raycast against the track, or NULL.
+ */
+void* btKartRaycaster::castRay(const btVector3& from, const btVector3& to,
+                               btVehicleRaycasterResult& result,
+                               const TrackHit *track_hit)
+{
+    if (!track_hit || !track_hit->m_valid ||
+        !isIdentical(from, track_hit->m_from) ||
+        !isIdentical(to, track_hit->m_to))
+        return castRay(from, to, result);
 
+    ClosestWithNormal rayCallback(from, to, track_hit->m_object);
     m_dynamicsWorld->rayTest(from, to, rayCallback);
+    if (!track_hit->m_has_hit)
+        return getResult(rayCallback, rayCallback.getTriangleIndex(), result);
 
     if (rayCallback.hasHit())
     {
-        btRigidBody* body = btRigidBody::upcast(rayCallback.m_collisionObject);
+        if (rayCallback.m_closestHitFraction == track_hit->m_hit_fraction)
+            return castRay(from, to, result);
+        if (rayCallback.m_closestHitFraction < track_hit->m_hit_fraction)
+        {
+            return getResult(rayCallback, rayCallback.getTriangleIndex(),
+                             result);
+        }
+    }
+    rayCallback.m_collisionObject    = track_hit->m_object;
+    rayCallback.m_closestHitFraction = track_hit->m_hit_fraction;
+    rayCallback.m_hitPointWorld      = track_hit->m_hit_point;
+    rayCallback.m_hitNormalWorld     = track_hit->m_hit_normal;
+    return getResult(rayCallback, track_hit->m_triangle_index, result);
+}   // castRay
+
+// ----------------------------------------------------------------------------
+/** Converts the closest hit of a raycast into the result of the vehicle
+ *  raycaster.
+ *  \param triangle_index Index of the triangle hit, or -1.
+ *  \return The body hit, or NULL if no body with contact response was hit.
+ */
+void* btKartRaycaster::getResult(
+                        const btCollisionWorld::ClosestRayResultCallback &ray,
+                        int triangle_index, btVehicleRaycasterResult& result)
+{
+    if (ray.hasHit())
+    {
+        btRigidBody* body = btRigidBody::upcast(ray.m_collisionObject);
         if (body && body->hasContactResponse())
         {
-            result.m_hitPointInWorld = rayCallback.m_hitPointWorld;
-            result.m_hitNormalInWorld = rayCallback.m_hitNormalWorld;
+            result.m_hitPointInWorld = ray.m_hitPointWorld;
+            result.m_hitNormalInWorld = ray.m_hitNormalWorld;
             result.m_hitNormalInWorld.normalize();
-            result.m_distFraction = rayCallback.m_closestHitFraction;
+            result.m_distFraction = ray.m_closestHitFraction;
             result.m_triangle_index = -1;
             // FIXME: this code assumes atm that the object the kart is
             // driving on is the main track (and not e.g. a physical object).
@@ -82,16 +209,16 @@ void* btKartRaycaster::castRay(const btVector3& from, const btVector3& to,
             TriangleMesh::RigidBodyTriangleMesh *rbtm =
                 dynamic_cast<TriangleMesh::RigidBodyTriangleMesh*>(body);
             if(m_smooth_normals &&
-                rayCallback.getTriangleIndex()>-1 &&
+                triangle_index>-1 &&
                 rbtm != NULL                         )
             {
 #undef DEBUG_NORMALS
 #ifdef DEBUG_NORMALS
                 btVector3 n=result.m_hitNormalInWorld;
 #endif
-                result.m_triangle_index = rayCallback.getTriangleIndex();
+                result.m_triangle_index = triangle_index;
                 result.m_hitNormalInWorld =
-                    rbtm->m_triangle_mesh->getInterpolatedNormal(rayCallback.getTriangleIndex(),
+                    rbtm->m_triangle_mesh->getInterpolatedNormal(triangle_index,
                                              result.m_hitPointInWorld);
 #ifdef DEBUG_NORMALS
                 printf("old %f %f %f new %f %f %f\n",
@@ -105,5 +232,395 @@ void* btKartRaycaster::castRay(const btVector3& from, const btVector3& to,
         }
     }
     return 0;
-}
+}   // getResult
+
+// ----------------------------------------------------------------------------
+/** Returns the collision object of the main track mesh, or NULL if there is
+ *  no track.
+ */
+btCollisionObject* btKartRaycaster::getTrackObject()
+{
+    Track *track = Track::getCurrentTrack();
+    if (!track || !track->getPtrTriangleMesh())
+        return NULL;
+    // Bullet's ray results only use non-const objects
+    return const_cast<btRigidBody*>(track->getPtrTriangleMesh()->getBody());
+}   // getTrackObject
+
+// ----------------------------------------------------------------------------
+/** Number of rays tested together against each node of the bvh. */
+static const int PACKET_SIZE = 4;
+
+/** Casts up to PACKET_SIZE rays against a bvh triangle mesh in one
+ *  traversal of the tree. Each ray visits exactly the same nodes in the same
+ *  order as in btQuantizedBvh::walkStacklessTreeAgainstRay(), and the
+ *  triangles are tested with the same callback as in
+ *  btCollisionWorld::rayTestSingle(), so the results are identical to a
+ *  raycast against the mesh alone. The node tests are done for all rays of
+ *  the packet at once, without branches, so that they can be vectorised.
+ */
+static void castRayPacket(btCollisionObject *object,
+                          const btBvhTriangleMeshShape *mesh,
+                          const btOptimizedBvh *bvh, int num_rays,
+                          btKartRaycaster::TrackHit *hits)
+{
+    const btTransform &object_transform = object->getWorldTransform();
+    btTransform world_to_object = object_transform.inverse();
+    btBroadphaseProxy *proxy = object->getBroadphaseHandle();
+
+    // Ray data in structure of arrays layout for the node tests
+    btScalar from[3][PACKET_SIZE], inv_dir[3][PACKET_SIZE];
+    btScalar ray_min[3][PACKET_SIZE], ray_max[3][PACKET_SIZE];
+    btScalar lambda_max[PACKET_SIZE];
+    int sign[3][PACKET_SIZE];
+    /** Index of the next node visited by each ray. */
+    int next_node[PACKET_SIZE];
+    btVector3 from_local[PACKET_SIZE], to_local[PACKET_SIZE];
+    ClosestWithNormal *results[PACKET_SIZE];
+    // Callbacks can't be default constructed, so keep them in raw memory
+    ATTRIBUTE_ALIGNED16(char) memory[PACKET_SIZE][sizeof(ClosestWithNormal)];
+
+    for (int l = 0; l < PACKET_SIZE; l++)
+    {
+        next_node[l] = INT_MAX;
+        const btVector3 &f = hits[std::min(l, num_rays - 1)].m_from;
+        const btVector3 &t = hits[std::min(l, num_rays - 1)].m_to;
+        results[l] = new(memory[l]) ClosestWithNormal(f, t);
+        if (l >= num_rays)
+            continue;
+
+        // The broadphase only tests the track if the ray hits its aabb
+        // (see btSingleRayCallback and btDbvt::rayTestInternal).
+        if (!proxy || !results[l]->needsCollision(proxy))
+            continue;
+        btVector3 dir = t - f;
+        dir.normalize();
+        btVector3 inv;
+        unsigned int s[3];
+        for (int i = 0; i < 3; i++)
+        {
+            inv[i] = dir[i] == btScalar(0.0) ? btScalar(BT_LARGE_FLOAT)
+                                             : btScalar(1.0) / dir[i];
+            s[i] = inv[i] < 0.0;
+        }
+        btVector3 bounds[2] = { proxy->m_aabbMin, proxy->m_aabbMax };
+        btScalar tmin;
+        if (!btRayAabb2(f, inv, s, bounds, tmin, 0.0f, dir.dot(t - f)))
+            continue;
+
+        // Same ray setup as in btCollisionWorld::rayTestSingle() and
+        // btQuantizedBvh::walkStacklessTreeAgainstRay()
+        from_local[l] = world_to_object * f;
+        to_local[l]   = world_to_object * t;
+        btVector3 ray_dir = to_local[l] - from_local[l];
+        ray_dir.normalize();
+        lambda_max[l] = ray_dir.dot(to_local[l] - from_local[l]);
+        btVector3 aabb_min = from_local[l], aabb_max = from_local[l];
+        aabb_min.setMin(to_local[l]);
+        aabb_max.setMax(to_local[l]);
+        for (int i = 0; i < 3; i++)
+        {
+            from[i][l]    = from_local[l][i];
+            inv_dir[i][l] = ray_dir[i] == btScalar(0.0)
+                          ? btScalar(BT_LARGE_FLOAT)
+                          : btScalar(1.0) / ray_dir[i];
+            sign[i][l]    = inv_dir[i][l] < 0.0;
+            ray_min[i][l] = aabb_min[i];
+            ray_max[i][l] = aabb_max[i];
+        }
+        next_node[l] = 0;
+    }   // for l < PACKET_SIZE
+
+    // Unused rays keep the values of the last ray
+    for (int l = num_rays; l < PACKET_SIZE; l++)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            from[i][l]    = from[i][num_rays - 1];
+            inv_dir[i][l] = inv_dir[i][num_rays - 1];
+            sign[i][l]    = sign[i][num_rays - 1];
+            ray_min[i][l] = ray_min[i][num_rays - 1];
+            ray_max[i][l] = ray_max[i][num_rays - 1];
+        }
+        lambda_max[l] = lambda_max[num_rays - 1];
+    }
+
+    const btOptimizedBvhNode *nodes = &bvh->getContiguousNodeArray()[0];
+    const int num_nodes = bvh->getNumNodes();
+    const btStridingMeshInterface *mesh_interface = mesh->getMeshInterface();
+    while (true)
+    {
+        int current = *std::min_element(next_node, next_node + PACKET_SIZE);
+        if (current >= num_nodes)
+            break;
+        const btOptimizedBvhNode &node = nodes[current];
+        const btVector3 &box_min = node.m_aabbMinOrg;
+        const btVector3 &box_max = node.m_aabbMaxOrg;
+
+        // TestAabbAgainstAabb2() and btRayAabb2() for all rays
+        int box_hit[PACKET_SIZE];
+        for (int l = 0; l < PACKET_SIZE; l++)
+        {
+            int overlap = !(ray_min[0][l] > box_max.getX() ||
+                            ray_max[0][l] < box_min.getX()   ) &
+                          !(ray_min[1][l] > box_max.getY() ||
+                            ray_max[1][l] < box_min.getY()   ) &
+                          !(ray_min[2][l] > box_max.getZ() ||
+                            ray_max[2][l] < box_min.getZ()   );
+            btScalar tmin  = ((sign[0][l] ? box_max.getX() : box_min.getX())
+                             - from[0][l]) * inv_dir[0][l];
+            btScalar tmax  = ((sign[0][l] ? box_min.getX() : box_max.getX())
+                             - from[0][l]) * inv_dir[0][l];
+            btScalar tymin = ((sign[1][l] ? box_max.getY() : box_min.getY())
+                             - from[1][l]) * inv_dir[1][l];
+            btScalar tymax = ((sign[1][l] ? box_min.getY() : box_max.getY())
+                             - from[1][l]) * inv_dir[1][l];
+            int hit = !(tmin > tymax || tymin > tmax);
+            tmin = tymin > tmin ? tymin : tmin;
+            tmax = tymax < tmax ? tymax : tmax;
+            btScalar tzmin = ((sign[2][l] ? box_max.getZ() : box_min.getZ())
+                             - from[2][l]) * inv_dir[2][l];
+            btScalar tzmax = ((sign[2][l] ? box_min.getZ() : box_max.getZ())
+                             - from[2][l]) * inv_dir[2][l];
+            hit &= !(tmin > tzmax || tzmin > tmax);
+            tmin = tzmin > tmin ? tzmin : tmin;
+            tmax = tzmax < tmax ? tzmax : tmax;
+            hit &= (tmin < lambda_max[l]) & (tmax > 0.0f);
+            box_hit[l] = overlap & hit;
+        }   // for l < PACKET_SIZE
+
+        bool is_leaf = node.m_escapeIndex == -1;
+        if (is_leaf)
+        {
+            bool triangle_loaded = false;
+            btVector3 triangle[3];
+            for (int l = 0; l < PACKET_SIZE; l++)
+            {
+                if (next_node[l] != current || !box_hit[l])
+                    continue;
+                if (!triangle_loaded)
+                {
+                    // Same as MyNodeOverlapCallback in
+                    // btBvhTriangleMeshShape::performRaycast()
+                    const unsigned char *vertex_base, *index_base;
+                    int num_verts, stride, index_stride, num_faces;
+                    PHY_ScalarType type, indices_type;
+                    mesh_interface->getLockedReadOnlyVertexIndexBase(
+                        &vertex_base, num_verts, type, stride, &index_base,
+                        index_stride, num_faces, indices_type, node.m_subPart);
+                    const unsigned int *gfx_base = (const unsigned int*)
+                        (index_base + node.m_triangleIndex * index_stride);
+                    const btVector3 &scaling = mesh_interface->getScaling();
+                    for (int j = 2; j >= 0; j--)
+                    {
+                        int graphics_index = indices_type == PHY_SHORT
+                                  ? ((const unsigned short*)gfx_base)[j]
+                                  : gfx_base[j];
+                        if (type == PHY_FLOAT)
+                        {
+                            const float *v = (const float*)
+                                (vertex_base + graphics_index * stride);
+                            triangle[j] = btVector3(v[0] * scaling.getX(),
+                                                    v[1] * scaling.getY(),
+                                                    v[2] * scaling.getZ());
+                        }
+                        else
+                        {
+                            const double *v = (const double*)
+                                (vertex_base + graphics_index * stride);
+                            triangle[j] =
+                                btVector3(btScalar(v[0]) * scaling.getX(),
+                                          btScalar(v[1]) * scaling.getY(),
+                                          btScalar(v[2]) * scaling.getZ());
+                        }
+                    }
+                    mesh_interface->unLockReadOnlyVertexBase(node.m_subPart);
+                    triangle_loaded = true;
+                }
+                TrackRaycastCallback callback(from_local[l], to_local[l],
+                                              results[l], object,
+                                              object_transform);
+                callback.processTriangle(triangle, node.m_subPart,
+                                         node.m_triangleIndex);
+            }   // for l < PACKET_SIZE
+        }   // if is_leaf
+
+        for (int l = 0; l < PACKET_SIZE; l++)
+        {
+            if (next_node[l] != current)
+                continue;
+            next_node[l] = box_hit[l] || is_leaf ? current + 1
+                                                 : current + node.m_escapeIndex;
+        }
+    }   // while true
+
+    for (int l = 0; l < PACKET_SIZE; l++)
+    {
+        if (l < num_rays)
+        {
+            btKartRaycaster::TrackHit &hit = hits[l];
+            hit.m_object         = object;
+            hit.m_has_hit        = results[l]->hasHit();
+            hit.m_hit_fraction   = results[l]->m_closestHitFraction;
+            hit.m_hit_point      = results[l]->m_hitPointWorld;
+            hit.m_hit_normal     = results[l]->m_hitNormalWorld;
+            hit.m_triangle_index = results[l]->getTriangleIndex();
+            hit.m_valid          = true;
+        }
+        results[l]->~ClosestWithNormal();
+    }
+}   // castRayPacket
+
+// ----------------------------------------------------------------------------
+/** Casts the rays stored in the hits against the given track object only.
+ *  The rays are done in packets which traverse the bvh of the track once.
+ *  If the track is not a bvh triangle mesh, all hits are marked as invalid.
+ *  \param track The collision object of the track.
+ *  \param num_rays Number of rays.
+ *  \param hits The rays (m_from and m_to must be set), on return the
+ *         results of the raycasts.
+ */
+void btKartRaycaster::castTrackRays(btCollisionObject *track, int num_rays,
+                                    TrackHit *hits)
+{
+    for (int i = 0; i < num_rays; i++)
+        hits[i].m_valid = false;
+    if (!track ||
+        track->getCollisionShape()->getShapeType() !=
+                                                 TRIANGLE_MESH_SHAPE_PROXYTYPE)
+        return;
+    const btBvhTriangleMeshShape *mesh =
+        (const btBvhTriangleMeshShape*)track->getCollisionShape();
+    const btOptimizedBvh *bvh =
+        const_cast<btBvhTriangleMeshShape*>(mesh)->getOptimizedBvh();
+    if (!bvh || bvh->isQuantized() || bvh->getNumNodes() == 0)
+        return;
+    for (int i = 0; i < num_rays; i += PACKET_SIZE)
+    {
+        castRayPacket(track, mesh, bvh, std::min(PACKET_SIZE, num_rays - i),
+                      hits + i);
+    }
+}   // castTrackRays
+
+// ----------------------------------------------------------------------------
+/** Compares the suspension raycasts of btKart with and without the results
+ *  of castTrackRays() on a synthetic bumpy track with a few boxes (standing
+ *  in for other karts) on it, and checks that both give the same results.
+ */
+void btKartRaycaster::benchmarkRaycasts()
+{
+    // A bumpy track of 200x200 quads
+    const int size = 200;
+    btTriangleMesh *mesh = new btTriangleMesh();
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> bump(0.0f, 0.3f);
+    std::vector<float> height((size + 1) * (size + 1));
+    for (unsigned int i = 0; i < height.size(); i++)
+        height[i] = bump(random);
+    for (int x = 0; x < size; x++)
+    {
+        for (int z = 0; z < size; z++)
+        {
+            btVector3 p00(float(x), height[x * (size + 1) + z], float(z));
+            btVector3 p10(float(x + 1), height[(x + 1) * (size + 1) + z],
+                          float(z));
+            btVector3 p01(float(x), height[x * (size + 1) + z + 1],
+                          float(z + 1));
+            btVector3 p11(float(x + 1), height[(x + 1) * (size + 1) + z + 1],
+                          float(z + 1));
+            mesh->addTriangle(p00, p10, p11);
+            mesh->addTriangle(p00, p11, p01);
+        }
+    }
+    btBvhTriangleMeshShape *track_shape =
+        new btBvhTriangleMeshShape(mesh, /*useQuantizedAabbCompression*/false);
+    btRigidBody *track = new btRigidBody(0.0f, NULL, track_shape);
+
+    btDefaultCollisionConfiguration config;
+    btCollisionDispatcher dispatcher(&config);
+    btDbvtBroadphase broadphase;
+    btSequentialImpulseConstraintSolver solver;
+    btDiscreteDynamicsWorld world(&dispatcher, &broadphase, &solver, &config);
+    world.addRigidBody(track);
+
+    std::uniform_real_distribution<float> position(1.0f, size - 2.0f);
+    std::vector<btRigidBody*> boxes;
+    btBoxShape box_shape(btVector3(0.7f, 0.3f, 1.0f));
+    for (int i = 0; i < 200; i++)
+    {
+        btTransform t(btQuaternion::getIdentity(),
+                      btVector3(position(random), 0.5f, position(random)));
+        boxes.push_back(new btRigidBody(0.0f, NULL, &box_shape));
+        boxes.back()->setWorldTransform(t);
+        world.addRigidBody(boxes.back());
+    }
 
+    // Four wheel rays for each kart
+    const int num_karts = 5000;
+    const int wheels = 4;
+    btAlignedObjectArray<TrackHit> hits;
+    hits.resize(num_karts * wheels);
+    for (int k = 0; k < num_karts; k++)
+    {
+        btVector3 centre(position(random), 1.2f, position(random));
+        for (int w = 0; w < wheels; w++)
+        {
+            TrackHit &hit = hits[k * wheels + w];
+            hit.m_from = centre + btVector3(w % 2 ? 0.5f : -0.5f, 0.0f,
+                                            w / 2 ? 0.8f : -0.8f);
+            hit.m_to   = hit.m_from + btVector3(0.0f, -1.5f, 0.0f);
+        }
+    }
+
+    btKartRaycaster raycaster(&world);
+    std::vector<btVehicleRaycasterResult> expected(hits.size());
+    std::vector<void*> expected_object(hits.size());
+    uint64_t start = StkTime::getMonoTimeUs();
+    for (int i = 0; i < hits.size(); i++)
+    {
+        expected_object[i] = raycaster.castRay(hits[i].m_from, hits[i].m_to,
+                                               expected[i]);
+    }
+    uint64_t time_single = StkTime::getMonoTimeUs() - start;
+
+    start = StkTime::getMonoTimeUs();
+    for (int k = 0; k < num_karts; k++)
+        castTrackRays(track, wheels, &hits[k * wheels]);
+    uint64_t time_track = StkTime::getMonoTimeUs() - start;
+
+    int mismatches = 0, track_hits = 0;
+    start = StkTime::getMonoTimeUs();
+    for (int i = 0; i < hits.size(); i++)
+    {
+        btVehicleRaycasterResult result;
+        void *object = raycaster.castRay(hits[i].m_from, hits[i].m_to,
+                                         result, &hits[i]);
+        if (hits[i].m_has_hit)
+            track_hits++;
+        if (object != expected_object[i] ||
+            (object && (!isIdentical(result.m_hitPointInWorld,
+                                     expected[i].m_hitPointInWorld)      ||
+                        !isIdentical(result.m_hitNormalInWorld,
+                                     expected[i].m_hitNormalInWorld)     ||
+                        result.m_distFraction != expected[i].m_distFraction)))
+            mismatches++;
+    }
+    uint64_t time_others = StkTime::getMonoTimeUs() - start;
+
+    Log::info("btKartRaycaster", "%d rays, %d hit the track, %d mismatches.",
+              hits.size(), track_hits, mismatches);
+    Log::info("btKartRaycaster",
+              "Single rays: %d us. Track packets: %d us + other objects: "
+              "%d us = %d us.", (int)time_single, (int)time_track,
+              (int)time_others, (int)(time_track + time_others));
+
+    for (unsigned int i = 0; i < boxes.size(); i++)
+    {
+        world.removeRigidBody(boxes[i]);
+        delete boxes[i];
+    }
+    world.removeRigidBody(track);
+    delete track;
+    delete track_shape;
+    delete mesh;
+}   // benchmarkRaycasts
@@ -14,6 +14,7 @@
 #include "BulletDynamics/Dynamics/btRigidBody.h"
 #include "BulletDynamics/ConstraintSolver/btTypedConstraint.h"
 #include "BulletDynamics/Vehicle/btVehicleRaycaster.h"
+#include "BulletCollision/CollisionDispatch/btCollisionWorld.h"
 class btDynamicsWorld;
 #include "LinearMath/btAlignedObjectArray.h"
 #include "BulletDynamics/Vehicle/btWheelInfo.h"
@@ -22,11 +23,40 @@ class btDynamicsWorld;
 
 class btKartRaycaster : public btVehicleRaycaster
 {
+public:
+    /** The result of a raycast against the track only, which is computed
+     *  for all wheels of all karts before the karts are updated (see
+     *  btKart::prepareTrackHits()). The ray is stored, so that the result
+     *  is only used for exactly the same ray. */
+    ATTRIBUTE_ALIGNED16(struct) TrackHit
+    {
+        BT_DECLARE_ALIGNED_ALLOCATOR();
+        btVector3 m_from;
+        btVector3 m_to;
+        btVector3 m_hit_point;
+        btVector3 m_hit_normal;
+        /** The track object the ray was cast against. */
+        btCollisionObject *m_object;
+        btScalar  m_hit_fraction;
+        /** Index of the triangle hit, or -1. */
+        int       m_triangle_index;
+        /** True if the ray hit the track. */
+        bool      m_has_hit;
+        /** False if the result can not be used, e.g. because the track
+         *  is not a bvh triangle mesh. */
+        bool      m_valid;
+
+        TrackHit() : m_valid(false) {}
+    };   // TrackHit
+
 private:
     btDynamicsWorld*    m_dynamicsWorld;
     /** True if the normals should be smoothed. Not all tracks support this,
     *  so this flag is set depending on track when constructing this object. */
     bool                m_smooth_normals;
+
+    void* getResult(const btCollisionWorld::ClosestRayResultCallback &ray,
+                    int triangle_index, btVehicleRaycasterResult& result);
 public:
     btKartRaycaster(btDynamicsWorld* world, bool smooth_normals=false)
         :m_dynamicsWorld(world), m_smooth_normals(smooth_normals)
@@ -35,6 +65,12 @@ public:
 
     virtual void* castRay(const btVector3& from,const btVector3& to,
                           btVehicleRaycasterResult& result);
+    void* castRay(const btVector3& from, const btVector3& to,
+                  btVehicleRaycasterResult& result, const TrackHit *track_hit);
+    static void castTrackRays(btCollisionObject *track, int num_rays,
+                              TrackHit *hits);
+    static btCollisionObject* getTrackObject();
+    static void benchmarkRaycasts();
 
 };
 
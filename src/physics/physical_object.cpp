@@ -44,6 +44,7 @@
 using namespace irr;
 
 #include <algorithm>
+#include <cctype>
 #include <memory>
 #include <string>
 #include <vector>
@@ -167,6 +168,17 @@ PhysicalObject::PhysicalObject(bool is_dynamic,
     m_reset_height       = settings.m_reset_height;
     m_on_kart_collision  = settings.m_on_kart_collision;
     m_on_item_collision  = settings.m_on_item_collision;
+    if (!m_on_kart_collision.empty())
+    {
+        m_on_kart_collision_script.setDeclaration(/*warn_if_not_found*/true,
+            "void " + m_on_kart_collision +
+            "(int, const string, const string)");
+    }
+    if (!m_on_item_collision.empty())
+    {
+        m_on_item_collision_script.setDeclaration(/*warn_if_not_found*/true,
+            "void " + m_on_item_collision + "(int, int, const string)");
+    }
     m_current_transform.setOrigin(Vec3());
     m_current_transform.setRotation(
         btQuaternion(0.0f, 0.0f, 0.0f, 1.0f));
@@ -513,7 +525,27 @@ void PhysicalObject::init(const PhysicalObject::Settings& settings)
                 }
             }   // for i<getMeshBufferCount
         }
-        triangle_mesh->createCollisionShape();
+        // Each mesh needs its own cache name, otherwise saving the BVH of
+        // one object would remove the cached BVH of all other objects.
+        std::string bvh_cache_name;
+        TrackObjectPresentationMesh* mesh_presentation =
+            m_object->getPresentation<TrackObjectPresentationMesh>();
+        std::string key = mesh_presentation
+            ? StringUtils::removeExtension(StringUtils::getBasename(
+                                           mesh_presentation->getModelFile()))
+            : m_object->getID();
+        if (Track::getCurrentTrack() && !key.empty())
+        {
+            for (char &c : key)
+            {
+                if (!isalnum((unsigned char)c))
+                    c = '_';
+            }
+            bvh_cache_name = Track::getCurrentTrack()->getIdent() +
+                             "-object-" + key;
+        }
+        triangle_mesh->createCollisionShape(/*create_collision_object*/true,
+                                            bvh_cache_name);
         m_shape = &triangle_mesh->getCollisionShape();
         m_triangle_mesh = triangle_mesh.release();
         m_init_pos.setOrigin(m_init_pos.getOrigin() + m_graphical_offset);
@@ -26,6 +26,7 @@
 #include "network/rewinder.hpp"
 #include "network/smooth_network_body.hpp"
 #include "physics/user_pointer.hpp"
+#include "scriptengine/script_function.hpp"
 #include "utils/vec3.hpp"
 #include "utils/leak_check.hpp"
 
@@ -180,6 +181,9 @@ private:
     * when a (flyable) item collides with this object
     */
     std::string           m_on_item_collision;
+    /** The script functions called for the collisions above. */
+    Scripting::ScriptFunction m_on_kart_collision_script;
+    Scripting::ScriptFunction m_on_item_collision_script;
     /** If this body is a bullet dynamic body, i.e. affected by physics
      *  or not (static (not moving) or kinematic (animated outside
      *  of physics). */
@@ -222,7 +226,7 @@ public:
     bool isDynamic() const { return m_is_dynamic; }
     // ------------------------------------------------------------------------
     /** Returns the ID of this physical object. */
-    std::string getID()          { return m_id; }
+    const std::string& getID() const { return m_id; }
     // ------------------------------------------------------------------------
     btDefaultMotionState* getMotionState() const { return m_motion_state; }
     // ------------------------------------------------------------------------
@@ -252,6 +256,12 @@ public:
     // ------------------------------------------------------------------------
     const std::string& getOnItemCollisionFunction() const { return m_on_item_collision; }
     // ------------------------------------------------------------------------
+    Scripting::ScriptFunction& getOnKartCollisionScript()
+                                         { return m_on_kart_collision_script; }
+    // ------------------------------------------------------------------------
+    Scripting::ScriptFunction& getOnItemCollisionScript()
+                                         { return m_on_item_collision_script; }
+    // ------------------------------------------------------------------------
     TrackObject* getTrackObject() { return m_object; }
 
     // Methods usable by scripts
@@ -50,6 +50,8 @@
  */
 Physics::Physics() : btSequentialImpulseConstraintSolver()
 {
+    m_kart_kart_collision_function.setDeclaration(/*warn_if_not_found*/false,
+                                          "void onKartKartCollision(int, int)");
     m_collision_conf      = new btDefaultCollisionConfiguration();
     m_dispatcher          = new btCollisionDispatcher(m_collision_conf);
 }   // Physics
@@ -192,15 +194,9 @@ void Physics::update(int ticks)
                               p->getContactPointCS(0),
                               p->getUserPointer(1)->getPointerKart(),
                               p->getContactPointCS(1)                );
-            Scripting::ScriptEngine* script_engine =
-                                            Scripting::ScriptEngine::getInstance();
             int kartid1 = p->getUserPointer(0)->getPointerKart()->getWorldKartId();
             int kartid2 = p->getUserPointer(1)->getPointerKart()->getWorldKartId();
-            script_engine->runFunction(false, "void onKartKartCollision(int, int)",
-                [=](asIScriptContext* ctx) {
-                    ctx->SetArgDWord(0, kartid1);
-                    ctx->SetArgDWord(1, kartid2);
-                });
+            m_kart_kart_collision_function.call(kartid1, kartid2);
             continue;
         }  // if kart-kart collision
 
@@ -208,29 +204,19 @@ void Physics::update(int ticks)
         {
             // Kart hits physical object
             // -------------------------
-            Scripting::ScriptEngine* script_engine = Scripting::ScriptEngine::getInstance();
             AbstractKart *kart = p->getUserPointer(1)->getPointerKart();
             int kartId = kart->getWorldKartId();
             PhysicalObject* obj = p->getUserPointer(0)->getPointerPhysicalObject();
-            std::string obj_id = obj->getID();
-            std::string scripting_function = obj->getOnKartCollisionFunction();
-
-            TrackObject* to = obj->getTrackObject();
-            TrackObject* library = to->getParentLibrary();
-            std::string lib_id;
-            std::string* lib_id_ptr = NULL;
-            if (library != NULL)
-                lib_id = library->getID();
-            lib_id_ptr = &lib_id;
-
-            if (scripting_function.size() > 0)
+            Scripting::ScriptFunction &scripting_function =
+                obj->getOnKartCollisionScript();
+
+            if (!scripting_function.isEmpty())
             {
-                script_engine->runFunction(true, "void " + scripting_function + "(int, const string, const string)",
-                    [&](asIScriptContext* ctx) {
-                        ctx->SetArgDWord(0, kartId);
-                        ctx->SetArgObject(1, lib_id_ptr);
-                        ctx->SetArgObject(2, &obj_id);
-                    });
+                static const std::string no_library_id;
+                TrackObject* library = obj->getTrackObject()->getParentLibrary();
+                const std::string* lib_id = library != NULL ? &library->getID()
+                                                            : &no_library_id;
+                scripting_function.call(kartId, lib_id, &obj->getID());
             }
             if (obj->isCrashReset())
             {
@@ -311,20 +297,11 @@ void Physics::update(int ticks)
         {
             // Projectile hits physical object
             // -------------------------------
-            Scripting::ScriptEngine* script_engine = Scripting::ScriptEngine::getInstance();
             Flyable* flyable = p->getUserPointer(0)->getPointerFlyable();
             PhysicalObject* obj = p->getUserPointer(1)->getPointerPhysicalObject();
-            std::string obj_id = obj->getID();
-            std::string scripting_function = obj->getOnItemCollisionFunction();
-            if (scripting_function.size() > 0)
-            {
-                script_engine->runFunction(true, "void " + scripting_function + "(int, int, const string)",
-                        [&](asIScriptContext* ctx) {
-                        ctx->SetArgDWord(0, (int)flyable->getType());
-                        ctx->SetArgDWord(1, flyable->getOwnerId());
-                        ctx->SetArgObject(2, &obj_id);
-                    });
-            }
+            obj->getOnItemCollisionScript().call((int)flyable->getType(),
+                                                 (int)flyable->getOwnerId(),
+                                                 &obj->getID());
             flyable->hit(NULL, obj);
 
             if (obj->isSoccerBall() && 
@@ -32,6 +32,7 @@
 #include "physics/irr_debug_drawer.hpp"
 #include "physics/stk_dynamics_world.hpp"
 #include "physics/user_pointer.hpp"
+#include "scriptengine/script_function.hpp"
 #include "utils/singleton.hpp"
 
 class AbstractKart;
@@ -149,6 +150,9 @@ private:
     btDefaultCollisionConfiguration *m_collision_conf;
     CollisionList                    m_all_collisions;
 
+    /** The script function called for each kart-kart collision. */
+    Scripting::ScriptFunction        m_kart_kart_collision_function;
+
     /** Singleton. */
     static Physics                  *m_physics;
 
@@ -0,0 +1,46 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2020 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "physics/stk_dynamics_world.hpp"
+
+#include "physics/btKart.hpp"
+#include "utils/worker_pool.hpp"
+
+// ----------------------------------------------------------------------------
+/** Casts the suspension rays of all karts against the track before the
+ *  karts are updated. These raycasts only read the track and the chassis
+ *  transforms, which do not change while the actions are updated, so they
+ *  are done in parallel, and the rays of all wheels of a kart are traced
+ *  through the track together. Each kart then only needs to test the
+ *  other objects in btKart::rayCast().
+ */
+void STKDynamicsWorld::updateActions(btScalar time_step)
+{
+    btCollisionObject *track = btKartRaycaster::getTrackObject();
+    if (track)
+    {
+        WorkerPool::get()->parallelFor(m_actions.size(),
+            [this, track](unsigned int i)
+            {
+                btKart *kart = dynamic_cast<btKart*>(m_actions[i]);
+                if (kart)
+                    kart->prepareTrackHits(track);
+            });
+    }
+    btDiscreteDynamicsWorld::updateActions(time_step);
+}   // updateActions
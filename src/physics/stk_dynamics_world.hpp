@@ -49,6 +49,8 @@ public:
     // ------------------------------------------------------------------------
     /** Gets the local time. */
     float getLocalTime() const { return m_localTime; }
+    // ------------------------------------------------------------------------
+    virtual void updateActions(btScalar time_step);
 };   // STKDynamicsWorld
 #endif
 /* EOF */
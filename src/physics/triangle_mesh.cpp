@@ -19,14 +19,25 @@
 #include "physics/triangle_mesh.hpp"
 
 #include "config/stk_config.hpp"
+#include "io/file_manager.hpp"
 #include "main_loop.hpp"
 #include "physics/physics.hpp"
 #include "utils/constants.hpp"
+#include "utils/file_utils.hpp"
+#include "utils/log.hpp"
 #include "utils/time.hpp"
 
 #include "btBulletDynamicsCommon.h"
 
-#include <fstream>
+#include <cstring>
+#include <set>
+
+// -----------------------------------------------------------------------------
+/** Version of the file format used to cache the BVH of collision shapes. It
+ *  must be increased whenever the format, the bullet version or the way the
+ *  BVH is built changes, so that outdated cache files are not used anymore.
+ */
+static const uint32_t BVH_CACHE_VERSION = 1;
 
 // -----------------------------------------------------------------------------
 /** Constructor: Initialises all data structures with zero.
@@ -44,6 +55,7 @@ TriangleMesh::TriangleMesh(bool can_be_transformed) : m_mesh()
     // (and m_mesh->m_weldingThreshold at m_normals
     m_collision_shape  = NULL;
     m_collision_object = NULL;
+    m_cached_bvh       = NULL;
     m_user_pointer.set(this);
 }   // TriangleMesh
 
@@ -86,13 +98,178 @@ void TriangleMesh::addTriangle(const btVector3 &t1, const btVector3 &t2,
     m_p1p2p3.push_back(edge1.cross(edge2).length2());
 }   // addTriangle
 
+// -----------------------------------------------------------------------------
+/** Computes a 64 bit FNV-1a hash of all triangles of this mesh, which is used
+ *  to check if a cached BVH was built for the same mesh.
+ */
+uint64_t TriangleMesh::getMeshHash() const
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    auto add = [&h](const void *data, size_t size)
+        {
+            const unsigned char *p = (const unsigned char*)data;
+            for (size_t i = 0; i < size; i++)
+            {
+                h ^= p[i];
+                h *= 0x100000001b3ULL;
+            }
+        };
+    const uint32_t n = (uint32_t)m_triangleIndex2Material.size();
+    add(&n, sizeof(n));
+    for (unsigned int i = 0; i < n; i++)
+    {
+        btVector3 p[3];
+        getTriangle(i, &p[0], &p[1], &p[2]);
+        for (unsigned int j = 0; j < 3; j++)
+            add(p[j].m_floats, 3 * sizeof(btScalar));
+    }
+    return h;
+}   // getMeshHash
+
+// -----------------------------------------------------------------------------
+/** Loads a BVH from a cache file written by saveCachedBvh(). The BVH is
+ *  deserialized in place, so its memory is kept in m_cached_bvh till the
+ *  collision shape is deleted.
+ *  \param file_name Name of the cache file.
+ *  \param hash Hash of the mesh, which must match the one in the file.
+ *  \return The BVH, or NULL if the file does not exist or is not valid.
+ */
+btOptimizedBvh* TriangleMesh::loadCachedBvh(const std::string &file_name,
+                                            uint64_t hash)
+{
+    FILE *fd = FileUtils::fopenU8Path(file_name, "rb");
+    if (!fd)
+        return NULL;
+
+    char magic[4];
+    uint32_t version = 0, pointer_size = 0, triangles = 0, size = 0;
+    uint64_t file_hash = 0;
+    bool ok = fread(magic, 1, 4, fd) == 4 && memcmp(magic, "STKB", 4) == 0 &&
+        fread(&version, sizeof(version), 1, fd) == 1 &&
+        version == BVH_CACHE_VERSION &&
+        fread(&pointer_size, sizeof(pointer_size), 1, fd) == 1 &&
+        pointer_size == sizeof(void*) &&
+        fread(&file_hash, sizeof(file_hash), 1, fd) == 1 &&
+        file_hash == hash &&
+        fread(&triangles, sizeof(triangles), 1, fd) == 1 &&
+        triangles == m_triangleIndex2Material.size() &&
+        fread(&size, sizeof(size), 1, fd) == 1 &&
+        size >= sizeof(btQuantizedBvh);
+    void *bytes = NULL;
+    btOptimizedBvh *bvh = NULL;
+    if (ok)
+    {
+        // The BVH is constructed in this memory, which must be aligned
+        bytes = btAlignedAlloc(size, 16);
+        ok = fread(bytes, 1, size, fd) == size;
+        if (ok)
+            bvh = btOptimizedBvh::deSerializeInPlace(bytes, size,
+                                                     !IS_LITTLE_ENDIAN);
+    }
+    fclose(fd);
+    if (!bvh)
+    {
+        Log::warn("TriangleMesh", "Ignoring invalid BVH cache file '%s'.",
+                  file_name.c_str());
+        if (bytes)
+            btAlignedFree(bytes);
+        return NULL;
+    }
+    m_cached_bvh = bytes;
+    return bvh;
+}   // loadCachedBvh
+
+// -----------------------------------------------------------------------------
+/** Saves a BVH to a cache file. The file is first written under a temporary
+ *  name and then renamed, so that other processes loading the same track
+ *  never see a partially written file.
+ *  \param file_name Name of the cache file.
+ *  \param hash Hash of the mesh.
+ *  \param bvh The BVH to save.
+ */
+void TriangleMesh::saveCachedBvh(const std::string &file_name, uint64_t hash,
+                                 const btOptimizedBvh *bvh) const
+{
+    const uint32_t size = bvh->calculateSerializeBufferSize();
+    void *buffer = btAlignedAlloc(size, 16);
+    if (!bvh->serialize(buffer, size, !IS_LITTLE_ENDIAN))
+    {
+        btAlignedFree(buffer);
+        return;
+    }
+
+    const std::string tmp_name = FileUtils::getTemporaryName(file_name);
+    FILE *fd = FileUtils::fopenU8Path(tmp_name, "wb");
+    if (!fd)
+    {
+        Log::warn("TriangleMesh", "Can not write BVH cache file '%s'.",
+                  tmp_name.c_str());
+        btAlignedFree(buffer);
+        return;
+    }
+    const uint32_t version = BVH_CACHE_VERSION;
+    const uint32_t pointer_size = sizeof(void*);
+    const uint32_t triangles = (uint32_t)m_triangleIndex2Material.size();
+    bool ok = fwrite("STKB", 1, 4, fd) == 4 &&
+        fwrite(&version, sizeof(version), 1, fd) == 1 &&
+        fwrite(&pointer_size, sizeof(pointer_size), 1, fd) == 1 &&
+        fwrite(&hash, sizeof(hash), 1, fd) == 1 &&
+        fwrite(&triangles, sizeof(triangles), 1, fd) == 1 &&
+        fwrite(&size, sizeof(size), 1, fd) == 1 &&
+        fwrite(buffer, 1, size, fd) == size;
+    ok = fclose(fd) == 0 && ok;
+    btAlignedFree(buffer);
+    if (!ok || FileUtils::renameU8Path(tmp_name, file_name) != 0)
+    {
+        Log::warn("TriangleMesh", "Can not write BVH cache file '%s'.",
+                  file_name.c_str());
+        file_manager->removeFile(tmp_name);
+    }
+}   // saveCachedBvh
+
+// -----------------------------------------------------------------------------
+/** Removes the BVH cache files of older versions of a mesh, i.e. the files
+ *  with the same cache name but a different hash. Otherwise a file would be
+ *  kept forever for each version of a track that was ever played.
+ *  \param bvh_cache_name The cache name of the mesh.
+ *  \param keep Full path of the current cache file, which is kept.
+ */
+static void removeOutdatedBvhFiles(const std::string &bvh_cache_name,
+                                   const std::string &keep)
+{
+    const std::string dir = file_manager->getCachedDataDir();
+    const std::string prefix = "bvh-" + bvh_cache_name + "-";
+    std::set<std::string> files;
+    file_manager->listFiles(files, dir);
+    for (const std::string &file : files)
+    {
+        // Only the hash may follow the prefix, so that the files of another
+        // mesh whose name starts with this name are not removed
+        if (file.size() != prefix.size() + 16 + 4 ||
+            file.compare(0, prefix.size(), prefix) != 0 ||
+            file.compare(file.size() - 4, 4, ".bvh") != 0 ||
+            file.find_first_not_of("0123456789abcdef", prefix.size()) !=
+                file.size() - 4 ||
+            dir + file == keep)
+            continue;
+        Log::debug("TriangleMesh", "Removing outdated BVH cache file '%s'.",
+                   file.c_str());
+        file_manager->removeFile(dir + file);
+    }
+}   // removeOutdatedBvhFiles
+
 // -----------------------------------------------------------------------------
 /** Creates a collision body only, which can be used for raycasting, but
  *  has no physical properties.
- *  @param serialized_bhv if non-null, load the serialized bhv from file instead
- *                        of builing it on the fly
+ *  \param create_collision_object If a collision object should be created.
+ *  \param bvh_cache_name If not empty, the BVH is loaded from (or, after
+ *         building it, saved to) a file in the cached data directory. The
+ *         name of the file is made of this name and a hash of the mesh, so
+ *         a changed mesh never uses an outdated BVH. The files of older
+ *         versions of the mesh are removed when a new file is saved.
  */
-void TriangleMesh::createCollisionShape(bool create_collision_object, const char* serialized_bhv)
+void TriangleMesh::createCollisionShape(bool create_collision_object,
+                                        const std::string &bvh_cache_name)
 {
     if(m_triangleIndex2Material.size()==0)
     {
@@ -105,53 +282,42 @@ void TriangleMesh::createCollisionShape(bool create_collision_object, const char
     // Now convert the triangle mesh into a static rigid body
     btBvhTriangleMeshShape* bhv_triangle_mesh;
 
-    if (serialized_bhv != NULL)
+    uint64_t hash = 0;
+    std::string cache_file;
+    btOptimizedBvh* bvh = NULL;
+    if (!bvh_cache_name.empty())
     {
-        FILE *f = fopen(serialized_bhv, "rb");
-        fseek(f, 0, SEEK_END);
-        long pos = ftell(f);
-        assert(pos != -1L);
-        fseek(f, 0, SEEK_SET);
-
-        void* bytes = btAlignedAlloc(pos, 16);
-        fread(bytes, pos, 1, f);
-        fclose(f);
-
-        btOptimizedBvh* bhv = btOptimizedBvh::deSerializeInPlace(bytes, pos, !IS_LITTLE_ENDIAN);
-        if (bhv == NULL)
-        {
-            Log::warn("TriangleMesh", "Failed to load serialized BHV");
-            bhv_triangle_mesh = new btBvhTriangleMeshShape(&m_mesh, false /* useQuantizedAabbCompression */);
-        }
-        else
-        {
-            bhv_triangle_mesh = new btBvhTriangleMeshShape(&m_mesh, false /* useQuantizedAabbCompression */,
-                                                           false /* buildBvh */);
-            bhv_triangle_mesh->setOptimizedBvh( bhv );
-        }
-        // Do *NOT* free the bytes, 'deSerializeInPlace' makes the btOptimizedBvh object
-        // directly at this memory location
-        //free(bytes);
+        hash = getMeshHash();
+        char name[32];
+        sprintf(name, "-%016llx.bvh", (unsigned long long)hash);
+        cache_file = file_manager->getCachedDataDir() + "bvh-" +
+            bvh_cache_name + name;
+        bvh = loadCachedBvh(cache_file, hash);
+    }
 
+    if (bvh)
+    {
+        bhv_triangle_mesh = new btBvhTriangleMeshShape(&m_mesh,
+            false /* useQuantizedAabbCompression */, false /* buildBvh */);
+        bhv_triangle_mesh->setOptimizedBvh(bvh);
+        Log::debug("TriangleMesh", "Loaded BVH from '%s'.",
+                   cache_file.c_str());
     }
     else
     {
-        bhv_triangle_mesh = new btBvhTriangleMeshShape(&m_mesh, false /* useQuantizedAabbCompression */);
-
-        /*
-         // code to serialize triangle mesh
-        btOptimizedBvh* bvh = bhv_triangle_mesh->getOptimizedBvh();
-        unsigned int ssize = bvh->calculateSerializeBufferSize();
-        char* buffer = (char*)btAlignedAlloc(ssize, 16);
-        bool success = bvh->serialize(buffer, ssize, !IS_LITTLE_ENDIAN);
-        printf("serialization success = %i\n", success);
-
-        std::ofstream fileout("/tmp/btOptimizedBvh");
-        fileout.write(buffer, ssize);
-        fileout.close();
-
-        btAlignedFree(buffer);
-         */
+        uint64_t start = StkTime::getMonoTimeUs();
+        bhv_triangle_mesh = new btBvhTriangleMeshShape(&m_mesh,
+            false /* useQuantizedAabbCompression */);
+        if (!cache_file.empty())
+        {
+            Log::debug("TriangleMesh", "Built BVH for '%s' (%u triangles) "
+                "in %f ms.", bvh_cache_name.c_str(),
+                (unsigned)m_triangleIndex2Material.size(),
+                (StkTime::getMonoTimeUs() - start) / 1000.0f);
+            saveCachedBvh(cache_file, hash,
+                          bhv_triangle_mesh->getOptimizedBvh());
+            removeOutdatedBvhFiles(bvh_cache_name, cache_file);
+        }
     }
 
     m_collision_shape = bhv_triangle_mesh;
@@ -178,16 +344,16 @@ void TriangleMesh::createCollisionShape(bool create_collision_object, const char
  *  for height of terrain detection).
  *  \param friction Friction to be used for this TriangleMesh.
  *  \param flags Additional collision flags (default 0).
- *  \param serializedBhv if non-NULL, the bhv is deserialized instead of
- *                       being calculated on the fly
+ *  \param bvh_cache_name If not empty, the name used to cache the BVH, see
+ *         createCollisionShape().
  */
 void TriangleMesh::createPhysicalBody(float friction,
                                       btCollisionObject::CollisionFlags flags,
-                                      const char* serializedBhv)
+                                      const std::string &bvh_cache_name)
 {
     // We need the collision shape, but not the collision object (since
     // this will be created when the dynamics body is anyway).
-    createCollisionShape(/*create_collision_object*/false, serializedBhv);
+    createCollisionShape(/*create_collision_object*/false, bvh_cache_name);
     main_loop->renderGUI(5583);
 
     btTransform startTransform;
@@ -232,6 +398,13 @@ void TriangleMesh::removeAll()
     }
     delete m_collision_shape;
     m_collision_shape = NULL;
+    if (m_cached_bvh)
+    {
+        // The BVH was constructed in place, so it does not own any memory
+        ((btQuantizedBvh*)m_cached_bvh)->~btQuantizedBvh();
+        btAlignedFree(m_cached_bvh);
+        m_cached_bvh = NULL;
+    }
 }   // removeAll
 
 // -----------------------------------------------------------------------------
@@ -314,12 +487,14 @@ btVector3 TriangleMesh::getInterpolatedNormal(unsigned int index,
  *         based on the three normals of the triangle and the location of the
  *         hit point (which is more compute intensive, but results in much
  *         smoother results).
+ *  \param triangle_index If not NULL, the index of the triangle hit.
  *  \return True if a triangle was hit, false otherwise (and no output
  *          variable will be set.
  */
 bool TriangleMesh::castRay(const btVector3 &from, const btVector3 &to,
                            btVector3 *xyz, const Material **material,
-                           btVector3 *normal, bool interpolate_normal) const
+                           btVector3 *normal, bool interpolate_normal,
+                           int *triangle_index) const
 {
     if(!m_collision_shape)
     {
@@ -384,6 +559,8 @@ bool TriangleMesh::castRay(const btVector3 &from, const btVector3 &to,
         *xyz      = ray_callback.m_hitPointWorld;
         xyz->setW(0.0f);
         *material = m_triangleIndex2Material[index];
+        if(triangle_index)
+            *triangle_index = index;
 
         if(normal)
         {
@@ -19,11 +19,13 @@
 #ifndef HEADER_TRIANGLE_MESH_HPP
 #define HEADER_TRIANGLE_MESH_HPP
 
+#include <string>
 #include <vector>
 #include "btBulletDynamicsCommon.h"
 
 #include "physics/user_pointer.hpp"
 #include "utils/aligned_array.hpp"
+#include "utils/types.hpp"
 
 class Material;
 
@@ -46,6 +48,10 @@ private:
     btDefaultMotionState        *m_motion_state;
     btCollisionShape            *m_collision_shape;
 
+    /** If the BVH of the collision shape was loaded from the cache, the
+     *  memory in which it was deserialized, otherwise NULL. */
+    void                        *m_cached_bvh;
+
     /** The three normals for each triangle. */
     AlignedArray<btVector3>      m_normals;
 
@@ -57,6 +63,10 @@ private:
      *  to the current transform of the body. */
     bool m_can_be_transformed;
 
+    btOptimizedBvh* loadCachedBvh(const std::string &file_name,
+                                  uint64_t hash);
+    void saveCachedBvh(const std::string &file_name, uint64_t hash,
+                       const btOptimizedBvh *bvh) const;
 public:
     class RigidBodyTriangleMesh : public btRigidBody
     {
@@ -76,11 +86,13 @@ public:
                      const btVector3 &t3, const btVector3 &n1,
                      const btVector3 &n2, const btVector3 &n3,
                      const Material* m);
-    void createCollisionShape(bool create_collision_object=true, const char* serialized_bhv=NULL);
+    void createCollisionShape(bool create_collision_object=true,
+                              const std::string &bvh_cache_name="");
     void createPhysicalBody(float friction,
                             btCollisionObject::CollisionFlags flags=
                                (btCollisionObject::CollisionFlags)0,
-                            const char* serializedBhv = NULL);
+                            const std::string &bvh_cache_name="");
+    uint64_t getMeshHash() const;
     void removeAll();
     void removeCollisionObject();
     btVector3 getInterpolatedNormal(unsigned int index,
@@ -111,7 +123,8 @@ public:
     // ------------------------------------------------------------------------
     bool castRay(const btVector3 &from, const btVector3 &to,
                  btVector3 *xyz, const Material **material,
-                 btVector3 *normal=NULL, bool interpolate_normal=false) const;
+                 btVector3 *normal=NULL, bool interpolate_normal=false,
+                 int *triangle_index=NULL) const;
     // ------------------------------------------------------------------------
     /** Returns the points of the 'indx' triangle.
      *  \param indx Index of the triangle to get.
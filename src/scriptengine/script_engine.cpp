@@ -33,12 +33,14 @@
 #include "scriptengine/scriptstdstring.hpp"
 #include "scriptengine/scriptvec3.hpp"
 #include "scriptengine/scriptarray.hpp"
+#include <algorithm>
 #include <string.h>
 #include "states_screens/dialogs/tutorial_message_dialog.hpp"
 #include "tracks/track_object_manager.hpp"
 #include "tracks/track.hpp"
 #include "utils/file_utils.hpp"
 #include "utils/profiler.hpp"
+#include "utils/time.hpp"
 
 
 using namespace Scripting;
@@ -47,6 +49,8 @@ namespace Scripting
 {
     const char* MODULE_ID_MAIN_SCRIPT_FILE = "main";
 
+    unsigned int ScriptEngine::m_cache_generation = 1;
+
     void AngelScript_ErrorCallback (const asSMessageInfo *msg, void *param)
     {
         const char *type = "ERR ";
@@ -75,12 +79,18 @@ namespace Scripting
         // Configure the script engine with all the functions, 
         // and variables that the script should be able to use.
         configureEngine(m_engine);
+
+        // Functions looked up with a previous script engine are invalid.
+        m_cache_generation++;
     }
 
     ScriptEngine::~ScriptEngine()
     {
         // Release the engine
         m_pending_timeouts.clearAndDeleteAll();
+        for (asIScriptContext* ctx : m_context_pool)
+            ctx->Release();
+        m_context_pool.clear();
         m_engine->DiscardModule(MODULE_ID_MAIN_SCRIPT_FILE);
         m_engine->Release();
     }
@@ -136,42 +146,12 @@ namespace Scripting
             return;
         }
 
-        asIScriptContext *ctx = m_engine->CreateContext();
-        if (ctx == NULL)
+        asIScriptContext *ctx = prepareContext(func);
+        if (ctx != NULL)
         {
-            Log::error("Scripting", "evalScript: Failed to create the context.");
-            //m_engine->Release();
-            return;
+            executeContext(ctx);
+            releaseContext(ctx);
         }
-
-        r = ctx->Prepare(func);
-        if (r < 0)
-        {
-            Log::error("Scripting", "evalScript: Failed to prepare the context.");
-            ctx->Release();
-            return;
-        }
-
-        // Execute the function
-        r = ctx->Execute();
-        if (r != asEXECUTION_FINISHED)
-        {
-            // The execution didn't finish as we had planned. Determine why.
-            if (r == asEXECUTION_ABORTED)
-            {
-                Log::error("Scripting", "The script was aborted before it could finish. Probably it timed out.");
-            }
-            else if (r == asEXECUTION_EXCEPTION)
-            {
-                Log::error("Scripting", "The script ended with an exception.");
-            }
-            else
-            {
-                Log::error("Scripting", "The script ended for some unforeseen reason (%i)", r);
-            }
-        }
-
-        ctx->Release();
         func->Release();
     }
 
@@ -179,44 +159,11 @@ namespace Scripting
 
     void ScriptEngine::runDelegate(asIScriptFunction* delegate)
     {
-        asIScriptContext *ctx = m_engine->CreateContext();
+        asIScriptContext *ctx = prepareContext(delegate);
         if (ctx == NULL)
-        {
-            Log::error("Scripting", "runMethod: Failed to create the context.");
-            //m_engine->Release();
-            return;
-        }
-
-        int r = ctx->Prepare(delegate);
-        if (r < 0)
-        {
-            Log::error("Scripting", "runMethod: Failed to prepare the context.");
-            ctx->Release();
             return;
-        }
-
-        // Execute the function
-        r = ctx->Execute();
-        if (r != asEXECUTION_FINISHED)
-        {
-            // The execution didn't finish as we had planned. Determine why.
-            if (r == asEXECUTION_ABORTED)
-            {
-                Log::error("Scripting", "The script was aborted before it could finish. Probably it timed out.");
-            }
-            else if (r == asEXECUTION_EXCEPTION)
-            {
-                Log::error("Scripting", "The script ended with an exception : (line %i) %s",
-                    ctx->GetExceptionLineNumber(), 
-                    ctx->GetExceptionString());
-            }
-            else
-            {
-                Log::error("Scripting", "The script ended for some unforeseen reason (%i)", r);
-            }
-        }
-
-        ctx->Release();
+        executeContext(ctx);
+        releaseContext(ctx);
     }
 
     //-----------------------------------------------------------------------------
@@ -273,7 +220,8 @@ namespace Scripting
     /** runs the specified script
     *  \param string scriptName = name of script to run
     */
-    void ScriptEngine::runFunction(bool warn_if_not_found, std::string function_name)
+    void ScriptEngine::runFunction(bool warn_if_not_found,
+                                   const std::string& function_name)
     {
         std::function<void(asIScriptContext*)> callback;
         std::function<void(asIScriptContext*)> get_return_value;
@@ -282,8 +230,9 @@ namespace Scripting
 
     //-----------------------------------------------------------------------------
 
-    void ScriptEngine::runFunction(bool warn_if_not_found, std::string function_name,
-        std::function<void(asIScriptContext*)> callback)
+    void ScriptEngine::runFunction(bool warn_if_not_found,
+                                   const std::string& function_name,
+                                   std::function<void(asIScriptContext*)> callback)
     {
         std::function<void(asIScriptContext*)> get_return_value;
         runFunction(warn_if_not_found, function_name, callback, get_return_value);
@@ -294,131 +243,167 @@ namespace Scripting
     /** runs the specified script
     *  \param string scriptName = name of script to run
     */
-    void ScriptEngine::runFunction(bool warn_if_not_found, std::string function_name,
-        std::function<void(asIScriptContext*)> callback,
-        std::function<void(asIScriptContext*)> get_return_value)
+    void ScriptEngine::runFunction(bool warn_if_not_found,
+                                   const std::string& function_name,
+                                   std::function<void(asIScriptContext*)> callback,
+                                   std::function<void(asIScriptContext*)> get_return_value)
     {
-        int r; //int for error checking
+        asIScriptFunction *func = getFunction(warn_if_not_found, function_name);
+        if (func == NULL)
+            return;
+
+        asIScriptContext *ctx = prepareContext(func);
+        if (ctx == NULL)
+            return;
+
+        // Here, we can pass parameters to the script functions. 
+        //ctx->setArgType(index, value);
+        //for example : ctx->SetArgFloat(0, 3.14159265359f);
+
+        if (callback)
+            callback(ctx);
+
+        // Retrieve the return value from the context here (for scripts that
+        // return values), e.g. float returnValue = ctx->GetReturnFloat();
+        if (executeContext(ctx) && get_return_value)
+            get_return_value(ctx);
 
-        asIScriptFunction *func;
+        releaseContext(ctx);
+    }
 
+    //-----------------------------------------------------------------------------
+    /** Returns the function with the given declaration. The result (even if
+     *  the function does not exist) is cached until cleanupCache() is called.
+     *  \param warn_if_not_found Print a warning if the function does not
+     *         exist, otherwise only a debug message is printed.
+     *  \param function_name The declaration of the function.
+     *  \return The function, or NULL if it does not exist.
+     */
+    asIScriptFunction* ScriptEngine::getFunction(bool warn_if_not_found,
+                                               const std::string& function_name)
+    {
         // TODO: allow splitting in multiple files
-        std::string script_filename = "scripting.as";
         auto cached_function = m_functions_cache.find(function_name);
-        if (cached_function == m_functions_cache.end())
+        if (cached_function != m_functions_cache.end())
         {
-            // Find the function for the function we want to execute.
-            //      This is how you call a normal function with arguments
-            //      asIScriptFunction *func = engine->GetModule(0)->GetFunctionByDecl("void func(arg1Type, arg2Type)");
-            asIScriptModule* module = m_engine->GetModule(MODULE_ID_MAIN_SCRIPT_FILE);
-
-            if (module == NULL)
-            {
-                if (warn_if_not_found)
-                    Log::warn("Scripting", "Scripting function was not found : %s (module not found)", function_name.c_str());
-                else
-                    Log::debug("Scripting", "Scripting function was not found : %s (module not found)", function_name.c_str());
-                m_functions_cache[function_name] = NULL; // remember that this function is unavailable
-                return;
-            }
+            // Script present in cache
+            if (cached_function->second == NULL && warn_if_not_found)
+                Log::warn("Scripting", "Scripting function was not found : %s", function_name.c_str());
+            return cached_function->second;
+        }
 
-            func = module->GetFunctionByDecl(function_name.c_str());
-            
-            if (func == NULL)
-            {
-                if (warn_if_not_found)
-                    Log::warn("Scripting", "Scripting function was not found : %s", function_name.c_str());
-                else
-                    Log::debug("Scripting", "Scripting function was not found : %s", function_name.c_str());
-                m_functions_cache[function_name] = NULL; // remember that this function is unavailable
-                return;
-            }
+        // Find the function for the function we want to execute.
+        //      This is how you call a normal function with arguments
+        //      asIScriptFunction *func = engine->GetModule(0)->GetFunctionByDecl("void func(arg1Type, arg2Type)");
+        asIScriptModule* module = m_engine->GetModule(MODULE_ID_MAIN_SCRIPT_FILE);
 
-            m_functions_cache[function_name] = func;
-            func->AddRef();
-        }
-        else
+        if (module == NULL)
         {
-            // Script present in cache
-            func = cached_function->second;
+            if (warn_if_not_found)
+                Log::warn("Scripting", "Scripting function was not found : %s (module not found)", function_name.c_str());
+            else
+                Log::debug("Scripting", "Scripting function was not found : %s (module not found)", function_name.c_str());
+            m_functions_cache[function_name] = NULL; // remember that this function is unavailable
+            return NULL;
         }
 
+        asIScriptFunction *func = module->GetFunctionByDecl(function_name.c_str());
+
         if (func == NULL)
         {
             if (warn_if_not_found)
                 Log::warn("Scripting", "Scripting function was not found : %s", function_name.c_str());
-            return; // function unavailable
+            else
+                Log::debug("Scripting", "Scripting function was not found : %s", function_name.c_str());
+            m_functions_cache[function_name] = NULL; // remember that this function is unavailable
+            return NULL;
         }
 
-        // Create a context that will execute the script.
-        asIScriptContext *ctx = m_engine->CreateContext();
-        if (ctx == NULL)
+        m_functions_cache[function_name] = func;
+        func->AddRef();
+        return func;
+    }   // getFunction
+
+    //-----------------------------------------------------------------------------
+    /** Returns a context prepared to execute the given function. Contexts are
+     *  taken from a pool (and only created if the pool is empty), since
+     *  creating a context is expensive. A function called from a script
+     *  gets a different context, since the context of the script is not
+     *  returned to the pool before it finished executing.
+     *  \param func The function to execute.
+     *  \return The context, or NULL if an error happened.
+     */
+    asIScriptContext* ScriptEngine::prepareContext(asIScriptFunction* func)
+    {
+        asIScriptContext *ctx;
+        if (m_context_pool.empty())
         {
-            Log::error("Scripting", "Failed to create the context.");
-            //m_engine->Release();
-            return;
+            ctx = m_engine->CreateContext();
+            if (ctx == NULL)
+            {
+                Log::error("Scripting", "Failed to create the context.");
+                return NULL;
+            }
+        }
+        else
+        {
+            ctx = m_context_pool.back();
+            m_context_pool.pop_back();
         }
 
-        // Prepare the script context with the function we wish to execute. Prepare()
-        // must be called on the context before each new script function that will be
-        // executed. Note, that if because we intend to execute the same function 
-        // several times, we will store the function returned by 
-        // GetFunctionByDecl(), so that this relatively slow call can be skipped.
-        r = ctx->Prepare(func);
+        // Prepare the script context with the function we wish to execute.
+        // Prepare() must be called on the context before each new script
+        // function that will be executed.
+        int r = ctx->Prepare(func);
         if (r < 0)
         {
             Log::error("Scripting", "Failed to prepare the context.");
-            ctx->Release();
-            //m_engine->Release();
-            return;
+            releaseContext(ctx);
+            return NULL;
         }
+        return ctx;
+    }   // prepareContext
 
-        // Here, we can pass parameters to the script functions. 
-        //ctx->setArgType(index, value);
-        //for example : ctx->SetArgFloat(0, 3.14159265359f);
-
-        if (callback)
-            callback(ctx);
+    //-----------------------------------------------------------------------------
+    /** Executes a prepared context, and prints an error message if the
+     *  script did not finish.
+     *  \param ctx The context to execute.
+     *  \return True if the script finished successfully.
+     */
+    bool ScriptEngine::executeContext(asIScriptContext* ctx)
+    {
+        int r = ctx->Execute();
+        if (r == asEXECUTION_FINISHED)
+            return true;
 
-        // Execute the function
-        r = ctx->Execute();
-        if (r != asEXECUTION_FINISHED)
+        // The execution didn't finish as we had planned. Determine why.
+        if (r == asEXECUTION_ABORTED)
         {
-            // The execution didn't finish as we had planned. Determine why.
-            if (r == asEXECUTION_ABORTED)
-            {
-                Log::error("Scripting", "The script was aborted before it could finish. Probably it timed out.");
-            }
-            else if (r == asEXECUTION_EXCEPTION)
-            {
-                Log::error("Scripting", "The script ended with an exception.");
-
-                // Write some information about the script exception
-                //asIScriptFunction *func = ctx->GetExceptionFunction();
-                //std::cout << "func: " << func->GetDeclaration() << std::endl;
-                //std::cout << "modl: " << func->GetModuleName() << std::endl;
-                //std::cout << "sect: " << func->GetScriptSectionName() << std::endl;
-                //std::cout << "line: " << ctx->GetExceptionLineNumber() << std::endl;
-                //std::cout << "desc: " << ctx->GetExceptionString() << std::endl;
-            }
-            else
-            {
-                Log::error("Scripting", "The script ended for some unforeseen reason (%i)", r);
-            }
+            Log::error("Scripting", "The script was aborted before it could finish. Probably it timed out.");
+        }
+        else if (r == asEXECUTION_EXCEPTION)
+        {
+            Log::error("Scripting", "The script ended with an exception : (line %i) %s",
+                ctx->GetExceptionLineNumber(),
+                ctx->GetExceptionString());
         }
         else
         {
-            // Retrieve the return value from the context here (for scripts that return values)
-            // <type> returnValue = ctx->getReturnType(); for example
-            //float returnValue = ctx->GetReturnFloat();
-
-            if (get_return_value)
-                get_return_value(ctx);
+            Log::error("Scripting", "The script ended for some unforeseen reason (%i)", r);
         }
+        return false;
+    }   // executeContext
 
-        // We must release the contexts when no longer using them
-        ctx->Release();
-    }
+    //-----------------------------------------------------------------------------
+    /** Returns a context to the pool after it was executed.
+     *  \param ctx The context, which must not be used afterwards.
+     */
+    void ScriptEngine::releaseContext(asIScriptContext* ctx)
+    {
+        // This releases the references to the function and its arguments.
+        ctx->Unprepare();
+        m_context_pool.push_back(ctx);
+    }   // releaseContext
 
     //-----------------------------------------------------------------------------
 
@@ -431,6 +416,7 @@ namespace Scripting
         }
         m_functions_cache.clear();
         m_engine->DiscardModule(MODULE_ID_MAIN_SCRIPT_FILE);
+        m_cache_generation++;
     }
 
     //-----------------------------------------------------------------------------
@@ -585,4 +571,87 @@ namespace Scripting
             }
         }
     }
+
+    //-----------------------------------------------------------------------------
+    /** Compares the cost of calling a script function like a kart-kart
+     *  collision callback: creating a new context for each call (as was done
+     *  before the context pool existed), runFunction() (which looks up the
+     *  declaration in the function cache for each call), and a
+     *  ScriptFunction handle.
+     */
+    void ScriptEngine::benchmarkCalls()
+    {
+        bool created = getInstance() == NULL;
+        ScriptEngine *engine = getInstance<ScriptEngine>();
+        asIScriptModule *module = engine->m_engine->GetModule(
+            MODULE_ID_MAIN_SCRIPT_FILE, asGM_ALWAYS_CREATE);
+        module->AddScriptSection("benchmark",
+            "int g_collisions = 0;\n"
+            "void onKartKartCollision(int a, int b) { g_collisions += a + b; }\n");
+        if (module->Build() < 0)
+        {
+            Log::error("Benchmark", "Failed to compile the benchmark script.");
+            engine->cleanupCache();
+            if (created)
+                kill();
+            return;
+        }
+        int *collisions = (int*)module->GetAddressOfGlobalVar(
+            module->GetGlobalVarIndexByName("g_collisions"));
+
+        const std::string declaration = "void onKartKartCollision(int, int)";
+        const int calls = 10000;
+        const int rounds = 10;
+
+        // Previous implementation: look up the declaration, and create a
+        // new context for each call.
+        uint64_t start = StkTime::getMonoTimeUs();
+        for (int n = 0; n < rounds * calls; n++)
+        {
+            asIScriptFunction *func = engine->getFunction(false, declaration);
+            asIScriptContext *ctx = engine->m_engine->CreateContext();
+            ctx->Prepare(func);
+            ctx->SetArgDWord(0, 1);
+            ctx->SetArgDWord(1, n & 7);
+            ctx->Execute();
+            ctx->Release();
+        }
+        uint64_t created_contexts = StkTime::getMonoTimeUs() - start;
+
+        start = StkTime::getMonoTimeUs();
+        for (int n = 0; n < rounds * calls; n++)
+        {
+            engine->runFunction(false, declaration,
+                [=](asIScriptContext* ctx) {
+                    ctx->SetArgDWord(0, 1);
+                    ctx->SetArgDWord(1, n & 7);
+                });
+        }
+        uint64_t run_function = StkTime::getMonoTimeUs() - start;
+
+        ScriptFunction function(false, declaration);
+        start = StkTime::getMonoTimeUs();
+        for (int n = 0; n < rounds * calls; n++)
+            function.call(1, n & 7);
+        uint64_t handle = StkTime::getMonoTimeUs() - start;
+
+        int expected = 0;
+        for (int n = 0; n < rounds * calls; n++)
+            expected += 1 + (n & 7);
+        if (*collisions != 3 * expected)
+        {
+            Log::error("Benchmark", "Script calls computed %d instead of %d.",
+                       *collisions, 3 * expected);
+        }
+
+        Log::info("Benchmark", "%d script calls: new context %.2f ms, "
+            "runFunction %.2f ms, ScriptFunction %.2f ms (%.0f calls per "
+            "second).", calls, created_contexts / 1000.0 / rounds,
+            run_function / 1000.0 / rounds, handle / 1000.0 / rounds,
+            rounds * calls * 1000000.0 / std::max(handle, (uint64_t)1));
+
+        engine->cleanupCache();
+        if (created)
+            kill();
+    }   // benchmarkCalls
 }
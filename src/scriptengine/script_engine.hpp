@@ -19,6 +19,7 @@
 #ifndef HEADER_SCRIPT_ENGINE_HPP
 #define HEADER_SCRIPT_ENGINE_HPP
 
+#include "scriptengine/script_function.hpp"
 #include "scriptengine/script_utils.hpp"
 #include "utils/no_copy.hpp"
 #include "utils/ptr_vector.hpp"
@@ -28,6 +29,7 @@
 #include <functional>
 #include <map>
 #include <string>
+#include <vector>
 
 class TrackObjectPresentation;
 
@@ -67,16 +69,26 @@ namespace Scripting
     public:
 
 
-        void runFunction(bool warn_if_not_found, std::string function_name);
-        void runFunction(bool warn_if_not_found, std::string function_name,
+        void runFunction(bool warn_if_not_found,
+            const std::string& function_name);
+        void runFunction(bool warn_if_not_found,
+            const std::string& function_name,
             std::function<void(asIScriptContext*)> callback);
-        void runFunction(bool warn_if_not_found, std::string function_name,
+        void runFunction(bool warn_if_not_found,
+            const std::string& function_name,
             std::function<void(asIScriptContext*)> callback,
             std::function<void(asIScriptContext*)> get_return_value);
         void runDelegate(asIScriptFunction* delegate_fn);
         void evalScript(std::string script_fragment);
         void cleanupCache();
 
+        asIScriptFunction* getFunction(bool warn_if_not_found,
+                                       const std::string& function_name);
+        asIScriptContext* prepareContext(asIScriptFunction* func);
+        bool executeContext(asIScriptContext* ctx);
+        void releaseContext(asIScriptContext* ctx);
+        static void benchmarkCalls();
+
         bool loadScript(std::string script_path, bool clear_previous);
         bool compileLoadedScripts();
 
@@ -86,11 +98,22 @@ namespace Scripting
 
         asIScriptEngine* getEngine() { return m_engine; }
 
+        /** Returns a number that changes each time the cache of functions
+         *  is cleared (or a new script engine is created), so that a
+         *  ScriptFunction knows when to look up its function again. */
+        static unsigned int getCacheGeneration() { return m_cache_generation; }
+
     private:
         asIScriptEngine *m_engine;
         std::map<std::string, asIScriptFunction*> m_functions_cache;
         PtrVector<PendingTimeout> m_pending_timeouts;
 
+        /** Contexts which are not executing, so that they can be reused
+         *  instead of creating a new context for each call. */
+        std::vector<asIScriptContext*> m_context_pool;
+
+        static unsigned int m_cache_generation;
+
         void configureEngine(asIScriptEngine *engine);
     };   // class ScriptEngine
 
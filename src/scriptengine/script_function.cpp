@@ -0,0 +1,60 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2014-2015  SuperTuxKart Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "scriptengine/script_function.hpp"
+
+#include "scriptengine/script_engine.hpp"
+
+namespace Scripting
+{
+    // ------------------------------------------------------------------------
+    /** Looks up the function if this was not done since the scripts were
+     *  (re)loaded, and returns a context prepared for it from the pool of
+     *  the script engine.
+     *  \return The context, or NULL if the function does not exist.
+     */
+    asIScriptContext* ScriptFunction::prepare()
+    {
+        ScriptEngine *engine = ScriptEngine::getInstance();
+        if (engine == NULL || m_declaration.empty())
+            return NULL;
+
+        if (m_generation != ScriptEngine::getCacheGeneration())
+        {
+            m_function = engine->getFunction(m_warn_if_not_found,
+                                             m_declaration);
+            m_generation = ScriptEngine::getCacheGeneration();
+        }
+        if (m_function == NULL)
+            return NULL;
+        return engine->prepareContext(m_function);
+    }   // prepare
+
+    // ------------------------------------------------------------------------
+    /** Executes the function in the given context (after the arguments were
+     *  set) and returns the context to the pool.
+     *  \return True if the function was executed successfully.
+     */
+    bool ScriptFunction::execute(asIScriptContext *ctx)
+    {
+        ScriptEngine *engine = ScriptEngine::getInstance();
+        bool success = engine->executeContext(ctx);
+        engine->releaseContext(ctx);
+        return success;
+    }   // execute
+}
@@ -0,0 +1,135 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2014-2015  SuperTuxKart Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_SCRIPT_FUNCTION_HPP
+#define HEADER_SCRIPT_FUNCTION_HPP
+
+#include <angelscript.h>
+#include <string>
+
+namespace Scripting
+{
+    /** A handle to a script function, which is declared once (e.g. when a
+     *  track object is loaded). The function is only looked up the first
+     *  time it is called after the scripts of a track were loaded, so a call
+     *  needs no string operations, and it uses a context from the pool of
+     *  the script engine. This makes it cheap enough to be called e.g. for
+     *  each collision. The arguments are set according to their C++ type:
+     *  int, float, bool, or a pointer to an object (e.g. a std::string or a
+     *  TrackObject for a handle).
+     */
+    class ScriptFunction
+    {
+    private:
+        /** The declaration of the function, e.g. "void onStart()". */
+        std::string m_declaration;
+
+        /** If a warning should be printed if the function does not exist. */
+        bool m_warn_if_not_found;
+
+        /** The function, NULL if it does not exist. Not reference counted,
+         *  the function is kept alive by the cache of the script engine. */
+        asIScriptFunction *m_function;
+
+        /** The cache generation of the script engine when m_function was
+         *  looked up, used to detect that the scripts were unloaded. */
+        unsigned int m_generation;
+
+        asIScriptContext* prepare();
+        bool execute(asIScriptContext *ctx);
+
+        // --------------------------------------------------------------------
+        static void setArg(asIScriptContext *ctx, int i, int value)
+        {
+            ctx->SetArgDWord(i, (asDWORD)value);
+        }   // setArg(int)
+        // --------------------------------------------------------------------
+        static void setArg(asIScriptContext *ctx, int i, float value)
+        {
+            ctx->SetArgFloat(i, value);
+        }   // setArg(float)
+        // --------------------------------------------------------------------
+        static void setArg(asIScriptContext *ctx, int i, bool value)
+        {
+            ctx->SetArgByte(i, value ? 1 : 0);
+        }   // setArg(bool)
+        // --------------------------------------------------------------------
+        template<typename T>
+        static void setArg(asIScriptContext *ctx, int i, const T *object)
+        {
+            ctx->SetArgObject(i, const_cast<T*>(object));
+        }   // setArg(object)
+        // --------------------------------------------------------------------
+        static void setArgs(asIScriptContext *ctx, int i) {}
+        // --------------------------------------------------------------------
+        template<typename T, typename... Args>
+        static void setArgs(asIScriptContext *ctx, int i, T first,
+                            Args... rest)
+        {
+            setArg(ctx, i, first);
+            setArgs(ctx, i + 1, rest...);
+        }   // setArgs
+
+    public:
+        // --------------------------------------------------------------------
+        ScriptFunction()
+        {
+            m_warn_if_not_found = false;
+            m_function          = NULL;
+            m_generation        = 0;
+        }   // ScriptFunction
+        // --------------------------------------------------------------------
+        ScriptFunction(bool warn_if_not_found, const std::string &declaration)
+        {
+            setDeclaration(warn_if_not_found, declaration);
+        }   // ScriptFunction
+        // --------------------------------------------------------------------
+        /** Sets the function to call.
+         *  \param warn_if_not_found Print a warning (once) if the function
+         *         does not exist, otherwise only a debug message is printed.
+         *  \param declaration The declaration of the function, e.g.
+         *         "void onKartKartCollision(int, int)".
+         */
+        void setDeclaration(bool warn_if_not_found,
+                            const std::string &declaration)
+        {
+            m_declaration       = declaration;
+            m_warn_if_not_found = warn_if_not_found;
+            m_function          = NULL;
+            m_generation        = 0;
+        }   // setDeclaration
+        // --------------------------------------------------------------------
+        /** Returns true if no function was declared. */
+        bool isEmpty() const { return m_declaration.empty(); }
+        // --------------------------------------------------------------------
+        /** Calls the function with the given arguments.
+         *  \return True if the function exists and was executed
+         *          successfully. */
+        template<typename... Args>
+        bool call(Args... args)
+        {
+            asIScriptContext *ctx = prepare();
+            if (!ctx)
+                return false;
+            setArgs(ctx, 0, args...);
+            return execute(ctx);
+        }   // call
+    };   // class ScriptFunction
+}
+
+#endif
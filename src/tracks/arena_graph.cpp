@@ -25,20 +25,71 @@
 #include "tracks/arena_node.hpp"
 #include "tracks/track.hpp"
 #include "tracks/track_manager.hpp"
+#include "utils/file_utils.hpp"
 #include "utils/log.hpp"
+#include "utils/string_utils.hpp"
+#include "utils/time.hpp"
 
 #include <algorithm>
+#include <atomic>
 #include <queue>
+#include <thread>
+
+// -----------------------------------------------------------------------------
+/** Version of the file format used to cache the shortest paths. It must be
+ *  increased whenever the format or the way the paths are computed changes,
+ *  so that outdated cache files are not used anymore.
+ */
+static const uint32_t ARENA_PATHS_CACHE_VERSION = 1;
+
+// -----------------------------------------------------------------------------
+/** Computes a 64 bit FNV-1a hash of the content of a file.
+ *  \return False if the file could not be read.
+ */
+static bool hashFile(const std::string &file_name, uint64_t *hash)
+{
+    FILE *fd = FileUtils::fopenU8Path(file_name, "rb");
+    if (!fd)
+        return false;
+    uint64_t h = 0xcbf29ce484222325ULL;
+    unsigned char buffer[16384];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), fd)) > 0)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            h ^= buffer[i];
+            h *= 0x100000001b3ULL;
+        }
+    }
+    fclose(fd);
+    *hash = h;
+    return true;
+}   // hashFile
 
 // -----------------------------------------------------------------------------
 ArenaGraph::ArenaGraph(const std::string &navmesh, const XMLNode *node)
           : Graph()
 {
     loadNavmesh(navmesh);
-    buildGraph();
-    // Compute shortest distance from all nodes
-    for (unsigned int i = 0; i < getNumNodes(); i++)
-        computeDijkstra(i);
+
+    // The shortest paths only depend on the navmesh, so they are cached on
+    // disk using a hash of the navmesh file as key.
+    uint64_t hash = 0;
+    std::string cache_file;
+    if (getNumNodes() > 0 && hashFile(navmesh, &hash))
+    {
+        char name[64];
+        sprintf(name, "arena-paths-%016llx.bin", (unsigned long long)hash);
+        cache_file = file_manager->getCachedDataDir() + name;
+    }
+    if (cache_file.empty() || !loadCachedPaths(cache_file, hash))
+    {
+        buildGraph();
+        computeAllShortestPaths();
+        if (!cache_file.empty())
+            saveCachedPaths(cache_file, hash);
+    }
 
     setNearbyNodesOfAllNodes();
     if (node && race_manager->getMinorMode() == RaceManager::MINOR_MODE_SOCCER)
@@ -171,6 +222,7 @@ void ArenaGraph::loadNavmesh(const std::string &navmesh)
         }
     }
     delete xml;
+    buildSectorGrid();
 
 }   // loadNavmesh
 
@@ -179,8 +231,7 @@ void ArenaGraph::buildGraph()
 {
     const unsigned int n_nodes = getNumNodes();
 
-    m_distance_matrix = std::vector<std::vector<float>>
-        (n_nodes, std::vector<float>(n_nodes, 9999.9f));
+    m_distance_matrix.assign(n_nodes * n_nodes, 9999.9f);
     for (unsigned int i = 0; i < n_nodes; i++)
     {
         ArenaNode* cur_node = getNode(i);
@@ -188,22 +239,21 @@ void ArenaGraph::buildGraph()
         {
             Vec3 diff = getNode(adjacent)->getCenter() - cur_node->getCenter();
             float distance = diff.length();
-            m_distance_matrix[i][adjacent] = distance;
+            m_distance_matrix[i * n_nodes + adjacent] = distance;
         }
-        m_distance_matrix[i][i] = 0.0f;
+        m_distance_matrix[i * n_nodes + i] = 0.0f;
     }
 
     // Allocate and initialise the previous node data structure:
-    m_parent_node = std::vector<std::vector<int16_t>>
-        (n_nodes, std::vector<int16_t>(n_nodes, Graph::UNKNOWN_SECTOR));
+    m_parent_node.assign(n_nodes * n_nodes, Graph::UNKNOWN_SECTOR);
     for (unsigned int i = 0; i < n_nodes; i++)
     {
         for (unsigned int j = 0; j < n_nodes; j++)
         {
-            if (i == j || m_distance_matrix[i][j] >= 9899.9f)
-                m_parent_node[i][j] = -1;
+            if (i == j || m_distance_matrix[i * n_nodes + j] >= 9899.9f)
+                m_parent_node[i * n_nodes + j] = -1;
             else
-                m_parent_node[i][j] = i;
+                m_parent_node[i * n_nodes + j] = i;
         }   // for j
     }   // for i
 
@@ -216,6 +266,8 @@ void ArenaGraph::buildGraph()
  *  source to j and m_parent_node[source][j] stores the last vertex visited on
  *  the shortest path from i to j before visiting j. Suppose the shortest path
  *  from i to j is i->......->k->j  then m_parent_node[i][j] = k
+ *  Only the row of 'source' is modified, so the computation for different
+ *  sources can run in parallel.
  */
 void ArenaGraph::computeDijkstra(int source)
 {
@@ -235,6 +287,8 @@ void ArenaGraph::computeDijkstra(int source)
     IndDistPair begin(source, 0.0f);
     queue.push(begin);
     const unsigned int n = getNumNodes();
+    float* distance = &m_distance_matrix[source * n];
+    int16_t* parent = &m_parent_node[source * n];
     std::vector<bool> visited;
     visited.resize(n, false);
     while (!queue.empty())
@@ -246,17 +300,20 @@ void ArenaGraph::computeDijkstra(int source)
         if (visited[cur_index]) continue;
         visited[cur_index] = true;
 
+        const Vec3& center = m_all_nodes[cur_index]->getCenter();
         for (const int& adjacent : getNode(cur_index)->getAdjacentNodes())
         {
             // Distance already computed, can be ignored
             if (visited[adjacent]) continue;
 
-            float new_dist =
-                current.second + m_distance_matrix[cur_index][adjacent];
-            if (new_dist < m_distance_matrix[source][adjacent])
+            // Don't use the row of cur_index in m_distance_matrix for the
+            // length of the edge, it might be modified by another thread.
+            float new_dist = current.second +
+                (m_all_nodes[adjacent]->getCenter() - center).length();
+            if (new_dist < distance[adjacent])
             {
-                m_distance_matrix[source][adjacent] = new_dist;
-                m_parent_node[source][adjacent] = cur_index;
+                distance[adjacent] = new_dist;
+                parent[adjacent] = cur_index;
             }
             IndDistPair pair(adjacent, new_dist);
             queue.push(pair);
@@ -264,6 +321,117 @@ void ArenaGraph::computeDijkstra(int source)
     }
 }   // computeDijkstra
 
+// ----------------------------------------------------------------------------
+/** Computes the shortest paths between all nodes by running Dijkstra for
+ *  each node, distributed over all available cores. buildGraph() must have
+ *  been called before.
+ */
+void ArenaGraph::computeAllShortestPaths()
+{
+    const unsigned int n = getNumNodes();
+    unsigned int thread_count = std::thread::hardware_concurrency();
+    if (thread_count == 0)
+        thread_count = 1;
+    thread_count = std::min(thread_count, n);
+
+    double start = StkTime::getRealTime();
+    std::atomic<unsigned int> next_source(0);
+    auto compute = [this, n, &next_source]()
+        {
+            unsigned int source;
+            while ((source = next_source.fetch_add(1)) < n)
+                computeDijkstra(source);
+        };
+    std::vector<std::thread> threads;
+    for (unsigned int i = 1; i < thread_count; i++)
+        threads.emplace_back(compute);
+    compute();
+    for (std::thread& t : threads)
+        t.join();
+    Log::info("ArenaGraph", "Computed shortest paths of %d nodes with %d "
+        "threads in %f seconds.", n, thread_count,
+        StkTime::getRealTime() - start);
+}   // computeAllShortestPaths
+
+// ----------------------------------------------------------------------------
+/** Loads the shortest paths from a cache file written by saveCachedPaths().
+ *  \param file_name Name of the cache file.
+ *  \param hash Hash of the navmesh, which must match the one in the file.
+ *  \return True if the paths were loaded.
+ */
+bool ArenaGraph::loadCachedPaths(const std::string &file_name, uint64_t hash)
+{
+    FILE *fd = FileUtils::fopenU8Path(file_name, "rb");
+    if (!fd)
+        return false;
+
+    const uint32_t n = getNumNodes();
+    char magic[4];
+    uint32_t version = 0, file_n = 0;
+    uint64_t file_hash = 0;
+    bool ok = fread(magic, 1, 4, fd) == 4 && memcmp(magic, "STKP", 4) == 0 &&
+        fread(&version, sizeof(version), 1, fd) == 1 &&
+        version == ARENA_PATHS_CACHE_VERSION &&
+        fread(&file_hash, sizeof(file_hash), 1, fd) == 1 &&
+        file_hash == hash &&
+        fread(&file_n, sizeof(file_n), 1, fd) == 1 && file_n == n;
+    if (ok)
+    {
+        m_distance_matrix.resize(n * n);
+        m_parent_node.resize(n * n);
+        ok = fread(m_distance_matrix.data(), sizeof(float), n * n, fd) ==
+                n * n &&
+             fread(m_parent_node.data(), sizeof(int16_t), n * n, fd) == n * n;
+    }
+    fclose(fd);
+    if (!ok)
+    {
+        Log::warn("ArenaGraph", "Ignoring invalid cache file '%s'.",
+                  file_name.c_str());
+        m_distance_matrix.clear();
+        m_parent_node.clear();
+        return false;
+    }
+    Log::info("ArenaGraph", "Loaded shortest paths from '%s'.",
+              file_name.c_str());
+    return true;
+}   // loadCachedPaths
+
+// ----------------------------------------------------------------------------
+/** Saves the shortest paths to a cache file. The file is first written
+ *  under a temporary name and then renamed, so that other processes loading
+ *  the same arena never see a partially written file.
+ *  \param file_name Name of the cache file.
+ *  \param hash Hash of the navmesh.
+ */
+void ArenaGraph::saveCachedPaths(const std::string &file_name,
+                                 uint64_t hash) const
+{
+    const std::string tmp_name = FileUtils::getTemporaryName(file_name);
+    FILE *fd = FileUtils::fopenU8Path(tmp_name, "wb");
+    if (!fd)
+    {
+        Log::warn("ArenaGraph", "Can not write cache file '%s'.",
+                  tmp_name.c_str());
+        return;
+    }
+    const uint32_t n = getNumNodes();
+    const uint32_t version = ARENA_PATHS_CACHE_VERSION;
+    bool ok = fwrite("STKP", 1, 4, fd) == 4 &&
+        fwrite(&version, sizeof(version), 1, fd) == 1 &&
+        fwrite(&hash, sizeof(hash), 1, fd) == 1 &&
+        fwrite(&n, sizeof(n), 1, fd) == 1 &&
+        fwrite(m_distance_matrix.data(), sizeof(float), n * n, fd) == n * n &&
+        fwrite(m_parent_node.data(), sizeof(int16_t), n * n, fd) == n * n;
+    ok = fclose(fd) == 0 && ok;
+    if (!ok || FileUtils::renameU8Path(tmp_name, file_name) != 0)
+    {
+        Log::warn("ArenaGraph", "Can not write cache file '%s'.",
+                  file_name.c_str());
+        file_manager->removeFile(tmp_name);
+    }
+}   // saveCachedPaths
+
 // ----------------------------------------------------------------------------
 /** THIS FUNCTION IS ONLY USED FOR UNIT-TESTING, to verify that the new
  *  Dijkstra algorithm gives the same results.
@@ -284,12 +452,14 @@ void ArenaGraph::computeFloydWarshall()
         {
             for (unsigned int j = 0; j < n; j++)
             {
-                if ((m_distance_matrix[i][k] + m_distance_matrix[k][j]) <
-                    m_distance_matrix[i][j])
+                if ((m_distance_matrix[i * n + k] +
+                     m_distance_matrix[k * n + j]) <
+                    m_distance_matrix[i * n + j])
                 {
-                    m_distance_matrix[i][j] =
-                        m_distance_matrix[i][k] + m_distance_matrix[k][j];
-                    m_parent_node[i][j] = m_parent_node[k][j];
+                    m_distance_matrix[i * n + j] =
+                        m_distance_matrix[i * n + k] +
+                        m_distance_matrix[k * n + j];
+                    m_parent_node[i * n + j] = m_parent_node[k * n + j];
                 }
             }
         }
@@ -341,7 +511,8 @@ void ArenaGraph::setNearbyNodesOfAllNodes()
         // Get the distance to all nodes at i
         ArenaNode* cur_node = getNode(i);
         std::vector<int> nearby_nodes;
-        std::vector<float> dist = m_distance_matrix[i];
+        std::vector<float> dist(m_distance_matrix.begin() + i * getNumNodes(),
+            m_distance_matrix.begin() + (i + 1) * getNumNodes());
 
         // Skip the same node
         dist[i] = 999999.0f;
@@ -362,14 +533,14 @@ void ArenaGraph::setNearbyNodesOfAllNodes()
 /** Determines the full path from 'from' to 'to' and returns it in a
  *  std::vector (in reverse order). Used only for unit testing.
  */
-std::vector<int16_t> ArenaGraph::getPathFromTo(int from, int to,
-                      const std::vector< std::vector< int16_t > >& parent_node)
+std::vector<int16_t> ArenaGraph::getPathFromTo(int from, int to, unsigned n,
+                                      const std::vector<int16_t>& parent_node)
 {
     std::vector<int16_t> path;
     path.push_back(to);
     while(from!=to)
     {
-        to = parent_node[from][to];
+        to = parent_node[from * n + to];
         path.push_back(to);
     }
     return path;
@@ -387,14 +558,27 @@ void ArenaGraph::unitTesting()
     Track *track = track_manager->getTrack("cave");
     std::string navmesh_file_name=track->getTrackFile("navmesh.xml");
 
-    double s = StkTime::getRealTime();
+    // The constructor might load the paths from the cache, which must
+    // give the same results as computing them
     ArenaGraph* ag = new ArenaGraph(navmesh_file_name);
+    std::vector<float> cached_distance_matrix = ag->m_distance_matrix;
+    std::vector<int16_t> cached_parent_node = ag->m_parent_node;
+
+    double s = StkTime::getRealTime();
+    ag->buildGraph();
+    ag->computeAllShortestPaths();
     double e = StkTime::getRealTime();
     Log::error("Time", "Dijkstra       %lf", e-s);
+    if (ag->m_distance_matrix != cached_distance_matrix ||
+        ag->m_parent_node != cached_parent_node)
+    {
+        Log::fatal("ArenaGraph", "Cached paths differ from the computed "
+                                 "paths.");
+    }
 
     // Save the Dijkstra results
-    std::vector< std::vector< float > > distance_matrix = ag->m_distance_matrix;
-    std::vector< std::vector< int16_t > > parent_node = ag->m_parent_node;
+    std::vector<float> distance_matrix = ag->m_distance_matrix;
+    std::vector<int16_t> parent_node = ag->m_parent_node;
     ag->buildGraph();
 
     // Now compute results with Floyd-Warshall
@@ -403,16 +587,18 @@ void ArenaGraph::unitTesting()
     e = StkTime::getRealTime();
     Log::error("Time", "Floyd-Warshall %lf", e-s);
 
+    const unsigned int n = ag->getNumNodes();
     int error_count = 0;
-    for(unsigned int i=0; i<ag->m_distance_matrix.size(); i++)
+    for(unsigned int i=0; i<n; i++)
     {
-        for(unsigned int j=0; j<ag->m_distance_matrix[i].size(); j++)
+        for(unsigned int j=0; j<n; j++)
         {
-            if(ag->m_distance_matrix[i][j] - distance_matrix[i][j] > 0.001f)
+            if(ag->m_distance_matrix[i*n+j] - distance_matrix[i*n+j] > 0.001f)
             {
                 Log::error("ArenaGraph",
                            "Incorrect distance %d, %d: Dijkstra: %f F.W.: %f",
-                           i, j, distance_matrix[i][j], ag->m_distance_matrix[i][j]);
+                           i, j, distance_matrix[i*n+j],
+                           ag->m_distance_matrix[i*n+j]);
                 error_count++;
             }    // if distance is too different
 
@@ -424,16 +610,19 @@ void ArenaGraph::unitTesting()
             // debugging in the feature
 #undef TEST_PARENT_POLY_EVEN_THOUGH_MANY_FALSE_POSITIVES
 #ifdef TEST_PARENT_POLY_EVEN_THOUGH_MANY_FALSE_POSITIVES
-            if(ag->m_parent_node[i][j] != parent_node[i][j])
+            if(ag->m_parent_node[i*n+j] != parent_node[i*n+j])
             {
                 error_count++;
-                std::vector<int16_t> dijkstra_path = getPathFromTo(i, j, parent_node);
-                std::vector<int16_t> floyd_path = getPathFromTo(i, j, ag->m_parent_node);
+                std::vector<int16_t> dijkstra_path =
+                    getPathFromTo(i, j, n, parent_node);
+                std::vector<int16_t> floyd_path =
+                    getPathFromTo(i, j, n, ag->m_parent_node);
                 if(dijkstra_path.size()!=floyd_path.size())
                 {
                     Log::error("ArenaGraph",
                                "Incorrect path length %d, %d: Dijkstra: %d F.W.: %d",
-                               i, j, parent_node[i][j], ag->m_parent_node[i][j]);
+                               i, j, parent_node[i*n+j],
+                               ag->m_parent_node[i*n+j]);
                     continue;
                 }
                 Log::error("ArenaGraph", "Path problems from %d to %d:",
@@ -34,11 +34,13 @@ class XMLNode;
 class ArenaGraph : public Graph
 {
 private:
-    /** The actual graph data structure, it is an adjacency matrix. */
-    std::vector<std::vector<float>> m_distance_matrix;
+    /** The actual graph data structure, it is an adjacency matrix stored
+     *  row by row: the entry (i, j) is at index i * getNumNodes() + j. */
+    std::vector<float> m_distance_matrix;
 
-    /** The matrix that is used to store computed shortest paths. */
-    std::vector<std::vector<int16_t>> m_parent_node;
+    /** The matrix that is used to store computed shortest paths, stored the
+     *  same way as m_distance_matrix. */
+    std::vector<int16_t> m_parent_node;
 
     /** Used in soccer mode to colorize the goal lines in minimap. */
     std::set<int> m_red_node;
@@ -56,10 +58,16 @@ private:
     // ------------------------------------------------------------------------
     void computeDijkstra(int n);
     // ------------------------------------------------------------------------
+    void computeAllShortestPaths();
+    // ------------------------------------------------------------------------
     void computeFloydWarshall();
     // ------------------------------------------------------------------------
-    static std::vector<int16_t> getPathFromTo(int from, int to,
-                     const std::vector< std::vector< int16_t > >& parent_node);
+    bool loadCachedPaths(const std::string &file_name, uint64_t hash);
+    // ------------------------------------------------------------------------
+    void saveCachedPaths(const std::string &file_name, uint64_t hash) const;
+    // ------------------------------------------------------------------------
+    static std::vector<int16_t> getPathFromTo(int from, int to, unsigned n,
+                                     const std::vector<int16_t>& parent_node);
     // ------------------------------------------------------------------------
     virtual bool hasLapLine() const OVERRIDE                  { return false; }
     // ------------------------------------------------------------------------
@@ -84,7 +92,7 @@ public:
     {
         if (i == Graph::UNKNOWN_SECTOR || j == Graph::UNKNOWN_SECTOR)
             return Graph::UNKNOWN_SECTOR;
-        return (int)(m_parent_node[j][i]);
+        return (int)(m_parent_node[j * getNumNodes() + i]);
     }
     // ------------------------------------------------------------------------
     /** Returns the distance between any two nodes */
@@ -92,7 +100,7 @@ public:
     {
         if (from == Graph::UNKNOWN_SECTOR || to == Graph::UNKNOWN_SECTOR)
             return 99999.0f;
-        return m_distance_matrix[from][to];
+        return m_distance_matrix[from * getNumNodes() + to];
     }
 
 };   // ArenaGraph
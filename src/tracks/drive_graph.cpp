@@ -160,6 +160,7 @@ void DriveGraph::load(const std::string &quad_file_name,
             max_height_testing);
     }
     delete quad;
+    buildSectorGrid();
 
     const XMLNode *xml = file_manager->createXMLTree(filename);
 
@@ -168,6 +169,7 @@ void DriveGraph::load(const std::string &quad_file_name,
         // No graph file exist, assume a default loop X -> X+1
         // Set the default loop:
         setDefaultSuccessors();
+        setNearbyNodesOfAllNodes();
         computeDirectionData();
 
         if (m_all_nodes.size() > 0)
@@ -246,6 +248,7 @@ void DriveGraph::load(const std::string &quad_file_name,
     delete xml;
 
     setDefaultSuccessors();
+    setNearbyNodesOfAllNodes();
     computeDistanceFromStart(getStartNode(), 0.0f);
     computeDirectionData();
 
@@ -360,6 +363,63 @@ void DriveGraph::setDefaultSuccessors()
     }   // for i<m_allNodes.size()
 }   // setDefaultSuccessors
 
+// -----------------------------------------------------------------------------
+/** Sets the nearby nodes of each node, which are tested first when searching
+ *  the sector a kart (or item etc) is on: all nodes that can be reached with
+ *  up to NEARBY_DEPTH steps along successors (which includes the entries of
+ *  shortcuts) or predecessors. They are sorted by the number of steps, so
+ *  that the closest node is found first if quads overlap.
+ */
+void DriveGraph::setNearbyNodesOfAllNodes()
+{
+    const unsigned int NEARBY_DEPTH = 3;
+    const unsigned int n = getNumNodes();
+    // Stores for each node the index of the last node it was added for
+    std::vector<unsigned int> visited(n, n);
+    std::vector<int> nearby_nodes;
+    for (unsigned int i = 0; i < n; i++)
+    {
+        nearby_nodes.clear();
+        visited[i] = i;
+        // Breadth first search, one depth level after the other
+        unsigned int level_start = 0;
+        nearby_nodes.push_back(i);
+        for (unsigned int depth = 0; depth < NEARBY_DEPTH; depth++)
+        {
+            const unsigned int level_end = (unsigned int)nearby_nodes.size();
+            for (unsigned int j = level_start; j < level_end; j++)
+            {
+                const DriveNode* dn = getNode(nearby_nodes[j]);
+                for (unsigned int k = 0; k < dn->getNumberOfSuccessors(); k++)
+                {
+                    const unsigned int next = dn->getSuccessor(k);
+                    if (visited[next] == i) continue;
+                    visited[next] = i;
+                    nearby_nodes.push_back(next);
+                }
+                for (unsigned int k = 0; k < dn->getNumberOfPredecessors();
+                     k++)
+                {
+                    const unsigned int prev = dn->getPredecessor(k);
+                    if (visited[prev] == i) continue;
+                    visited[prev] = i;
+                    nearby_nodes.push_back(prev);
+                }
+            }
+            level_start = level_end;
+        }   // for depth < NEARBY_DEPTH
+        // The node itself is always tested before the nearby nodes
+        nearby_nodes.erase(nearby_nodes.begin());
+        getNode(i)->setNearbyNodes(nearby_nodes);
+    }   // for i < n
+}   // setNearbyNodesOfAllNodes
+
+// -----------------------------------------------------------------------------
+const std::vector<int>* DriveGraph::getNearbyNodes(int n) const
+{
+    return &getNode(n)->getNearbyNodes();
+}   // getNearbyNodes
+
 // -----------------------------------------------------------------------------
 /** Sets all start positions depending on the drive graph. The number of
  *  entries needed is defined by the size of the start_transform (though all
@@ -50,6 +50,8 @@ private:
     // ------------------------------------------------------------------------
     void setDefaultSuccessors();
     // ------------------------------------------------------------------------
+    void setNearbyNodesOfAllNodes();
+    // ------------------------------------------------------------------------
     void computeChecklineRequirements(DriveNode* node, int latest_checkline);
     // ------------------------------------------------------------------------
     void computeDirectionData();
@@ -72,6 +74,8 @@ private:
     virtual bool hasLapLine() const OVERRIDE;
     // ------------------------------------------------------------------------
     virtual void differentNodeColor(int n, video::SColor* c) const OVERRIDE;
+    // ------------------------------------------------------------------------
+    virtual const std::vector<int>* getNearbyNodes(int n) const OVERRIDE;
 
 public:
     static DriveGraph* get()     { return dynamic_cast<DriveGraph*>(m_graph); }
@@ -96,6 +96,12 @@ private:
      */
    std::vector< int > m_checkline_requirements;
 
+    /** The nodes close to this node in the graph, i.e. the successors and
+     *  predecessors (including the ones on shortcuts) up to a certain depth.
+     *  They are tested first when searching the sector of a point that was
+     *  on this node before. */
+    std::vector<int>   m_nearby_nodes;
+
 
     // ------------------------------------------------------------------------
    void markAllSuccessorsToUse(unsigned int n,
@@ -193,6 +199,14 @@ public:
     /** True if this node should be ignored by the AI. */
     bool        letAIIgnore() const                     { return m_ai_ignore; }
     // ------------------------------------------------------------------------
+    /** Returns the nodes close to this node in the graph. */
+    const std::vector<int>& getNearbyNodes() const  { return m_nearby_nodes; }
+    // ------------------------------------------------------------------------
+    void        setNearbyNodes(const std::vector<int>& nodes)
+    {
+        m_nearby_nodes = nodes;
+    }   // setNearbyNodes
+    // ------------------------------------------------------------------------
     virtual void getDistances(const Vec3 &xyz, Vec3 *result) const = 0;
 
 };   // DriveNode
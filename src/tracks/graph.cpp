@@ -25,13 +25,23 @@
 #include "graphics/material_manager.hpp"
 #include "graphics/sp/sp_mesh.hpp"
 #include "graphics/sp/sp_mesh_buffer.hpp"
+#include "io/file_manager.hpp"
 #include "modes/profile_world.hpp"
 #include "race/race_manager.hpp"
 #include "tracks/arena_node_3d.hpp"
+#include "tracks/drive_graph.hpp"
 #include "tracks/drive_node_2d.hpp"
 #include "tracks/drive_node_3d.hpp"
 #include "tracks/track.hpp"
+#include "tracks/track_manager.hpp"
+#include "utils/file_utils.hpp"
 #include "utils/log.hpp"
+#include "utils/string_utils.hpp"
+#include "utils/time.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <set>
 
 const int Graph::UNKNOWN_SECTOR = -1;
 const float Graph::MIN_HEIGHT_TESTING = -1.0f;
@@ -48,6 +58,12 @@ Graph::Graph()
     m_bb_min      = Vec3( 99999,  99999,  99999);
     m_bb_max      = Vec3(-99999, -99999, -99999);
     memset(m_bb_nodes, 0, 4 * sizeof(int));
+    m_grid_min_x     = 0;
+    m_grid_min_z     = 0;
+    m_grid_cell_size = 1.0f;
+    m_grid_width     = 0;
+    m_grid_height    = 0;
+    m_test_nearby_nodes = true;
 }  // Graph
 
 // -----------------------------------------------------------------------------
@@ -602,6 +618,8 @@ void Graph::createQuad(const Vec3 &p0, const Vec3 &p1, const Vec3 &p2,
  *         test. This is used by the AI to make sure that it ends up on the
  *         selected way in case of a branch, and also to make sure that it
  *         doesn't skip e.g. a loop (see explanation below for details).
+ *         If it is NULL, the nearby nodes of the previous sector (if the
+ *         graph has any) are tested first, and only then all quads.
  */
 void Graph::findRoadSector(const Vec3& xyz, int *sector,
                            std::vector<int> *all_sectors,
@@ -615,6 +633,24 @@ void Graph::findRoadSector(const Vec3& xyz, int *sector,
         return;
     }   // if still on same quad
 
+    // Next most likely it is on a quad close to the previous one in the
+    // graph, which also keeps the sector on the same path if quads overlap.
+    if (!all_sectors && *sector != UNKNOWN_SECTOR && m_test_nearby_nodes)
+    {
+        const std::vector<int>* nearby = getNearbyNodes(*sector);
+        if (nearby)
+        {
+            for (unsigned int i = 0; i < nearby->size(); i++)
+            {
+                if (getQuad((*nearby)[i])->pointInside(xyz, ignore_vertical))
+                {
+                    *sector = (*nearby)[i];
+                    return;
+                }
+            }
+        }
+    }   // if nearby nodes
+
     // Now we search through all quads, starting with
     // the current one
     int indx       = *sector;
@@ -632,6 +668,31 @@ void Graph::findRoadSector(const Vec3& xyz, int *sector,
                             ? (unsigned int)all_sectors->size()
                             : (unsigned int)m_all_nodes.size();
     *sector = UNKNOWN_SECTOR;
+
+    // Without a list of sectors only the quads of the grid cell containing
+    // the point need to be tested. Pick the one that the linear search
+    // below would find first, i.e. the first one after the previous sector.
+    int x, z;
+    if (!all_sectors && !m_grid_start.empty() && getGridCell(xyz, &x, &z))
+    {
+        if (x < 0 || x >= m_grid_width || z < 0 || z >= m_grid_height)
+            return;
+        const int n = getNumNodes();
+        const int cell = z * m_grid_width + x;
+        int min_order = n;
+        for (int i = m_grid_start[cell]; i < m_grid_start[cell + 1]; i++)
+        {
+            const int q = m_grid_quads[i];
+            const int order = (q - indx - 1 + n) % n;
+            if (order < min_order && getQuad(q)->pointInside(xyz,
+                                                             ignore_vertical))
+            {
+                min_order = order;
+                *sector   = q;
+            }
+        }
+        return;
+    }
     for(unsigned int i=0; i<max_count; i++)
     {
         if(all_sectors)
@@ -708,6 +769,16 @@ int Graph::findOutOfRoadSector(const Vec3& xyz, const int curr_sector,
     int   min_sector = UNKNOWN_SECTOR;
     float min_dist_2 = 999999.0f*999999.0f;
 
+    if (!all_sectors && findOutOfRoadSectorInGrid(xyz, current_sector + 1,
+                                                  ignore_vertical,
+                                                  &min_sector))
+    {
+        if (min_sector != UNKNOWN_SECTOR)
+            return min_sector;
+        Log::warn("Graph", "unknown sector found.");
+        return 0;
+    }
+
     // If a kart is falling and in between (or too far below)
     // a driveline point it might not fulfill
     // the height condition. So we run the test twice: first with height
@@ -760,6 +831,331 @@ int Graph::findOutOfRoadSector(const Vec3& xyz, const int curr_sector,
     return 0;
 }   // findOutOfRoadSector
 
+//-----------------------------------------------------------------------------
+/** Searches the closest sector to a point using the sector grid, with
+ *  exactly the same result as the linear search in findOutOfRoadSector().
+ *  The grid cells are tested in rings of increasing distance around the
+ *  cell of the point, until the remaining cells are further away than the
+ *  closest sector found so far.
+ *  \param xyz The point for which the closest sector is searched.
+ *  \param start The sector with which the linear search would start, used
+ *         to break ties between sectors with the same distance.
+ *  \param ignore_vertical True if the height condition should be ignored.
+ *  \param sector On return the closest sector, or UNKNOWN_SECTOR if no
+ *         sector is close enough.
+ *  \return False if the grid can not be used for this point.
+ */
+bool Graph::findOutOfRoadSectorInGrid(const Vec3& xyz, int start,
+                                      bool ignore_vertical, int *sector) const
+{
+    int cx, cz;
+    if (m_grid_start.empty() || !getGridCell(xyz, &cx, &cz))
+        return false;
+
+    const int n = getNumNodes();
+    start = (start % n + n) % n;
+
+    // Index 0 is the closest sector which fulfills the height condition,
+    // index 1 the closest one independent of height.
+    int   min_sector[2] = { UNKNOWN_SECTOR, UNKNOWN_SECTOR };
+    float min_dist_2[2] = { 999999.0f*999999.0f, 999999.0f*999999.0f };
+    int   min_order[2]  = { n, n };
+
+    // Rings closer than first_ring do not contain any cell of the grid
+    const int first_ring = std::max(std::max(0, std::max(-cx, -cz)),
+        std::max(cx - m_grid_width + 1, cz - m_grid_height + 1));
+    const int last_ring  = std::max(std::max(cx, m_grid_width  - 1 - cx),
+                                    std::max(cz, m_grid_height - 1 - cz));
+    for (int r = first_ring; r <= last_ring; r++)
+    {
+        // All cells not tested yet are at least (r-1) cells away
+        const float bound = (r - 1) * m_grid_cell_size * 0.999f;
+        if (min_sector[0] != UNKNOWN_SECTOR && bound > 0 &&
+            bound * bound > min_dist_2[0])
+            break;
+
+        for (int z = std::max(cz - r, 0);
+             z <= std::min(cz + r, m_grid_height - 1); z++)
+        {
+            const int step = (z == cz - r || z == cz + r) ? 1 : 2 * r;
+            for (int x = cx - r; x <= cx + r; x += step)
+            {
+                if (x < 0 || x >= m_grid_width)
+                    continue;
+                const int cell = z * m_grid_width + x;
+                for (int i = m_grid_start[cell]; i < m_grid_start[cell + 1];
+                     i++)
+                {
+                    const int indx = m_grid_quads[i];
+                    const Quad* q = getQuad(indx);
+                    if (q->isIgnored())
+                        continue;
+                    const float dist_2 = q->getDistance2FromPoint(xyz);
+                    const int order = (indx - start + n) % n;
+                    const float dist = xyz.getY() - q->getMinHeight();
+                    const bool height_ok = (dist < 5.0f && dist > -1.0f) ||
+                                           q->is3DQuad() || ignore_vertical;
+                    for (int phase = height_ok ? 0 : 1; phase < 2; phase++)
+                    {
+                        if (dist_2 < min_dist_2[phase] ||
+                            (dist_2 == min_dist_2[phase] &&
+                             order < min_order[phase]))
+                        {
+                            min_dist_2[phase] = dist_2;
+                            min_sector[phase] = indx;
+                            min_order[phase]  = order;
+                        }
+                    }
+                }   // for i in cell
+            }   // for x
+        }   // for z
+    }   // for r
+
+    *sector = min_sector[0] != UNKNOWN_SECTOR ? min_sector[0] : min_sector[1];
+    return true;
+}   // findOutOfRoadSectorInGrid
+
+//-----------------------------------------------------------------------------
+/** Computes the grid cell in which a point is. The cell can be outside of
+ *  the grid.
+ *  \return False if the point is too far away from the grid.
+ */
+bool Graph::getGridCell(const Vec3& xyz, int *x, int *z) const
+{
+    const float fx = (xyz.getX() - m_grid_min_x) / m_grid_cell_size;
+    const float fz = (xyz.getZ() - m_grid_min_z) / m_grid_cell_size;
+    // This also rejects NaN
+    if (!(fabsf(fx) < 1.0e6f && fabsf(fz) < 1.0e6f))
+        return false;
+    *x = (int)floorf(fx);
+    *z = (int)floorf(fz);
+    return true;
+}   // getGridCell
+
+//-----------------------------------------------------------------------------
+/** Builds the grid used by findRoadSector() and findOutOfRoadSector(). Must
+ *  be called once all quads are created.
+ */
+void Graph::buildSectorGrid()
+{
+    m_grid_start.clear();
+    m_grid_quads.clear();
+    const unsigned int n = getNumNodes();
+    if (n == 0)
+        return;
+
+    // The 2d bounding box of each quad. A 3d quad tests the point against a
+    // box extending 5 units along its normal (see BoundingBox3D), so its
+    // bounding box is enlarged accordingly.
+    std::vector<float> extents(4 * n);
+    float min_x =  999999.0f, min_z =  999999.0f;
+    float max_x = -999999.0f, max_z = -999999.0f;
+    for (unsigned int i = 0; i < n; i++)
+    {
+        const Quad* q = getQuad(i);
+        float x0 = (*q)[0].getX(), x1 = x0, z0 = (*q)[0].getZ(), z1 = z0;
+        for (int j = 1; j < 4; j++)
+        {
+            x0 = std::min(x0, (*q)[j].getX());
+            x1 = std::max(x1, (*q)[j].getX());
+            z0 = std::min(z0, (*q)[j].getZ());
+            z1 = std::max(z1, (*q)[j].getZ());
+        }
+        if (q->is3DQuad())
+        {
+            x0 -= 5.0f; x1 += 5.0f; z0 -= 5.0f; z1 += 5.0f;
+        }
+        extents[4 * i    ] = x0;
+        extents[4 * i + 1] = x1;
+        extents[4 * i + 2] = z0;
+        extents[4 * i + 3] = z1;
+        min_x = std::min(min_x, x0);
+        max_x = std::max(max_x, x1);
+        min_z = std::min(min_z, z0);
+        max_z = std::max(max_z, z1);
+    }
+
+    // Aim at about one quad per cell
+    m_grid_min_x     = min_x;
+    m_grid_min_z     = min_z;
+    m_grid_cell_size = std::max(sqrtf((max_x - min_x) * (max_z - min_z) / n),
+                                1.0f);
+    m_grid_width     = (int)((max_x - min_x) / m_grid_cell_size) + 1;
+    m_grid_height    = (int)((max_z - min_z) / m_grid_cell_size) + 1;
+
+    // Store the quads per cell in one array: first count the quads of each
+    // cell, then compute the start index of each cell, then fill in.
+    const int num_cells = m_grid_width * m_grid_height;
+    std::vector<int> count(num_cells + 1, 0);
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (unsigned int i = 0; i < n; i++)
+        {
+            int x0, z0, x1, z1;
+            getGridCell(Vec3(extents[4 * i    ], 0, extents[4 * i + 2]),
+                        &x0, &z0);
+            getGridCell(Vec3(extents[4 * i + 1], 0, extents[4 * i + 3]),
+                        &x1, &z1);
+            x1 = std::min(x1, m_grid_width  - 1);
+            z1 = std::min(z1, m_grid_height - 1);
+            for (int z = std::max(z0, 0); z <= z1; z++)
+            {
+                for (int x = std::max(x0, 0); x <= x1; x++)
+                {
+                    const int cell = z * m_grid_width + x;
+                    if (pass == 0)
+                        count[cell]++;
+                    else
+                        m_grid_quads[count[cell]++] = i;
+                }
+            }
+        }
+        if (pass == 0)
+        {
+            m_grid_start.resize(num_cells + 1);
+            int sum = 0;
+            for (int i = 0; i <= num_cells; i++)
+            {
+                m_grid_start[i] = sum;
+                sum += count[i];
+                count[i] = m_grid_start[i];
+            }
+            m_grid_quads.resize(sum);
+        }
+    }
+    Log::debug("Graph", "Sector grid with %dx%d cells, %d entries for %d "
+               "quads.", m_grid_width, m_grid_height,
+               (int)m_grid_quads.size(), n);
+}   // buildSectorGrid
+
+//-----------------------------------------------------------------------------
+/** Compares the linear sector search with the grid based one, and with
+ *  the search that tests the nearby nodes of the previous sector first, by
+ *  replaying the kart positions recorded in the stock replay files on the
+ *  drive graph of their track. Each position is also tested 10 units
+ *  higher, to exercise findOutOfRoadSector() for karts in the air. The
+ *  nearby nodes can give a different result than the linear search where
+ *  quads overlap, so these differences are only counted.
+ */
+void Graph::benchmarkSectorSearch()
+{
+    std::set<std::string> files;
+    file_manager->listFiles(files,
+        file_manager->getAssetDirectory(FileManager::REPLAY),
+        /*is_full_path*/ true);
+
+    int tested = 0;
+    for (const std::string& file : files)
+    {
+        if (StringUtils::getExtension(file) != "replay")
+            continue;
+        FILE* fd = FileUtils::fopenU8Path(file, "r");
+        if (!fd)
+            continue;
+        std::string track_name;
+        int reverse = 0;
+        std::vector<Vec3> positions;
+        char s[1024], name[1024];
+        while (fgets(s, 1023, fd))
+        {
+            float t, x, y, z;
+            if (sscanf(s, "track: %1023s", name) == 1)
+                track_name = name;
+            else if (sscanf(s, "reverse: %d", &reverse) == 1)
+                continue;
+            else if (!track_name.empty() &&
+                     sscanf(s, "%f %f %f %f", &t, &x, &y, &z) == 4)
+                positions.push_back(Vec3(x, y, z));
+        }
+        fclose(fd);
+
+        Track* track = track_manager->getTrack(track_name);
+        if (!track || positions.empty())
+        {
+            Log::warn("Benchmark", "Track '%s' of '%s' not found, skipped.",
+                      track_name.c_str(), file.c_str());
+            continue;
+        }
+        DriveGraph* graph = new DriveGraph(track->getTrackFile("quads.xml"),
+            track->getTrackFile("graph.xml"), reverse != 0);
+        if (graph->getNumNodes() == 0)
+        {
+            Graph::destroy();
+            continue;
+        }
+
+        // Track the sector of a kart on the recorded positions and of one
+        // above them the same way TrackSector::update does.
+        auto replay = [graph, &positions](std::vector<int>* result)
+        {
+            result->clear();
+            int sector[2] = { UNKNOWN_SECTOR, UNKNOWN_SECTOR };
+            for (const Vec3& p : positions)
+            {
+                for (int k = 0; k < 2; k++)
+                {
+                    Vec3 xyz = p;
+                    if (k == 1)
+                        xyz.setY(xyz.getY() + 10.0f);
+                    int prev_sector = sector[k];
+                    graph->findRoadSector(xyz, &sector[k]);
+                    if (sector[k] == UNKNOWN_SECTOR)
+                    {
+                        sector[k] = graph->findOutOfRoadSector(xyz,
+                                                               prev_sector);
+                    }
+                    result->push_back(sector[k]);
+                }
+            }
+        };
+
+        const int passes = 10;
+        std::vector<int> nearby_result, grid_result, linear_result;
+        uint64_t start = StkTime::getMonoTimeUs();
+        for (int i = 0; i < passes; i++)
+            replay(&nearby_result);
+        uint64_t nearby_time = StkTime::getMonoTimeUs() - start;
+
+        graph->m_test_nearby_nodes = false;
+        start = StkTime::getMonoTimeUs();
+        for (int i = 0; i < passes; i++)
+            replay(&grid_result);
+        uint64_t grid_time = StkTime::getMonoTimeUs() - start;
+
+        std::vector<int> grid_start, grid_quads;
+        grid_start.swap(graph->m_grid_start);
+        grid_quads.swap(graph->m_grid_quads);
+        start = StkTime::getMonoTimeUs();
+        for (int i = 0; i < passes; i++)
+            replay(&linear_result);
+        uint64_t linear_time = StkTime::getMonoTimeUs() - start;
+        grid_start.swap(graph->m_grid_start);
+        grid_quads.swap(graph->m_grid_quads);
+        graph->m_test_nearby_nodes = true;
+
+        int mismatches = 0, differences = 0;
+        for (unsigned int i = 0; i < grid_result.size(); i++)
+        {
+            if (grid_result[i] != linear_result[i])
+                mismatches++;
+            if (nearby_result[i] != linear_result[i])
+                differences++;
+        }
+        const float queries = float(passes * grid_result.size());
+        Log::info("Benchmark", "%s (%d quads, %d positions): linear %.3f "
+                  "us/query, grid %.3f us/query, %d mismatches, nearby "
+                  "nodes and grid %.3f us/query, %d different sectors",
+                  track_name.c_str(), graph->getNumNodes(),
+                  (int)positions.size(), linear_time / queries,
+                  grid_time / queries, mismatches, nearby_time / queries,
+                  differences);
+        Graph::destroy();
+        tested++;
+    }
+    if (tested == 0)
+        Log::warn("Benchmark", "No replay with an installed track found.");
+}   // benchmarkSectorSearch
+
 //-----------------------------------------------------------------------------
 void Graph::loadBoundingBoxNodes()
 {
@@ -66,6 +66,8 @@ protected:
     // ------------------------------------------------------------------------
     /** Map 4 bounding box points to 4 closest graph nodes. */
     void loadBoundingBoxNodes();
+    // ------------------------------------------------------------------------
+    void buildSectorGrid();
 
 private:
     /** The 2d bounding box, used for hashing. */
@@ -90,6 +92,28 @@ private:
     /** The render target used for drawing the minimap. */
     std::unique_ptr<RenderTarget> m_render_target;
 
+    /** A uniform grid on the XZ plane over all quads, used to quickly find
+     *  the quads close to a point in findRoadSector() and
+     *  findOutOfRoadSector(). Each cell stores the indices of all quads whose
+     *  (padded) 2d bounding box overlaps it: the quads of cell i are
+     *  m_grid_quads[m_grid_start[i]] ... m_grid_quads[m_grid_start[i+1]-1].
+     *  If m_grid_start is empty, all quads are tested linearly. */
+    std::vector<int> m_grid_start;
+    std::vector<int> m_grid_quads;
+
+    /** Minimum X and Z coordinate of the grid. */
+    float m_grid_min_x, m_grid_min_z;
+
+    /** Length of the side of a grid cell. */
+    float m_grid_cell_size;
+
+    /** Number of cells in X and Z direction. */
+    int m_grid_width, m_grid_height;
+
+    /** If the nearby nodes of the previous sector are tested first in
+     *  findRoadSector(). Only switched off to benchmark the search. */
+    bool m_test_nearby_nodes;
+
     // ------------------------------------------------------------------------
     void createMesh(bool show_invisible=true,
                     bool enable_transparency=false,
@@ -103,9 +127,19 @@ private:
     // ------------------------------------------------------------------------
     void cleanupDebugMesh();
     // ------------------------------------------------------------------------
+    bool getGridCell(const Vec3& xyz, int *x, int *z) const;
+    // ------------------------------------------------------------------------
+    bool findOutOfRoadSectorInGrid(const Vec3& xyz, int start,
+                                   bool ignore_vertical, int *sector) const;
+    // ------------------------------------------------------------------------
     virtual bool hasLapLine() const = 0;
     // ------------------------------------------------------------------------
     virtual void differentNodeColor(int n, video::SColor* c) const = 0;
+    // ------------------------------------------------------------------------
+    /** Returns the nodes that should be tested first in findRoadSector()
+     *  if a point was on node n before, or NULL if the graph has none. */
+    virtual const std::vector<int>* getNearbyNodes(int n) const
+                                                              { return NULL; }
 
 public:
     static const int UNKNOWN_SECTOR;
@@ -141,6 +175,8 @@ public:
     // ------------------------------------------------------------------------
     virtual ~Graph();
     // ------------------------------------------------------------------------
+    static void benchmarkSectorSearch();
+    // ------------------------------------------------------------------------
     void createDebugMesh();
     // ------------------------------------------------------------------------
     RenderTarget* makeMiniMap(const core::dimension2du &dimension,
@@ -0,0 +1,291 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2020 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+
+#include "tracks/height_map.hpp"
+
+#include "io/file_manager.hpp"
+#include "physics/triangle_mesh.hpp"
+#include "utils/file_utils.hpp"
+#include "utils/log.hpp"
+#include "utils/time.hpp"
+#include "utils/worker_pool.hpp"
+
+#include <cassert>
+#include <cstring>
+#include <limits>
+
+// ----------------------------------------------------------------------------
+/** Version of the file format used to cache height maps. It must be
+ *  increased whenever the format (or the way the grid is built) changes. */
+static const uint32_t HEIGHT_MAP_CACHE_VERSION = 1;
+
+const float HeightMap::NO_GROUND = -std::numeric_limits<float>::max();
+
+// ----------------------------------------------------------------------------
+/** Creates an empty height map, init() must be called before it is used.
+ *  \param aabb_min, aabb_max The bounding box of the track.
+ *  \param resolution Number of cells in x and in z direction.
+ */
+HeightMap::HeightMap(const Vec3 &aabb_min, const Vec3 &aabb_max,
+                     unsigned int resolution)
+         : m_resolution(resolution), m_min(aabb_min), m_max(aabb_max)
+{
+    assert(resolution > 0);
+    m_cell_x = (m_max.getX() - m_min.getX()) / resolution;
+    m_cell_z = (m_max.getZ() - m_min.getZ()) / resolution;
+    // Avoid divisions by zero for a flat bounding box
+    if (m_cell_x <= 0.0f)
+        m_cell_x = 1.0f;
+    if (m_cell_z <= 0.0f)
+        m_cell_z = 1.0f;
+}   // HeightMap
+
+// ----------------------------------------------------------------------------
+/** Fills the grid, either from the cache file or by casting a ray for each
+ *  cell against the mesh (which is then saved to the cache file).
+ *  \param mesh The (main) track mesh, its collision shape must exist.
+ *  \param cache_file Full path of the cache file, or "" to always build the
+ *         grid.
+ */
+void HeightMap::init(const TriangleMesh &mesh, const std::string &cache_file)
+{
+    // The grid depends on the mesh, the bounding box and the resolution
+    uint64_t hash = 0;
+    if (!cache_file.empty())
+    {
+        hash = mesh.getMeshHash();
+        auto add = [&hash](const void *data, size_t size)
+            {
+                const unsigned char *p = (const unsigned char*)data;
+                for (size_t i = 0; i < size; i++)
+                {
+                    hash ^= p[i];
+                    hash *= 0x100000001b3ULL;
+                }
+            };
+        add(&m_resolution, sizeof(m_resolution));
+        add(m_min.m_floats, 3 * sizeof(btScalar));
+        add(m_max.m_floats, 3 * sizeof(btScalar));
+    }
+
+    // The triangle of each cell (-1 if none), the materials are looked up
+    // from it, so the cache does not need to store materials.
+    std::vector<int32_t> triangles;
+    if (cache_file.empty() || !loadCache(cache_file, hash, &triangles))
+    {
+        build(mesh, &triangles);
+        if (!cache_file.empty())
+            saveCache(cache_file, hash, triangles);
+    }
+
+    m_materials.resize(triangles.size());
+    for (unsigned int i = 0; i < triangles.size(); i++)
+    {
+        m_materials[i] = triangles[i] >= 0 ? mesh.getMaterial(triangles[i])
+                                           : NULL;
+    }
+}   // init
+
+// ----------------------------------------------------------------------------
+/** Casts a ray downwards through the centre of each cell. The rows of the
+ *  grid are done in parallel, which is safe since raycasts do not change
+ *  the mesh.
+ *  \param mesh The track mesh.
+ *  \param triangles On return the index of the triangle hit in each cell.
+ */
+void HeightMap::build(const TriangleMesh &mesh,
+                      std::vector<int32_t> *triangles)
+{
+    uint64_t start = StkTime::getMonoTimeUs();
+    const unsigned int n = m_resolution;
+    m_heights.resize(n * n);
+    triangles->resize(n * n);
+    const float top = m_max.getY() + 1.0f;
+    const float bottom = m_min.getY() - 1.0f;
+    WorkerPool::get()->parallelFor(n,
+        [this, &mesh, triangles, n, top, bottom](unsigned int ix)
+        {
+            const float x = m_min.getX() + (ix + 0.5f) * m_cell_x;
+            for (unsigned int iz = 0; iz < n; iz++)
+            {
+                const float z = m_min.getZ() + (iz + 0.5f) * m_cell_z;
+                btVector3 hit_point;
+                const Material *material;
+                int triangle = -1;
+                const unsigned int cell = ix * n + iz;
+                if (mesh.castRay(btVector3(x, top, z),
+                    btVector3(x, bottom, z), &hit_point, &material,
+                    /*normal*/NULL, /*interpolate*/false, &triangle))
+                {
+                    m_heights[cell] = hit_point.getY();
+                    (*triangles)[cell] = triangle;
+                }
+                else
+                {
+                    m_heights[cell] = NO_GROUND;
+                    (*triangles)[cell] = -1;
+                }
+            }
+        });
+    Log::info("HeightMap", "Built %ux%u height map in %f ms.", n, n,
+              (StkTime::getMonoTimeUs() - start) / 1000.0f);
+}   // build
+
+// ----------------------------------------------------------------------------
+/** Loads the grid from a cache file written by saveCache().
+ *  \param file_name Name of the cache file.
+ *  \param hash Hash of the mesh and the grid parameters.
+ *  \param triangles On return the index of the triangle hit in each cell.
+ *  \return True if the grid was loaded.
+ */
+bool HeightMap::loadCache(const std::string &file_name, uint64_t hash,
+                          std::vector<int32_t> *triangles)
+{
+    FILE *fd = FileUtils::fopenU8Path(file_name, "rb");
+    if (!fd)
+        return false;
+
+    const uint32_t n = m_resolution * m_resolution;
+    char magic[4];
+    uint32_t version = 0;
+    uint64_t file_hash = 0;
+    bool ok = fread(magic, 1, 4, fd) == 4 && memcmp(magic, "STKH", 4) == 0 &&
+        fread(&version, sizeof(version), 1, fd) == 1 &&
+        version == HEIGHT_MAP_CACHE_VERSION &&
+        fread(&file_hash, sizeof(file_hash), 1, fd) == 1 &&
+        file_hash == hash;
+    if (ok)
+    {
+        m_heights.resize(n);
+        triangles->resize(n);
+        ok = fread(m_heights.data(), sizeof(float), n, fd) == n &&
+             fread(triangles->data(), sizeof(int32_t), n, fd) == n;
+    }
+    fclose(fd);
+    if (!ok)
+    {
+        // An outdated file is normal after a track was changed
+        Log::debug("HeightMap", "Ignoring outdated cache file '%s'.",
+                   file_name.c_str());
+        m_heights.clear();
+        triangles->clear();
+        return false;
+    }
+    Log::debug("HeightMap", "Loaded height map from '%s'.",
+               file_name.c_str());
+    return true;
+}   // loadCache
+
+// ----------------------------------------------------------------------------
+/** Saves the grid to a cache file. The file is first written under a
+ *  temporary name and then renamed, so that other processes loading the
+ *  same track never see a partially written file. There is only one file
+ *  per track, a file of an older version of the track is replaced.
+ *  \param file_name Name of the cache file.
+ *  \param hash Hash of the mesh and the grid parameters.
+ *  \param triangles The index of the triangle hit in each cell.
+ */
+void HeightMap::saveCache(const std::string &file_name, uint64_t hash,
+                          const std::vector<int32_t> &triangles) const
+{
+    const std::string tmp_name = FileUtils::getTemporaryName(file_name);
+    FILE *fd = FileUtils::fopenU8Path(tmp_name, "wb");
+    if (!fd)
+    {
+        Log::warn("HeightMap", "Can not write cache file '%s'.",
+                  tmp_name.c_str());
+        return;
+    }
+    const uint32_t n = m_resolution * m_resolution;
+    const uint32_t version = HEIGHT_MAP_CACHE_VERSION;
+    bool ok = fwrite("STKH", 1, 4, fd) == 4 &&
+        fwrite(&version, sizeof(version), 1, fd) == 1 &&
+        fwrite(&hash, sizeof(hash), 1, fd) == 1 &&
+        fwrite(m_heights.data(), sizeof(float), n, fd) == n &&
+        fwrite(triangles.data(), sizeof(int32_t), n, fd) == n;
+    ok = fclose(fd) == 0 && ok;
+    if (ok && FileUtils::renameU8Path(tmp_name, file_name) != 0)
+    {
+        // Renaming does not replace an existing file on all systems
+        file_manager->removeFile(file_name);
+        ok = FileUtils::renameU8Path(tmp_name, file_name) == 0;
+    }
+    if (!ok)
+    {
+        Log::warn("HeightMap", "Can not write cache file '%s'.",
+                  file_name.c_str());
+        file_manager->removeFile(tmp_name);
+    }
+}   // saveCache
+
+// ----------------------------------------------------------------------------
+void HeightMap::unitTesting()
+{
+    // Two materials, only used to check that the right one is found
+    char m1, m2;
+    const Material *ground = (const Material*)&m1;
+    const Material *roof = (const Material*)&m2;
+
+    // A square of 10x10 at height 2, and above its first quarter a smaller
+    // square at height 5
+    TriangleMesh mesh(/*can_be_transformed*/false);
+    const btVector3 up(0, 1, 0);
+    auto add_square = [&mesh, &up](float size, float y, const Material *m)
+        {
+            mesh.addTriangle(btVector3(0, y, 0), btVector3(0, y, size),
+                             btVector3(size, y, 0), up, up, up, m);
+            mesh.addTriangle(btVector3(size, y, 0), btVector3(0, y, size),
+                             btVector3(size, y, size), up, up, up, m);
+        };
+    add_square(10.0f, 2.0f, ground);
+    add_square(5.0f, 5.0f, roof);
+    mesh.createCollisionShape();
+
+    // The grid is larger than the mesh in x direction
+    HeightMap hm(Vec3(0, 0, 0), Vec3(20, 10, 10), 8);
+    hm.init(mesh);
+    float height = 0;
+    const Material *material = NULL;
+    if (!hm.getGround(1, 1, &height, &material) || height != 5.0f ||
+        material != roof)
+        Log::fatal("HeightMap", "Top most ground not found.");
+    if (!hm.getGround(8, 8, &height, &material) || height != 2.0f ||
+        material != ground)
+        Log::fatal("HeightMap", "Ground not found.");
+    if (hm.getGround(15, 5, &height, &material) ||
+        hm.getHeight(15, 5) != NO_GROUND)
+        Log::fatal("HeightMap", "Ground found where there is none.");
+    // Positions outside of the grid use the nearest cell
+    if (hm.getHeight(-100, 1) != 5.0f || hm.getHeight(8, 100) != 2.0f)
+        Log::fatal("HeightMap", "Wrong height outside of the grid.");
+
+    // The cache gives the same grid, and is only used for the same mesh
+    const std::string file_name =
+        file_manager->getCachedDataDir() + "heightmap-unit-test.bin";
+    hm.saveCache(file_name, 1234, std::vector<int32_t>(8 * 8, 0));
+    HeightMap loaded(Vec3(0, 0, 0), Vec3(20, 10, 10), 8);
+    std::vector<int32_t> triangles;
+    if (loaded.loadCache(file_name, 4321, &triangles))
+        Log::fatal("HeightMap", "Cache with wrong hash loaded.");
+    if (!loaded.loadCache(file_name, 1234, &triangles) ||
+        loaded.m_heights != hm.m_heights ||
+        triangles != std::vector<int32_t>(8 * 8, 0))
+        Log::fatal("HeightMap", "Cache not loaded.");
+    file_manager->removeFile(file_name);
+}   // unitTesting
@@ -0,0 +1,117 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2020 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+
+#ifndef HEADER_HEIGHT_MAP_HPP
+#define HEADER_HEIGHT_MAP_HPP
+
+#include "utils/no_copy.hpp"
+#include "utils/types.hpp"
+#include "utils/vec3.hpp"
+
+#include <string>
+#include <vector>
+
+class Material;
+class TriangleMesh;
+
+/** \ingroup tracks
+ *  A grid with the height and the material of the (top most) ground of a
+ *  track, which is used for ground lookups that do not need the exact
+ *  triangle that is hit, e.g. the collisions of weather particles. The grid
+ *  covers the axis aligned bounding box of the track in x and z direction,
+ *  each cell stores the ground below the centre of the cell.
+ *  Building the grid casts one ray per cell (split over all cores using
+ *  the WorkerPool). Since it only depends on the track mesh, it is cached
+ *  on disk together with a hash of the mesh, like the BVH of the track.
+ */
+class HeightMap : public NoCopy
+{
+private:
+    /** Number of cells in x and in z direction. */
+    const unsigned int m_resolution;
+
+    /** Minimum x and z coordinate of the grid, and the lowest point of the
+     *  track (used as lowest point of the raycasts). */
+    const Vec3 m_min;
+
+    /** Maximum coordinates of the grid. */
+    const Vec3 m_max;
+
+    /** Size of a cell in x and z direction. */
+    float m_cell_x, m_cell_z;
+
+    /** Height of each cell (x index * resolution + z index), NO_GROUND if
+     *  there is no ground below the cell. */
+    std::vector<float> m_heights;
+
+    /** Material of the ground of each cell. */
+    std::vector<const Material*> m_materials;
+
+    void build(const TriangleMesh &mesh, std::vector<int32_t> *triangles);
+    bool loadCache(const std::string &file_name, uint64_t hash,
+                   std::vector<int32_t> *triangles);
+    void saveCache(const std::string &file_name, uint64_t hash,
+                   const std::vector<int32_t> &triangles) const;
+    // ------------------------------------------------------------------------
+    /** Returns the index of the cell containing the given position, which is
+     *  clamped to the grid. */
+    unsigned int getCell(float x, float z) const
+    {
+        int ix = (int)((x - m_min.getX()) / m_cell_x);
+        int iz = (int)((z - m_min.getZ()) / m_cell_z);
+        const int last = (int)m_resolution - 1;
+        ix = ix < 0 ? 0 : (ix > last ? last : ix);
+        iz = iz < 0 ? 0 : (iz > last ? last : iz);
+        return ix * m_resolution + iz;
+    }   // getCell
+
+public:
+    /** Height of cells without any ground. */
+    static const float NO_GROUND;
+
+    HeightMap(const Vec3 &aabb_min, const Vec3 &aabb_max,
+              unsigned int resolution);
+    void init(const TriangleMesh &mesh, const std::string &cache_file = "");
+    // ------------------------------------------------------------------------
+    /** Returns the height of the ground at the given position, or NO_GROUND
+     *  if there is no ground below it. */
+    float getHeight(float x, float z) const
+                                        { return m_heights[getCell(x, z)]; }
+    // ------------------------------------------------------------------------
+    /** Returns the height and the material of the ground at the given
+     *  position.
+     *  \return False if there is no ground below the position, height and
+     *          material are not changed then. */
+    bool getGround(float x, float z, float *height,
+                   const Material **material) const
+    {
+        const unsigned int cell = getCell(x, z);
+        if (m_heights[cell] == NO_GROUND)
+            return false;
+        *height = m_heights[cell];
+        *material = m_materials[cell];
+        return true;
+    }   // getGround
+    // ------------------------------------------------------------------------
+    unsigned int getResolution() const                { return m_resolution; }
+    // ------------------------------------------------------------------------
+    static void unitTesting();
+};   // class HeightMap
+
+#endif
@@ -72,6 +72,7 @@
 #include "tracks/check_manager.hpp"
 #include "tracks/drive_graph.hpp"
 #include "tracks/drive_node.hpp"
+#include "tracks/height_map.hpp"
 #include "tracks/model_definition_loader.hpp"
 #include "tracks/track_manager.hpp"
 #include "tracks/track_object_manager.hpp"
@@ -79,6 +80,7 @@
 #include "utils/log.hpp"
 #include "utils/mini_glm.hpp"
 #include "utils/string_utils.hpp"
+#include "utils/time.hpp"
 #include "utils/translation.hpp"
 
 #include <IBillboardTextSceneNode.h>
@@ -89,6 +91,7 @@
 #include <ISceneManager.h>
 #include <SMeshBuffer.h>
 
+#include <future>
 #include <iostream>
 #include <stdexcept>
 #include <sstream>
@@ -364,6 +367,7 @@ void Track::cleanup()
     if (CVS->isGLSL())
         m_sun->drop();
 #endif
+    m_height_map.reset();
     delete m_track_mesh;
     m_track_mesh = NULL;
 
@@ -728,7 +732,8 @@ void Track::startMusic() const
 
 //-----------------------------------------------------------------------------
 /** Loads the quad graph for arena, i.e. the definition of all quads, and the
- *  way they are connected to each other. Input file name is hardcoded for now
+ *  way they are connected to each other. Input file name is hardcoded for now.
+ *  Like loadDriveGraph() this is called in a separate thread.
  */
 void Track::loadArenaGraph(const XMLNode &node)
 {
@@ -751,16 +756,6 @@ void Track::loadArenaGraph(const XMLNode &node)
 
     ArenaGraph* graph = new ArenaGraph(m_root+"navmesh.xml", &node);
     Graph::setGraph(graph);
-
-    if(Graph::get()->getNumNodes()==0)
-    {
-        Log::warn("track", "No graph nodes defined for track '%s'\n",
-                m_filename.c_str());
-    }
-    else
-    {
-        loadMinimap();
-    }
 }   // loadArenaGraph
 
 //-----------------------------------------------------------------------------
@@ -789,7 +784,8 @@ btQuaternion Track::getArenaStartRotation(const Vec3& xyz, float heading)
 
 //-----------------------------------------------------------------------------
 /** Loads the drive graph, i.e. the definition of all quads, and the way
- *  they are connected to each other.
+ *  they are connected to each other. This is called in a separate thread
+ *  by loadTrackModel(), so it must not access the scene or the GPU.
  */
 void Track::loadDriveGraph(unsigned int mode_id, const bool reverse)
 {
@@ -805,21 +801,6 @@ void Track::loadDriveGraph(unsigned int mode_id, const bool reverse)
         assert(DriveGraph::get()->getNode(i)->getPredecessor(0)!=-1);
     }
 #endif
-
-    if(DriveGraph::get()->getNumNodes()==0)
-    {
-        Log::warn("track", "No graph nodes defined for track '%s'\n",
-                m_filename.c_str());
-        if (race_manager->getNumberOfKarts() > 1)
-        {
-            Log::fatal("track", "I can handle the lack of driveline in single"
-                "kart mode, but not with AIs\n");
-        }
-    }
-    else
-    {
-        loadMinimap();
-    }
 }   // loadDriveGraph
 
 // -----------------------------------------------------------------------------
@@ -909,9 +890,13 @@ void Track::createPhysicsModel(unsigned int main_track_count)
         uploadNodeVertexBuffer(m_all_nodes[i]);
     }
     main_loop->renderGUI(5580);
-    m_track_mesh->createPhysicalBody(m_friction);
+    // Building the BVH of a large track takes a lot of time, so it is
+    // cached on disk
+    m_track_mesh->createPhysicalBody(m_friction,
+        (btCollisionObject::CollisionFlags)0, m_ident + "-track");
     main_loop->renderGUI(5585);
-    m_gfx_effect_mesh->createCollisionShape();
+    m_gfx_effect_mesh->createCollisionShape(
+        /*create_collision_object*/true, m_ident + "-gfx");
     main_loop->renderGUI(5590);
 
 }   // createPhysicsModel
@@ -1487,7 +1472,8 @@ bool Track::loadMainTrack(const XMLNode &root)
         Log::fatal("track", "m_track_mesh == NULL, cannot loadMainTrack\n");
     }
 
-    m_gfx_effect_mesh->createCollisionShape();
+    m_gfx_effect_mesh->createCollisionShape(
+        /*create_collision_object*/true, m_ident + "-gfx-main");
     scene_node->setMaterialFlag(video::EMF_LIGHTING, true);
     scene_node->setMaterialFlag(video::EMF_GOURAUD_SHADING, true);
     main_loop->renderGUI(4500);
@@ -1777,6 +1763,7 @@ static void recursiveUpdatePhysics(std::vector<TrackObject*>& tos)
 void Track::loadTrackModel(bool reverse_track, unsigned int mode_id)
 {
     assert(!m_current_track);
+    const uint64_t load_start = StkTime::getMonoTimeUs();
 
     // Use m_filename to also get the path, not only the identifier
     STKTexManager::getInstance()
@@ -1897,57 +1884,21 @@ void Track::loadTrackModel(bool reverse_track, unsigned int mode_id)
     }
     main_loop->renderGUI(3320);
 
-    if (!m_is_arena && !m_is_soccer && !m_is_cutscene) 
-        loadDriveGraph(mode_id, reverse_track);
-    else if ((m_is_arena || m_is_soccer) && !m_is_cutscene && m_has_navmesh)
-        loadArenaGraph(*root);
-    main_loop->renderGUI(3340);
-
-    if (NetworkConfig::get()->isNetworking())
-        NetworkItemManager::create();
-    else
-    {
-        // Seed random engine locally
-        uint32_t seed = (uint32_t)StkTime::getTimeSinceEpoch();
-        ItemManager::updateRandomSeed(seed);
-        ItemManager::create();
-        powerup_manager->setRandomSeed(seed);
-    }
-    main_loop->renderGUI(3360);
-
-    // Set the default start positions. Node that later the default
-    // positions can still be overwritten.
-    float forwards_distance  = 1.5f;
-    float sidewards_distance = 3.0f;
-    float upwards_distance   = 0.1f;
-    int   karts_per_row      = 2;
-
-    const XMLNode *default_start = root->getNode("default-start");
-    if (default_start)
-    {
-        default_start->get("forwards-distance",  &forwards_distance );
-        default_start->get("sidewards-distance", &sidewards_distance);
-        default_start->get("upwards-distance",   &upwards_distance  );
-        default_start->get("karts-per-row",      &karts_per_row     );
-    }
-
-    if (!m_is_arena && !m_is_soccer && !m_is_cutscene)
-    {
-        if (race_manager->getMinorMode() == RaceManager::MINOR_MODE_FOLLOW_LEADER)
+    // The drive or arena graph only depends on its own files, so it is
+    // loaded in a separate thread while the main track model is loaded.
+    // Nothing may use the graph until graph_loading.get() returned.
+    uint64_t graph_time = 0;
+    std::future<void> graph_loading = std::async(std::launch::async,
+        [this, mode_id, reverse_track, root, &graph_time]()
         {
-            // In a FTL race the non-leader karts are placed at the end of the
-            // field, so we need all start positions.
-            m_start_transforms.resize(stk_config->m_max_karts);
-        }
-        else
-            m_start_transforms.resize(race_manager->getNumberOfKarts());
-        DriveGraph::get()->setDefaultStartPositions(&m_start_transforms,
-                                                   karts_per_row,
-                                                   forwards_distance,
-                                                   sidewards_distance,
-                                                   upwards_distance);
-    }
-    main_loop->renderGUI(3400);
+            const uint64_t start = StkTime::getMonoTimeUs();
+            if (!m_is_arena && !m_is_soccer && !m_is_cutscene)
+                loadDriveGraph(mode_id, reverse_track);
+            else if ((m_is_arena || m_is_soccer) && !m_is_cutscene &&
+                     m_has_navmesh)
+                loadArenaGraph(*root);
+            graph_time = StkTime::getMonoTimeUs() - start;
+        });
 
     // we need to check for fog before loading the main track model
     if (const XMLNode *node = root->getNode("sun"))
@@ -2001,11 +1952,82 @@ void Track::loadTrackModel(bool reverse_track, unsigned int mode_id)
         node->get("xyz", &m_godrays_position);
     }
 
+    uint64_t stage_start = StkTime::getMonoTimeUs();
     loadMainTrack(*root);
+    unsigned int main_track_count = (unsigned int)m_all_nodes.size();
+    const uint64_t main_track_time = StkTime::getMonoTimeUs() - stage_start;
     main_loop->renderGUI(4700);
 
-    unsigned int main_track_count = (unsigned int)m_all_nodes.size();
+    // Wait for the graph, this also rethrows any exception from loading it
+    stage_start = StkTime::getMonoTimeUs();
+    graph_loading.get();
+    const uint64_t graph_wait_time = StkTime::getMonoTimeUs() - stage_start;
+    if (Graph::get())
+    {
+        if (Graph::get()->getNumNodes() == 0)
+        {
+            Log::warn("track", "No graph nodes defined for track '%s'\n",
+                      m_filename.c_str());
+            if (DriveGraph::get() && race_manager->getNumberOfKarts() > 1)
+            {
+                Log::fatal("track", "I can handle the lack of driveline in "
+                           "single kart mode, but not with AIs\n");
+            }
+        }
+        else
+        {
+            loadMinimap();
+        }
+    }
+    main_loop->renderGUI(4710);
+
+    if (NetworkConfig::get()->isNetworking())
+        NetworkItemManager::create();
+    else
+    {
+        // Seed random engine locally
+        uint32_t seed = (uint32_t)StkTime::getTimeSinceEpoch();
+        ItemManager::updateRandomSeed(seed);
+        ItemManager::create();
+        powerup_manager->setRandomSeed(seed);
+    }
+    main_loop->renderGUI(4720);
+
+    // Set the default start positions. Node that later the default
+    // positions can still be overwritten.
+    float forwards_distance  = 1.5f;
+    float sidewards_distance = 3.0f;
+    float upwards_distance   = 0.1f;
+    int   karts_per_row      = 2;
+
+    const XMLNode *default_start = root->getNode("default-start");
+    if (default_start)
+    {
+        default_start->get("forwards-distance",  &forwards_distance );
+        default_start->get("sidewards-distance", &sidewards_distance);
+        default_start->get("upwards-distance",   &upwards_distance  );
+        default_start->get("karts-per-row",      &karts_per_row     );
+    }
 
+    if (!m_is_arena && !m_is_soccer && !m_is_cutscene)
+    {
+        if (race_manager->getMinorMode() == RaceManager::MINOR_MODE_FOLLOW_LEADER)
+        {
+            // In a FTL race the non-leader karts are placed at the end of the
+            // field, so we need all start positions.
+            m_start_transforms.resize(stk_config->m_max_karts);
+        }
+        else
+            m_start_transforms.resize(race_manager->getNumberOfKarts());
+        DriveGraph::get()->setDefaultStartPositions(&m_start_transforms,
+                                                   karts_per_row,
+                                                   forwards_distance,
+                                                   sidewards_distance,
+                                                   upwards_distance);
+    }
+    main_loop->renderGUI(4730);
+
+    stage_start = StkTime::getMonoTimeUs();
     ModelDefinitionLoader model_def_loader(this);
     main_loop->renderGUI(4800);
 
@@ -2045,13 +2067,16 @@ void Track::loadTrackModel(bool reverse_track, unsigned int mode_id)
     }
 
     model_def_loader.cleanLibraryNodesAfterLoad();
+    const uint64_t objects_time = StkTime::getMonoTimeUs() - stage_start;
     main_loop->renderGUI(5100);
 
+    stage_start = StkTime::getMonoTimeUs();
     Scripting::ScriptEngine::getInstance()->compileLoadedScripts();
     main_loop->renderGUI(5200);
 
     // Init all track objects
     m_track_object_manager->init();
+    const uint64_t scripts_time = StkTime::getMonoTimeUs() - stage_start;
     main_loop->renderGUI(5300);
 
 
@@ -2172,7 +2197,9 @@ void Track::loadTrackModel(bool reverse_track, unsigned int mode_id)
     for (auto* obj : objs_removing)
         m_track_object_manager->removeObject(obj);
 
+    stage_start = StkTime::getMonoTimeUs();
     createPhysicsModel(main_track_count);
+    const uint64_t physics_time = StkTime::getMonoTimeUs() - stage_start;
     main_loop->renderGUI(5600);
 
     freeCachedMeshVertexBuffer();
@@ -2254,6 +2281,14 @@ void Track::loadTrackModel(bool reverse_track, unsigned int mode_id)
     }
     main_loop->renderGUI(6100);
 
+    Log::info("Track", "Loaded '%s' in %.1f ms: main track %.1f ms, graph "
+              "%.1f ms in parallel (%.1f ms waited for it), objects %.1f ms, "
+              "scripts %.1f ms, physics %.1f ms.", m_ident.c_str(),
+              (StkTime::getMonoTimeUs() - load_start) / 1000.0f,
+              main_track_time / 1000.0f, graph_time / 1000.0f,
+              graph_wait_time / 1000.0f, objects_time / 1000.0f,
+              scripts_time / 1000.0f, physics_time / 1000.0f);
+
     STKTexManager::getInstance()->unsetTextureErrorMessage();
 #ifndef SERVER_ONLY
     if (CVS->isGLSL())
@@ -2712,42 +2747,23 @@ void Track::itemCommand(const XMLNode *node)
 
 // ----------------------------------------------------------------------------
 
-std::vector< std::vector<float> > Track::buildHeightMap()
+/** Returns a grid with the height and material of the ground of this track
+ *  (see HeightMap), e.g. for particles colliding with the ground. It is only
+ *  built when it is used for the first time, and is then loaded from the
+ *  cache when the track is loaded again.
+ */
+std::shared_ptr<const HeightMap> Track::getHeightMap()
 {
-    std::vector< std::vector<float> > out(HEIGHT_MAP_RESOLUTION);
-
-    float x = m_aabb_min.getX();
-    const float x_len = m_aabb_max.getX() - m_aabb_min.getX();
-    const float z_len = m_aabb_max.getZ() - m_aabb_min.getZ();
-
-    const float x_step = x_len/HEIGHT_MAP_RESOLUTION;
-    const float z_step = z_len/HEIGHT_MAP_RESOLUTION;
-
-    btVector3 hitpoint;
-    const Material* material;
-    btVector3 normal;
-
-    for (int i=0; i<HEIGHT_MAP_RESOLUTION; i++)
+    if (!m_height_map)
     {
-        out[i].resize(HEIGHT_MAP_RESOLUTION);
-        float z = m_aabb_min.getZ();
-
-        for (int j=0; j<HEIGHT_MAP_RESOLUTION; j++)
-        {
-            btVector3 pos(x, 100.0f, z);
-            btVector3 to = pos;
-            to.setY(-100000.f);
-
-            m_track_mesh->castRay(pos, to, &hitpoint, &material, &normal);
-            z += z_step;
-
-            out[i][j] = hitpoint.getY();
-        }   // j<HEIGHT_MAP_RESOLUTION
-        x += x_step;
+        HeightMap *height_map = new HeightMap(m_aabb_min, m_aabb_max,
+                                              HEIGHT_MAP_RESOLUTION);
+        height_map->init(*m_track_mesh, file_manager->getCachedDataDir() +
+                         "heightmap-" + m_ident + ".bin");
+        m_height_map.reset(height_map);
     }
-
-    return out;
-}   // buildHeightMap
+    return m_height_map;
+}   // getHeightMap
 
 // ----------------------------------------------------------------------------
 void Track::drawMiniMap(const core::rect<s32>& dest_rect) const
@@ -26,6 +26,7 @@
   * objects.
   */
 
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -44,6 +45,7 @@ class AbstractKart;
 class AnimationManager;
 class BezierCurve;
 class CheckManager;
+class HeightMap;
 class ModelDefinitionLoader;
 class MovingTexture;
 class MusicInformation;
@@ -196,6 +198,9 @@ private:
      *  allowing the kart to drive in/partly under water), but the
      *  actual surface position is needed for the water splash effect. */
     TriangleMesh*            m_gfx_effect_mesh;
+    /** Height and material grid of m_track_mesh, built on first use by
+     *  getHeightMap(). */
+    std::shared_ptr<const HeightMap> m_height_map;
     /** Minimum coordinates of this track. */
     Vec3                     m_aabb_min;
     /** Maximum coordinates of this track. */
@@ -447,7 +452,7 @@ public:
                                         unsigned int mode_id=0);
     bool findGround(AbstractKart *kart);
 
-    std::vector< std::vector<float> > buildHeightMap();
+    std::shared_ptr<const HeightMap> getHeightMap();
     void               drawMiniMap(const core::rect<s32>& dest_rect) const;
     void               updateMiniMapScale();
     // ------------------------------------------------------------------------
@@ -157,7 +157,7 @@ public:
     // ------------------------------------------------------------------------
 	const std::string getName() const { return m_name; }
     // ------------------------------------------------------------------------
-    const std::string getID() const { return m_id; }
+    const std::string& getID() const { return m_id; }
     // ------------------------------------------------------------------------
     const std::string getInteraction() const { return m_interaction; }
     // ------------------------------------------------------------------------
@@ -1155,24 +1155,25 @@ void TrackObjectPresentationActionTrigger::onTriggerItemApproached()
     {
         kart_id = camera->getKart()->getWorldKartId();
     }
-    if (!m_library_id.empty() && !m_triggered_object.empty() &&
-        !m_library_name.empty())
+    bool is_library_action = !m_library_id.empty() &&
+                             !m_triggered_object.empty() &&
+                             !m_library_name.empty();
+    if (m_action_function.isEmpty())
     {
-        Scripting::ScriptEngine::getInstance()->runFunction(true, "void "
-            + m_library_name + "::" + m_action +
-            "(int, const string, const string)", [=](asIScriptContext* ctx)
-            {
-                ctx->SetArgDWord(0, kart_id);
-                ctx->SetArgObject(1, &m_library_id);
-                ctx->SetArgObject(2, &m_triggered_object);
-            });
+        if (is_library_action)
+        {
+            m_action_function.setDeclaration(/*warn_if_not_found*/true,
+                "void " + m_library_name + "::" + m_action +
+                "(int, const string, const string)");
+        }
+        else
+        {
+            m_action_function.setDeclaration(/*warn_if_not_found*/true,
+                "void " + m_action + "(int)");
+        }
     }
+    if (is_library_action)
+        m_action_function.call(kart_id, &m_library_id, &m_triggered_object);
     else
-    {
-        Scripting::ScriptEngine::getInstance()->runFunction(true,
-            "void " + m_action + "(int)", [=](asIScriptContext* ctx)
-            {
-                ctx->SetArgDWord(0, kart_id);
-            });
-    }
+        m_action_function.call(kart_id);
 }   // onTriggerItemApproached
@@ -21,6 +21,7 @@
 #define HEADER_TRACK_OBJECT_PRESENTATION_HPP
 
 #include "graphics/lod_node.hpp"
+#include "scriptengine/script_function.hpp"
 #include "utils/cpp2011.hpp"
 #include "utils/no_copy.hpp"
 #include "utils/log.hpp"
@@ -393,6 +394,9 @@ private:
     /** For action trigger objects */
     std::string m_action, m_library_id, m_triggered_object, m_library_name;
 
+    /** The script function called when the trigger is activated. */
+    Scripting::ScriptFunction m_action_function;
+
     float m_xml_reenable_timeout;
 
     uint64_t m_reenable_timeout;
@@ -44,6 +44,9 @@ public:
     /** Sets this instance to be ready to be deleted. */
     void setCanBeDeleted() {m_can_be_deleted.setAtomic(true); }
     // ------------------------------------------------------------------------
+    /** Returns if this instance is ready to be deleted, without waiting. */
+    bool isReadyToDeleted() { return m_can_be_deleted.getAtomic(); }
+    // ------------------------------------------------------------------------
     /** Waits at most t seconds for this class to be ready to be deleted.
      *  \return true if the class is ready, false in case of a time out.
      */
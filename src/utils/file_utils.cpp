@@ -18,10 +18,14 @@
 #include "utils/file_utils.hpp"
 #include "utils/log.hpp"
 #include "utils/string_utils.hpp"
+#include "utils/time.hpp"
 
 #include <stdio.h>
 #include <string>
 #include <sys/stat.h>
+#if !defined(WIN32)
+#include <unistd.h>
+#endif
 
 // ----------------------------------------------------------------------------
 #if defined(WIN32)
@@ -166,3 +170,33 @@ int FileUtils::renameU8Path(const std::string& u8_path_old,
     return rename(u8_path_old.c_str(), u8_path_new.c_str());
 #endif
 }   // renameU8Path
+
+// ----------------------------------------------------------------------------
+/** remove() with unicode path capability.
+ */
+int FileUtils::removeU8Path(const std::string& u8_path)
+{
+#if defined(WIN32)
+    return _wremove(StringUtils::utf8ToWide(u8_path).c_str());
+#else
+    return remove(u8_path.c_str());
+#endif
+}   // removeU8Path
+
+// ----------------------------------------------------------------------------
+/** Returns a name for a temporary file next to the given file, which is
+ *  written and then renamed to the file, so that other processes never see
+ *  a partially written file. The name contains the process id, so that
+ *  processes writing the same file at the same time (e.g. server lobbies
+ *  loading the same track) never use the same temporary file.
+ */
+std::string FileUtils::getTemporaryName(const std::string& u8_path)
+{
+#if defined(WIN32)
+    unsigned pid = (unsigned)GetCurrentProcessId();
+#else
+    unsigned pid = (unsigned)getpid();
+#endif
+    return u8_path + "." + StringUtils::toString(pid) + "." +
+        StringUtils::toString(StkTime::getMonoTimeUs()) + ".tmp";
+}   // getTemporaryName
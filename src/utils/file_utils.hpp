@@ -39,6 +39,10 @@ namespace FileUtils
     int renameU8Path(const std::string& u8_path_old,
                      const std::string& u8_path_new);
     // ------------------------------------------------------------------------
+    int removeU8Path(const std::string& u8_path);
+    // ------------------------------------------------------------------------
+    std::string getTemporaryName(const std::string& u8_path);
+    // ------------------------------------------------------------------------
     /* Return a path which can be opened for writing in all systems, as long as
      * u8_path is unicode encoded. */
     inline std::string getPortableWritingPath(const std::string& u8_path)
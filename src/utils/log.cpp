@@ -21,9 +21,15 @@
 #include "config/user_config.hpp"
 #include "network/network_config.hpp"
 #include "utils/file_utils.hpp"
+#include "utils/string_utils.hpp"
+#include "utils/time.hpp"
+#include "utils/vs.hpp"
 
+#include <algorithm>
 #include <cstdio>
+#include <cstring>
 #include <ctime>
+#include <stdint.h>
 #include <stdio.h>
 
 #ifdef ANDROID
@@ -42,6 +48,102 @@ std::string   Log::m_prefix        = "";
 size_t        Log::m_buffer_size = 1;
 bool          Log::m_console_log = true;
 Synchronised<std::vector<struct Log::LineInfo> > Log::m_line_buffer;
+Synchronised<std::vector<Log::ThreadBuffer*> > Log::m_thread_buffers;
+std::atomic<bool> Log::m_async(false);
+std::thread   Log::m_writer_thread;
+std::mutex    Log::m_writer_lock;
+std::string   Log::m_file_batch;
+bool          Log::m_batch_file_output = false;
+std::string   Log::m_file_name;
+size_t        Log::m_file_size      = 0;
+time_t        Log::m_file_open_time = 0;
+size_t        Log::m_rotate_size    = 0;
+int           Log::m_rotate_time    = 0;
+
+// ----------------------------------------------------------------------------
+/** A single producer, single consumer ring buffer for the log lines of one
+ *  thread. Only the owning thread writes lines into it (without any lock),
+ *  only the writer thread (while holding m_writer_lock) reads from it. Each
+ *  line is stored as one byte log level, two bytes length, followed by the
+ *  text of the line. The head and tail are never wrapped, the position in
+ *  m_data is computed by masking them.
+ */
+struct Log::ThreadBuffer
+{
+    /** Size of the buffer, must be a power of two. */
+    static const uint32_t SIZE = 64 * 1024;
+
+    /** The stored lines. */
+    char m_data[SIZE];
+
+    /** Position at which the owning thread writes the next line. */
+    std::atomic<uint64_t> m_head;
+
+    /** Position from which the writer thread reads the next line. */
+    std::atomic<uint64_t> m_tail;
+
+    /** Number of lines dropped since the last time the writer checked,
+     *  because the buffer was full. */
+    std::atomic<uint32_t> m_dropped;
+
+    /** Set when the owning thread exits, the writer thread then deletes
+     *  this buffer once it is empty. */
+    std::atomic<bool> m_orphaned;
+
+    // ------------------------------------------------------------------------
+    ThreadBuffer() : m_head(0), m_tail(0), m_dropped(0), m_orphaned(false)
+    {
+    }   // ThreadBuffer
+    // ------------------------------------------------------------------------
+    void copyIn(uint64_t pos, const char *src, uint32_t n)
+    {
+        uint32_t start = (uint32_t)(pos & (SIZE - 1));
+        uint32_t first = std::min(n, SIZE - start);
+        memcpy(m_data + start, src, first);
+        memcpy(m_data, src + first, n - first);
+    }   // copyIn
+    // ------------------------------------------------------------------------
+    void copyOut(uint64_t pos, char *dst, uint32_t n) const
+    {
+        uint32_t start = (uint32_t)(pos & (SIZE - 1));
+        uint32_t first = std::min(n, SIZE - start);
+        memcpy(dst, m_data + start, first);
+        memcpy(dst + first, m_data, n - first);
+    }   // copyOut
+    // ------------------------------------------------------------------------
+    /** Returns the buffer of the calling thread, creating and registering it
+     *  on first use. Returns NULL if the calling thread is already exiting
+     *  and its buffer has been released.
+     */
+    static ThreadBuffer* get()
+    {
+        struct Owner
+        {
+            ThreadBuffer *m_buffer;
+            Owner()
+            {
+                m_buffer = new ThreadBuffer();
+                m_thread_buffers.lock();
+                m_thread_buffers.getData().push_back(m_buffer);
+                m_thread_buffers.unlock();
+            }
+            ~Owner()
+            {
+                m_released = true;
+                m_buffer->m_orphaned.store(true, std::memory_order_release);
+            }
+        };
+        if (m_released) return NULL;
+        static thread_local Owner owner;
+        return owner.m_buffer;
+    }   // get
+    // ------------------------------------------------------------------------
+    /** Set once the buffer of this thread was released (as part of the
+     *  thread exiting). */
+    static thread_local bool m_released;
+};   // ThreadBuffer
+
+thread_local bool Log::ThreadBuffer::m_released = false;
 
 // ----------------------------------------------------------------------------
 /** Selects background/foreground colors for the message depending on
@@ -127,12 +229,44 @@ void Log::resetTerminalColor()
 #endif
 }   // resetTerminalColor
 
+// ----------------------------------------------------------------------------
+/** Returns the current local time in the format of asctime (without the
+ *  trailing new line). The string is only recomputed once per second and
+ *  thread, and it avoids the non thread-safe asctime and localtime.
+ */
+static const char* getTimeStamp()
+{
+    static thread_local std::time_t last_time = -1;
+    static thread_local char time_stamp[32];
+
+    std::time_t now = std::time(nullptr);
+    if (now == last_time)
+        return time_stamp;
+    last_time = now;
+
+    struct tm t;
+#ifdef WIN32
+    localtime_s(&t, &now);
+#else
+    localtime_r(&now, &t);
+#endif
+    static const char *days[] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri",
+                                  "Sat" };
+    static const char *months[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                    "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+    snprintf(time_stamp, sizeof(time_stamp), "%.3s %.3s%3d %.2d:%.2d:%.2d %d",
+             days[t.tm_wday % 7], months[t.tm_mon % 12], t.tm_mday,
+             t.tm_hour, t.tm_min, t.tm_sec, 1900 + t.tm_year);
+    return time_stamp;
+}   // getTimeStamp
+
 // ----------------------------------------------------------------------------
 /** This actually creates a log message. If the messages are to be buffered,
  *  it will be appended to the output buffer. If the buffer is full, it will
  *  be flushed. If the message is not to be buffered, it will be immediately
- *  written using writeLine().
-
+ *  written using writeLine(). In asynchronous mode the message is added to
+ *  the ring buffer of the calling thread instead, and written by the writer
+ *  thread.
  *  \param level Log level of the message to print.
  *  \param format A printf-like format string.
  *  \param va_list The values to be printed for the format.
@@ -161,10 +295,8 @@ void Log::printMessage(int level, const char *component, const char *format,
     if (NetworkConfig::get()->isNetworking() &&
         NetworkConfig::get()->isServer())
     {
-        std::time_t result = std::time(nullptr);
         index += snprintf (line + index, remaining,
-            "%.24s [%s] %s: ", std::asctime(std::localtime(&result)),
-            names[level], component);
+            "%s [%s] %s: ", getTimeStamp(), names[level], component);
     }
     else
 #endif
@@ -180,6 +312,18 @@ void Log::printMessage(int level, const char *component, const char *format,
     index = index > MAX_LENGTH - 1 ? MAX_LENGTH - 1 : index;
     sprintf(line + index, "\n");
 
+    if (m_async.load(std::memory_order_relaxed))
+    {
+        // Fatal messages are written immediately, since the program is
+        // going to exit.
+        if (level < LL_FATAL && addToThreadBuffer(line, index + 1, level))
+            return;
+        std::lock_guard<std::mutex> lock(m_writer_lock);
+        writeThreadBuffers();
+        writeLine(line, level);
+        return;
+    }
+
     // If the data is not buffered, immediately print it:
     if (m_buffer_size <= 1)
     {
@@ -256,7 +400,13 @@ void Log::writeLine(const char *line, int level)
     if (m_buffer_size <= 1) OutputDebugStringA(line);
 #endif
 
-    if (m_file_stdout) fprintf(m_file_stdout, "%s", line);
+    if (m_file_stdout)
+    {
+        if (m_batch_file_output)
+            m_file_batch.append(line);
+        else
+            fprintf(m_file_stdout, "%s", line);
+    }
 
 #ifdef WIN32
     if (level >= LL_FATAL)
@@ -277,6 +427,12 @@ void Log::toggleConsoleLog(bool val)
  */
 void Log::flushBuffers()
 {
+    if (m_async.load())
+    {
+        std::lock_guard<std::mutex> lock(m_writer_lock);
+        writeThreadBuffers();
+    }
+
     m_line_buffer.lock();
     for (unsigned int i = 0; i < m_line_buffer.getData().size(); i++)
     {
@@ -287,6 +443,223 @@ void Log::flushBuffers()
     m_line_buffer.unlock();
 }   // flushBuffers
 
+// ----------------------------------------------------------------------------
+/** Adds a line to the ring buffer of the calling thread. This never blocks:
+ *  if the buffer is full the line is dropped (and the writer thread will
+ *  report the number of dropped lines).
+ *  \param line The line to add.
+ *  \param length Length of the line.
+ *  \param level Log level of the line.
+ *  \return False if the calling thread has no buffer anymore (because it is
+ *          exiting), in which case the line must be written directly.
+ */
+bool Log::addToThreadBuffer(const char *line, int length, int level)
+{
+    ThreadBuffer *tb = ThreadBuffer::get();
+    if (!tb)
+        return false;
+
+    const uint32_t needed = (uint32_t)length + 3;
+    uint64_t head = tb->m_head.load(std::memory_order_relaxed);
+    uint64_t tail = tb->m_tail.load(std::memory_order_acquire);
+    if (ThreadBuffer::SIZE - (head - tail) < needed)
+    {
+        tb->m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    const char header[3] = { (char)level, (char)(length & 0xff),
+                             (char)(length >> 8) };
+    tb->copyIn(head, header, 3);
+    tb->copyIn(head + 3, line, (uint32_t)length);
+    tb->m_head.store(head + needed, std::memory_order_release);
+    return true;
+}   // addToThreadBuffer
+
+// ----------------------------------------------------------------------------
+/** Writes all lines stored in the thread buffers, and deletes the buffers of
+ *  threads that have exited. The lines of each thread are written in order,
+ *  but lines of different threads might not be in the exact order in which
+ *  they were logged. Must be called with m_writer_lock held.
+ *  \return True if any line was written.
+ */
+bool Log::writeThreadBuffers()
+{
+    // Only this function (with m_writer_lock held) deletes buffers, so the
+    // pointers stay valid after the copy, and new threads can register
+    // while the lines are written.
+    m_thread_buffers.lock();
+    std::vector<ThreadBuffer*> buffers = m_thread_buffers.getData();
+    m_thread_buffers.unlock();
+
+    bool written = false;
+    std::vector<ThreadBuffer*> orphaned;
+    char line[ThreadBuffer::SIZE + 1];
+    m_batch_file_output = true;
+    for (ThreadBuffer *tb : buffers)
+    {
+        // Test this first: if the thread has exited, all its lines will be
+        // written by the loop below.
+        if (tb->m_orphaned.load(std::memory_order_acquire))
+            orphaned.push_back(tb);
+
+        uint32_t dropped = tb->m_dropped.exchange(0);
+        uint64_t tail = tb->m_tail.load(std::memory_order_relaxed);
+        uint64_t head = tb->m_head.load(std::memory_order_acquire);
+        while (tail != head)
+        {
+            char header[3];
+            tb->copyOut(tail, header, 3);
+            uint32_t length = (uint8_t)header[1] | ((uint8_t)header[2] << 8);
+            tb->copyOut(tail + 3, line, length);
+            line[length] = 0;
+            tail += length + 3;
+            tb->m_tail.store(tail, std::memory_order_release);
+            writeLine(line, header[0]);
+            m_file_size += length;
+            written = true;
+            if (m_file_batch.size() > ThreadBuffer::SIZE)
+                writeFileBatch();
+        }
+        if (dropped > 0)
+        {
+            int length = snprintf(line, sizeof(line), "[warn   ] Log: %u "
+                                  "lines were dropped because the log buffer "
+                                  "was full.\n", dropped);
+            writeLine(line, LL_WARN);
+            m_file_size += length;
+            written = true;
+        }
+    }   // for tb in buffers
+    writeFileBatch();
+    m_batch_file_output = false;
+
+    if (!orphaned.empty())
+    {
+        m_thread_buffers.lock();
+        std::vector<ThreadBuffer*> &all = m_thread_buffers.getData();
+        for (ThreadBuffer *tb : orphaned)
+            all.erase(std::find(all.begin(), all.end(), tb));
+        m_thread_buffers.unlock();
+        for (ThreadBuffer *tb : orphaned)
+            delete tb;
+    }
+    return written;
+}   // writeThreadBuffers
+
+// ----------------------------------------------------------------------------
+/** Writes the lines collected in m_file_batch to the log file. Must be called
+ *  with m_writer_lock held.
+ */
+void Log::writeFileBatch()
+{
+    if (m_file_stdout && !m_file_batch.empty())
+        fwrite(m_file_batch.data(), 1, m_file_batch.size(), m_file_stdout);
+    m_file_batch.clear();
+}   // writeFileBatch
+
+// ----------------------------------------------------------------------------
+/** The main loop of the writer thread in asynchronous mode: it regularly
+ *  writes the lines from all thread buffers, and rotates the log file if
+ *  necessary.
+ */
+void Log::writerLoop()
+{
+    VS::setThreadName("LogWriter");
+    while (m_async.load())
+    {
+        bool written;
+        {
+            std::lock_guard<std::mutex> lock(m_writer_lock);
+            written = writeThreadBuffers();
+            if (m_file_stdout &&
+                ((m_rotate_size > 0 && m_file_size >= m_rotate_size) ||
+                 (m_rotate_time > 0 &&
+                  std::time(nullptr) - m_file_open_time >= m_rotate_time)))
+            {
+                rotateOutputFile();
+            }
+        }
+        // Only wait if there was nothing to write, so that the writer can
+        // keep up with bursts of messages.
+        if (!written)
+            StkTime::sleep(10);
+    }
+}   // writerLoop
+
+// ----------------------------------------------------------------------------
+/** Closes the log file, renames it and its backups (file becomes file.1,
+ *  file.1 becomes file.2 etc) and opens a new log file. Must be called with
+ *  m_writer_lock held.
+ */
+void Log::rotateOutputFile()
+{
+    fclose(m_file_stdout);
+    m_file_stdout = NULL;
+
+    const int NUM_BACKUPS = 3;
+    for (int i = NUM_BACKUPS; i > 0; i--)
+    {
+        std::string older = m_file_name + "." + StringUtils::toString(i);
+        std::string newer = i > 1
+                          ? m_file_name + "." + StringUtils::toString(i - 1)
+                          : m_file_name;
+        FileUtils::removeU8Path(older);
+        FileUtils::renameU8Path(newer, older);
+    }
+    m_file_stdout = FileUtils::fopenU8Path(m_file_name, "w");
+    if (m_file_stdout)
+        setvbuf(m_file_stdout, NULL, _IONBF, 0);
+    m_file_size = 0;
+    m_file_open_time = std::time(nullptr);
+}   // rotateOutputFile
+
+// ----------------------------------------------------------------------------
+/** Switches asynchronous logging on or off. In asynchronous mode each thread
+ *  only copies its messages into its own ring buffer, and a separate writer
+ *  thread does all terminal and file output, so that e.g. the game and
+ *  network threads never wait for a slow disk.
+ *  \param async True to enable asynchronous logging.
+ */
+void Log::setAsync(bool async)
+{
+    if (async == m_async.load())
+        return;
+    if (async)
+    {
+        static bool exit_handler_added = false;
+        if (!exit_handler_added)
+        {
+            // Make sure all messages are written on exit, and that the
+            // thread is stopped before the static data is destroyed.
+            exit_handler_added = true;
+            atexit([]() { Log::setAsync(false); });
+        }
+        m_async.store(true);
+        m_writer_thread = std::thread(writerLoop);
+        return;
+    }
+    m_async.store(false);
+    if (m_writer_thread.joinable())
+        m_writer_thread.join();
+    std::lock_guard<std::mutex> lock(m_writer_lock);
+    writeThreadBuffers();
+}   // setAsync
+
+// ----------------------------------------------------------------------------
+/** Sets when the log file is rotated. This is only done by the writer thread
+ *  in asynchronous mode.
+ *  \param max_size Rotate the log file once it is bigger than this many
+ *         bytes, 0 for no limit.
+ *  \param max_seconds Rotate the log file once it has been open for this
+ *         many seconds, 0 for no limit.
+ */
+void Log::setRotation(size_t max_size, int max_seconds)
+{
+    std::lock_guard<std::mutex> lock(m_writer_lock);
+    m_rotate_size = max_size;
+    m_rotate_time = max_seconds;
+}   // setRotation
+
 // ----------------------------------------------------------------------------
 /** This function opens the files that will contain the output.
  *  \param logout : name of the file that will contain stdout output
@@ -294,23 +667,31 @@ void Log::flushBuffers()
  */
 void Log::openOutputFiles(const std::string &logout)
 {
-    m_file_stdout = FileUtils::fopenU8Path(logout, "w");
+    {
+        std::lock_guard<std::mutex> lock(m_writer_lock);
+        m_file_name = logout;
+        m_file_size = 0;
+        m_file_open_time = std::time(nullptr);
+        m_file_stdout = FileUtils::fopenU8Path(logout, "w");
+        // Disable buffering so that messages are seen asap
+        if (m_file_stdout)
+            setvbuf(m_file_stdout, NULL, _IONBF, 0);
+    }
     if (!m_file_stdout)
     {
         Log::error("main", "Can not open log file '%s'. Writing to "
                            "stdout instead.", logout.c_str());
     }
-    else
-    {
-        // Disable buffering so that messages are seen asap
-        setvbuf(m_file_stdout, NULL, _IONBF, 0);
-    }
 } // closeOutputFiles
 
 // ----------------------------------------------------------------------------
 /** Function to close output files */
 void Log::closeOutputFiles()
 {
-    fclose(m_file_stdout);
+    setAsync(false);
+    std::lock_guard<std::mutex> lock(m_writer_lock);
+    if (m_file_stdout)
+        fclose(m_file_stdout);
+    m_file_stdout = NULL;
 } // closeOutputFiles
 
@@ -23,10 +23,14 @@
 #include "utils/synchronised.hpp"
 
 #include <assert.h>
+#include <atomic>
+#include <ctime>
+#include <mutex>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string>
+#include <thread>
 #include <vector>
 
 
@@ -81,9 +85,52 @@ private:
     /** An optional prefix to be printed. */
     static std::string m_prefix;
 
+    /** The per-thread ring buffers used for asynchronous logging, see
+     *  log.cpp. */
+    struct ThreadBuffer;
+    static Synchronised<std::vector<ThreadBuffer*> > m_thread_buffers;
+
+    /** True if log lines are written by m_writer_thread. */
+    static std::atomic<bool> m_async;
+
+    /** The thread writing the log lines in asynchronous mode. */
+    static std::thread m_writer_thread;
+
+    /** Protects the output (and the consumer side of the thread buffers)
+     *  in asynchronous mode. */
+    static std::mutex m_writer_lock;
+
+    /** Lines for the log file collected by writeThreadBuffers(), so that
+     *  they can be written with a single call. */
+    static std::string m_file_batch;
+
+    /** True while writeThreadBuffers() collects the lines in m_file_batch. */
+    static bool m_batch_file_output;
+
+    /** Name of the log file, used for rotating it. */
+    static std::string m_file_name;
+
+    /** Number of bytes written to the log file since it was opened. */
+    static size_t m_file_size;
+
+    /** Time when the log file was opened. */
+    static time_t m_file_open_time;
+
+    /** Maximum size of the log file before it is rotated, 0 if unlimited. */
+    static size_t m_rotate_size;
+
+    /** Maximum age (in seconds) of the log file before it is rotated, 0 if
+     *  unlimited. */
+    static int m_rotate_time;
+
     static void setTerminalColor(LogLevel level);
     static void resetTerminalColor();
     static void writeLine(const char *line, int level);
+    static bool addToThreadBuffer(const char *line, int length, int level);
+    static bool writeThreadBuffers();
+    static void writeFileBatch();
+    static void writerLoop();
+    static void rotateOutputFile();
 
     static void printMessage(int level, const char *component,
                              const char *format, VALIST va_list);
@@ -121,6 +168,8 @@ public:
     static void closeOutputFiles();
     static void flushBuffers();
     static void toggleConsoleLog(bool val);
+    static void setAsync(bool async);
+    static void setRotation(size_t max_size, int max_seconds);
 
     // ------------------------------------------------------------------------
     /** Sets the number of lines to buffer. Setting the buffer size to a 
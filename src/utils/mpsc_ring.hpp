@@ -0,0 +1,130 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2020 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_MPSC_RING_HPP
+#define HEADER_MPSC_RING_HPP
+
+#include "utils/no_copy.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+
+/** A bounded multiple producer, single consumer queue without locks. Each
+ *  slot stores a sequence number which tells producers and the consumer
+ *  whether the slot is free or holds a published element, so producers only
+ *  compete on one compare-and-swap of the tail index, and the consumer never
+ *  writes to the tail at all.
+ *  The capacity must be a power of two.
+ */
+template<typename T>
+class MPSCRing : public NoCopy
+{
+private:
+    struct Slot
+    {
+        std::atomic<size_t> m_sequence;
+        T m_data;
+    };
+
+    /** The slots, capacity = m_mask + 1. */
+    std::unique_ptr<Slot[]> m_slots;
+
+    const size_t m_mask;
+
+    /** Next position to be claimed by a producer. */
+    std::atomic<size_t> m_tail;
+
+    /** Next position to be read by the consumer, only used by the consumer
+     *  thread, but read by size(). */
+    std::atomic<size_t> m_head;
+
+public:
+    // ------------------------------------------------------------------------
+    MPSCRing(size_t capacity)
+        : m_slots(new Slot[capacity]), m_mask(capacity - 1)
+    {
+        assert(capacity >= 2 && (capacity & (capacity - 1)) == 0);
+        for (size_t i = 0; i < capacity; i++)
+            m_slots[i].m_sequence.store(i, std::memory_order_relaxed);
+        m_tail.store(0, std::memory_order_relaxed);
+        m_head.store(0, std::memory_order_relaxed);
+    }   // MPSCRing
+    // ------------------------------------------------------------------------
+    /** Adds an element, can be called from any thread.
+     *  \param data The element to add.
+     *  \param cas_retries If not NULL, the number of failed compare-and-swap
+     *         of the tail (i.e. times another producer was faster) is added.
+     *  \return False if the ring is full, the element was not added then.
+     */
+    bool push(const T& data, unsigned* cas_retries = NULL)
+    {
+        size_t pos = m_tail.load(std::memory_order_relaxed);
+        Slot* slot;
+        while (true)
+        {
+            slot = &m_slots[pos & m_mask];
+            size_t seq = slot->m_sequence.load(std::memory_order_acquire);
+            ptrdiff_t diff = (ptrdiff_t)seq - (ptrdiff_t)pos;
+            if (diff == 0)
+            {
+                if (m_tail.compare_exchange_weak(pos, pos + 1,
+                    std::memory_order_relaxed))
+                    break;
+                if (cas_retries)
+                    (*cas_retries)++;
+            }
+            else if (diff < 0)
+                return false;
+            else
+                pos = m_tail.load(std::memory_order_relaxed);
+        }
+        slot->m_data = data;
+        slot->m_sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }   // push
+    // ------------------------------------------------------------------------
+    /** Removes the oldest element, must only be called from the consumer
+     *  thread.
+     *  \return False if no (completely written) element is available.
+     */
+    bool pop(T* data)
+    {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        Slot* slot = &m_slots[head & m_mask];
+        if (slot->m_sequence.load(std::memory_order_acquire) != head + 1)
+            return false;
+        *data = slot->m_data;
+        slot->m_sequence.store(head + m_mask + 1, std::memory_order_release);
+        m_head.store(head + 1, std::memory_order_relaxed);
+        return true;
+    }   // pop
+    // ------------------------------------------------------------------------
+    /** Returns the approximate number of elements, for statistics only. */
+    size_t size() const
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        size_t head = m_head.load(std::memory_order_relaxed);
+        return tail > head ? tail - head : 0;
+    }   // size
+    // ------------------------------------------------------------------------
+    size_t capacity() const                              { return m_mask + 1; }
+};   // class MPSCRing
+
+#endif
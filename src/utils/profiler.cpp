@@ -592,3 +592,24 @@ void Profiler::writeToFile()
     m_lock.unlock();
 
 }   // writeFile
+
+//-----------------------------------------------------------------------------
+/** Returns the total time (in ms) spent in each event since the profiler was
+ *  started. Events with the same name in different threads are added up.
+ *  Note that nested events are included in the time of their parents.
+ *  \param totals On return contains the total time for each event name.
+ */
+void Profiler::getTotals(std::map<std::string, double> *totals)
+{
+    m_lock.lock();
+    for (int thread_id = 0; thread_id < m_threads_used; thread_id++)
+    {
+        const ThreadData &td = m_all_threads_data[thread_id];
+        for (AllEventData::const_iterator i = td.m_all_event_data.begin();
+             i != td.m_all_event_data.end(); ++i)
+        {
+            (*totals)[i->first] += i->second.getTotal();
+        }
+    }   // for all thread_ids
+    m_lock.unlock();
+}   // getTotals
@@ -170,12 +170,17 @@ private:
         /** Vector of all buffered markers. */
         std::vector<Marker> m_all_markers;
 
+        /** Total time spent in this event since the profiler was started,
+         *  independent of the size of the circular buffer. */
+        double m_total;
+
     public:
-        EventData() {}
+        EventData() { m_total = 0; }
         EventData(video::SColor colour, int max_size)
         {
             m_all_markers.resize(max_size);
             m_colour = colour;
+            m_total  = 0;
         }   // EventData
         // --------------------------------------------------------------------
         /** Records the start of an event for a given frame. */
@@ -189,7 +194,9 @@ private:
         void setEnd(size_t frame, double end)
         {
             assert(frame < m_all_markers.capacity());
+            double duration = m_all_markers[frame].getDuration();
             m_all_markers[frame].setEnd(end);
+            m_total += m_all_markers[frame].getDuration() - duration;
         }   // setEnd
         // --------------------------------------------------------------------
         const Marker& getMarker(int n) const { return m_all_markers[n]; }
@@ -198,6 +205,9 @@ private:
         /** Returns the colour for this event. */
         video::SColor getColour() const { return m_colour;  }
         // --------------------------------------------------------------------
+        /** Returns the total time (in ms) spent in this event. */
+        double getTotal() const { return m_total; }
+        // --------------------------------------------------------------------
     };   // EventData
 
     // ========================================================================
@@ -288,6 +298,7 @@ public:
     void     draw();
     void     onClick(const core::vector2di& mouse_pos);
     void     writeToFile();
+    void     getTotals(std::map<std::string, double> *totals);
 
     // ------------------------------------------------------------------------
     bool isFrozen() const { return m_freeze_state == FROZEN; }
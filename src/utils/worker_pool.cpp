@@ -0,0 +1,205 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2020 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "utils/worker_pool.hpp"
+
+#include "utils/log.hpp"
+
+#include <algorithm>
+
+WorkerPool *WorkerPool::m_worker_pool = NULL;
+int         WorkerPool::m_num_threads = -1;
+
+/** More threads than this rarely help for the small per time step jobs. */
+static const unsigned int MAX_DEFAULT_WORKERS = 7;
+
+// ----------------------------------------------------------------------------
+/** Returns the worker pool, creating it on first use.
+ */
+WorkerPool* WorkerPool::get()
+{
+    if (!m_worker_pool)
+    {
+        unsigned int n;
+        if (m_num_threads >= 0)
+            n = (unsigned int)m_num_threads;
+        else
+        {
+            // The calling thread works on each job, too
+            n = std::thread::hardware_concurrency();
+            n = n > 1 ? std::min(n - 1, MAX_DEFAULT_WORKERS) : 0;
+        }
+        m_worker_pool = new WorkerPool(n);
+    }
+    return m_worker_pool;
+}   // get
+
+// ----------------------------------------------------------------------------
+/** Stops all worker threads and deletes the pool.
+ */
+void WorkerPool::destroy()
+{
+    delete m_worker_pool;
+    m_worker_pool = NULL;
+}   // destroy
+
+// ----------------------------------------------------------------------------
+WorkerPool::WorkerPool(unsigned int num_threads)
+{
+    m_job          = NULL;
+    m_job_size     = 0;
+    m_next_index.store(0);
+    m_running.store(false);
+    m_job_id       = 0;
+    m_busy_workers = 0;
+    m_quit         = false;
+    for (unsigned int i = 0; i < num_threads; i++)
+        m_threads.emplace_back(&WorkerPool::workerLoop, this);
+    if (num_threads > 0)
+        Log::info("WorkerPool", "Started %d worker threads.", num_threads);
+}   // WorkerPool
+
+// ----------------------------------------------------------------------------
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_job_started.notify_all();
+    for (std::thread& t : m_threads)
+        t.join();
+}   // ~WorkerPool
+
+// ----------------------------------------------------------------------------
+/** The main loop of each worker thread: waits for a job, works on it till
+ *  all indices are taken, and reports back.
+ */
+void WorkerPool::workerLoop()
+{
+    unsigned int last_job_id = 0;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+        m_job_started.wait(lock, [this, &last_job_id]()
+            {
+                return m_quit || m_job_id != last_job_id;
+            });
+        if (m_quit)
+            return;
+        last_job_id = m_job_id;
+        lock.unlock();
+        runJob();
+        lock.lock();
+        if (--m_busy_workers == 0)
+            m_job_done.notify_one();
+    }
+}   // workerLoop
+
+// ----------------------------------------------------------------------------
+/** Calls the job function for indices which are not taken yet.
+ */
+void WorkerPool::runJob()
+{
+    while (true)
+    {
+        unsigned int i = m_next_index.fetch_add(1);
+        if (i >= m_job_size)
+            return;
+        (*m_job)(i);
+    }
+}   // runJob
+
+// ----------------------------------------------------------------------------
+/** Calls f(i) for all i in [0, count), distributed over all threads of the
+ *  pool, and returns once all calls are done. The order in which the calls
+ *  happen is undefined, so f must only modify data which belongs to index i.
+ *  \param count Number of indices.
+ *  \param f The function to call.
+ */
+void WorkerPool::parallelFor(unsigned int count,
+                             const std::function<void(unsigned int)> &f)
+{
+    bool running = false;
+    if (m_threads.empty() || count < 2 ||
+        !m_running.compare_exchange_strong(running, true))
+    {
+        for (unsigned int i = 0; i < count; i++)
+            f(i);
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_job          = &f;
+    m_job_size     = count;
+    m_next_index.store(0);
+    m_busy_workers = (unsigned int)m_threads.size();
+    m_job_id++;
+    lock.unlock();
+    m_job_started.notify_all();
+
+    runJob();
+
+    // Workers which were too slow to take any index still have to report
+    // back, since they access the job data.
+    lock.lock();
+    m_job_done.wait(lock, [this]() { return m_busy_workers == 0; });
+    m_job = NULL;
+    m_running.store(false);
+}   // parallelFor
+
+// ----------------------------------------------------------------------------
+/** Unit testing function.
+ */
+void WorkerPool::unitTesting()
+{
+    WorkerPool pool(3);
+    for (unsigned int count = 0; count < 100; count += 7)
+    {
+        std::vector<int> done(count, 0);
+        pool.parallelFor(count, [&done](unsigned int i) { done[i]++; });
+        if (std::count(done.begin(), done.end(), 1) != (int)count)
+        {
+            Log::fatal("WorkerPool", "Not all of %u indices were done once.",
+                       count);
+        }
+    }
+
+    // A nested job is run sequentially by the thread that started it
+    std::vector<int> done(8 * 8, 0);
+    pool.parallelFor(8, [&pool, &done](unsigned int i)
+        {
+            pool.parallelFor(8, [&done, i](unsigned int j)
+                {
+                    done[i * 8 + j]++;
+                });
+        });
+    if (std::count(done.begin(), done.end(), 1) != 8 * 8)
+        Log::fatal("WorkerPool", "Nested job was not done correctly.");
+
+    // Without worker threads everything is done by the calling thread
+    WorkerPool sequential(0);
+    std::thread::id caller = std::this_thread::get_id();
+    bool same_thread = true;
+    sequential.parallelFor(10, [caller, &same_thread](unsigned int i)
+        {
+            same_thread &= std::this_thread::get_id() == caller;
+        });
+    if (!same_thread)
+        Log::fatal("WorkerPool", "Job without workers used another thread.");
+}   // unitTesting
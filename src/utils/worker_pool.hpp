@@ -0,0 +1,113 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2020 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_WORKER_POOL_HPP
+#define HEADER_WORKER_POOL_HPP
+
+#include "utils/no_copy.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/** A small pool of threads which are kept alive for the whole game, so that
+ *  short jobs which are run every time step (e.g. preparing the kart
+ *  updates) can be split over all cores without creating threads each time.
+ *  The thread calling parallelFor() works on the job, too, and only returns
+ *  once all parts are done. Only one job is run at a time: if the pool is
+ *  busy (e.g. parallelFor() is called from inside a job, or by two threads
+ *  at the same time), the job is run sequentially by the calling thread.
+ *  The pool is a singleton which is created on first use with
+ *  the number of worker threads given to setNumThreads() (default: one less
+ *  than the number of cores).
+ */
+class WorkerPool : public NoCopy
+{
+private:
+    /** The singleton. */
+    static WorkerPool *m_worker_pool;
+
+    /** Number of worker threads to create, -1 to use all cores. */
+    static int m_num_threads;
+
+    std::vector<std::thread> m_threads;
+
+    /** Protects the job data and the counters below. */
+    std::mutex m_mutex;
+
+    /** Set while a job is run, makes sure that only one job is run at a
+     *  time. */
+    std::atomic<bool> m_running;
+
+    /** Wakes up the workers when a new job is started. */
+    std::condition_variable m_job_started;
+
+    /** Wakes up the thread in parallelFor() when all workers are done. */
+    std::condition_variable m_job_done;
+
+    /** The function to call for each index of the current job. */
+    const std::function<void(unsigned int)> *m_job;
+
+    /** Number of indices of the current job. */
+    unsigned int m_job_size;
+
+    /** The next index to be done, workers take indices one by one. */
+    std::atomic<unsigned int> m_next_index;
+
+    /** Increased for each job, so workers know that there is a new job. */
+    unsigned int m_job_id;
+
+    /** Number of workers which have not finished the current job. */
+    unsigned int m_busy_workers;
+
+    /** Set to stop all threads. */
+    bool m_quit;
+
+    // ------------------------------------------------------------------------
+    WorkerPool(unsigned int num_threads);
+    // ------------------------------------------------------------------------
+    ~WorkerPool();
+    // ------------------------------------------------------------------------
+    void workerLoop();
+    // ------------------------------------------------------------------------
+    void runJob();
+
+public:
+    // ------------------------------------------------------------------------
+    static WorkerPool* get();
+    // ------------------------------------------------------------------------
+    static void destroy();
+    // ------------------------------------------------------------------------
+    /** Sets the number of worker threads, must be called before the pool
+     *  is used. 0 disables the pool, i.e. all jobs are run sequentially. */
+    static void setNumThreads(int n)                     { m_num_threads = n; }
+    // ------------------------------------------------------------------------
+    static void unitTesting();
+    // ------------------------------------------------------------------------
+    void parallelFor(unsigned int count,
+                     const std::function<void(unsigned int)> &f);
+    // ------------------------------------------------------------------------
+    /** Returns the number of worker threads (not counting the thread which
+     *  calls parallelFor()). */
+    unsigned int getNumWorkers() const { return (unsigned int)m_threads.size(); }
+};   // WorkerPool
+
+#endif
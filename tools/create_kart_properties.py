@@ -30,7 +30,7 @@ import sys
 characteristics = """Suspension: stiffness, rest, travel, expSpringResponse(bool), maxForce
 Stability: rollInfluence, chassisLinearDamping, chassisAngularDamping, downwardImpulseFactor, trackConnectionAccel, angularFactor(std::vector<float>/floatVector), smoothFlyingImpulse
 Turn: radius(InterpolationArray), timeResetSteer, timeFullSteer(InterpolationArray)
-Engine: power, maxSpeed, brakeFactor, brakeTimeIncrease, maxSpeedReverseRatio
+Engine: power, maxSpeed, genericMaxSpeed, brakeFactor, brakeTimeIncrease, maxSpeedReverseRatio
 Gear: switchRatio(std::vector<float>/floatVector), powerIncrease(std::vector<float>/floatVector)
 Mass
 Wheels: dampingRelaxation, dampingCompression
@@ -47,7 +47,7 @@ Plunger: bandMaxLength, bandForce, bandDuration, bandSpeedIncrease, bandFadeOutT
 Startup: time(std::vector<float>/floatVector), boost(std::vector<float>/floatVector)
 Rescue: duration, vertOffset, height
 Explosion: duration, radius, invulnerabilityTime
-Nitro: duration, engineForce, consumption, smallContainer, bigContainer, maxSpeedIncrease, fadeOutTime, max
+Nitro: duration, engineForce, engineMult, consumption, smallContainer, bigContainer, maxSpeedIncrease, fadeOutTime, max
 Slipstream: durationFactor, baseSpeed, length, width, innerFactor, minCollectTime, maxCollectTime, addPower, minSpeed, maxSpeedIncrease, fadeOutTime
 Skid: increase, decrease, max, timeTillMax, visual, visualTime, revertVisualTime, minSpeed, timeTillBonus(std::vector<float>/floatVector), bonusSpeed(std::vector<float>/floatVector), bonusTime(std::vector<float>/floatVector), bonusForce(std::vector<float>/floatVector), physicalJumpTime, graphicalJumpTime, postSkidRotateFactor, reduceTurnMin, reduceTurnMax, enabled(bool)"""
 
@@ -182,31 +182,44 @@ def createAcGetter(groups):
 }}  // get{1}
 """.format(m.typeC, nameTitle, nameUnderscore.upper(), typeC, result))
 
+""" Returns the type returned by the inline getters, larger types are returned
+    by reference. """
+def getterType(member):
+    if member.typeC == "float" or member.typeC == "bool":
+        return member.typeC
+    return "const {0}&".format(member.typeC)
+
 def createKpDefs(groups):
     for g in groups:
         print()
         for m in g.members:
             nameTitle = joinSubName(g, m, True)
-            nameUnderscore = joinSubName(g, m, False)
-            typeC = m.typeC
 
-            print("    {0} get{1}() const;".
-                format(typeC, nameTitle, nameUnderscore))
+            print("    {0} get{1}() const\n        {{ return m_cached_characteristic->get{1}(); }}".
+                format(getterType(m), nameTitle))
+
+def createCcValues(groups):
+    for g in groups:
+        print()
+        for m in g.members:
+            nameUnderscore = joinSubName(g, m, False)
+            print("        {0} m_{1};".format(m.typeC, nameUnderscore))
 
-def createKpGetter(groups):
+def createCcGetter(groups):
     for g in groups:
+        print()
         for m in g.members:
             nameTitle = joinSubName(g, m, True)
             nameUnderscore = joinSubName(g, m, False)
-            typeC = m.typeC
-            result = "result"
+            print("    {0} get{1}() const\n        {{ return m_values.m_{2}; }}".
+                format(getterType(m), nameTitle, nameUnderscore))
 
-            print("""// ----------------------------------------------------------------------------
-{1} KartProperties::get{0}() const
-{{
-    return m_cached_characteristic->get{0}();
-}}  // get{0}
-""".format(nameTitle, typeC))
+def createCcValue(groups):
+    for g in groups:
+        for m in g.members:
+            nameUnderscore = joinSubName(g, m, False)
+            print("    case {0}:\n        return Value(&values->m_{1});".
+                format(nameUnderscore.upper(), nameUnderscore))
 
 def createGetType(groups):
     for g in groups:
@@ -244,8 +257,10 @@ functions = {
     "acgetter": (createAcGetter, "Implement the getters",                                  "karts/abstract_characteristic.cpp"),
     "getType":  (createGetType,  "Implement the getType function",                         "karts/abstract_characteristic.cpp"),
     "getName":  (createGetName,  "Implement the getName function",                         "karts/abstract_characteristic.cpp"),
-    "kpdefs":   (createKpDefs,   "Create the header function definitions for the getters", "karts/kart_properties.hpp"),
-    "kpgetter": (createKpGetter, "Implement the getters",                                  "karts/kart_properties.cpp"),
+    "kpdefs":   (createKpDefs,   "Create the inline getters",                              "karts/kart_properties.hpp"),
+    "ccvalues": (createCcValues, "Create the members which store the cached values",       "karts/cached_characteristic.hpp"),
+    "ccgetter": (createCcGetter, "Create the inline getters of the cached values",         "karts/cached_characteristic.hpp"),
+    "ccvalue":  (createCcValue,  "Implement the getValue function",                        "karts/cached_characteristic.cpp"),
     "loadXml":  (createLoadXml,  "Code to load the characteristics from an xml file",      "karts/xml_characteristic.cpp"),
 }
 